@@ -0,0 +1,614 @@
+/* Copyright (c) 2026, Edwin Freekenhorst
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   DLSw_bench.c: DLSw router loopback throughput and latency benchmark.
+
+   The DLSw router (DLSw_rt) only implements the target side of a circuit,
+   so two router instances cannot set up a circuit between themselves.
+   The benchmark therefore runs one DLSw_rt instance on loopback between
+   two in-process stand-ins:
+
+     SDLC primary  <--- line 127.0.0.1:375nn --->  DLSw_rt  <--- 2065 --->  DLSw peer
+     (NCP/LIB role)                                                (origin router role)
+
+   - The peer stand-in listens on 127.0.0.2:2065, exchanges capabilities,
+     sets up the circuit (CANUREACH, REACH_ACK, XID, CONTACTED) and then
+     sends INFOFRAMEs downstream, obeying the DLSw flow control (IFCM) grants.
+   - The SDLC primary stand-in accepts the line and RS232 connections,
+     sends SNRM, then polls with RR and sends I-frames upstream.
+
+   Each side keeps at most 'window' frames outstanding per direction.
+   Reported are the circuit setup times, frames/s, bytes/s and frame
+   latency percentiles per direction, and the time spent waiting for
+   flow control grants (FCB pacing).
+
+   With -udp DLSw_rt runs as a DLSw version 2 router without a configured
+   peer: the peer stand-in first explores with a CANUREACH_ex over UDP,
+   and the TCP connections are only set up once DLSw_rt has answered.
+
+   Usage: DLSw_bench [-dlsw path] [-frames n] [-size n] [-window n] [-ipw n] [-line n] [-time sec] [-udp] [-v]
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "DLSw_defs.h"
+
+#define SDLCBASE   37500
+#define LINE_IP    "127.0.0.1"                          /* DLSw_rt and SDLC line address */
+#define PEER_IP    "127.0.0.2"                          /* Peer stand-in address         */
+#define MAXFRAME   4096                                 /* Largest I-frame size          */
+
+/* SDLC frame definition */
+#define BFlag          0
+#define FAddr          1
+#define FCntl          2
+#define CPoll          0x10
+#define SNRM           0x83
+#define UA             0x63
+#define RR             0x01
+#define RTS            0x08
+
+char     *dlsw_path = "BIN/DLSw";                       /* DLSw router executable        */
+int      nframes = 1000;                                /* Frames per direction          */
+int      fsize = 256;                                   /* I-field size                  */
+int      window = 7;                                    /* Outstanding frames            */
+int      ipw = 20;                                      /* DLSw initial pacing window    */
+int      linenum = 20;                                  /* SDLC line number              */
+int      maxtime = 60;                                  /* Time limit (sec)              */
+int      verbose = 0;                                   /* Show DLSw_rt output           */
+int      udp = 0;                                       /* Explore over UDP (v2)         */
+
+int      line_lfd, peer_lfd;                            /* Listening sockets             */
+int      line_fd, sig_fd;                               /* SDLC line and RS232 sockets   */
+int      peer_wfd, peer_rfd;                            /* Peer write (to rt) and read   */
+
+pthread_mutex_t bench_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t  bench_cond = PTHREAD_COND_INITIALIZER;
+
+int      connected = 0;                                 /* Circuit CONNECTED             */
+int      dn_sent, dn_rcvd;                              /* Downstream (peer -> SDLC)     */
+int      up_sent, up_rcvd;                              /* Upstream (SDLC -> peer)       */
+double   *dn_tsent, *dn_lat;                            /* Send time and latency (usec)  */
+double   *up_tsent, *up_lat;
+int      granted;                                       /* Peer granted units            */
+int      fca_due;                                       /* Flow control ack due          */
+long     ifcm_cnt, pace_stalls;                         /* IFCMs received, stalls        */
+double   pace_wait;                                     /* Time waiting for grants       */
+double   t_canureach, t_icanreach, t_contact, t_snrm, t_ua;
+double   t_explore, t_explored, t_tcp;                  /* UDP explorer and TCP setup    */
+struct timespec t_base;
+
+// ***************************************************************
+// Function to return the time since start in usec.
+// ***************************************************************
+static double now_usec() {
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return ((now.tv_sec - t_base.tv_sec) * 1000000.0) + ((now.tv_nsec - t_base.tv_nsec) / 1000.0);
+}
+
+// ***************************************************************
+// Function to receive exactly len bytes.
+// ***************************************************************
+static int recv_full(int fd, uint8_t *buf, int len) {
+   int rc, got = 0;
+   while (got < len) {
+      rc = recv(fd, buf + got, len - got, 0);
+      if (rc < 1) return -1;
+      got = got + rc;
+   }
+   return got;
+}
+
+// ***************************************************************
+// Function to read one DLSw message. Returns the message length.
+// ***************************************************************
+static int read_msg(int fd, uint8_t *buf) {
+   int hlen, mlen;
+   if (recv_full(fd, buf, LEN_INFO) < 0) return -1;
+   hlen = buf[HDR_HLEN];
+   mlen = (buf[HDR_MLEN] << 8) + buf[HDR_MLEN+1];
+   if ((hlen < LEN_INFO) || (hlen + mlen > 65536)) return -1;
+   if (recv_full(fd, buf + LEN_INFO, hlen + mlen - LEN_INFO) < 0) return -1;
+   return hlen + mlen;
+}
+
+// ***************************************************************
+// Functions to encode and decode the sequence number in an I-field.
+// Each byte holds 6 bits in the range 0x40-0x7F, so the payload can
+// never contain the 47 0F 7E link trailer.
+// ***************************************************************
+static void put_seq(uint8_t *p, int seq) {
+   p[0] = 0x40 | ((seq >> 18) & 0x3F);
+   p[1] = 0x40 | ((seq >> 12) & 0x3F);
+   p[2] = 0x40 | ((seq >> 6) & 0x3F);
+   p[3] = 0x40 | (seq & 0x3F);
+}
+
+static int get_seq(uint8_t *p) {
+   return ((p[0] & 0x3F) << 18) | ((p[1] & 0x3F) << 12) | ((p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+}
+
+// ***************************************************************
+// Build a DLSw control message header.
+// ***************************************************************
+static void ctl_hdr(uint8_t *buf, uint8_t type, int mlen) {
+   memset(buf, 0, LEN_CTRL);
+   buf[HDR_VER] = DLSW_VER;
+   buf[HDR_HLEN] = LEN_CTRL;
+   buf[HDR_MLEN] = mlen >> 8;
+   buf[HDR_MLEN+1] = mlen & 0xFF;
+   buf[HDR_MTYP] = type;
+   buf[HDR_PID] = 0x42;
+   buf[HDR_NUM] = 0x01;
+   buf[HDR_DIR] = DIR_TGT;
+   buf[HDR_ODLC+3] = 0x01;                              // Origin data link correlator
+   buf[HDR_ODPID+3] = 0x01;                             // Origin DLC port id
+}
+
+// ***************************************************************
+// Peer stand-in receive side: upstream INFOFRAMEs and IFCMs.
+// ***************************************************************
+void *PEER_rx_thread(void *arg) {
+   uint8_t buf[65536];
+   int len, seq;
+   while ((len = read_msg(peer_rfd, buf)) > 0) {
+      pthread_mutex_lock(&bench_lock);
+      switch (buf[HDR_MTYP]) {
+         case ICANREACH:
+            t_icanreach = now_usec();
+            break;
+         case CONTACT:
+            t_contact = now_usec();
+            break;
+         case IFCM:
+            ifcm_cnt++;
+            if (buf[HDR_FCB] & FCB_FCI) {
+               if ((buf[HDR_FCB] & FCB_FCO) == FCO_RPT)
+                  granted = granted + ipw;              // Repeat window
+               fca_due = 1;
+            }
+            break;
+         case INFOFRAME:
+            if (len - buf[HDR_HLEN] >= 4) {
+               seq = get_seq(buf + buf[HDR_HLEN]);
+               if (seq < nframes) {
+                  up_lat[seq] = now_usec() - up_tsent[seq];
+                  up_rcvd++;
+               }
+            }
+            break;
+      }
+      pthread_cond_broadcast(&bench_cond);
+      pthread_mutex_unlock(&bench_lock);
+   }
+   return NULL;
+}
+
+// ***************************************************************
+// Wait (with the bench_lock held) until a condition is met.
+// ***************************************************************
+#define WAIT_FOR(cond) while (!(cond)) pthread_cond_wait(&bench_cond, &bench_lock)
+
+// ***************************************************************
+// Peer stand-in transmit side: circuit setup and downstream data.
+// ***************************************************************
+void *PEER_tx_thread(void *arg) {
+   uint8_t buf[65536];
+   double t;
+
+   // Capabilities exchange: our initial pacing window
+   ctl_hdr(buf, CAP_EXCHANGE, 0x14);
+   buf[LEN_CTRL + 0] = 0x00;                            // GDS length
+   buf[LEN_CTRL + 1] = 0x14;
+   buf[LEN_CTRL + 2] = 0x15;                            // GDS id 1520: capabilities
+   buf[LEN_CTRL + 3] = 0x20;
+   buf[LEN_CTRL + CAP_IPW_OFF] = 0x04;
+   buf[LEN_CTRL + CAP_IPW_OFF + 1] = CAP_IPW;
+   buf[LEN_CTRL + CAP_IPW_OFF + 2] = ipw >> 8;
+   buf[LEN_CTRL + CAP_IPW_OFF + 3] = ipw & 0xFF;
+   send(peer_wfd, buf, LEN_CTRL + 0x14, 0);
+
+   // Wait for the SDLC line to be connected, else DLSw_rt will not answer CANUREACH
+   while (line_fd < 1) usleep(1000);
+   usleep(100000);
+
+   // Circuit setup
+   t_canureach = now_usec();
+   ctl_hdr(buf, CANUREACH, 0);
+   send(peer_wfd, buf, LEN_CTRL, 0);
+   pthread_mutex_lock(&bench_lock);
+   WAIT_FOR(t_icanreach > 0);
+   pthread_mutex_unlock(&bench_lock);
+
+   ctl_hdr(buf, REACH_ACK, 0);
+   send(peer_wfd, buf, LEN_CTRL, 0);
+   granted = ipw;                                       // Flow control starts now
+
+   ctl_hdr(buf, XIDFRAME, 6);
+   buf[LEN_CTRL + 0] = 0x02;                            // PU type 2
+   buf[LEN_CTRL + 2] = 0x01;                            // IDBLK/IDNUM
+   buf[LEN_CTRL + 3] = 0x70;
+   buf[LEN_CTRL + 5] = 0x01;
+   send(peer_wfd, buf, LEN_CTRL + 6, 0);
+   pthread_mutex_lock(&bench_lock);
+   granted--;
+   WAIT_FOR(t_contact > 0);
+   pthread_mutex_unlock(&bench_lock);
+
+   ctl_hdr(buf, CONTACTED, 0);
+   send(peer_wfd, buf, LEN_CTRL, 0);
+   pthread_mutex_lock(&bench_lock);
+   granted--;
+   connected = 1;
+   pthread_cond_broadcast(&bench_cond);
+   pthread_mutex_unlock(&bench_lock);
+
+   // Steady state: downstream INFOFRAMEs. Wait for the UA first, as SNRM clears
+   // any I-frames DLSw_rt has queued for the SDLC line
+   pthread_mutex_lock(&bench_lock);
+   WAIT_FOR(t_ua > 0);
+   pthread_mutex_unlock(&bench_lock);
+   memset(buf, 0, LEN_INFO);
+   buf[HDR_VER] = DLSW_VER;
+   buf[HDR_HLEN] = LEN_INFO;
+   buf[HDR_MLEN] = fsize >> 8;
+   buf[HDR_MLEN+1] = fsize & 0xFF;
+   buf[HDR_MTYP] = INFOFRAME;
+   memset(buf + LEN_INFO, 0x40, fsize);
+   while (dn_sent < nframes) {
+      pthread_mutex_lock(&bench_lock);
+      WAIT_FOR(dn_sent - dn_rcvd < window);
+      if (granted <= 0) {                              // Wait for a flow control grant
+         pace_stalls++;
+         t = now_usec();
+         WAIT_FOR(granted > 0);
+         pace_wait += now_usec() - t;
+      }
+      granted--;
+      buf[HDR_FCB] = fca_due ? FCB_FCA : 0x00;
+      fca_due = 0;
+      put_seq(buf + LEN_INFO, dn_sent);
+      dn_tsent[dn_sent] = now_usec();
+      dn_sent++;
+      pthread_mutex_unlock(&bench_lock);
+      send(peer_wfd, buf, LEN_INFO + fsize, 0);
+   }
+   return NULL;
+}
+
+// ***************************************************************
+// SDLC primary stand-in: SNRM, upstream I-frames and RR polls.
+// ***************************************************************
+void *PRIM_thread(void *arg) {
+   uint8_t frame[MAXFRAME + 8], rbuf[65536], sig;
+   uint8_t Ns = 0, Nr = 0;
+   int rlen, flen, seq, Fptr, sockopt = 1;
+   struct pollfd pfd;
+
+   line_fd = accept(line_lfd, NULL, 0);                 // Data lead
+   sig_fd = accept(line_lfd, NULL, 0);                  // RS232 signal lead
+   recv(line_fd, rbuf, 1, MSG_WAITALL);                 // Lead identification (LEAD_DATA)
+   recv(sig_fd, rbuf, 3, MSG_WAITALL);                  // ...(LEAD_SIG and data lead port)
+   setsockopt(line_fd, IPPROTO_TCP, TCP_NODELAY, &sockopt, sizeof(sockopt));
+   printf("\rDLSwB: SDLC line connected\n");
+
+   pthread_mutex_lock(&bench_lock);
+   WAIT_FOR(connected);
+   pthread_mutex_unlock(&bench_lock);
+
+   // Wait for RTS from DLSw_rt (sent when CONNECTED), then SNRM
+   pfd.fd = sig_fd;
+   pfd.events = POLLIN;
+   if (poll(&pfd, 1, 5000) > 0)
+      read(sig_fd, &sig, 1);
+   t_snrm = now_usec();
+   frame[0] = 0x7E; frame[1] = 0xC1; frame[2] = SNRM + CPoll;
+   frame[3] = 0x47; frame[4] = 0x0F; frame[5] = 0x7E;
+   send(line_fd, frame, 6, 0);
+   recv_full(line_fd, rbuf, 6);
+   pthread_mutex_lock(&bench_lock);
+   t_ua = now_usec();
+   pthread_cond_broadcast(&bench_cond);
+   pthread_mutex_unlock(&bench_lock);
+
+   while ((up_rcvd < nframes) || (dn_rcvd < nframes)) {
+      // Upstream I-frames within the window
+      pthread_mutex_lock(&bench_lock);
+      while ((up_sent < nframes) && (up_sent - up_rcvd < window)) {
+         frame[BFlag] = 0x7E;
+         frame[FAddr] = 0xC1;
+         frame[FCntl] = (Nr << 5) | (Ns << 1);
+         Ns = (Ns + 1) & 0x07;
+         memset(frame + 3, 0x40, fsize);
+         put_seq(frame + 3, up_sent);
+         frame[fsize + 3] = 0x47; frame[fsize + 4] = 0x0F; frame[fsize + 5] = 0x7E;
+         up_tsent[up_sent] = now_usec();
+         up_sent++;
+         pthread_mutex_unlock(&bench_lock);
+         send(line_fd, frame, fsize + 6, 0);
+         pthread_mutex_lock(&bench_lock);
+      }
+      pthread_mutex_unlock(&bench_lock);
+
+      // Poll for downstream data
+      frame[0] = 0x7E; frame[1] = 0xC1; frame[2] = (Nr << 5) | RR | CPoll;
+      frame[3] = 0x47; frame[4] = 0x0F; frame[5] = 0x7E;
+      send(line_fd, frame, 6, 0);
+      rlen = 0;
+      do {                                              // Read the response frame
+         pfd.fd = line_fd;
+         if (poll(&pfd, 1, 5000) < 1) {
+            printf("\rDLSwB: No poll response from DLSw_rt\n");
+            return NULL;
+         }
+         flen = recv(line_fd, rbuf + rlen, sizeof(rbuf) - rlen, 0);
+         if (flen < 1) return NULL;
+         rlen = rlen + flen;
+      } while (!((rlen >= 6) && (rbuf[rlen-3] == 0x47) && (rbuf[rlen-2] == 0x0F) && (rbuf[rlen-1] == 0x7E)));
+
+      Fptr = 0;
+      if ((rbuf[FCntl] & 0x01) == 0x00) {               // I-frame ?
+         Nr = (Nr + 1) & 0x07;
+         seq = get_seq(rbuf + Fptr + 3);
+         pthread_mutex_lock(&bench_lock);
+         if (seq < nframes) {
+            dn_lat[seq] = now_usec() - dn_tsent[seq];
+            dn_rcvd++;
+         }
+         pthread_cond_broadcast(&bench_cond);
+         pthread_mutex_unlock(&bench_lock);
+      }
+      // Drain RS232 signals
+      pfd.fd = sig_fd;
+      if (poll(&pfd, 1, 0) > 0)
+         read(sig_fd, &sig, 1);
+   }
+   return NULL;
+}
+
+// ***************************************************************
+// DLSw version 2: explore over UDP before any TCP connection exists.
+// DLSw_rt only answers once its SDLC line is up, so retry for a while.
+// ***************************************************************
+static int explore_udp(void) {
+   struct sockaddr_in addr;
+   struct pollfd pfd;
+   uint8_t buf[LEN_CTRL];
+   int fd, i, sockopt = 1;
+
+   fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+   setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (void*)&sockopt, sizeof(sockopt));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = inet_addr(PEER_IP);
+   addr.sin_port = htons(DLSW_UDP_PORT);
+   if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+      printf("\rDLSwB: Cannot bind to %s:%d, %s\n", PEER_IP, DLSW_UDP_PORT, strerror(errno));
+      exit(EXIT_FAILURE);
+   }
+   addr.sin_addr.s_addr = inet_addr(LINE_IP);
+   pfd.fd = fd;
+   pfd.events = POLLIN;
+   for (i = 0; i < 100; i++) {
+      ctl_hdr(buf, CANUREACH, 0);
+      buf[HDR_SFLG] = SSPex;
+      t_explore = now_usec();
+      sendto(fd, buf, LEN_CTRL, 0, (struct sockaddr *)&addr, sizeof(addr));
+      if ((poll(&pfd, 1, 100) == 1) && (recv(fd, buf, LEN_CTRL, 0) == LEN_CTRL) &&
+          (buf[HDR_MTYP] == ICANREACH) && (buf[HDR_SFLG] & SSPex)) {
+         t_explored = now_usec();
+         close(fd);
+         return 0;
+      }
+   }
+   close(fd);
+   return -1;
+}
+
+// ***************************************************************
+// Create a listening socket on ip:port.
+// ***************************************************************
+static int listen_on(char *ip, int port) {
+   struct sockaddr_in addr;
+   int fd, sockopt = 1;
+   fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+   setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (void*)&sockopt, sizeof(sockopt));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = inet_addr(ip);
+   addr.sin_port = htons(port);
+   if ((bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) || (listen(fd, 5) != 0)) {
+      printf("\rDLSwB: Cannot listen on %s:%d, %s\n", ip, port, strerror(errno));
+      exit(EXIT_FAILURE);
+   }
+   return fd;
+}
+
+static int cmp_dbl(const void *a, const void *b) {
+   double x = *(double *)a, y = *(double *)b;
+   return (x > y) - (x < y);
+}
+
+// ***************************************************************
+// Print throughput and latency percentiles for one direction.
+// ***************************************************************
+static void report(char *dir, double *lat, int n, double secs) {
+   if (n == 0) {
+      printf("%-10s no frames\n", dir);
+      return;
+   }
+   qsort(lat, n, sizeof(double), cmp_dbl);
+   printf("%-10s %7d %10.0f %12.0f %9.1f %9.1f %9.1f %9.1f\n", dir, n, n / secs, (double)n * fsize / secs,
+          lat[n / 2], lat[(n * 90) / 100], lat[(n * 99) / 100], lat[n - 1]);
+}
+
+int main(int argc, char *argv[]) {
+   pthread_t prim_id, ptx_id, prx_id;
+   struct sockaddr_in addr;
+   char linestr[8];
+   pid_t pid;
+   int i;
+   double t_start, secs;
+
+   i = 1;
+   while (i < argc) {
+      if ((strcmp(argv[i], "-dlsw") == 0) && (i + 1 < argc)) {
+         dlsw_path = argv[i+1];
+      } else if ((strcmp(argv[i], "-frames") == 0) && (i + 1 < argc)) {
+         nframes = atoi(argv[i+1]);
+      } else if ((strcmp(argv[i], "-size") == 0) && (i + 1 < argc)) {
+         fsize = atoi(argv[i+1]);
+      } else if ((strcmp(argv[i], "-window") == 0) && (i + 1 < argc)) {
+         window = atoi(argv[i+1]);
+      } else if ((strcmp(argv[i], "-ipw") == 0) && (i + 1 < argc)) {
+         ipw = atoi(argv[i+1]);
+      } else if ((strcmp(argv[i], "-line") == 0) && (i + 1 < argc)) {
+         linenum = atoi(argv[i+1]);
+      } else if ((strcmp(argv[i], "-time") == 0) && (i + 1 < argc)) {
+         maxtime = atoi(argv[i+1]);
+      } else if (strcmp(argv[i], "-v") == 0) {
+         verbose = 1;
+         i++;
+         continue;
+      } else if (strcmp(argv[i], "-udp") == 0) {
+         udp = 1;
+         i++;
+         continue;
+      } else {
+         printf("\rDLSwB: invalid argument %s\n", argv[i]);
+         printf("\r   Valid arguments are:\n");
+         printf("\r   -dlsw {path}    : DLSw router executable (default BIN/DLSw)\n");
+         printf("\r   -frames {n}     : frames per direction\n");
+         printf("\r   -size {n}       : I-field size in bytes (4..%d)\n", MAXFRAME);
+         printf("\r   -window {n}     : outstanding frames per direction\n");
+         printf("\r   -ipw {n}        : DLSw initial pacing window\n");
+         printf("\r   -line {n}       : SDLC line number\n");
+         printf("\r   -time {sec}     : time limit\n");
+         printf("\r   -udp            : explore over UDP first (DLSw version 2)\n");
+         printf("\r   -v              : show DLSw router output\n");
+         return 1;
+      }
+      i = i + 2;
+   }
+   if ((nframes < 1) || (fsize < 4) || (fsize > MAXFRAME) || (window < 1) || (ipw < 1)) {
+      printf("\rDLSwB: Invalid frames, size, window or ipw argument\n");
+      return 1;
+   }
+   dn_tsent = calloc(nframes, sizeof(double));
+   dn_lat = calloc(nframes, sizeof(double));
+   up_tsent = calloc(nframes, sizeof(double));
+   up_lat = calloc(nframes, sizeof(double));
+   clock_gettime(CLOCK_MONOTONIC, &t_base);
+
+   // Listen for DLSw_rt on the SDLC line and on the peer DLSw port
+   line_lfd = listen_on(LINE_IP, SDLCBASE + linenum);
+   peer_lfd = listen_on(PEER_IP, DLSW_PORT);
+   pthread_create(&prim_id, NULL, PRIM_thread, NULL);
+
+   // Start the DLSw router
+   sprintf(linestr, "%d", linenum);
+   pid = fork();
+   if (pid == 0) {
+      if (!verbose)
+         freopen("/dev/null", "w", stdout);
+      if (udp)
+         execl(dlsw_path, "DLSw", "-cchn", LINE_IP, "-udp", "-dlswip", LINE_IP, "-line", linestr, (char *)NULL);
+      else
+         execl(dlsw_path, "DLSw", "-cchn", LINE_IP, "-peerhn", PEER_IP, "-dlswip", LINE_IP, "-line", linestr, (char *)NULL);
+      printf("\rDLSwB: Cannot start %s: %s\n", dlsw_path, strerror(errno));
+      _exit(1);
+   }
+
+   // Version 2: DLSw_rt only connects to us after answering our explorer
+   if (udp && (explore_udp() != 0)) {
+      printf("\rDLSwB: No ICANREACH_ex from the DLSw router\n");
+      kill(pid, SIGTERM);
+      return 1;
+   }
+
+   // Peer connections: read side is DLSw_rt's outbound connection
+   peer_wfd = socket(AF_INET, SOCK_STREAM, 0);
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = inet_addr(LINE_IP);
+   addr.sin_port = htons(DLSW_PORT);
+   for (i = 0; connect(peer_wfd, (struct sockaddr*)&addr, sizeof(addr)) != 0; i++) {
+      if (i == 100) {
+         printf("\rDLSwB: DLSw router did not start\n");
+         kill(pid, SIGTERM);
+         return 1;
+      }
+      close(peer_wfd);
+      peer_wfd = socket(AF_INET, SOCK_STREAM, 0);
+      usleep(50000);
+   }
+   peer_rfd = accept(peer_lfd, NULL, 0);
+   t_tcp = now_usec();
+   i = 1;
+   setsockopt(peer_wfd, IPPROTO_TCP, TCP_NODELAY, &i, sizeof(i));
+   printf("\rDLSwB: Peer connections established\n");
+
+   pthread_create(&prx_id, NULL, PEER_rx_thread, NULL);
+   pthread_create(&ptx_id, NULL, PEER_tx_thread, NULL);
+
+   // Wait for completion or time out
+   t_start = 0;
+   while (now_usec() < maxtime * 1000000.0) {
+      pthread_mutex_lock(&bench_lock);
+      if (connected && (t_start == 0)) t_start = now_usec();
+      i = (up_rcvd == nframes) && (dn_rcvd == nframes);
+      pthread_mutex_unlock(&bench_lock);
+      if (i) break;
+      usleep(10000);
+   }
+   secs = (now_usec() - t_start) / 1000000.0;
+   kill(pid, SIGTERM);
+   waitpid(pid, NULL, 0);
+
+   if (!i)
+      printf("\rDLSwB: Time limit of %d seconds reached, results are partial\n", maxtime);
+   if (udp)
+      printf("\nExplorer (usec): CANUREACH_ex->ICANREACH_ex (UDP) %.0f, ->TCP peer connections %.0f\n",
+             t_explored - t_explore, t_tcp - t_explore);
+   printf("\nCircuit setup (usec): CANUREACH->ICANREACH %.0f, ->CONTACT %.0f, SNRM->UA %.0f\n",
+          t_icanreach - t_canureach, t_contact - t_canureach, t_ua - t_snrm);
+   printf("Steady state: %d byte I-fields, window %d, %.2f seconds\n", fsize, window, secs);
+   printf("Direction   Frames   Frames/s      Bytes/s   p50(us)   p90(us)   p99(us)   max(us)\n");
+   report("Down", dn_lat, dn_rcvd, secs);
+   report("Up", up_lat, up_rcvd, secs);
+   printf("FCB pacing: %ld IFCM received, %ld stalls, %.0f usec waiting for grants\n", ifcm_cnt, pace_stalls, pace_wait);
+   return 0;
+}
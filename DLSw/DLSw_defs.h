@@ -0,0 +1,142 @@
+/* Copyright (c) 2024, Edwin Freekenhorst
+
+   DLSw defintions are taken from Matt Burke
+   Matt Burke's DLSw testserver has been used as the starting point.
+   See Matt's website: www.9track.net/hercules/DLSw
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   DLSw_defs.h: DLSw (RFC 1795) message and header definitions
+                Shared by the DLSw router and the DLSw benchmark.
+*/
+
+/*-------------------------------------------------------------------*/
+/* DLSw definitions                                                  */
+/*-------------------------------------------------------------------*/
+
+/* Message types */
+
+#define CANUREACH       0x03                            /* Can U Reach Station */
+#define ICANREACH       0x04                            /* I Can Reach Station */
+#define REACH_ACK       0x05                            /* Reach Acknowledgment */
+#define DGRMFRAME       0x06                            /* Datagram Frame */
+#define XIDFRAME        0x07                            /* XID Frame */
+#define CONTACT         0x08                            /* Contact Remote Station */
+#define CONTACTED       0x09                            /* Remote Station Contacted */
+#define RESTART_DL      0x10                            /* Restart Data Link */
+#define DL_RESTARTED    0x11                            /* Data Link Restarted */
+#define ENTER_BUSY      0x0C                            /* Enter Busy */
+#define EXIT_BUSY       0x0D                            /* Exit Busy */
+#define INFOFRAME       0x0A                            /* Information (I) Frame */
+#define HALT_DL         0x0E                            /* Halt Data Link */
+#define DL_HALTED       0x0F                            /* Data Link Halted */
+#define NETBIOS_NQ      0x12                            /* NETBIOS Name Query */
+#define NETBIOS_NR      0x13                            /* NETBIOS Name Recog */
+#define DATAFRAME       0x14                            /* Data Frame */
+#define HALT_DL_NOACK   0x19                            /* Halt Data Link with no Ack */
+#define NETBIOS_ANQ     0x1A                            /* NETBIOS Add Name Query */
+#define NETBIOS_ANR     0x1B                            /* NETBIOS Add Name Response */
+#define KEEPALIVE       0x1D                            /* Transport Keepalive Message */
+#define CAP_EXCHANGE    0x20                            /* Capabilities Exchange */
+#define IFCM            0x21                            /* Independent Flow Control Message */
+#define TEST_CIRC_REQ   0x7A                            /* Test Circuit Request */
+#define TEST_CIRC_RSP   0x7B                            /* Test Circuit Response */
+
+/* SSP flags */
+
+#define SSPex           0x80                            /* explorer message */
+
+/* Frame direction */
+
+#define DIR_TGT         0x01                            /* origin to target */
+#define DIR_ORG         0x02                            /* target to origin */
+
+/* Header constants */
+
+#define DLSW_VER        0x31                            /* DLSw version 1 */
+#define LEN_CTRL        72                              /* control header length */
+#define LEN_INFO        16                              /* info header length */
+
+#define DLSW_PORT       2065
+#define DLSW_UDP_PORT   2067                            /* UDP explorers (RFC 2166) */
+
+/* Common header fields */
+
+#define HDR_VER         0x00                            /* Version Number */
+#define HDR_HLEN        0x01                            /* Header Length */
+#define HDR_MLEN        0x02                            /* Message Length */
+#define HDR_RDLC        0x04                            /* Remote Data Link Correlator */
+#define HDR_RDPID       0x08                            /* Remote DLC Port ID */
+#define HDR_MTYP        0x0E                            /* Message Type */
+#define HDR_FCB         0x0F                            /* Flow Control Byte */
+
+/* Control header fields */
+
+#define HDR_PID         0x10                            /* Protocol ID */
+#define HDR_NUM         0x11                            /* Header Number */
+#define HDR_LFS         0x14                            /* Largest Frame Size */
+#define HDR_SFLG        0x15                            /* SSP Flags */
+#define HDR_CP          0x16                            /* Circuit Priority */
+#define HDR_TMAC        0x18                            /* Target MAC Address */
+#define HDR_OMAC        0x1E                            /* Origin MAC Address */
+#define HDR_OSAP        0x24                            /* Origin Link SAP */
+#define HDR_TSAP        0x25                            /* Target Link SAP */
+#define HDR_DIR         0x26                            /* Frame Direction */
+#define HDR_DLEN        0x2A                            /* DLC Header Length */
+#define HDR_ODPID       0x2C                            /* Origin DLC Port ID */
+#define HDR_ODLC        0x30                            /* Origin Data Link Correlator */
+#define HDR_OTID        0x34                            /* Origin Transport ID */
+#define HDR_TDPID       0x38                            /* Target DLC Port ID */
+#define HDR_TDLC        0x3C                            /* Target Data Link Correlator */
+#define HDR_TTID        0x40                            /* Target Transport ID */
+
+/* Flow control fields */
+
+#define FCB_FCI         0x80                            /* Flow control indicator */
+#define FCB_FCA         0x40                            /* Flow control acknowledge */
+#define FCB_FCO         0x07                            /* Flow control operator */
+
+#define FCO_RPT         0x00                            /* Repeat window operator */
+#define FCO_INC         0x01                            /* Increment window operator */
+#define FCO_DEC         0x02                            /* Decrement window operator */
+#define FCO_RST         0x03                            /* Reset window operator */
+#define FCO_HLV         0x04                            /* Halve window operator */
+
+/* Capabilities Exchange Subfields */
+
+#define CAP_VID         0x81                            /* Vendor ID */
+#define CAP_VER         0x82                            /* DLSw Version */
+#define CAP_IPW         0x83                            /* Initial Pacing Window */
+#define CAP_VERS        0x84                            /* Version String */
+#define CAP_MACX        0x85                            /* MAC Address Exclusivity */
+#define CAP_SSL         0x86                            /* Supported SAP List */
+#define CAP_TCP         0x87                            /* TCP Connections */
+#define CAP_NBX         0x88                            /* NetBIOS Name Exclusivity */
+#define CAP_MACL        0x89                            /* MAC Address List */
+#define CAP_NBL         0x8A                            /* NetBIOS Name List */
+#define CAP_VC          0x8B                            /* Vendor Context */
+#define CAP_MCAST       0x8C                            /* Multicast Capabilities (RFC 2166) */
+
+/* Capabilities Exchange Subfield offsets */
+
+#define CAP_VID_OFF     0x05                            /* Offfset to Vendor ID */
+#define CAP_VER_OFF     0x10                            /* Offset to DLSw Version */
+#define CAP_IPW_OFF     0x0D                            /* Offset to Initial Pacing Window */
+#define CAP_VERS_OFF    0x18                            /* Offset to Version String */
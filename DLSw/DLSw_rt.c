@@ -51,122 +51,14 @@
 
 #define DLSW_PORT  2065
 #define SDLCBASE   37500
+#define LEAD_DATA  0x44    /* First byte on the SDLC line data lead ('D')   */
+#define LEAD_SIG   0x53    /* First byte on the SDLC line signal lead ('S') */
 #define OFF        0
 #define ON         1
 #define NO         0
 #define YES        1
 
-/*-------------------------------------------------------------------*/
-/* DLSw definitions                                                  */
-/*-------------------------------------------------------------------*/
-
-/* Message types */
-
-#define CANUREACH       0x03                            /* Can U Reach Station */
-#define ICANREACH       0x04                            /* I Can Reach Station */
-#define REACH_ACK       0x05                            /* Reach Acknowledgment */
-#define DGRMFRAME       0x06                            /* Datagram Frame */
-#define XIDFRAME        0x07                            /* XID Frame */
-#define CONTACT         0x08                            /* Contact Remote Station */
-#define CONTACTED       0x09                            /* Remote Station Contacted */
-#define RESTART_DL      0x10                            /* Restart Data Link */
-#define DL_RESTARTED    0x11                            /* Data Link Restarted */
-#define ENTER_BUSY      0x0C                            /* Enter Busy */
-#define EXIT_BUSY       0x0D                            /* Exit Busy */
-#define INFOFRAME       0x0A                            /* Information (I) Frame */
-#define HALT_DL         0x0E                            /* Halt Data Link */
-#define DL_HALTED       0x0F                            /* Data Link Halted */
-#define NETBIOS_NQ      0x12                            /* NETBIOS Name Query */
-#define NETBIOS_NR      0x13                            /* NETBIOS Name Recog */
-#define DATAFRAME       0x14                            /* Data Frame */
-#define HALT_DL_NOACK   0x19                            /* Halt Data Link with no Ack */
-#define NETBIOS_ANQ     0x1A                            /* NETBIOS Add Name Query */
-#define NETBIOS_ANR     0x1B                            /* NETBIOS Add Name Response */
-#define KEEPALIVE       0x1D                            /* Transport Keepalive Message */
-#define CAP_EXCHANGE    0x20                            /* Capabilities Exchange */
-#define IFCM            0x21                            /* Independent Flow Control Message */
-#define TEST_CIRC_REQ   0x7A                            /* Test Circuit Request */
-#define TEST_CIRC_RSP   0x7B                            /* Test Circuit Response */
-
-/* SSP flags */
-
-#define SSPex           0x80                            /* explorer message */
-
-/* Frame direction */
-
-#define DIR_TGT         0x01                            /* origin to target */
-#define DIR_ORG         0x02                            /* target to origin */
-
-/* Header constants */
-
-#define DLSW_VER        0x31                            /* DLSw version 1 */
-#define LEN_CTRL        72                              /* control header length */
-#define LEN_INFO        16                              /* info header length */
-
-#define DLSW_PORT       2065
-
-/* Common header fields */
-
-#define HDR_VER         0x00                            /* Version Number */
-#define HDR_HLEN        0x01                            /* Header Length */
-#define HDR_MLEN        0x02                            /* Message Length */
-#define HDR_RDLC        0x04                            /* Remote Data Link Correlator */
-#define HDR_RDPID       0x08                            /* Remote DLC Port ID */
-#define HDR_MTYP        0x0E                            /* Message Type */
-#define HDR_FCB         0x0F                            /* Flow Control Byte */
-
-/* Control header fields */
-
-#define HDR_PID         0x10                            /* Protocol ID */
-#define HDR_NUM         0x11                            /* Header Number */
-#define HDR_LFS         0x14                            /* Largest Frame Size */
-#define HDR_SFLG        0x15                            /* SSP Flags */
-#define HDR_CP          0x16                            /* Circuit Priority */
-#define HDR_TMAC        0x18                            /* Target MAC Address */
-#define HDR_OMAC        0x1E                            /* Origin MAC Address */
-#define HDR_OSAP        0x24                            /* Origin Link SAP */
-#define HDR_TSAP        0x25                            /* Target Link SAP */
-#define HDR_DIR         0x26                            /* Frame Direction */
-#define HDR_DLEN        0x2A                            /* DLC Header Length */
-#define HDR_ODPID       0x2C                            /* Origin DLC Port ID */
-#define HDR_ODLC        0x30                            /* Origin Data Link Correlator */
-#define HDR_OTID        0x34                            /* Origin Transport ID */
-#define HDR_TDPID       0x38                            /* Target DLC Port ID */
-#define HDR_TDLC        0x3C                            /* Target Data Link Correlator */
-#define HDR_TTID        0x40                            /* Target Transport ID */
-
-/* Flow control fields */
-
-#define FCB_FCI         0x80                            /* Flow control indicator */
-#define FCB_FCA         0x40                            /* Flow control acknowledge */
-#define FCB_FCO         0x07                            /* Flow control operator */
-
-#define FCO_RPT         0x00                            /* Repeat window operator */
-#define FCO_INC         0x01                            /* Increment window operator */
-#define FCO_DEC         0x02                            /* Decrement window operator */
-#define FCO_RST         0x03                            /* Reset window operator */
-#define FCO_HLV         0x04                            /* Halve window operator */
-
-/* Capabilities Exchange Subfields */
-
-#define CAP_VID         0x81                            /* Vendor ID */
-#define CAP_VER         0x82                            /* DLSw Version */
-#define CAP_IPW         0x83                            /* Initial Pacing Window */
-#define CAP_VERS        0x84                            /* Version String */
-#define CAP_MACX        0x85                            /* MAC Address Exclusivity */
-#define CAP_SSL         0x86                            /* Supported SAP List */
-#define CAP_TCP         0x87                            /* TCP Connections */
-#define CAP_NBX         0x88                            /* NetBIOS Name Exclusivity */
-#define CAP_MACL        0x89                            /* MAC Address List */
-#define CAP_NBL         0x8A                            /* NetBIOS Name List */
-#define CAP_VC          0x8B                            /* Vendor Context */
-
-/* Capabilities Exchange Subfield offsets */
-
-#define CAP_VID_OFF     0x05                            /* Offfset to Vendor ID */
-#define CAP_VER_OFF     0x10                            /* Offset to DLSw Version */
-#define CAP_IPW_OFF     0x0D                            /* Offset to Initial Pacing Window */
-#define CAP_VERS_OFF    0x18                            /* Offset to Version String */
+#include "DLSw_defs.h"
 
 uint8_t CONTROL_MSG_Hdr[] = {
       DLSW_VER, 0x48, 0x00, 0x26, 0x00, 0x00, 0x00, 0x00,      /* 0x00 - 0x07 */
@@ -277,12 +169,14 @@ int            dlsw_sfd;            /* Our DLSw server socket                */
 int            conrfd = OFF;        /* Status of DLSw read connection        */
 int            conwfd = OFF;        /* Status of DLSw write connection       */
 int            conlfd = OFF;        /* Status of SDLC line connection        */
+int            udp_fd = -1;         /* DLSw v2 explorer socket (-udp)        */
 
 uint8_t        seq_Nr = 0;          /* SDLC frame sequence receive number    */
 uint8_t        seq_Ns = 0;          /* SDLC frame sequence send number       */
 
 int SocketReadAct (int fd);
 void ReadSig (int rs232_fd, int state);
+void SendLeadID (int data_fd, int rs232_fd);
 
 struct         sockaddr_in lineaddr; /* SDLC line connection                 */
 int            line_fd;             /* SDLC line socket                      */
@@ -347,6 +241,201 @@ static bool IsSocketConnected(int sockfd) {
    return true;
 }
 
+/*-------------------------------------------------------------------*/
+/* DLSw output queues                                                */
+/*-------------------------------------------------------------------*/
+/* All messages to the peer DLSw share the one TCP connection.       */
+/* They are queued and sent without blocking, so a busy LU does not  */
+/* set the latency for the other LUs on the PU:                      */
+/*  - Control messages and expedited flow PIUs (FID2 EFI) go first.  */
+/*  - Messages that halt or restart the circuit wait until all data  */
+/*    queued before them has gone, so they cannot overtake it.       */
+/*  - INFOFRAMEs are queued per LU (FID2 DAF) and the LU queues are  */
+/*    served by deficit round robin. Each turn a queue may send      */
+/*    DRR_QUANTUM bytes times the weight of its LU's transmission    */
+/*    priority (-lupri), so an interactive LU is not held up behind  */
+/*    a printer or file transfer on the same circuit.                */
+/* A partly sent message is always completed first. If the queues    */
+/* back up beyond TXQ_HIWAT, polls from the NCP are answered with    */
+/* RNR until they have drained. All queues are emptied when the      */
+/* connection to the peer DLSw is lost or (re)established.           */
+/*-------------------------------------------------------------------*/
+#define NUM_LU          256                             /* FID2 local addresses */
+#define DRR_QUANTUM     1024                            /* Bytes per turn for weight 1 */
+#define TXQ_HIWAT       65536                           /* Above this the NCP gets RNR */
+#define TP_LOW          1                               /* Transmission priority weights */
+#define TP_MED          2
+#define TP_HIGH         4
+
+struct DLSw_msg {
+   struct DLSw_msg *next;
+   int      len;                                        /* Message length */
+   uint32_t seq;                                        /* Order in which it was queued */
+   uint8_t  data[];                                     /* DLSw header + message */
+};
+
+struct DLSw_txq {
+   struct DLSw_msg *head, *tail;
+   int      deficit;                                    /* DRR: bytes it may still send this turn */
+};
+
+struct DLSw_txq ctl_q;                                  /* Control and expedited messages */
+struct DLSw_txq cst_q;                                  /* Circuit state messages */
+struct DLSw_txq lu_q[NUM_LU];                           /* INFOFRAMEs per LU */
+uint8_t        lu_tp[NUM_LU];                           /* Transmission priority weight per LU */
+int            lu_next = 0;                             /* DRR: LU queue being served */
+uint32_t       lu_qlen = 0;                             /* Bytes in the LU queues */
+struct DLSw_msg *tx_msg = NULL;                         /* Message being sent */
+int            tx_off;                                  /* ...and how much of it has gone */
+uint32_t       tx_seq = 0;                              /* Sequence number of the last message queued */
+
+/*********************************************************************/
+/* Queue a message for the peer DLSw. lu is the LU local address     */
+/* (DAF) of an INFOFRAME, or -1 for a control message.               */
+/*********************************************************************/
+static int DLSw_put(uint8_t *buf, int len, int lu) {
+   struct DLSw_msg *msg;
+   struct DLSw_txq *q;
+
+   msg = malloc(sizeof(struct DLSw_msg) + len);
+   if (msg == NULL) {
+      printf("\rDLSw: No storage for output queue, message of %d bytes dropped\n", len);
+      return 0;
+   }
+   msg->next = NULL;
+   msg->len = len;
+   msg->seq = ++tx_seq;
+   memcpy(msg->data, buf, len);
+   if (lu < 0) {
+      switch (buf[HDR_MTYP]) {
+         case HALT_DL:
+         case HALT_DL_NOACK:
+         case DL_HALTED:
+         case RESTART_DL:
+         case DL_RESTARTED:
+            q = &cst_q;
+            break;
+         default:
+            q = &ctl_q;
+            break;
+      }  // End switch
+   } else {
+      q = &lu_q[lu];
+      lu_qlen += len;
+   }
+   if (q->tail == NULL)
+      q->head = msg;
+   else
+      q->tail->next = msg;
+   q->tail = msg;
+   return len;
+}
+
+static struct DLSw_msg *DLSw_deq(struct DLSw_txq *q) {
+   struct DLSw_msg *msg = q->head;
+   q->head = msg->next;
+   if (q->head == NULL)
+      q->tail = NULL;
+   return msg;
+}
+
+/*********************************************************************/
+/* Select the next message to send: control first, then circuit      */
+/* state once no older INFOFRAME is left, then DRR.                  */
+/*********************************************************************/
+static struct DLSw_msg *DLSw_next(void) {
+   struct DLSw_txq *q;
+   struct DLSw_msg *msg;
+   int lu;
+
+   if (ctl_q.head != NULL)
+      return DLSw_deq(&ctl_q);
+   if (cst_q.head != NULL) {
+      for (lu = 0; lu < NUM_LU; lu++)                   /* Queue heads are the oldest of each LU */
+         if ((lu_q[lu].head != NULL) && ((int32_t)(lu_q[lu].head->seq - cst_q.head->seq) < 0))
+            break;
+      if (lu == NUM_LU)
+         return DLSw_deq(&cst_q);
+   }
+   while (lu_qlen > 0) {
+      q = &lu_q[lu_next];
+      if ((q->head != NULL) && (q->head->len <= q->deficit)) {
+         msg = DLSw_deq(q);
+         q->deficit -= msg->len;
+         lu_qlen -= msg->len;
+         return msg;
+      }
+      if (q->head == NULL)
+         q->deficit = 0;                                /* An idle LU saves up no credit */
+      lu_next = (lu_next + 1) % NUM_LU;                 /* Next LU's turn */
+      if (lu_q[lu_next].head != NULL)
+         lu_q[lu_next].deficit += DRR_QUANTUM * lu_tp[lu_next];
+   }
+   return NULL;
+}
+
+/*********************************************************************/
+/* Discard all queued messages and a partly sent one.                */
+/*********************************************************************/
+static void DLSw_reset(void) {
+   int lu;
+
+   free(tx_msg);
+   tx_msg = NULL;
+   tx_off = 0;
+   while (ctl_q.head != NULL)
+      free(DLSw_deq(&ctl_q));
+   while (cst_q.head != NULL)
+      free(DLSw_deq(&cst_q));
+   for (lu = 0; lu < NUM_LU; lu++) {
+      while (lu_q[lu].head != NULL)
+         free(DLSw_deq(&lu_q[lu]));
+      lu_q[lu].deficit = 0;
+   }
+   lu_next = 0;
+   lu_qlen = 0;
+}
+
+/*********************************************************************/
+/* Send queued messages until the socket takes no more.              */
+/*********************************************************************/
+static void DLSw_flush(void) {
+   ssize_t rc;
+
+   while (1) {
+      if (tx_msg == NULL) {
+         tx_msg = DLSw_next();
+         tx_off = 0;
+         if (tx_msg == NULL)
+            return;
+      }
+      rc = send(dlsw_wfd, tx_msg->data + tx_off, tx_msg->len - tx_off, MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (rc <= 0)                                      /* Socket full (or gone) */
+         return;
+      tx_off += rc;
+      if (tx_off == tx_msg->len) {
+         free(tx_msg);
+         tx_msg = NULL;
+      }
+   }
+}
+
+/*********************************************************************/
+/* Queue and send an INFOFRAME. The PIU starts with a FID2 TH:       */
+/* byte 0 has the EFI (expedited flow) bit, byte 2 the DAF.          */
+/*********************************************************************/
+static int DLSw_put_info(uint8_t *buf, int len) {
+   uint8_t *th = buf + LEN_INFO;
+   int lu = 0, rc;
+
+   if ((len >= LEN_INFO + 6) && ((th[0] & 0xF0) == 0x20)) {   /* FID2 ? */
+      lu = (th[0] & 0x01) ? -1 : th[2];
+   }
+   rc = DLSw_put(buf, len, lu);
+   DLSw_flush();
+   return rc;
+}
+
 /*-------------------------------------------------------------------*/
 /* Process DLSw message                                              */
 /*-------------------------------------------------------------------*/
@@ -494,7 +583,7 @@ int proc_DLSw(unsigned char DLSw_rbuf[], int DLSwrlen, unsigned char *DLSw_wbuf)
             DLSw_wbuf[HDR_MLEN] = 0x00;                                    // No message (header only)
             DLSw_wbuf[HDR_MLEN+1] = 0x00;                                  // No message (header only)
             DLSwwlen = sizeof(INFOFRAME_Hdr);                              // Total frame length equals to header length
-            rc = send(dlsw_wfd, DLSw_wbuf, DLSwwlen, 0);                   // Send to peer DLSw
+            rc = DLSw_put(DLSw_wbuf, DLSwwlen, -1);                        // Queue for peer DLSw
          }  // End if (rp_granted_units
       }  // End  if (!fca_owed)
    }  // End if (flow_control)
@@ -735,6 +824,56 @@ int proc_DLSw(unsigned char DLSw_rbuf[], int DLSwrlen, unsigned char *DLSw_wbuf)
    return DLSwwlen;
 }
 
+/*-------------------------------------------------------------------*/
+/* DLSw version 2 explorers (RFC 2166)                               */
+/*-------------------------------------------------------------------*/
+/* A CANUREACH_ex received as a UDP unicast or multicast datagram is */
+/* answered with an ICANREACH_ex UDP unicast to the sender, so no    */
+/* TCP connection is needed just to explore. The peer opens its TCP  */
+/* connection once we have answered, and we open ours to it.         */
+/* If peer is not 0 only explorers from that peer are answered.      */
+/* Returns 1 and the sender's address in from if one was answered.   */
+/*-------------------------------------------------------------------*/
+static int DLSw_explorer(int fd, in_addr_t peer, struct sockaddr_in *from) {
+   uint8_t buf[1500];
+   struct sockaddr_in src;
+   socklen_t srclen;
+   ssize_t len;
+   int answered = 0;
+
+   while (1) {
+      srclen = sizeof(src);
+      len = recvfrom(fd, buf, sizeof(buf), MSG_DONTWAIT, (struct sockaddr *)&src, &srclen);
+      if (len <= 0)
+         return answered;
+      if ((len < LEN_CTRL) || (buf[HDR_HLEN] != LEN_CTRL) ||
+          (buf[HDR_MTYP] != CANUREACH) || !(buf[HDR_SFLG] & SSPex))
+         continue;                                                         // Only CANUREACH_ex is sent over UDP
+      if (Tdbg_flag == ON) {
+         fprintf(T_trace, "\rCANUREACH_EX (UDP) from %s\n", inet_ntoa(src.sin_addr));
+         printf("\rDLSW: Received CANUREACH_EX (UDP) from %s\n", inet_ntoa(src.sin_addr));
+      }
+      if ((conlfd == OFF) || ((peer != 0) && (src.sin_addr.s_addr != peer)))
+         continue;                                                         // Station not reachable (for this peer)
+      buf[HDR_MTYP] = ICANREACH;                                           // Change type to I can reach
+      buf[HDR_MLEN] = 0x00;                                                // No message (header only)
+      buf[HDR_MLEN+1] = 0x00;
+      buf[HDR_DIR] = DIR_ORG;                                              // Set Direction of this reply
+      memcpy(buf + HDR_RDLC, &buf[HDR_ODLC], 4);                           // Copy origin DLC to remote DLC
+      memcpy(buf + HDR_RDPID, &buf[HDR_ODPID], 4);                         // Copy Origin PID to remote PID
+      if (sendto(fd, buf, LEN_CTRL, 0, (struct sockaddr *)&src, srclen) != LEN_CTRL) {
+         printf("\rDLSw: Sending ICANREACH_EX to %s failed with %s\n", inet_ntoa(src.sin_addr), strerror(errno));
+         continue;
+      }
+      if (Tdbg_flag == ON) {
+         fprintf(T_trace, "\rSending ICANREACH_EX (UDP)\n");
+         printf("\rDLSW: Sending ICANREACH_EX (UDP)\n");
+      }
+      *from = src;
+      answered = 1;
+   }
+}
+
 /*----------------------------------------------------------------------------*/
 /*----------------------------------------------------------------------------*/
 /* Main section - establish and manage TCP connections                        */
@@ -743,8 +882,13 @@ int proc_DLSw(unsigned char DLSw_rbuf[], int DLSwrlen, unsigned char *DLSw_wbuf)
 void main(int argc, char *argv[]) {
    struct         sockaddr_in dlswaddr;  /* Our DLSw connection               */
    struct         sockaddr_in peeraddr;  /* Peer DLSw connection              */
-   struct         epoll_event event, events[1];
+   struct         sockaddr_in inaddr;    /* Inbound peer DLSw connection      */
+   struct         epoll_event event, events[2];
    in_addr_t      lineip;                /* DLSw line listening address       */
+   in_addr_t      dlswip = htonl(INADDR_ANY);  /* DLSw listening address      */
+   int            Mptr, Mlen;            /* DLSw message pointer and length   */
+   int            DLSwrrem = 0;          /* Partial DLSw message in buffer    */
+   int            DLSwskip = 0;          /* Rest of an oversized message      */
    int            epoll_fd;              /* Event polling socket              */
    int            sockopt;               /* Used for setsocketoption          */
    int            pendingrcv;            /* pending data on the socket        */
@@ -752,6 +896,13 @@ void main(int argc, char *argv[]) {
    char           *ipaddr;
    struct         hostent *dlswent;
    struct         hostent *lineent;
+   struct         in_addr ccip;          /* Resolved 3705 host address        */
+   struct         in_addr peerip;        /* Resolved peer DLSw address        */
+   struct         in_addr mcastip = { 0 }; /* DLSw v2 multicast group (-mcast) */
+   struct         sockaddr_in expladdr;  /* Sender of an answered explorer    */
+   int            dlswv2 = NO;           /* Explorers over UDP (-udp, -mcast) */
+   int            peer_known = NO;       /* Peer DLSw address is known        */
+   int            inbound;               /* Inbound TCP connection pending    */
    int            peerlen;               /* size of peer ip address           */
    int            linenum = 20;          /* SDLC line number (default 20)     */
    char           *peeraddrp;
@@ -767,13 +918,18 @@ void main(int argc, char *argv[]) {
       printf("\r   Valid arguments are:\n");
       printf("\r   -peerhn {hostname}  : hostname of peer DLSw\n");
       printf("\r   -peerip {ipaddress} : ipaddress of peer DLSw \n");
+      printf("\r   -dlswip {ipaddress} : local ipaddress to listen on for the peer DLSw\n");
+      printf("\r   -udp               : accept DLSw version 2 explorers on UDP port %d\n", DLSW_UDP_PORT);
+      printf("\r   -mcast {group}      : also accept explorers sent to this multicast group\n");
       printf("\r   -cchn {hostname}  : hostname of host running the 3705\n");
       printf("\r   -ccip {ipaddress} : ipaddress of host running the 3705 \n");
       printf("\r   -line {line number} : SDLC line number to connect to\n");
+      printf("\r   -lupri {lu}:{HIGH|MED|LOW} : transmission priority of LU local address lu (hex)\n");
       printf("\r   -d : switch debug on  \n");
       return;
    }
    Tdbg_flag = OFF;
+   memset(lu_tp, TP_MED, sizeof(lu_tp));
    i = 1;
 
    while (i < argc) {
@@ -787,6 +943,7 @@ void main(int argc, char *argv[]) {
             printf("\rDLSw: Cannot resolve 3705 hostname %s\n", argv[i+1]);
             return;                /* error */
          }  // End if linewent
+         memcpy(&ccip, lineent->h_addr_list[0], sizeof(ccip));   // hostent is overwritten by the next lookup
          printf("\rDLSw: Connection to be established with SLDC line at 3705 on host %s\n", argv[i+1]);
          i = i+2;
          continue;
@@ -796,6 +953,7 @@ void main(int argc, char *argv[]) {
             printf("\rDLSw: Cannot resolve ip address %s\n", argv[i+1]);
             return; /* error */
          }  // End if lineent
+         memcpy(&ccip, lineent->h_addr_list[0], sizeof(ccip));
          printf("\rDLSw: Connection to be established with SDLC line at 3705 on ip address %s\n", argv[i+1]);
          i = i + 2;
          continue;
@@ -809,6 +967,8 @@ void main(int argc, char *argv[]) {
             printf("\rDLSw: Cannot resolve hostname %s\n", argv[i+1]);
             return;                /* error */
          }  // End if dlswent
+         memcpy(&peerip, dlswent->h_addr_list[0], sizeof(peerip));
+         peer_known = YES;
          printf("\rDLSw: Connection to be established with peer DLSw %s\n", argv[i+1]);
          i = i + 2;
          continue;
@@ -818,9 +978,50 @@ void main(int argc, char *argv[]) {
             printf("\rDLSw: Cannot resolve ip address %s\n", argv[i+1]);
             return; /* error */
          }  // End if dlswent
+         memcpy(&peerip, dlswent->h_addr_list[0], sizeof(peerip));
+         peer_known = YES;
          printf("\rDLSw: Connection to be established with peer DLSw at ip address %s\n", argv[i+1]);
          i = i + 2;
          continue;
+      } else if (strcmp(argv[i], "-dlswip") == 0) {
+         dlswip = inet_addr(argv[i+1]);
+         printf("\rDLSw: Listening for peer DLSw on ip address %s\n", argv[i+1]);
+         i = i + 2;
+         continue;
+      } else if (strcmp(argv[i], "-udp") == 0) {
+         dlswv2 = YES;
+         printf("\rDLSw: Accepting DLSw version 2 explorers on UDP port %d\n", DLSW_UDP_PORT);
+         i++;
+         continue;
+      } else if ((strcmp(argv[i], "-mcast") == 0) && (i + 1 < argc)) {
+         if ((inet_pton(AF_INET, argv[i+1], &mcastip) != 1) || !IN_MULTICAST(ntohl(mcastip.s_addr))) {
+            printf("\rDLSw: Invalid multicast group %s\n", argv[i+1]);
+            return;
+         }
+         dlswv2 = YES;
+         printf("\rDLSw: Accepting DLSw version 2 explorers for multicast group %s\n", argv[i+1]);
+         i = i + 2;
+         continue;
+      } else if ((strcmp(argv[i], "-lupri") == 0) && (i + 1 < argc)) {
+         char tp[8];
+         unsigned int lu;
+         if ((sscanf(argv[i+1], "%x:%7s", &lu, tp) != 2) || (lu >= NUM_LU)) {
+            printf("\rDLSw: Invalid LU priority %s\n", argv[i+1]);
+            return;
+         }
+         if (strcmp(tp, "HIGH") == 0)
+            lu_tp[lu] = TP_HIGH;
+         else if (strcmp(tp, "MED") == 0)
+            lu_tp[lu] = TP_MED;
+         else if (strcmp(tp, "LOW") == 0)
+            lu_tp[lu] = TP_LOW;
+         else {
+            printf("\rDLSw: Invalid LU priority %s\n", argv[i+1]);
+            return;
+         }
+         printf("\rDLSw: LU %02X has transmission priority %s\n", lu, tp);
+         i = i + 2;
+         continue;
       } else {
          printf("\rDLS: invalid argument %s\n", argv[i]);
          printf("\r     Valid arguments are:\n");
@@ -828,7 +1029,11 @@ void main(int argc, char *argv[]) {
          printf("\r     -ccip {ipaddress}   : ipaddress of host running the 3705 \n");
          printf("\r     -peerhn {hostname}  : hostname of peer DLSw\n");
          printf("\r     -peerip {ipaddress} : ipaddress of peer DLSw \n");
+         printf("\r     -dlswip {ipaddress} : local ipaddress to listen on for the peer DLSw\n");
+         printf("\r     -udp               : accept DLSw version 2 explorers on UDP port %d\n", DLSW_UDP_PORT);
+         printf("\r     -mcast {group}      : also accept explorers sent to this multicast group\n");
          printf("\r     -line {line number} : SDLC line number to connect to\n");
+         printf("\r     -lupri {lu}:{HIGH|MED|LOW} : transmission priority of LU local address lu (hex)\n");
          printf("\r     -d : switch debug on  \n");
          return;
       }  // End else
@@ -843,6 +1048,8 @@ void main(int argc, char *argv[]) {
                        "     DLSw_rt -d : trace all DLSw activities\n"
                        );
    }
+   if (dlswv2 == NO)
+      peer_known = YES;                     // Version 1: TCP connections to the peer from the start
    state = DISCONNECTED;
    print_state();
 
@@ -867,7 +1074,7 @@ void main(int argc, char *argv[]) {
 
    // Assign IP addr and PORT number
    lineaddr.sin_family = AF_INET;
-   memcpy(&lineaddr.sin_addr, lineent->h_addr_list[0], lineent->h_length);
+   lineaddr.sin_addr = ccip;
    lineaddr.sin_port = htons(SDLCBASE + linenum);
 
    // Line and signal sockets have been created. The connection to the LIB will be done
@@ -889,7 +1096,7 @@ void main(int argc, char *argv[]) {
 
    /* Bind the socket */
    dlswaddr.sin_family = AF_INET;
-   dlswaddr.sin_addr.s_addr = htonl(INADDR_ANY);
+   dlswaddr.sin_addr.s_addr = dlswip;
    dlswaddr.sin_port = htons(DLSW_PORT);           // Default DLSw read port (2067)
    if (bind(dlsw_sfd, (struct sockaddr *)&dlswaddr, sizeof(dlswaddr)) < 0) {
        printf("\rDLSw: Inbound socket bind failed with %s\n", strerror(errno));
@@ -916,6 +1123,41 @@ void main(int argc, char *argv[]) {
    }
    printf("\rDLSw: DLSw ready, waiting for connection on TCP port %d\n\r", DLSW_PORT );
 
+   //*******************************************************************************
+   // Prepare the DLSw version 2 explorer socket (UDP unicast and multicast)
+   //*******************************************************************************
+   if (dlswv2 == YES) {
+      if ((udp_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0)) == -1) {
+         printf("\rDLSw: Explorer socket creation failed with error %s\n", strerror(errno));
+         exit(-1);
+      }
+      sockopt = 1;
+      setsockopt(udp_fd, SOL_SOCKET, SO_REUSEADDR, (void*)&sockopt, sizeof(sockopt));
+      dlswaddr.sin_port = htons(DLSW_UDP_PORT);
+      if (mcastip.s_addr != 0)              // Multicast datagrams are not addressed to dlswip
+         dlswaddr.sin_addr.s_addr = htonl(INADDR_ANY);
+      if (bind(udp_fd, (struct sockaddr *)&dlswaddr, sizeof(dlswaddr)) < 0) {
+         printf("\rDLSw: Explorer socket bind failed with %s\n", strerror(errno));
+         exit(EXIT_FAILURE);
+      }
+      if (mcastip.s_addr != 0) {
+         struct ip_mreq mreq;
+         mreq.imr_multiaddr = mcastip;
+         mreq.imr_interface.s_addr = dlswip;
+         if (setsockopt(udp_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+            printf("\rDLSw: Joining multicast group failed with %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+         }
+      }
+      event.events = EPOLLIN;
+      event.data.fd = udp_fd;
+      if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, udp_fd, &event) == -1) {
+         printf("\nDLSw: Add polling event failed with error %s \n\r", strerror(errno));
+         exit(-3);
+      }
+      printf("\rDLSw: Waiting for explorers on UDP port %d\n\r", DLSW_UDP_PORT);
+   }
+
    //*************************************************************************************
    // Establish the outbound and inbound DLSw connections (write/read to/from peer DLSw)
    //*************************************************************************************
@@ -935,9 +1177,10 @@ void main(int argc, char *argv[]) {
 
    // Assign IP addr and PORT number
    peeraddr.sin_family = AF_INET;
-   memcpy(&peeraddr.sin_addr, dlswent->h_addr_list[0], dlswent->h_length);
+   peeraddr.sin_addr = peerip;
    peeraddr.sin_port = htons(DLSW_PORT);
-   printf("\rDLSw: Waiting for DLSw peer outbound connection to be established\n");
+   if (peer_known == YES)
+      printf("\rDLSw: Waiting for DLSw peer outbound connection to be established\n");
 
    dlsw_rfd = 0;  /* Clear DLSw read file descriptor                         */
    seq_Nr = 0;    /* Initialize SDLC frame sequence receive number           */
@@ -945,29 +1188,47 @@ void main(int argc, char *argv[]) {
    SDLCwlen = 0;  /* Initialize SDLC write buffer length                     */
 
    while (1) {
+      if (conwfd == ON)
+         DLSw_flush();                      // Send what is still queued for the peer DLSw
+
       //*****************************************************************************************
       // Check if there is data to be received from the peer DLSw
       // If the connection is not active yet or if the connection was lost, try to re-establish
       //*****************************************************************************************
       if (conrfd == OFF) {
-         event_count = epoll_wait(epoll_fd, events, 1, 50);
-         if ((event_count > 0) && (dlsw_rfd < 1)) {
+         event_count = epoll_wait(epoll_fd, events, 2, 50);
+         inbound = NO;
+         for (int e = 0; e < event_count; e++)
+            if (events[e].data.fd == dlsw_sfd)
+               inbound = YES;               // Not just an explorer datagram
+         if ((inbound == YES) && (dlsw_rfd < 1)) {
             /* Accept */
-            peerlen = sizeof(peeraddr);
-            if ((dlsw_rfd = accept(dlsw_sfd, (struct sockaddr *) &peeraddr, &peerlen)) == -1) {
+            peerlen = sizeof(inaddr);
+            if ((dlsw_rfd = accept(dlsw_sfd, (struct sockaddr *) &inaddr, &peerlen)) == -1) {
                printf("\rDLSw: Inbound peer DLSw connection accept failed with %s\n", strerror(errno));
                exit(-1);
             }  // End if dlsw_rfd
-            peeraddrp = inet_ntoa(peeraddr.sin_addr);
+            peeraddrp = inet_ntoa(inaddr.sin_addr);
             printf("\rDLSw: Inbound connection from peer DLSw at %s\n", peeraddrp);
             conrfd = ON;
          }  // End if (event_count > 0)
       }  // End if (conrfd == OFF)
 
-      if (conwfd == OFF) {
+      // Version 2: explorers arrive over UDP. Without a configured peer, the TCP
+      // connection is opened to the first peer whose explorer has been answered.
+      if ((udp_fd > 0) && (DLSw_explorer(udp_fd, (peer_known == YES) ? peeraddr.sin_addr.s_addr : 0, &expladdr))) {
+         if (peer_known == NO) {
+            peeraddr.sin_addr = expladdr.sin_addr;
+            peer_known = YES;
+            printf("\rDLSw: Explorer answered, opening TCP connection to peer DLSw at %s\n", inet_ntoa(expladdr.sin_addr));
+         }
+      }
+
+      if ((conwfd == OFF) && (peer_known == YES)) {
          rc = connect(dlsw_wfd, (struct sockaddr*)&peeraddr, sizeof(peeraddr));
          if (rc == 0) {
             printf("\rDLSw: Outbound connection to peer has been established\n");
+            DLSw_reset();                   // Nothing queued belongs to this connection
             conwfd = ON;
          }  // End if rc == 0
       }  // End if conwfd == OFF
@@ -978,7 +1239,16 @@ void main(int argc, char *argv[]) {
          DLSw_wbuf[HDR_MTYP] = CAP_EXCHANGE;
          memcpy(DLSw_wbuf + HDR_OMAC, OMAC_addr, 6);
          memcpy(&DLSw_wbuf[HDR_MLEN], CAP_EXCHANGE_Msg, 2);
-         rc = send(dlsw_wfd, DLSw_wbuf, sizeof(CAP_EXCHANGE_Msg) + sizeof(CONTROL_MSG_Hdr), 0);
+         DLSwwlen = sizeof(CAP_EXCHANGE_Msg) + sizeof(CONTROL_MSG_Hdr);
+         if (udp_fd > 0) {                  // Tell the peer it may explore over UDP
+            DLSw_wbuf[DLSwwlen++] = 0x03;
+            DLSw_wbuf[DLSwwlen++] = CAP_MCAST;
+            DLSw_wbuf[DLSwwlen++] = 0x01;   // Multicast capable
+            DLSw_wbuf[sizeof(CONTROL_MSG_Hdr) + 1] += 3;    // GDS length
+            DLSw_wbuf[HDR_MLEN + 1] += 3;   // Message length
+         }
+         rc = DLSw_put(DLSw_wbuf, DLSwwlen, -1);
+         DLSw_flush();
          printf("\rDLSw: CAP_EXCHANGE sent\n");
          if (Tdbg_flag == ON) {
             fprintf(T_trace, "\rDLSw CAP_EXCHANGE sent: ");
@@ -1008,9 +1278,30 @@ void main(int argc, char *argv[]) {
                return;
             }
             conrfd = OFF;
+            DLSwrrem = 0;                     // Discard any partial message
+            DLSwskip = 0;
+            // The outbound connection went with it: drop what was queued for it and
+            // redo the capabilities exchange once the peer is back.
+            DLSw_reset();
+            close(dlsw_wfd);
+            dlsw_wfd = socket(AF_INET, SOCK_STREAM, 0);
+            if (dlsw_wfd <= 0) {
+               printf("\rDLSw: Cannot create outbound socket\n");
+               return;
+            }
+            conwfd = OFF;
+            capex = NO;
          } else {
             if (pendingrcv > 0) {
-               DLSwrlen = read(dlsw_rfd, DLSw_rbuf, sizeof(DLSw_rbuf));
+               // Append to a partial message left over from the previous read (if any)
+               rc = read(dlsw_rfd, DLSw_rbuf + DLSwrrem, sizeof(DLSw_rbuf) - 1 - DLSwrrem);
+               DLSwrlen = (rc > 0) ? DLSwrrem + rc : DLSwrrem;
+               if (DLSwskip > 0) {                                // Still dropping an oversized message
+                  Mptr = (DLSwrlen < DLSwskip) ? DLSwrlen : DLSwskip;
+                  DLSwskip -= Mptr;
+                  DLSwrlen -= Mptr;
+                  memmove(DLSw_rbuf, &DLSw_rbuf[Mptr], DLSwrlen);
+               }  // End if (DLSwskip > 0)
                if (Tdbg_flag == ON) {
                   fprintf(T_trace, "\rDLSw Read Buffer: ");
                   for (int i = 0; i < DLSwrlen; i ++) {
@@ -1020,18 +1311,42 @@ void main(int argc, char *argv[]) {
                   fflush(T_trace);
                }  // End if debug
 
-               DLSwwlen = proc_DLSw(&DLSw_rbuf[0], DLSwrlen, DLSw_wbuf);
-               if (DLSwwlen != 0) {
-                  rc = send(dlsw_wfd, DLSw_wbuf, DLSwwlen, 0);
-                  if (Tdbg_flag == ON) {
-                     fprintf(T_trace, "\rDLSw Write Buffer (sent=%d): ", rc);
-                     for (int i = 0; i < DLSwwlen; i ++) {
-                        fprintf(T_trace, "%02X ", DLSw_wbuf[i]);
-                     }
-                     fprintf(T_trace, "\n\r");
-                     fflush(T_trace);
-                  }  // End if debug
-               }  // End if (DLSwrlen != 0)
+               // A single read may return several DLSw messages. Process them one by one.
+               Mptr = 0;
+               while (DLSwrlen - Mptr >= LEN_INFO) {
+                  Mlen = DLSw_rbuf[Mptr + HDR_HLEN] + (DLSw_rbuf[Mptr + HDR_MLEN] << 8) + DLSw_rbuf[Mptr + HDR_MLEN + 1];
+                  if ((DLSw_rbuf[Mptr + HDR_HLEN] != 0) && (Mlen > sizeof(DLSw_rbuf) - 1)) {   // Would never fit the read buffer
+                     printf("\rDLSw: Message of %d bytes exceeds the read buffer, skipped\n", Mlen);
+                     DLSwskip = Mlen - (DLSwrlen - Mptr);
+                     Mptr = DLSwrlen;
+                     break;
+                  }  // End if (Mlen > sizeof(DLSw_rbuf) - 1)
+                  if ((DLSw_rbuf[Mptr + HDR_HLEN] == 0) || (Mptr + Mlen > DLSwrlen))
+                     break;                                       // Incomplete (or invalid) message
+                  DLSwwlen = proc_DLSw(&DLSw_rbuf[Mptr], Mlen, DLSw_wbuf);
+                  if (DLSwwlen != 0) {
+                     rc = DLSw_put(DLSw_wbuf, DLSwwlen, -1);
+                     if (Tdbg_flag == ON) {
+                        fprintf(T_trace, "\rDLSw Write Buffer (sent=%d): ", rc);
+                        for (int i = 0; i < DLSwwlen; i ++) {
+                           fprintf(T_trace, "%02X ", DLSw_wbuf[i]);
+                        }
+                        fprintf(T_trace, "\n\r");
+                        fflush(T_trace);
+                     }  // End if debug
+                  }  // End if (DLSwwlen != 0)
+                  Mptr = Mptr + Mlen;
+               }  // End while (DLSwrlen - Mptr)
+               DLSw_flush();                                      // Send the responses (and IFCMs)
+               if ((Mptr < DLSwrlen) && (DLSw_rbuf[Mptr + HDR_HLEN] == 0))
+                  Mptr = DLSwrlen;                                // Invalid header, discard the rest
+               DLSwrrem = DLSwrlen - Mptr;                        // Keep partial message for next read
+               if (DLSwrrem >= sizeof(DLSw_rbuf) - 1) {           // Full, yet no complete message
+                  printf("\rDLSw: Read buffer full without a complete message, discarded\n");
+                  DLSwrrem = 0;
+               }  // End if (DLSwrrem >= sizeof(DLSw_rbuf) - 1)
+               if (DLSwrrem > 0)
+                  memmove(DLSw_rbuf, &DLSw_rbuf[Mptr], DLSwrrem);
             }  // End if (pendingrcv > 0)
          }  // End if (rc < 0)
       }  // End if (conrfd == ON)
@@ -1048,6 +1363,7 @@ void main(int argc, char *argv[]) {
             rc2 = connect(rs232_fd, (struct sockaddr*)&lineaddr, sizeof(lineaddr));
          }  // End if ((rc1 = 0) && (!(IsSocketConnected(rs232_fd))))
          if ((rc1 == 0) && (rc2 == 0)) {
+            SendLeadID(line_fd, rs232_fd);
             printf("\rDLSw: SDLC line connection has been established\n");
             conlfd = ON;
          }  // End if ((rc1 == 0) && (rc2 ==0))
@@ -1210,7 +1526,8 @@ void main(int argc, char *argv[]) {
                               } else {
                                  SDLC_wbuf[FptrL++] = 0x7E;                      // Add link header
                                  SDLC_wbuf[FptrL++] = SDLC_rbuf[Fptr + FAddr];   // Copy station ID
-                                 if (lp_granted_units > 0) {                     // If remote allows more messages
+                                 if ((lp_granted_units > 0) &&                   // If remote allows more messages
+                                     (lu_qlen < TXQ_HIWAT)) {                    // ...and the output queues are not backed up
                                     SDLC_wbuf[FptrL++] = RR + CFinal;            // ...insert RR response and set final bit
                                  } else {                                        // If granted messages are exhausted...
                                     SDLC_wbuf[FptrL++] = RNR + CFinal;           // ...insert RNR response and set final bit
@@ -1250,7 +1567,7 @@ void main(int argc, char *argv[]) {
 
                         // NOTE: filedescriptor set to rfd !!!
                         if (state == CONNECTED) {                                // If state CONNECTED sent a UA response else ignore
-                           rc = send(dlsw_wfd, DLSw_wbuf, DLSwwlen, 0);          // Send Info frame to DLSw peer
+                           rc = DLSw_put_info(DLSw_wbuf, DLSwwlen);              // Queue Info frame for DLSw peer
                            if (Tdbg_flag == ON) {
                               fprintf(T_trace, "DLSw: Upstream Write Buffer (send=%d): ", rc);
                               for (int i = 0; i < DLSwwlen; i ++) {
@@ -1300,6 +1617,24 @@ int  SocketReadAct(int fd) {
    return select(fd + 1, &fdset, NULL, NULL,  &timeout);
 }
 
+//*******************************************************************************************
+// Identify the two leads to the 3705 line: the data lead starts with LEAD_DATA, the RS232  *
+// signal lead with LEAD_SIG and the local port of the data lead, so the LIB can pair them. *
+//*******************************************************************************************
+void SendLeadID(int data_fd, int rs232_fd) {
+   struct sockaddr_in addr;
+   socklen_t addrlen = sizeof(addr);
+   uint8_t lead[3];
+
+   lead[0] = LEAD_DATA;
+   send(data_fd, lead, 1, 0);
+   getsockname(data_fd, (struct sockaddr *)&addr, &addrlen);
+   lead[0] = LEAD_SIG;
+   memcpy(&lead[1], &addr.sin_port, 2);                  // Port in network byte order
+   send(rs232_fd, lead, 3, 0);
+   return;
+}
+
 //*******************************************************************************************
 // Check if there is a signal update from the RS232 connection                              *
 // If so, receive signal data from the RS232 connection and respond if needed               *
@@ -0,0 +1,569 @@
+/* Copyright (c) 2026, Henk Stegeman and Edwin Freekenhorst
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   i3270_load.c - TN3270 load generator for the i3274/i3174 listeners.
+
+   Opens many concurrent TN3270 sessions, each doing the client side of
+   the telnet negotiation that negotiate() in i3270_tn.c performs for the
+   controller: WILL TERMINAL-TYPE, IS IBM-3278-2, WILL/DO EOR and
+   WILL/DO BINARY.  The 3270 records are built and parsed with the IAC
+   handling and code page of i3270_tn.c (double_up_iac, host_to_guest).
+
+   After the connection screen every session replays a script:
+     * comment
+     think ms             Think time before each following AID.
+     wait                 Wait for an unsolicited host record.
+     enter [text]         Send ENTER with text in the first input field
+     pf1..pf24 [text]     or a PF key, and wait for the host reply.
+     pa1..pa3, clear      Send a short read AID and wait for the reply.
+
+   Measured: connect time (connect until the connection screen), connect
+   rate, and per script statement the response time (AID sent until the
+   host record ending with IAC EOR).
+
+   Usage: i3270_load [-host addr] [-port n] [-ports n] [-sessions n]
+                     [-rate n] [-loops n] [-wait sec] [-term type] script
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "i327x.h"
+
+#define TNPORT       32741               /* First 3274 TN3270 port (pu_fd)      */
+#define MAXSTMT        256               /* Script statements                   */
+#define MAXLAT      100000               /* Response times kept per statement   */
+#define RBUFLEN      16384               /* Receive buffer per session          */
+
+/* Session states */
+#define LS_CONNECT       0               /* Connect in progress                 */
+#define LS_NEGOTIATE     1               /* Telnet negotiation / first screen   */
+#define LS_THINK         2               /* Think time running                  */
+#define LS_REPLY         3               /* Waiting for the host reply          */
+#define LS_DONE          4               /* Script completed                    */
+#define LS_FAILED        5               /* Connect or negotiation failed       */
+#define LS_CLOSED        6               /* Closed after completing the script  */
+
+uint16_t Tdbg_flag = OFF;                /* Referenced by i3270_tn.c            */
+FILE    *T_trace;
+
+unsigned char host_to_guest (unsigned char byte);
+int write_socket( int fd, const void *_ptr, int nbytes );
+int double_up_iac (BYTE *buf, int len);
+
+struct Stmt {
+   BYTE     aid;                         /* AID, 0 for wait and think           */
+   int      wait;                        /* Wait statement                      */
+   char     verb[16];                    /* Statement verb                      */
+   int      think;                       /* Think time (think statement)        */
+   char     text[80];                    /* Input field text                    */
+   int      line;                        /* Script line number                  */
+   long     count;                       /* Responses                           */
+   double   tot, min, max;               /* Response time total, min, max (usec)*/
+   double  *lat;                         /* Response time samples               */
+} stmt[MAXSTMT];
+int nstmt = 0;
+
+struct LSess {
+   int      fd;
+   int      state;
+   int      pc;                          /* Next script statement               */
+   int      loop;                        /* Script loops done                   */
+   int      think;                       /* Current think time (ms)             */
+   int      iac, sb;                     /* Telnet parser: IAC seen, in SB      */
+   BYTE     cmd;                         /* Telnet parser: DO/DONT/WILL/WONT    */
+   int      sblen;
+   BYTE     sbbuf[16];
+   int      rlen;                        /* 3270 record length so far           */
+   struct timespec start;                /* Connect start / AID sent            */
+   struct timespec due;                  /* End of think time                   */
+} *lsess;
+
+char *hostaddr = "127.0.0.1";
+int  port = TNPORT, nports = 1;
+int  nsess = 10;
+int  rate = 0;                           /* Connects per second, 0 = all at once */
+int  loops = 1;
+int  maxwait = 30;
+char *termtype = "IBM-3278-2";
+int  epfd;
+
+long connects = 0, failures = 0;
+double contot = 0, conmax = 0;
+struct timespec t0, tlast_conn;
+
+/*-------------------------------------------------------------------*/
+/* Return elapsed time in usec.                                      */
+/*-------------------------------------------------------------------*/
+static double usec(struct timespec *from, struct timespec *to) {
+   return ((to->tv_sec - from->tv_sec) * 1000000.0) + ((to->tv_nsec - from->tv_nsec) / 1000.0);
+}
+
+/*-------------------------------------------------------------------*/
+/* AID byte for a script verb, or 0 if it is not an AID key.         */
+/*-------------------------------------------------------------------*/
+static BYTE aid_code(char *verb) {
+   static BYTE pf[24] = { 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0x7A, 0x7B, 0x7C,
+                          0xC1, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0x4A, 0x4B, 0x4C };
+   int n;
+
+   if (strcmp(verb, "enter") == 0) return 0x7D;
+   if (strcmp(verb, "clear") == 0) return 0x6D;
+   if (strcmp(verb, "pa1") == 0)   return 0x6C;
+   if (strcmp(verb, "pa2") == 0)   return 0x6E;
+   if (strcmp(verb, "pa3") == 0)   return 0x6B;
+   if ((sscanf(verb, "pf%d", &n) == 1) && (n >= 1) && (n <= 24))
+      return pf[n - 1];
+   return 0;
+}
+
+/*-------------------------------------------------------------------*/
+/* Read the script.                                                  */
+/*-------------------------------------------------------------------*/
+static int read_script(char *file) {
+   FILE *fp;
+   char line[256], verb[16], arg[80];
+   int lineno = 0, n;
+
+   if ((fp = fopen(file, "r")) == NULL) {
+      printf("LOAD: Cannot open script %s\n", file);
+      return -1;
+   }
+   while (fgets(line, sizeof(line), fp) != NULL) {
+      lineno++;
+      line[strcspn(line, "\r\n")] = '\0';
+      verb[0] = arg[0] = '\0';
+      n = sscanf(line, "%15s %79[^\n]", verb, arg);
+      if ((n < 1) || (verb[0] == '*'))
+         continue;
+      for (char *p = verb; *p != '\0'; p++)
+         *p = tolower(*p);
+      if (nstmt == MAXSTMT) {
+         printf("LOAD: Too many script statements\n");
+         return -1;
+      }
+      memset(&stmt[nstmt], 0, sizeof(struct Stmt));
+      stmt[nstmt].line = lineno;
+      strcpy(stmt[nstmt].verb, verb);
+      if (strcmp(verb, "think") == 0) {
+         stmt[nstmt].think = atoi(arg);
+      } else if (strcmp(verb, "wait") == 0) {
+         stmt[nstmt].wait = 1;
+      } else {
+         if ((stmt[nstmt].aid = aid_code(verb)) == 0) {
+            printf("LOAD: Invalid statement in line %d: %s\n", lineno, line);
+            return -1;
+         }
+         strcpy(stmt[nstmt].text, arg);
+      }
+      stmt[nstmt].lat = malloc(sizeof(double) * MAXLAT);
+      nstmt++;
+   }
+   fclose(fp);
+   return 0;
+}
+
+/*-------------------------------------------------------------------*/
+/* Send the inbound 3270 record for an AID statement.                */
+/* Short read AIDs (CLEAR, PA) carry the AID only.                   */
+/*-------------------------------------------------------------------*/
+static int send_aid(struct LSess *s, struct Stmt *st) {
+   BYTE buf[512];
+   int len = 0;
+
+   buf[len++] = st->aid;
+   if ((st->aid != 0x6D) && ((st->aid & 0xF0) != 0x60)) {
+      buf[len++] = 0x40;                          /* Cursor address       */
+      buf[len++] = 0x40;
+      if (st->text[0] != '\0') {
+         buf[len++] = 0x11;                       /* SBA first input field*/
+         buf[len++] = 0x40;
+         buf[len++] = 0x50;
+         for (int i = 0; st->text[i] != '\0'; i++)
+            buf[len++] = host_to_guest(st->text[i]);
+      }
+   }
+   len = double_up_iac(buf, len);
+   buf[len++] = IAC;
+   buf[len++] = EOR_MARK;
+   clock_gettime(CLOCK_MONOTONIC, &s->start);
+   return (write_socket(s->fd, buf, len) == len) ? 0 : -1;
+}
+
+/*-------------------------------------------------------------------*/
+/* Start the next script statement of a session.                     */
+/*-------------------------------------------------------------------*/
+static void next_stmt(struct LSess *s) {
+   struct timespec now;
+
+   while (1) {
+      if (s->pc == nstmt) {
+         s->pc = 0;
+         if (++s->loop >= loops) {
+            s->state = LS_DONE;
+            shutdown(s->fd, SHUT_RDWR);
+            return;
+         }
+      }
+      if ((stmt[s->pc].aid == 0) && (stmt[s->pc].wait == 0)) {   /* think */
+         s->think = stmt[s->pc++].think;
+         continue;
+      }
+      break;
+   }
+   if ((stmt[s->pc].aid != 0) && (s->think > 0)) {
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      s->due = now;
+      s->due.tv_sec += s->think / 1000;
+      s->due.tv_nsec += (s->think % 1000) * 1000000L;
+      if (s->due.tv_nsec >= 1000000000L) {
+         s->due.tv_sec++;
+         s->due.tv_nsec -= 1000000000L;
+      }
+      s->state = LS_THINK;
+      return;
+   }
+   s->state = LS_REPLY;
+   if (stmt[s->pc].aid != 0)
+      send_aid(s, &stmt[s->pc]);
+   else
+      clock_gettime(CLOCK_MONOTONIC, &s->start);  /* wait: time to the next record */
+}
+
+/*-------------------------------------------------------------------*/
+/* A complete host record (IAC EOR) arrived.                         */
+/*-------------------------------------------------------------------*/
+static void record(struct LSess *s) {
+   struct timespec now;
+   struct Stmt *st;
+   double t;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   s->rlen = 0;
+   if (s->state == LS_NEGOTIATE) {               /* Connection screen    */
+      t = usec(&s->start, &now);
+      contot += t;
+      if (t > conmax) conmax = t;
+      connects++;
+      tlast_conn = now;
+      if (nstmt > 0)
+         next_stmt(s);
+      else
+         s->state = LS_DONE;
+      return;
+   }
+   if (s->state != LS_REPLY)                    /* Unsolicited, ignore  */
+      return;
+   st = &stmt[s->pc];
+   t = usec(&s->start, &now);
+   if ((st->count == 0) || (t < st->min)) st->min = t;
+   if (t > st->max) st->max = t;
+   if (st->count < MAXLAT)
+      st->lat[st->count] = t;
+   st->tot += t;
+   st->count++;
+   s->pc++;
+   next_stmt(s);
+}
+
+/*-------------------------------------------------------------------*/
+/* Client side of the telnet negotiation and IAC handling.           */
+/*-------------------------------------------------------------------*/
+static void telnet_in(struct LSess *s, BYTE *buf, int len) {
+   BYTE rsp[64];
+   int rlen;
+   BYTE c;
+
+   for (int i = 0; i < len; i++) {
+      c = buf[i];
+      if (s->cmd != 0) {                         /* Option of DO/DONT/WILL/WONT */
+         rsp[0] = IAC;
+         rsp[2] = c;
+         if (s->cmd == DO)
+            rsp[1] = ((c == TERMINAL_TYPE) || (c == EOR) || (c == BINARY)) ? WILL : WONT;
+         else if (s->cmd == WILL)
+            rsp[1] = ((c == EOR) || (c == BINARY)) ? DO : DONT;
+         else
+            rsp[1] = 0;
+         if (rsp[1] != 0)
+            write_socket(s->fd, rsp, 3);
+         s->cmd = 0;
+         continue;
+      }
+      if (s->iac) {
+         s->iac = 0;
+         switch (c) {
+            case DO: case DONT: case WILL: case WONT:
+               s->cmd = c;
+               break;
+            case SB:
+               s->sb = 1;
+               s->sblen = 0;
+               break;
+            case SE:                             /* SB TERMINAL-TYPE SEND ?  */
+               s->sb = 0;
+               if ((s->sblen >= 2) && (s->sbbuf[0] == TERMINAL_TYPE) && (s->sbbuf[1] == SEND)) {
+                  rlen = 0;
+                  rsp[rlen++] = IAC;
+                  rsp[rlen++] = SB;
+                  rsp[rlen++] = TERMINAL_TYPE;
+                  rsp[rlen++] = IS;
+                  memcpy(&rsp[rlen], termtype, strlen(termtype));
+                  rlen += strlen(termtype);
+                  rsp[rlen++] = IAC;
+                  rsp[rlen++] = SE;
+                  write_socket(s->fd, rsp, rlen);
+               }
+               break;
+            case EOR_MARK:
+               record(s);
+               break;
+            case IAC:                            /* IAC IAC: data byte FF    */
+               s->rlen++;
+               break;
+         }
+         continue;
+      }
+      if (c == IAC) {
+         s->iac = 1;
+         continue;
+      }
+      if (s->sb) {
+         if (s->sblen < sizeof(s->sbbuf))
+            s->sbbuf[s->sblen++] = c;
+         continue;
+      }
+      s->rlen++;                                 /* 3270 data byte           */
+   }
+}
+
+/*-------------------------------------------------------------------*/
+/* Start the connection of a session (non blocking).                 */
+/*-------------------------------------------------------------------*/
+static void start_connect(int i) {
+   struct sockaddr_in servaddr;
+   struct epoll_event ev;
+   int flag = 1;
+
+   servaddr.sin_family = AF_INET;
+   servaddr.sin_addr.s_addr = inet_addr(hostaddr);
+   servaddr.sin_port = htons(port + (i % nports));
+   lsess[i].fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+   if (lsess[i].fd < 0) {
+      printf("LOAD: Session %d: socket failed: %s\n", i, strerror(errno));
+      lsess[i].state = LS_FAILED;
+      failures++;
+      return;
+   }
+   setsockopt(lsess[i].fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+   clock_gettime(CLOCK_MONOTONIC, &lsess[i].start);
+   lsess[i].state = LS_CONNECT;
+   connect(lsess[i].fd, (struct sockaddr*)&servaddr, sizeof(servaddr));
+   ev.events = EPOLLIN | EPOLLOUT;
+   ev.data.u32 = i;
+   epoll_ctl(epfd, EPOLL_CTL_ADD, lsess[i].fd, &ev);
+}
+
+static void fail(struct LSess *s, int i, char *why) {
+   printf("LOAD: Session %d: %s\n", i, why);
+   epoll_ctl(epfd, EPOLL_CTL_DEL, s->fd, NULL);
+   close(s->fd);
+   s->state = LS_FAILED;
+   failures++;
+}
+
+static int cmp_lat(const void *a, const void *b) {
+   double x = *(const double *)a, y = *(const double *)b;
+   return (x < y) ? -1 : (x > y);
+}
+
+int main(int argc, char *argv[]) {
+   struct epoll_event ev, events[256];
+   struct rlimit rl;
+   struct timespec now;
+   BYTE buf[RBUFLEN];
+   char *script = NULL;
+   int i, n, rc, started = 0, active, err;
+   socklen_t errlen;
+   double elapsed, p95;
+   long trans = 0;
+
+   i = 1;
+   while (i < argc) {
+      if ((strcmp(argv[i], "-host") == 0) && (i + 1 < argc)) {
+         hostaddr = argv[i+1];
+         i = i + 2;
+      } else if ((strcmp(argv[i], "-port") == 0) && (i + 1 < argc)) {
+         port = atoi(argv[i+1]);
+         i = i + 2;
+      } else if ((strcmp(argv[i], "-ports") == 0) && (i + 1 < argc)) {
+         nports = atoi(argv[i+1]);
+         i = i + 2;
+      } else if ((strcmp(argv[i], "-sessions") == 0) && (i + 1 < argc)) {
+         nsess = atoi(argv[i+1]);
+         i = i + 2;
+      } else if ((strcmp(argv[i], "-rate") == 0) && (i + 1 < argc)) {
+         rate = atoi(argv[i+1]);
+         i = i + 2;
+      } else if ((strcmp(argv[i], "-loops") == 0) && (i + 1 < argc)) {
+         loops = atoi(argv[i+1]);
+         i = i + 2;
+      } else if ((strcmp(argv[i], "-wait") == 0) && (i + 1 < argc)) {
+         maxwait = atoi(argv[i+1]);
+         i = i + 2;
+      } else if ((strcmp(argv[i], "-term") == 0) && (i + 1 < argc)) {
+         termtype = argv[i+1];
+         i = i + 2;
+      } else if ((argv[i][0] != '-') && (script == NULL)) {
+         script = argv[i];
+         i++;
+      } else {
+         script = NULL;
+         break;
+      }
+   }
+   if ((script == NULL) || (nsess < 1) || (nports < 1) || (loops < 1) || (rate < 0) || (maxwait < 1) ||
+       (strlen(termtype) > 40)) {
+      printf("LOAD: Usage: i3270_load [options] script\n");
+      printf("   Valid options are:\n");
+      printf("    -host {addr}    : controller address (default 127.0.0.1)\n");
+      printf("    -port {n}       : first TN3270 port (default %d)\n", TNPORT);
+      printf("    -ports {n}      : spread the sessions over n ports (default 1)\n");
+      printf("    -sessions {n}   : concurrent sessions (default 10)\n");
+      printf("    -rate {n}       : connects per second, 0 = all at once (default 0)\n");
+      printf("    -loops {n}      : script repetitions per session (default 1)\n");
+      printf("    -wait {sec}     : connect and response time limit (default 30)\n");
+      printf("    -term {type}    : terminal type (default IBM-3278-2)\n");
+      return 1;
+   }
+   if (read_script(script) != 0)
+      return 1;
+
+   // Every session needs a descriptor.
+   getrlimit(RLIMIT_NOFILE, &rl);
+   if (rl.rlim_cur < nsess + 16) {
+      rl.rlim_cur = (rl.rlim_max < nsess + 16) ? rl.rlim_max : nsess + 16;
+      setrlimit(RLIMIT_NOFILE, &rl);
+      if (rl.rlim_cur < nsess + 16) {
+         printf("LOAD: Descriptor limit %ld too low for %d sessions\n", (long) rl.rlim_cur, nsess);
+         return 1;
+      }
+   }
+   lsess = calloc(nsess, sizeof(struct LSess));
+   epfd = epoll_create1(0);
+
+   printf("LOAD: %d session(s) to %s port %d..%d, %d statement(s), %d loop(s), terminal %s\n",
+          nsess, hostaddr, port, port + nports - 1, nstmt, loops, termtype);
+   clock_gettime(CLOCK_MONOTONIC, &t0);
+   tlast_conn = t0;
+
+   do {
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      // Start the connections, paced by -rate.
+      while ((started < nsess) && ((rate == 0) || (usec(&t0, &now) >= started * 1000000.0 / rate)))
+         start_connect(started++);
+
+      n = epoll_wait(epfd, events, 256, 1);
+      for (int e = 0; e < n; e++) {
+         i = events[e].data.u32;
+         struct LSess *s = &lsess[i];
+         if (s->state == LS_CONNECT) {
+            err = 0;
+            errlen = sizeof(err);
+            getsockopt(s->fd, SOL_SOCKET, SO_ERROR, &err, &errlen);
+            if (err != 0) {
+               fail(s, i, strerror(err));
+               continue;
+            }
+            s->state = LS_NEGOTIATE;
+            ev.events = EPOLLIN;
+            ev.data.u32 = i;
+            epoll_ctl(epfd, EPOLL_CTL_MOD, s->fd, &ev);
+         }
+         if (events[e].events & EPOLLIN) {
+            rc = read(s->fd, buf, sizeof(buf));
+            if (rc < 1) {
+               if (s->state == LS_DONE) {
+                  epoll_ctl(epfd, EPOLL_CTL_DEL, s->fd, NULL);
+                  close(s->fd);
+                  s->state = LS_CLOSED;
+               } else {
+                  fail(s, i, "connection closed by the controller");
+               }
+               continue;
+            }
+            telnet_in(s, buf, rc);
+         }
+      }
+
+      // Think times and time limits.
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      active = 0;
+      for (i = 0; i < started; i++) {
+         struct LSess *s = &lsess[i];
+         if ((s->state == LS_THINK) && (usec(&s->due, &now) >= 0)) {
+            s->state = LS_REPLY;
+            send_aid(s, &stmt[s->pc]);
+         }
+         if ((s->state < LS_THINK || s->state == LS_REPLY) && (usec(&s->start, &now) > maxwait * 1000000.0)) {
+            fail(s, i, (s->state == LS_REPLY) ? "no host reply" : "no connection screen (LU not available ?)");
+            continue;
+         }
+         if (s->state < LS_DONE)
+            active++;
+      }
+   } while ((active > 0) || (started < nsess));
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   elapsed = usec(&t0, &now) / 1000000.0;
+
+   printf("\n  Connected: %ld, failed: %ld\n", connects, failures);
+   if (connects > 0)
+      printf("  Connect time: avg %.0f usec, max %.0f usec, rate %.1f connects/sec\n",
+             contot / connects, conmax, connects / (usec(&t0, &tlast_conn) / 1000000.0));
+   printf("\n  Line  Statement             Responses  Resp min(us)  Resp avg(us)  Resp max(us)  95%% below(us)\n");
+   for (i = 0; i < nstmt; i++) {
+      if ((stmt[i].aid == 0) && (stmt[i].wait == 0))
+         continue;
+      n = (stmt[i].count < MAXLAT) ? stmt[i].count : MAXLAT;
+      qsort(stmt[i].lat, n, sizeof(double), cmp_lat);
+      p95 = (n > 0) ? stmt[i].lat[(n * 95) / 100] : 0.0;
+      printf("  %4d  %-5s %-14.14s  %9ld  %12.0f  %12.0f  %12.0f  %13.0f\n", stmt[i].line,
+             stmt[i].verb, stmt[i].text,
+             stmt[i].count, stmt[i].min, (stmt[i].count > 0) ? stmt[i].tot / stmt[i].count : 0.0,
+             stmt[i].max, p95);
+      trans += stmt[i].count;
+   }
+   printf("\n  Elapsed: %.2f sec, %ld transactions, %.1f transactions/sec\n\n", elapsed, trans, trans / elapsed);
+   return 0;
+}
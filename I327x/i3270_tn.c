@@ -310,6 +310,9 @@ BYTE    buf[512];                       /* Receive buffer            */
 /* extended attributes. Displays are negotiated into tn3270 mode.    */
 /* An optional device number suffix (example: IBM-3270@01F) may      */
 /* be specified to request allocation to a specific device number.   */
+/* A four digit suffix (example: IBM-3278-2@C102) names the station  */
+/* address and the LU number; it is used to route the client to the  */
+/* controller that owns that station when the port is shared.        */
 /* Valid 3270 printer type is "IBM-3287-1"                           */
 /*                                                                   */
 /* Terminal types whose first four characters are not "IBM-" are     */
@@ -323,16 +326,18 @@ BYTE    buf[512];                       /* Receive buffer            */
 /*      model   3270 model indicator (2,3,4,5,X)                     */
 /*      extatr  3270 extended attributes (Y,N)                       */
 /*      devn    Requested device number, or FF=any device number     */
+/*      stan    Requested station address, or FF=any station         */
 /* Return value:                                                     */
 /*      0=negotiation successful, -1=negotiation error               */
 /*-------------------------------------------------------------------*/
-int negotiate(int csock, BYTE *class, BYTE *model, BYTE *extatr, BYTE *devn)
+int negotiate(int csock, BYTE *class, BYTE *model, BYTE *extatr, BYTE *devn, BYTE *stan)
 {
 int    rc;                              /* Return code               */
 char  *termtype;                        /* Pointer to terminal type  */
 char  *s;                               /* String pointer            */
 BYTE   c;                               /* Trailing character        */
-BYTE   devnum;                          /* Requested device number   */
+unsigned int devnum;                    /* Requested device number   */
+int    ndig;                            /* Number of suffix digits   */
 BYTE   buf[512];                        /* Telnet negotiation buffer */
 static BYTE do_term[] = { IAC, DO, TERMINAL_TYPE };
 static BYTE will_term[] = { IAC, WILL, TERMINAL_TYPE };
@@ -391,8 +396,15 @@ static BYTE will_naws[] = { IAC, WILL, NAWS };
    /* Check terminal type string for device name suffix */
    s = strchr (termtype, '@');
 
-   if (s != NULL && sscanf (s, "@%02x", &devnum) == 1) {
-      *devn = devnum;
+   *stan = 0xFF;
+   if (s != NULL && sscanf (s, "@%4x%n", &devnum, &ndig) == 1) {
+      if (ndig == 5) {                  /* @SSLL: station and LU     */
+         *stan = devnum >> 8;
+         *devn = devnum & 0xFF;
+      } else {
+         sscanf (s, "@%02x", &devnum);
+         *devn = devnum;
+      }
    }
    else {
       *devn = 0xFF;
@@ -492,51 +504,45 @@ static BYTE will_naws[] = { IAC, WILL, NAWS };
 
 
 /*-------------------------------------------------------------------*/
-/* NEW CLIENT CONNECTION                                             */
+/* NEGOTIATE NEW CLIENT                                              */
+/* Negotiates the telnet options only, so that a controller sharing  */
+/* its listening port can find the owner of the requested station    */
+/* before the client is greeted.                                     */
+/* Returns 0 if ok, -1 if negotiation failed (socket is closed).     */
 /*-------------------------------------------------------------------*/
-int connect_client (int *csockp, BYTE i327xnump, BYTE *portnump, BYTE *portnumr)
-/* returns 1 if 3270, else 0 */
+int negotiate_client (int csock, BYTE *class, BYTE *stan, BYTE *portnumr)
 {
 int                     rc;             /* Return code               */
-size_t                  len;            /* Data length               */
-int                     csock;          /* Socket for conversation   */
-BYTE                    portnum;        /* Proposed port number      */
-struct sockaddr_in      client;         /* Client address structure  */
-socklen_t               namelen;        /* Length of client structure*/
-char                   *clientip;       /* Addr of client ip address */
-BYTE                    devnum;         /* Requested device number   */
-BYTE                    class;          /* D=3270, P=3287, K=3215/1052 */
 BYTE                    model;          /* 3270 model (2,3,4,5,X)    */
 BYTE                    extended;       /* Extended attributes (Y,N) */
+
+   rc = negotiate (csock, class, &model, &extended, portnumr, stan);
+   if (rc != 0) {
+      close (csock);
+      return -1;
+   }
+   return 0;
+}  // End function negotiate_client
+
+/*-------------------------------------------------------------------*/
+/* GREET NEGOTIATED CLIENT                                           */
+/* Sends the connection message to the client.                       */
+/* Returns 1 if 3270, else 0                                         */
+/*-------------------------------------------------------------------*/
+int greet_client (int csock, BYTE class, BYTE i327xnump, BYTE portnum)
+{
+int                     rc;             /* Return code               */
+size_t                  len;            /* Data length               */
 char                    buf[256];       /* Message buffer            */
 char                    conmsg[256];    /* Connection message        */
 char                    devmsg[40];     /* Device message            */
 char                    hostmsg[256];   /* Host ID message           */
-char                    num_procs[16];  /* #of processors string     */
-
-   /* Load the socket address from the thread parameter */
-   csock = *csockp;
-
-   /* Obtain the client's IP address */
-   namelen = sizeof(client);
-   rc = getpeername (csock, (struct sockaddr *)&client, &namelen);
-
-   /* Log the client's IP address and hostname */
-   clientip = strdup(inet_ntoa(client.sin_addr));
 
-
-   /* Negotiate telnet parameters */
-   rc = negotiate (csock, &class, &model, &extended, portnumr);
-   if (*portnumr == 0xFF) *portnumr = *portnump;
-
-   if (rc != 0) {
-      close (csock);
-      if (clientip) free(clientip);
-      return 0;
-   }
+   conmsg[0] = '\0';
+   hostmsg[0] = '\0';
 
    /* Build connection message for client */
-       snprintf (devmsg, sizeof(devmsg)-1, "Connecting to 327x-%01X port %02X  ", i327xnump, *portnumr);
+       snprintf (devmsg, sizeof(devmsg)-1, "Connecting to 327x-%01X port %02X  ", i327xnump, portnum);
 
    /* Send connection message to client */
    if (class != 'K') {
@@ -567,6 +573,25 @@ char                    num_procs[16];  /* #of processors string     */
       rc = send_packet (csock, (BYTE *)buf, (int)len, "CONNECTION RESPONSE");
    }
    return (class == 'D') ? 1 : 0;   /* return 1 if 3270 */
+}  // End function greet_client
+
+/*-------------------------------------------------------------------*/
+/* NEW CLIENT CONNECTION                                             */
+/*-------------------------------------------------------------------*/
+int connect_client (int *csockp, BYTE i327xnump, BYTE *portnump, BYTE *portnumr)
+/* returns 1 if 3270, else 0 */
+{
+BYTE                    class;          /* D=3270, P=3287, K=3215/1052 */
+BYTE                    stan;           /* Requested station address */
+
+   /* Negotiate telnet parameters */
+   if (negotiate_client (*csockp, &class, &stan, portnumr) != 0) {
+      if (*portnumr == 0xFF) *portnumr = *portnump;
+      return 0;
+   }
+   if (*portnumr == 0xFF) *portnumr = *portnump;
+
+   return greet_client (*csockp, class, i327xnump, *portnumr);
 }  // End function connect_client */
 
 /********************************************************************/
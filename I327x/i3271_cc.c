@@ -101,6 +101,7 @@ int send_packet(int csock, uint8_t *buf, int len, char *caption);
 int connect_client (int *csockp, BYTE i327xnump, BYTE *lunump, BYTE *lunumr);
 int SocketReadAct (int fd);
 void ReadSig (int rs232_fd);
+void SendLeadID (int data_fd, int rs232_fd);
 
 uint8_t  ACKreq = 0;
 uint8_t  NAKreq = 0;
@@ -684,6 +685,7 @@ void main(int argc, char *argv[]) {
    while (connect(rs232_fd, (struct sockaddr*)&servaddr, sizeof(servaddr)) != 0) {
       sleep(1);
    }
+   SendLeadID(clubsc_fd, rs232_fd);
    printf("\rCLU: BSC line connection has been established\n");
    // Now 'IML' the 3271
    rc = proc_CLUiml();
@@ -718,6 +720,7 @@ void main(int argc, char *argv[]) {
          while (connect(rs232_fd, (struct sockaddr*)&servaddr, sizeof(servaddr)) != 0) {
             sleep(1);
          }  // End while
+         SendLeadID(clubsc_fd, rs232_fd);
          printf("\rCLU: BSC line connection has been re-established\n");
          signal = RTS;
          rc = send(rs232_fd, &signal,1, 0);                      // Set RTS signal high (ready to send/receive)
@@ -787,6 +790,24 @@ void main(int argc, char *argv[]) {
       return;
 }
 
+//*******************************************************************************************
+// Identify the two leads to the 3705 line: the data lead starts with LEAD_DATA, the RS232  *
+// signal lead with LEAD_SIG and the local port of the data lead, so the LIB can pair them. *
+//*******************************************************************************************
+void SendLeadID(int data_fd, int rs232_fd) {
+   struct sockaddr_in addr;
+   socklen_t addrlen = sizeof(addr);
+   uint8_t lead[3];
+
+   lead[0] = LEAD_DATA;
+   send(data_fd, lead, 1, 0);
+   getsockname(data_fd, (struct sockaddr *)&addr, &addrlen);
+   lead[0] = LEAD_SIG;
+   memcpy(&lead[1], &addr.sin_port, 2);                  // Port in network byte order
+   send(rs232_fd, lead, 3, 0);
+   return;
+}
+
 //*******************************************************************************************
 // Check if there is a signal update from the RS232 connection                              *
 // If so, receive signal data from the RS232 connection and respond if needed               *
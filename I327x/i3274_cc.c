@@ -36,6 +36,7 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <signal.h>
 #include <unistd.h>
 #include <ctype.h>
@@ -47,17 +48,21 @@
 #include <errno.h>
 #include <sys/epoll.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <sys/ioctl.h>
 #include <sys/syscall.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
 
 #if !defined(min)
 #define  min(a,b)   (((a) <= (b)) ? (a) : (b))
 #endif
 
 #define BUFPD 0x1C
+#define MAXOUT 7                    // SDLC window: frames per poll response (modulo 8)
 
 /* RS232 signals. The 4 high order bit positions are alinged with the scanner Display Register   */
 #define CTS 0x80   /* Clear To Send                 */
@@ -79,6 +84,12 @@ uint16_t   lineport;                /* SDLC line listening port          */
 int        pusdlc_fd;               /* PU.T2 connection                  */
 int        rs232_fd;                /* RS232 signal connection           */
 int        station;                 /* Station number based on station address */
+uint8_t    staddr[MAXSNAPU];        /* Station address of each PU (-addr)         */
+int        nstaddr = 0;             /* Number of -addr addresses (0 = any)        */
+int        tnport = 0;              /* Shared TN3270 port (-port), 0 = none       */
+int        tn_fd = -1;              /* Shared TN3270 listening socket             */
+int        rt_fd[MAXSNAPU];         /* Route socket per station, -1 = not ours    */
+int        rs_fd = -1;              /* Socket used to hand clients to other 3274s */
 int        sockopt;                 /* Used for setsocketoption          */
 int        pendingrcv;              /* pending data on the socket        */
 int        event_count;             /* # events received                 */
@@ -96,6 +107,12 @@ uint8_t BLU_rsp_buf[BUFLEN_3274];   // DLC header + TH + RH + RU + DLC trailer
 int     BLU_rsp_ptr;                // Offset pointer to BLU
 int     BLU_rsp_len;                // Length of BLU response
 int     BLU_rsp_stat;               // BLU buffer state
+int     BLU_rsp_frm[MAXOUT];        // Offset of each frame in a multi frame response
+int     BLU_rsp_nfrm;               // Number of frames in the response (0 = one frame)
+int     BLU_rsp_room;               // Frames left in the SDLC window for this poll
+int     BLU_rsp_budget;             // Bytes left in the byte budget for this poll
+int     pollbudget = 4096;          // Inbound bytes per poll response (-budget)
+SSL_CTX *tls_ctx = NULL;            // TLS for the TN3270 listeners (-tlscert), NULL = plain
 // Saved RH
 uint8_t  saved_FD2_RH_0;
 uint8_t  saved_FD2_RH_1;
@@ -114,10 +131,19 @@ uint8_t SDLCreqb[BUFLEN_3274];
 void commadpt_read_tty(struct CB327x *i327x, struct IO3270 *ioblk, BYTE * bfr, BYTE lunum, int len);
 int send_packet(int csock, BYTE *buf, int len, char *caption);
 int connect_client (int *csockp, BYTE i327xnump, BYTE *lunump, BYTE *lunumr);
+int negotiate_client (int csock, BYTE *class, BYTE *stan, BYTE *portnumr);
+int greet_client (int csock, BYTE class, BYTE i327xnump, BYTE portnum);
 int SocketReadAct (int fd);
 
 void make_seq (struct CB327x *pu2, BYTE *bufptr, int lunum);
+int  pacing_open (struct CB327x *pu2, int lunum);
+int  addr2station (uint8_t addr);
+void lu_attach (BYTE k, int fd, BYTE class, BYTE lu);
+void lu_connected (BYTE k);
+int  tn_listen (void);
+void proc_shared (void);
 void ReadSig (int rs232_fd);
+void SendLeadID (int data_fd, int rs232_fd);
 
 /*-------------------------------------------------------------------*/
 /* Supported FMD NS Headers                                          */
@@ -199,6 +225,177 @@ uint8_t F2_REQCONT_Req[] = {
 // uint8_t PLU_rsp_buf[BUFLEN_3270]; /* PIU response buffer: TH + RH + RU  */
 int double_up_iac (BYTE *buf, int len);
 
+/*-------------------------------------------------------------------*/
+/* Subroutine to build the next inbound frame of LU k into buffer.   */
+/* In order of precedence this is an isolated pacing response, the   */
+/* pending TN3270 input or a NOTIFY / TERMSELF for power on / off.   */
+/* Returns the frame length, or 0 if the LU has nothing to send.     */
+/*-------------------------------------------------------------------*/
+int lu_inbound (int k, unsigned char BLU_req_buf[], unsigned char BLU_rsp_buf[]) {
+   int BLU_rsp_ptr = 0;                      // Offset in this frame
+   int BLU_rsp_len;
+   int RU_rsp_len;
+   int i;
+
+   if ((pu2[station]->pac_ipr[k] == ON) && (pu2[station]->bindflag[k] == 1)) {
+      // Outbound data of a paced window has been passed on to the
+      // terminal: send an isolated pacing response (IPR) to the host.
+      BLU_rsp_buf[BLU_rsp_ptr++] = 0x7E;     // Bflag
+      BLU_rsp_buf[BLU_rsp_ptr++] = BLU_req_buf[FAddr];   // Sec Station Addr
+      BLU_rsp_buf[BLU_rsp_ptr++] = CFinal;   // Control byte
+
+      /* Construct 6 byte FID2 TH */
+      BLU_rsp_buf[FD2_TH_0] = 0x2E;          // FID2
+      BLU_rsp_buf[FD2_TH_1] = 0x00;          // Reserved
+      BLU_rsp_buf[FD2_TH_daf] = pu2[station]->daf_addr1[k]; //  daf
+      BLU_rsp_buf[FD2_TH_oaf] = k+2;         // oaf
+      BLU_rsp_buf[FD2_TH_scf0] = 0x00;       // IPR carries no sequence number
+      BLU_rsp_buf[FD2_TH_scf1] = 0x00;
+
+      /* Construct 3 byte FID2 RH */
+      BLU_rsp_buf[FD2_RH_0] = 0x83;          // FMD response
+      BLU_rsp_buf[FD2_RH_1] = 0x01;          // Pacing indicator only
+      BLU_rsp_buf[FD2_RH_2] = 0x00;
+      BLU_rsp_ptr = BLU_rsp_ptr + 6 + 3;     // Update BLU pointer
+
+      /* Construct 3 byte LT */
+      BLU_rsp_buf[BLU_rsp_ptr++] = 0x47;     // FCS High
+      BLU_rsp_buf[BLU_rsp_ptr++] = 0x0F;     // FCS Low
+      BLU_rsp_buf[BLU_rsp_ptr++] = 0x7E;     // Eflag
+      BLU_rsp_len = BLU_rsp_ptr;             // Update BLU_rsp_len
+      pu2[station]->pac_ipr[k] = OFF;
+      if (Tdbg_flag == ON)                   // Trace Terminal Controller ?
+         fprintf(T_trace, "PIU4: <= IPR for LU %02X\n", k+2);
+      return(BLU_rsp_len);                   // Send IPR to host
+   }  // End if pac_ipr
+   if ((pu2[station]->lu_fd[k] > 0) && (pu2[station]->readylu[k] == 1)) {
+      if ((pu2[station]->actlu[k] == 1) && (ioblk[pu2[station]->punum][k]->inpbufl > 0) &&
+          (pacing_open(pu2[station], k))) {
+
+         // TN3270 input found. Build FID2 & Rsp RU
+         RU_rsp_len = ioblk[pu2[station]->punum][k]->inpbufl;
+
+         /* Construct 3 byte LH */
+         BLU_rsp_buf[BLU_rsp_ptr++] = 0x7E;  // Bflag
+         BLU_rsp_buf[BLU_rsp_ptr++] = BLU_req_buf[FAddr]; // Sec Station Addr
+         //BLU_rsp_buf[BLU_rsp_ptr++] = BLU_req_buf[FCntl]; // Control byte
+         BLU_rsp_buf[BLU_rsp_ptr++] = CFinal;             // Control byte
+         //BLU_rsp_buf[FCntl] = CFinal;                     // Set final bit
+
+         /* Construct 6 byte FID2 TH */
+         BLU_rsp_buf[FD2_TH_0] = 0x2E;       // FID2
+         BLU_rsp_buf[FD2_TH_1] = 0x00;       // Reserved
+         BLU_rsp_buf[FD2_TH_daf] = pu2[station]->daf_addr1[k]; //  daf
+         BLU_rsp_buf[FD2_TH_oaf] = k+2;      // oaf
+         BLU_rsp_buf[FD2_TH_scf0] = 0x00;    // seq #
+         BLU_rsp_buf[FD2_TH_scf1] = 0x00;
+         make_seq(pu2[station], BLU_rsp_buf, k); // Update sequence number for this LU
+
+         /* Construct 3 byte FID2 RH */
+         BLU_rsp_buf[FD2_RH_0] = 0x00;
+         BLU_rsp_buf[FD2_RH_0] |= 0x03;      // Indicate this is first and last in chain
+         BLU_rsp_buf[FD2_RH_1] = 0x80;       // We need a response...
+         pu2[station]->dri[k] = ON;          // ...so remember this
+         BLU_rsp_buf[FD2_RH_2] = 0x20;       // Indicate Change Direction
+         BLU_rsp_ptr = BLU_rsp_ptr + 6 + 3;  // Update BLU pointer
+         if (pu2[station]->pac_win[k] > 0) { // Inbound pacing in effect ?
+            if (pu2[station]->pac_cnt[k] == 0) {   // First request of a new window...
+               pu2[station]->pac_cnt[k] = pu2[station]->pac_win[k];
+               pu2[station]->pac_nxt[k] = OFF;     // ...next window needs a pacing rsp
+               BLU_rsp_buf[FD2_RH_1] |= 0x01;      // ...so set the pacing indicator
+            }
+            pu2[station]->pac_cnt[k]--;
+         }
+
+         /* Copy 3270 input buffer as RU (Rsp) after TH and RH */
+         for (int j = 0; j < RU_rsp_len; j++)
+            BLU_rsp_buf[BLU_rsp_ptr++] = ioblk[pu2[station]->punum][k]->inpbuf[j];
+
+         /* Construct 3 byte LT */
+         BLU_rsp_buf[BLU_rsp_ptr++] = 0x47;  // FCS High
+         BLU_rsp_buf[BLU_rsp_ptr++] = 0x0F;  // FCS Low
+         BLU_rsp_buf[BLU_rsp_ptr++] = 0x7E;  // Eflag
+         BLU_rsp_len = BLU_rsp_ptr;          // Update BLU_rsp_len
+         ioblk[pu2[station]->punum][k]->inpbufl = 0; // 3270 input buffer has been processed, so reset length.
+
+         if (Tdbg_flag == ON) {              // Trace Terminal Controller ?
+            fprintf(T_trace, "PIU4: <= 3270 Data [%d]: \nPIU4: ", BLU_rsp_len);
+            for (i = 0; i < BLU_rsp_len; i++) {
+               fprintf(T_trace, "%02X ", (int) BLU_rsp_buf[i] & 0xFF);
+               if ((i + 1) % 16 == 0)
+                  fprintf(T_trace, " \nPIU4: ");
+            }
+            fprintf(T_trace, "\n");
+         }
+         /* Send 3270 data response to host */
+         return(BLU_rsp_len);                // Send 3270 response BLU to host
+      } // End if pu2[station]->actlu[k] == 1
+   } else if (((pu2[station]->lu_fd[k] > 0) && (pu2[station]->readylu[k] == 2)) ||
+               (pu2[station]->readylu[k] > 2)) { // End if pu2[station]->lu_fd[k] > 0
+      /* This section handles a LU "power on" (i.e. 3270 terminal connect) or           */
+      /*  a LU "power off" (i.e. 3270 terminal disconnect)                              */
+      /* A SNA Nofify command with LU "powered on" is send to VTAM if readylu=2         */
+      /* A SNA Nofify command with LU "powered off" is send to VTAM if readylu=3        */
+      /* readylu=3 indicates TN3270 has disconnected, but LU is still active for VTAM   */
+      if (Tdbg_flag == ON)                   // Trace Terminal Controller ?
+         fprintf(T_trace, "Preparing UNBIND / NOTIFY request\n ");
+      /* Construct 3 byte LH */
+      BLU_rsp_buf[BLU_rsp_ptr++] = 0x7E;     // Bflag
+      BLU_rsp_buf[BLU_rsp_ptr++] = BLU_req_buf[FAddr];   // Sec Station Addr
+      //BLU_rsp_buf[BLU_rsp_ptr++] = BLU_req_buf[FCntl]; // Control byte
+      BLU_rsp_buf[BLU_rsp_ptr++] = CFinal;               // Control byte
+      //BLU_rsp_buf[FCntl] = CFinal;         // Set final bit
+
+      /* Construct 6 byte FID2 TH */
+      BLU_rsp_buf[FD2_TH_0] = 0x2E;          // FID2
+      BLU_rsp_buf[FD2_TH_1] = 0x00;          // Reserved
+      BLU_rsp_buf[FD2_TH_daf] = pu2[station]->daf_addr1[k]; //  daf
+      BLU_rsp_buf[FD2_TH_oaf] = k+2;         // oaf
+      BLU_rsp_buf[FD2_TH_scf0] = 0x00;       // seq #
+      BLU_rsp_buf[FD2_TH_scf1] = 0x00;
+      make_seq(pu2[station], BLU_rsp_buf, k);  // Update sequence number for this LU
+
+      /* Construct 3 byte FID2 RH */
+      BLU_rsp_buf[FD2_RH_0] = 0x00;          //  FM Data (FMD)
+      BLU_rsp_buf[FD2_RH_0] |= 0x08;         // Field formatted RU
+      BLU_rsp_buf[FD2_RH_0] |= 0x03;         // Indicate this is first and last in chain
+      BLU_rsp_buf[FD2_RH_1] = 0x00;          // We do not need a response...
+      //BLU_rsp_buf[FD2_RH_1] = 0x80;          // We need a response...
+      //pu2[station]->dri[k] = ON;             // ...so remember this
+      BLU_rsp_buf[FD2_RH_2] = 0x20;          // Indicate Change Direction
+      BLU_rsp_ptr = BLU_rsp_ptr + 6 + 3;     // Update BLU pointer
+
+      /* This section handles LU Power On and LU Power off     */
+      if (pu2[station]->readylu[k] == 4) {  // There is still an activer BIND, so prepare UNBIND
+        //BLU_rsp_buf[FD2_TH_daf] = pu2[station]->bindflag[k];      //  copy DAF of LU at the other end
+        BLU_rsp_buf[FD2_TH_daf] = 0x00;                             //  SSCP
+        memcpy(&BLU_rsp_buf[BLU_rsp_ptr], F2_TERMSELF_Req, sizeof(F2_TERMSELF_Req));
+        pu2[station]->bindflag[k] = 0;     //  reset bindflag
+        BLU_rsp_ptr = BLU_rsp_ptr + sizeof(F2_TERMSELF_Req);
+      } // End  if (pu2[station]->readylu[k] == 4)
+      if (pu2[station]->readylu[k] == 3)  {  // Power off, no BIND active, so sent NOTIFY for power off
+        memcpy(&BLU_rsp_buf[BLU_rsp_ptr], F2_NOTIFY_Req, sizeof(F2_NOTIFY_Req)); //
+        BLU_rsp_buf[FD2_RU_0 + 5] = 0x01;        // indicate Power off.
+        BLU_rsp_ptr = BLU_rsp_ptr + sizeof(F2_NOTIFY_Req);
+      } // End if (pu2[station]->readylu[k] == 3)
+      if (pu2[station]->readylu[k] == 2)  {  // Power on after ACTLU, send NOTIFY for power on
+        memcpy(&BLU_rsp_buf[BLU_rsp_ptr], F2_NOTIFY_Req, sizeof(F2_NOTIFY_Req)); //
+        BLU_rsp_buf[FD2_RU_0 + 5] = 0x03;        // indicate Power on.
+        BLU_rsp_ptr = BLU_rsp_ptr + sizeof(F2_NOTIFY_Req);
+      } // End if (pu2[station]->readylu[k] == 2)
+      /*                                      */
+      /* Construct 3 byte LT */
+      BLU_rsp_buf[BLU_rsp_ptr++] = 0x47;     // FCS High
+      BLU_rsp_buf[BLU_rsp_ptr++] = 0x0F;     // FCS Low
+      BLU_rsp_buf[BLU_rsp_ptr++] = 0x7E;     // Eflag
+      BLU_rsp_len = BLU_rsp_ptr;             // Update BLU_rsp_len
+      if (pu2[station]->readylu[k] > 1)
+         pu2[station]->readylu[k]--;          // Indicate next phase (1 = active, 2 powering on, 3 = powering off, 4 = unbind)
+      return(BLU_rsp_len);                   // Send 3270 response BLU to host
+   }  // End if ((pu2[station]->lu_fd[k] > 0)
+   return 0;                                 // Nothing pending for this LU
+}
+
 /*-------------------------------------------------------------------*/
 /* Process FID2 PIU (TH + RH + RU (Req)                              */
 /*-------------------------------------------------------------------*/
@@ -228,9 +425,9 @@ int proc_PIU (unsigned char BLU_req_buf[], int BLU_req_len, unsigned char BLU_rs
    // Load Frame Control Field
    Fcntl = BLU_req_buf[FCntl];
    // Set the 3274 to the provided station address.
-   // If it is a broadcast (FF) the station address will be set to C1) (has to be improved)
-   if (BLU_req_buf[FAddr] == 0xFF) BLU_req_buf[FAddr] = 0xC1;
-   station = (BLU_req_buf[FAddr] & 0x0F) - 1;
+   // If it is a broadcast (FF) the station address will be set to the first station (C1 without -addr)
+   if (BLU_req_buf[FAddr] == 0xFF) BLU_req_buf[FAddr] = (nstaddr > 0) ? staddr[0] : 0xC1;
+   station = addr2station(BLU_req_buf[FAddr]);
 
    if (Tdbg_flag == ON) {  // Trace Terminal Controller ?
       if ((Fcntl & 0x03) == SUPRV) {                     // Supervisory format ?
@@ -316,147 +513,51 @@ int proc_PIU (unsigned char BLU_req_buf[], int BLU_req_len, unsigned char BLU_rs
          //================================================================
          if (BLU_rsp_stat == EMPTY) {         // Empty ?
             // RR received and no response pending.
-            // SCAN all active LU's for any new input.
-            for (int k = pu2[station]->last_lu; k < MAXLU; k++) {
-               if ((pu2[station]->lu_fd[k] > 0) && (pu2[station]->readylu[k] == 1)) {
-                  if ((pu2[station]->actlu[k] == 1) && (ioblk[pu2[station]->punum][k]->inpbufl > 0)) {
-
-                     // TN3270 input found. Build FID2 & Rsp RU
-                     RU_rsp_len = ioblk[pu2[station]->punum][k]->inpbufl;
-
-                     /* Construct 3 byte LH */
-                     BLU_rsp_ptr = 0;                    // Reset pointer
-                     BLU_rsp_buf[BLU_rsp_ptr++] = 0x7E;  // Bflag
-                     BLU_rsp_buf[BLU_rsp_ptr++] = BLU_req_buf[FAddr]; // Sec Station Addr
-                     //BLU_rsp_buf[BLU_rsp_ptr++] = BLU_req_buf[FCntl]; // Control byte
-                     BLU_rsp_buf[BLU_rsp_ptr++] = CFinal;             // Control byte
-                     //BLU_rsp_buf[FCntl] = CFinal;                     // Set final bit
-
-                     /* Construct 6 byte FID2 TH */
-                     BLU_rsp_buf[FD2_TH_0] = 0x2E;       // FID2
-                     BLU_rsp_buf[FD2_TH_1] = 0x00;       // Reserved
-                     BLU_rsp_buf[FD2_TH_daf] = pu2[station]->daf_addr1[k]; //  daf
-                     BLU_rsp_buf[FD2_TH_oaf] = k+2;      // oaf
-                     BLU_rsp_buf[FD2_TH_scf0] = 0x00;    // seq #
-                     BLU_rsp_buf[FD2_TH_scf1] = 0x00;
-                     make_seq(pu2[station], BLU_rsp_buf, k); // Update sequence number for this LU
-
-                     /* Construct 3 byte FID2 RH */
-                     BLU_rsp_buf[FD2_RH_0] = 0x00;
-                     BLU_rsp_buf[FD2_RH_0] |= 0x03;      // Indicate this is first and last in chain
-                     BLU_rsp_buf[FD2_RH_1] = 0x80;       // We need a response...
-                     pu2[station]->dri[k] = ON;          // ...so remember this
-                     BLU_rsp_buf[FD2_RH_2] = 0x20;       // Indicate Change Direction
-                     BLU_rsp_ptr = BLU_rsp_ptr + 6 + 3;  // Update BLU pointer
-
-                     /* Copy 3270 input buffer as RU (Rsp) after TH and RH */
-                     for (int j = 0; j < RU_rsp_len; j++)
-                        BLU_rsp_buf[BLU_rsp_ptr++] = ioblk[pu2[station]->punum][k]->inpbuf[j];
-
-                     /* Construct 3 byte LT */
-                     BLU_rsp_buf[BLU_rsp_ptr++] = 0x47;  // FCS High
-                     BLU_rsp_buf[BLU_rsp_ptr++] = 0x0F;  // FCS Low
-                     BLU_rsp_buf[BLU_rsp_ptr++] = 0x7E;  // Eflag
-                     BLU_rsp_len = BLU_rsp_ptr;          // Update BLU_rsp_len
-                     if (!(BLU_req_buf[FCntl] & CPoll)) {  // No polling? - Unlikely since this is RR, but just in case ....
-                        //BLU_rsp_buf[FCntl] = CFinal;   // Set final bit
-                        BLU_rsp_stat = FILLED;           // ...Indicate there is data to send.
-                     }
-                     ioblk[pu2[station]->punum][k]->inpbufl = 0; // 3270 input buffer has been processed, so reset length.
-
-                     if (Tdbg_flag == ON) {              // Trace Terminal Controller ?
-                        fprintf(T_trace, "PIU4: <= 3270 Data [%d]: \nPIU4: ", BLU_rsp_len);
-                        for (i = 0; i < BLU_rsp_len; i++) {
-                           fprintf(T_trace, "%02X ", (int) BLU_rsp_buf[i] & 0xFF);
-                           if ((i + 1) % 16 == 0)
-                              fprintf(T_trace, " \nPIU4: ");
-                        }
-                        fprintf(T_trace, "\n");
-                     }
-                     /* Cycle through all LU's 1 by 1 to check if there is input.
-                        Keep a pointer to the last lu that has been scanned.
-                        The next RR will start with the one following the last
-                        If all LU's have been scanned, start again with the first LU */
-                     pu2[station]->last_lu = k + 1;
-                     if (pu2[station]->last_lu == MAXLU)
-                        pu2[station]->last_lu = 0;
-                     /* Send 3270 data response to host */
-                     return(BLU_rsp_len);                // Send 3270 response BLU to host
-                  } // End if pu2[station]->actlu[k] == 1
-               } else if (((pu2[station]->lu_fd[k] > 0) && (pu2[station]->readylu[k] == 2)) ||
-                           (pu2[station]->readylu[k] > 2)) { // End if pu2[station]->lu_fd[k] > 0
-                  /* This section handles a LU "power on" (i.e. 3270 terminal connect) or           */
-                  /*  a LU "power off" (i.e. 3270 terminal disconnect)                              */
-                  /* A SNA Nofify command with LU "powered on" is send to VTAM if readylu=2         */
-                  /* A SNA Nofify command with LU "powered off" is send to VTAM if readylu=3        */
-                  /* readylu=3 indicates TN3270 has disconnected, but LU is still active for VTAM   */
-                  if (Tdbg_flag == ON)                   // Trace Terminal Controller ?
-                     fprintf(T_trace, "Preparing UNBIND / NOTIFY request\n ");
-                  /* Construct 3 byte LH */
-                  BLU_rsp_ptr = 0;                       // Reset pointer
-                  BLU_rsp_buf[BLU_rsp_ptr++] = 0x7E;     // Bflag
-                  BLU_rsp_buf[BLU_rsp_ptr++] = BLU_req_buf[FAddr];   // Sec Station Addr
-                  //BLU_rsp_buf[BLU_rsp_ptr++] = BLU_req_buf[FCntl]; // Control byte
-                  BLU_rsp_buf[BLU_rsp_ptr++] = CFinal;               // Control byte
-                  //BLU_rsp_buf[FCntl] = CFinal;         // Set final bit
-
-                  /* Construct 6 byte FID2 TH */
-                  BLU_rsp_buf[FD2_TH_0] = 0x2E;          // FID2
-                  BLU_rsp_buf[FD2_TH_1] = 0x00;          // Reserved
-                  BLU_rsp_buf[FD2_TH_daf] = pu2[station]->daf_addr1[k]; //  daf
-                  BLU_rsp_buf[FD2_TH_oaf] = k+2;         // oaf
-                  BLU_rsp_buf[FD2_TH_scf0] = 0x00;       // seq #
-                  BLU_rsp_buf[FD2_TH_scf1] = 0x00;
-                  make_seq(pu2[station], BLU_rsp_buf, k);  // Update sequence number for this LU
-
-                  /* Construct 3 byte FID2 RH */
-                  BLU_rsp_buf[FD2_RH_0] = 0x00;          //  FM Data (FMD)
-                  BLU_rsp_buf[FD2_RH_0] |= 0x08;         // Field formatted RU
-                  BLU_rsp_buf[FD2_RH_0] |= 0x03;         // Indicate this is first and last in chain
-                  BLU_rsp_buf[FD2_RH_1] = 0x00;          // We do not need a response...
-                  //BLU_rsp_buf[FD2_RH_1] = 0x80;          // We need a response...
-                  //pu2[station]->dri[k] = ON;             // ...so remember this
-                  BLU_rsp_buf[FD2_RH_2] = 0x20;          // Indicate Change Direction
-                  BLU_rsp_ptr = BLU_rsp_ptr + 6 + 3;     // Update BLU pointer
-
-                  /* This section handles LU Power On and LU Power off     */
-                  if (pu2[station]->readylu[k] == 4) {  // There is still an activer BIND, so prepare UNBIND
-                    //BLU_rsp_buf[FD2_TH_daf] = pu2[station]->bindflag[k];      //  copy DAF of LU at the other end
-                    BLU_rsp_buf[FD2_TH_daf] = 0x00;                             //  SSCP
-                    memcpy(&BLU_rsp_buf[BLU_rsp_ptr], F2_TERMSELF_Req, sizeof(F2_TERMSELF_Req));
-                    pu2[station]->bindflag[k] = 0;     //  reset bindflag
-                    BLU_rsp_ptr = BLU_rsp_ptr + sizeof(F2_TERMSELF_Req);
-                  } // End  if (pu2[station]->readylu[k] == 4)
-                  if (pu2[station]->readylu[k] == 3)  {  // Power off, no BIND active, so sent NOTIFY for power off
-                    memcpy(&BLU_rsp_buf[BLU_rsp_ptr], F2_NOTIFY_Req, sizeof(F2_NOTIFY_Req)); //
-                    BLU_rsp_buf[FD2_RU_0 + 5] = 0x01;        // indicate Power off.
-                    BLU_rsp_ptr = BLU_rsp_ptr + sizeof(F2_NOTIFY_Req);
-                  } // End if (pu2[station]->readylu[k] == 3)
-                  if (pu2[station]->readylu[k] == 2)  {  // Power on after ACTLU, send NOTIFY for power on
-                    memcpy(&BLU_rsp_buf[BLU_rsp_ptr], F2_NOTIFY_Req, sizeof(F2_NOTIFY_Req)); //
-                    BLU_rsp_buf[FD2_RU_0 + 5] = 0x03;        // indicate Power on.
-                    BLU_rsp_ptr = BLU_rsp_ptr + sizeof(F2_NOTIFY_Req);
-                  } // End if (pu2[station]->readylu[k] == 2)
-                  /*                                      */
-                  /* Construct 3 byte LT */
-                  BLU_rsp_buf[BLU_rsp_ptr++] = 0x47;     // FCS High
-                  BLU_rsp_buf[BLU_rsp_ptr++] = 0x0F;     // FCS Low
-                  BLU_rsp_buf[BLU_rsp_ptr++] = 0x7E;     // Eflag
-                  BLU_rsp_len = BLU_rsp_ptr;             // Update BLU_rsp_len
-                  if (!(BLU_req_buf[FCntl] & CPoll)) {   // No polling? - Unlikely since this is RR, but just in case...
-                     BLU_rsp_stat = FILLED;              // ...Indicate there is data to send.
-                  }
-                  if (pu2[station]->readylu[k] > 1)
-                     pu2[station]->readylu[k]--;          // Indicate next phase (1 = active, 2 powering on, 3 = powering off, 4 = unbind)
-                  /* Cycle through all LU's 1 by 1 to check if there is input. */
-                  /* Keep a pointer to the last lu that has been scanned. */
-                  /* The next RR will start with the one following the last */
-                  /* If all LU's have been scanned, start again with the first LU */
-                  pu2[station]->last_lu = k + 1;
-                  if (pu2[station]->last_lu == MAXLU) pu2[station]->last_lu = 0;
-                  return(BLU_rsp_len);                   // Send 3270 response BLU to host
-               }  // End if ((pu2[station]->lu_fd[k] > 0)
-            }  // End for int k=0
+            // Serve the LU's round robin, starting with the one following the
+            // last LU served, so a busy LU cannot starve the others. Each LU
+            // adds at most one pacing response and one data or NOTIFY frame.
+            // The response is limited to the frames left in the SDLC window
+            // and to the poll byte budget, so one poll can carry input from
+            // several LU's. Without a poll only a single frame is built.
+            int nfrm = 0, k = 0, len, rsvd, ipr;
+            int first = pu2[station]->last_lu;           // LU to be served first
+            BLU_rsp_ptr = 0;
+            for (int n = 0; n < MAXLU; n++) {
+               k = (first + n) % MAXLU;
+               for (int m = 0; m < 2; m++) {
+                  if ((nfrm >= BLU_rsp_room) ||
+                      ((nfrm > 0) && !(BLU_req_buf[FCntl] & CPoll)))
+                     break;                              // Window full
+                  rsvd = 64;                             // Room for an IPR or NOTIFY frame
+                  if ((pu2[station]->lu_fd[k] > 0) && (ioblk[pu2[station]->punum][k] != NULL))
+                     rsvd = rsvd + ioblk[pu2[station]->punum][k]->inpbufl;
+                  if ((nfrm > 0) && (BLU_rsp_ptr + rsvd > BLU_rsp_budget))
+                     break;                              // Byte budget used up
+                  ipr = (pu2[station]->pac_ipr[k] == ON) && (pu2[station]->bindflag[k] == 1);
+                  len = lu_inbound(k, BLU_req_buf, &BLU_rsp_buf[BLU_rsp_ptr]);
+                  if (len == 0)
+                     break;
+                  BLU_rsp_frm[nfrm++] = BLU_rsp_ptr;
+                  BLU_rsp_ptr = BLU_rsp_ptr + len;
+                  pu2[station]->last_lu = (k + 1) % MAXLU;   // Next poll starts after this LU
+                  if (!ipr)                              // Only a pacing response may be followed...
+                     break;                              // ...by the LU's own input
+               }  // End for m
+               if ((nfrm >= BLU_rsp_room) || (BLU_rsp_ptr >= BLU_rsp_budget) ||
+                   ((nfrm > 0) && !(BLU_req_buf[FCntl] & CPoll)))
+                  break;
+            }  // End for n
+            if (nfrm > 0) {
+               BLU_rsp_nfrm = nfrm;
+               BLU_rsp_len = BLU_rsp_ptr;                // Update BLU_rsp_len
+               if (!(BLU_req_buf[FCntl] & CPoll)) {      // No polling? - Unlikely since this is RR, but just in case...
+                  BLU_rsp_stat = FILLED;                 // ...Indicate there is data to send.
+               }
+               if (Tdbg_flag == ON)                      // Trace Terminal Controller ?
+                  fprintf(T_trace, "RR: %d inbound frame(s), %d bytes, next LU %02X\n",
+                          nfrm, BLU_rsp_len, pu2[station]->last_lu + 2);
+               return(BLU_rsp_len);                      // Send 3270 response BLU(s) to host
+            }
 
             // No pending TN3270 input found, just send a RR + CFinal.
             /* Construct a RR response */
@@ -473,7 +574,6 @@ int proc_PIU (unsigned char BLU_req_buf[], int BLU_req_len, unsigned char BLU_rs
             BLU_rsp_buf[EFlag] = 0x7E;                   // Eflag
             BLU_rsp_len = 6;                             // BLU_rsp_len
 
-            pu2[station]->last_lu = 0;
             return(BLU_rsp_len);                         // Send RR BLU to host
 
          } // End if (BLU_rsp_stat == EMPTY)
@@ -532,6 +632,16 @@ int proc_PIU (unsigned char BLU_req_buf[], int BLU_req_len, unsigned char BLU_rs
       if (Tdbg_flag == ON)                               // Trace Terminal Controller ?
          fprintf(T_trace, "PIU0: => THRH type = %d\n", THRH_type);
 
+      // Pacing response from the host (isolated or on a +Rsp): open the next inbound window.
+      if ((THRH_type == DATA_ONLY) && ((BLU_req_buf[FD2_RH_0] & 0x80) == 0x80) &&
+          (BLU_req_buf[FD2_RH_1] & 0x01)) {
+         pu2[station]->pac_nxt[pu2[station]->lu_addr1 - 2] = ON;
+         if (Tdbg_flag == ON)                            // Trace Terminal Controller ?
+            fprintf(T_trace, "PIU0: => Pacing response for LU %02X\n", pu2[station]->lu_addr1);
+         if ((BLU_req_buf[FD2_RH_1] & 0xA0) == 0x00)     // IPR: nothing else to do
+            return 0;
+      }
+
       /**********************************************************/
       /*** PROCESS IFRAME as SNA cmd, Resp or as TN3270 DATA STREAM ***/
       /**********************************************************/
@@ -648,6 +758,12 @@ int proc_PIU (unsigned char BLU_req_buf[], int BLU_req_len, unsigned char BLU_rs
          //************************************************************
          if   (pu2[station]->lu_fd[pu2[station]->lu_addr1 - 2] > 0)
             send_packet (pu2[station]->lu_fd[pu2[station]->lu_addr1 - 2], (BYTE *) Dbuf, RU_req_len, "3270 Data");
+         // Pacing indicator on the first request of a window: answer with an IPR
+         // once it has been passed on to the terminal.
+         if (((THRH_type == DATA_ONLY) || (THRH_type == DATA_FIRST) || (chainrh == 3)) &&
+             (BLU_req_buf[FD2_RH_1] & 0x01) &&
+             (pu2[station]->lu_fd[pu2[station]->lu_addr1 - 2] > 0))
+            pu2[station]->pac_ipr[pu2[station]->lu_addr1 - 2] = ON;
          //************************************************************
 
          //*******************************************************************************************************
@@ -691,7 +807,7 @@ int proc_PIU (unsigned char BLU_req_buf[], int BLU_req_len, unsigned char BLU_rs
          BLU_rsp_buf[FD2_RH_0]  = saved_FD2_RH_0;        // RU_cat & FI
          BLU_rsp_buf[FD2_RH_0] |= 0x83;                  // Indicate this is a Response
          BLU_rsp_buf[FD2_RH_0] &= 0xFB;                  // Reset SDI
-         BLU_rsp_buf[FD2_RH_1]  = saved_FD2_RH_1 & 0xEF; // +Rsp
+         BLU_rsp_buf[FD2_RH_1]  = saved_FD2_RH_1 & 0xEE; // +Rsp (pacing is answered by an IPR)
          BLU_rsp_buf[FD2_RH_2]  = 0x00;
 
          BLU_rsp_ptr = BLU_rsp_ptr + 6 + 3;              // Update pointer
@@ -777,12 +893,18 @@ int proc_PIU (unsigned char BLU_req_buf[], int BLU_req_len, unsigned char BLU_rs
             pu2[station]->daf_addr1[pu2[station]->lu_addr1 - 2] = BLU_req_buf[FD2_TH_oaf];
             pu2[station]->lu_lu_seqn[pu2[station]->lu_addr1 - 2] = 0;
             pu2[station]->bindflag[pu2[station]->lu_addr1 - 2] = 1;
+            // Secondary send pacing count (BIND byte 8) bounds our inbound data.
+            pu2[station]->pac_win[pu2[station]->lu_addr1 - 2] = BLU_req_buf[FD2_RU_0 + 8] & 0x3F;
+            pu2[station]->pac_cnt[pu2[station]->lu_addr1 - 2] = 0;
+            pu2[station]->pac_nxt[pu2[station]->lu_addr1 - 2] = ON;
+            pu2[station]->pac_ipr[pu2[station]->lu_addr1 - 2] = OFF;
             // If not FM3 profile or cols < 24 or rows < 80, respond with -BIND
             if ((BLU_req_buf[FD2_RU_0 + 2] != 0x03) ||
                 (BLU_req_buf[FD2_RU_0 + 20] < 0x18) ||
                 (BLU_req_buf[FD2_RU_0 + 21] < 0x50 )) {
                    BLU_rsp_buf[FD2_RH_1] = BLU_req_buf[FD2_RH_1] | 0x10;  // -Rsp
                    pu2[station]->bindflag[pu2[station]->lu_addr1 - 2] = 0;
+                   pu2[station]->pac_win[pu2[station]->lu_addr1 - 2] = 0;
                }
             // Copy BIND to RU.
             memcpy(&BLU_rsp_buf[FD2_RU_0], F2_BIND_Rsp, sizeof(F2_BIND_Rsp));
@@ -810,6 +932,9 @@ int proc_PIU (unsigned char BLU_req_buf[], int BLU_req_len, unsigned char BLU_rs
             /* Save oaf from request */
             pu2[station]->daf_addr1[pu2[station]->lu_addr1 - 2] = BLU_req_buf[FD2_TH_oaf];
             pu2[station]->lu_lu_seqn[pu2[station]->lu_addr1 - 2] = 0;
+            pu2[station]->pac_cnt[pu2[station]->lu_addr1 - 2] = 0;
+            pu2[station]->pac_nxt[pu2[station]->lu_addr1 - 2] = ON;
+            pu2[station]->pac_ipr[pu2[station]->lu_addr1 - 2] = OFF;
             // Copy +CLEAR to RU.
             memcpy(&BLU_rsp_buf[FD2_RU_0], F2_CLEAR_Rsp, sizeof(F2_CLEAR_Rsp));
 
@@ -885,6 +1010,8 @@ int proc_PIU (unsigned char BLU_req_buf[], int BLU_req_len, unsigned char BLU_rs
          //if (BLU_req_buf[FD2_RU_0] == 0x32 && BLU_req_buf[FD2_RU_1] != 0x02) {
          if (BLU_req_buf[FD2_RU_0] == 0x32) {
             pu2[station]->bindflag[pu2[station]->lu_addr1 - 2 ] = 0;
+            pu2[station]->pac_win[pu2[station]->lu_addr1 - 2] = 0;
+            pu2[station]->pac_ipr[pu2[station]->lu_addr1 - 2] = OFF;
             /* Save oaf from UNBIND request */
             pu2[station]->daf_addr1[pu2[station]->lu_addr1 - 2] = BLU_req_buf[FD2_TH_oaf];
             pu2[station]->lu_lu_seqn[pu2[station]->lu_addr1 - 2] = 0;
@@ -931,6 +1058,27 @@ int proc_PIU (unsigned char BLU_req_buf[], int BLU_req_len, unsigned char BLU_rs
 //#####################################################################
 
 
+/*-------------------------------------------------------------------*/
+/* Subroutine to map an SDLC station address to a PU (station) nr.   */
+/* Without -addr the low order digit selects the PU (C1 = PU 0).     */
+/* With -addr only the given addresses are ours; frames for other   */
+/* stations on a multipoint line are ignored (-1).                   */
+/*-------------------------------------------------------------------*/
+int addr2station (uint8_t addr) {
+   if (nstaddr == 0) {
+      if (addr == 0xFF) addr = 0xC1;
+      if (((addr & 0x0F) < 1) || ((addr & 0x0F) > MAXSNAPU))
+         return -1;
+      return (addr & 0x0F) - 1;
+   }
+   if (addr == 0xFF)                        // Broadcast: first station
+      return 0;
+   for (int j = 0; j < nstaddr; j++)
+      if (staddr[j] == addr)
+         return j;
+   return -1;
+}
+
 /*-------------------------------------------------------------------*/
 /* Subroutine to create unique PIU sequence numbers.                 */
 /*-------------------------------------------------------------------*/
@@ -939,6 +1087,18 @@ void make_seq (struct CB327x * pu2, BYTE * bufptr, int lunum) {
    bufptr[FD2_TH_scf1] = (unsigned char)(  pu2->lu_lu_seqn[lunum]     ) & 0xff;
 }
 
+/*-------------------------------------------------------------------*/
+/* Subroutine to check whether an LU may send inbound data.          */
+/* With a BIND pacing window the first request of each window        */
+/* carries the pacing indicator; once the window is used up the LU   */
+/* waits for the host's pacing response before sending again.        */
+/*-------------------------------------------------------------------*/
+int pacing_open (struct CB327x * pu2, int lunum) {
+   if (pu2->pac_win[lunum] == 0)                  // No pacing ?
+      return 1;
+   return (pu2->pac_cnt[lunum] > 0) || (pu2->pac_nxt[lunum] == ON);
+}
+
 /********************************************************************/
 /* Procedure to 'iml' the 3274                                      */
 /********************************************************************/
@@ -949,6 +1109,8 @@ int proc_PU2iml() {
       for (BYTE i = 0; i < MAXLU; i++) {
          pu2[j]->lu_fd[i] = 0;
          pu2[j]->readylu[i] = 0;
+         pu2[j]->pac_win[i] = 0;
+         pu2[j]->pac_ipr[i] = OFF;
       } // End for i = 0
       pu2[j]->lunum = 0;
       pu2[j]->last_lu = 0;
@@ -979,12 +1141,17 @@ int proc_PU2iml() {
       sin1.sin_addr.s_addr = inet_addr(ipaddr);
       sin1.sin_port=htons(32741+j);
       if (bind(pu2[j]->pu_fd, (struct sockaddr *)&sin1, sizeof(sin1)) < 0) {
+         if (tnport != 0) {                   // Another 3274 has the private port,
+            close(pu2[j]->pu_fd);             // ...this one is reached on the shared port
+            pu2[j]->pu_fd = -1;
+         } else {
           printf("\nPU2: Bind 3274-%01X socket failed\n\r", j);
           free(pu2[j]);
           return -1;
+         }
       }
       /* Listen and verify */
-      if ((listen(pu2[j]->pu_fd, 10)) != 0) {
+      if ((pu2[j]->pu_fd >= 0) && (listen(pu2[j]->pu_fd, 10)) != 0) {
          printf("\nPU2: 3174-%01X Socket listen failed %s\n\r", j, strerror(errno));
           free(pu2[j]);
           return -2;
@@ -996,6 +1163,8 @@ int proc_PU2iml() {
          free(pu2[j]);
          return -3;
       }
+      if (pu2[j]->pu_fd < 0)                  // No private port, epoll only paces the loop
+         continue;
       event.events = EPOLLIN;
       event.data.fd = pu2[j]->pu_fd;
       if (epoll_ctl(pu2[j]->epoll_fd, EPOLL_CTL_ADD, pu2[j]->pu_fd, &event) == -1) {
@@ -1006,14 +1175,330 @@ int proc_PU2iml() {
       }
       printf("\rPU2: 3274-%01X IML ready. TN3270 can connect to port %d \n\r", j,32741+j);
    }  // End for j=0
+   if (tnport != 0)
+      return tn_listen();
    return 0;
  }
+
+/*-------------------------------------------------------------------*/
+/* Route socket name of a station on the shared TN3270 port.         */
+/* Abstract AF_UNIX names, so nothing is left behind in the file     */
+/* system when a controller goes away.                               */
+/*-------------------------------------------------------------------*/
+socklen_t route_name (struct sockaddr_un *un, BYTE stan) {
+   memset(un, 0, sizeof(struct sockaddr_un));
+   un->sun_family = AF_UNIX;
+   snprintf(&un->sun_path[1], sizeof(un->sun_path)-1, "i3274-%d-%02X", tnport, stan);
+   return offsetof(struct sockaddr_un, sun_path) + 1 + strlen(&un->sun_path[1]);
+}
+
+/*-------------------------------------------------------------------*/
+/* Procedure to open the shared TN3270 port (-port).                 */
+/* Several 3274 processes, each with its own -addr stations, listen  */
+/* on the same port with SO_REUSEPORT and the kernel spreads the     */
+/* incoming connections over them. A client that asks for a station */
+/* owned by another process (IBM-3278-2@SSLL) is handed over to that */
+/* process through the station's route socket.                       */
+/*-------------------------------------------------------------------*/
+int tn_listen () {
+   struct sockaddr_un un;
+   socklen_t unl;
+   BYTE stan;
+
+   if ((tn_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0)) == -1) {
+      printf("\nPU2: Endpoint creation for shared port failed with error %s ", strerror(errno));
+      return -5;
+   }
+   sockopt=1;
+   setsockopt(tn_fd, SOL_SOCKET, SO_REUSEADDR, (void*)&sockopt, sizeof(sockopt));
+   setsockopt(tn_fd, SOL_SOCKET, SO_REUSEPORT, (void*)&sockopt, sizeof(sockopt));
+   sin1.sin_family=AF_INET;
+   sin1.sin_addr.s_addr = inet_addr(ipaddr);
+   sin1.sin_port=htons(tnport);
+   if (bind(tn_fd, (struct sockaddr *)&sin1, sizeof(sin1)) < 0) {
+      printf("\nPU2: Bind shared port %d failed %s\n\r", tnport, strerror(errno));
+      close(tn_fd);
+      tn_fd = -1;
+      return -5;
+   }
+   if ((listen(tn_fd, 128)) != 0) {
+      printf("\nPU2: Shared port %d listen failed %s\n\r", tnport, strerror(errno));
+      close(tn_fd);
+      tn_fd = -1;
+      return -5;
+   }
+   rs_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+   // Claim the route name of each of our stations
+   for (BYTE j = 0; j < MAXSNAPU; j++) {
+      rt_fd[j] = -1;
+      if ((nstaddr != 0) && (j >= nstaddr))
+         continue;
+      stan = (nstaddr > 0) ? staddr[j] : 0xC1 + j;
+      rt_fd[j] = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+      unl = route_name(&un, stan);
+      if (bind(rt_fd[j], (struct sockaddr *)&un, unl) < 0) {
+         printf("\rPU2: Station %02X is already served on port %d, use -addr\n\r", stan, tnport);
+         close(rt_fd[j]);
+         rt_fd[j] = -1;
+         continue;
+      }
+      printf("\rPU2: 3274-%01X station %02X can be reached on shared port %d \n\r", j, stan, tnport);
+   }  // End for j=0
+   return 0;
+}
+
+/*-------------------------------------------------------------------*/
+/* Set up the TLS context for the TN3270 listeners (-tlscert).       */
+/* The record layer is handed to the kernel after the handshake, so  */
+/* only kTLS capable ciphers are offered. OpenSSL before 3.2 offloads */
+/* TLS 1.3 in the send direction only, so 1.2 is the limit there.    */
+/*-------------------------------------------------------------------*/
+int tls_init (char *cert, char *key) {
+   if ((tls_ctx = SSL_CTX_new(TLS_server_method())) == NULL) {
+      printf("\rPU2: Cannot create TLS context %s\n", ERR_error_string(ERR_get_error(), NULL));
+      return -1;
+   }
+   SSL_CTX_set_options(tls_ctx, SSL_OP_ENABLE_KTLS | SSL_OP_NO_TICKET);
+   SSL_CTX_set_num_tickets(tls_ctx, 0);          // No post handshake messages
+   SSL_CTX_set_min_proto_version(tls_ctx, TLS1_2_VERSION);
+#if OPENSSL_VERSION_NUMBER < 0x30200000L
+   SSL_CTX_set_max_proto_version(tls_ctx, TLS1_2_VERSION);
+#endif
+   SSL_CTX_set_cipher_list(tls_ctx, "ECDHE+AESGCM:ECDHE+CHACHA20");
+   if ((SSL_CTX_use_certificate_chain_file(tls_ctx, cert) != 1) ||
+       (SSL_CTX_use_PrivateKey_file(tls_ctx, key, SSL_FILETYPE_PEM) != 1) ||
+       (SSL_CTX_check_private_key(tls_ctx) != 1)) {
+      printf("\rPU2: Cannot load TLS certificate %s or key %s: %s\n", cert, key,
+             ERR_error_string(ERR_get_error(), NULL));
+      SSL_CTX_free(tls_ctx);
+      tls_ctx = NULL;
+      return -1;
+   }
+   return 0;
+}
+
+/*-------------------------------------------------------------------*/
+/* TLS handshake on a just accepted TN3270 socket, then switch the   */
+/* session to kTLS. From then on send/read on the socket carry plain */
+/* 3270 data and the kernel does the encryption. If the kernel can't */
+/* take both directions the client is refused.                       */
+/* Returns 0, or -1 with the socket closed.                          */
+/*-------------------------------------------------------------------*/
+int tls_accept (int fd) {
+   struct timeval tv = {5, 0};                   // Don't let a silent client hang the line
+   SSL *ssl;
+   int  rc = -1;
+
+   setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+   setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+   if ((ssl = SSL_new(tls_ctx)) != NULL) {
+      SSL_set_fd(ssl, fd);
+      if (SSL_accept(ssl) != 1) {
+         printf("\rPU2: TLS handshake failed %s\n", ERR_error_string(ERR_get_error(), NULL));
+      } else if (!BIO_get_ktls_send(SSL_get_wbio(ssl)) || !BIO_get_ktls_recv(SSL_get_rbio(ssl))) {
+         printf("\rPU2: kTLS not available for %s, connection closed\n", SSL_get_cipher(ssl));
+      } else {
+         rc = 0;
+      }
+      if (Tdbg_flag == ON)    // Trace Terminal Controller ?
+         fprintf(T_trace, "3274: TLS accept fd=%d %s %s rc=%d\n", fd, SSL_get_version(ssl), SSL_get_cipher(ssl), rc);
+      SSL_free(ssl);                              // Keys stay with the socket, fd stays open
+   }  // End if ssl
+   ERR_clear_error();
+   if (rc != 0) {
+      close(fd);
+      return -1;
+   }
+   tv.tv_sec = 0;
+   setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+   setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+   return 0;
+}
+
+/*-------------------------------------------------------------------*/
+/* Check a kTLS LU socket for input. FIONREAD counts the ciphertext  */
+/* still in TCP, not the decrypted data, so peek instead. A closed   */
+/* socket or a TLS alert (close_notify) ends the session.            */
+/*-------------------------------------------------------------------*/
+int tls_pending (int fd, int *pend) {
+   BYTE c;
+   int  rc;
+
+   *pend = 0;
+   rc = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+   if (rc > 0) {
+      *pend = rc;
+      return 0;
+   }
+   if ((rc < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+      return 0;
+   return -1;
+}
+
+/*-------------------------------------------------------------------*/
+/* Hand a negotiated client over to the 3274 owning its station.     */
+/* The socket travels as SCM_RIGHTS; class and LU go in the data.    */
+/*-------------------------------------------------------------------*/
+void route_client (BYTE stan, int fd, BYTE class, BYTE lu) {
+   struct sockaddr_un un;
+   struct msghdr msg;
+   struct iovec iov;
+   struct cmsghdr *cmsg;
+   char ctl[CMSG_SPACE(sizeof(int))];
+   BYTE data[2];
+
+   data[0] = class;
+   data[1] = lu;
+   iov.iov_base = data;
+   iov.iov_len = 2;
+   memset(&msg, 0, sizeof(msg));
+   memset(ctl, 0, sizeof(ctl));
+   msg.msg_name = &un;
+   msg.msg_namelen = route_name(&un, stan);
+   msg.msg_iov = &iov;
+   msg.msg_iovlen = 1;
+   msg.msg_control = ctl;
+   msg.msg_controllen = sizeof(ctl);
+   cmsg = CMSG_FIRSTHDR(&msg);
+   cmsg->cmsg_level = SOL_SOCKET;
+   cmsg->cmsg_type = SCM_RIGHTS;
+   cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+   memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+   if (sendmsg(rs_fd, &msg, 0) < 0)
+      printf("\rPU2: No 3274 serves station %02X, connection closed\n", stan);
+   else if (Tdbg_flag == ON)    // Trace Terminal Controller ?
+      fprintf(T_trace, "3274: client for station %02X LU %02X routed\n", stan, lu);
+   close(fd);                   // The receiver holds its own copy
+}
+
+/*-------------------------------------------------------------------*/
+/* Receive a client handed over by another 3274. Returns the fd      */
+/* or -1 if nothing is queued on the route socket.                   */
+/*-------------------------------------------------------------------*/
+int recv_client (int sfd, BYTE *class, BYTE *lu) {
+   struct msghdr msg;
+   struct iovec iov;
+   struct cmsghdr *cmsg;
+   char ctl[CMSG_SPACE(sizeof(int))];
+   BYTE data[2];
+   int fd = -1;
+
+   iov.iov_base = data;
+   iov.iov_len = 2;
+   memset(&msg, 0, sizeof(msg));
+   msg.msg_iov = &iov;
+   msg.msg_iovlen = 1;
+   msg.msg_control = ctl;
+   msg.msg_controllen = sizeof(ctl);
+   if (recvmsg(sfd, &msg, MSG_DONTWAIT) < 2)
+      return -1;
+   cmsg = CMSG_FIRSTHDR(&msg);
+   if ((cmsg == NULL) || (cmsg->cmsg_type != SCM_RIGHTS))
+      return -1;
+   memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+   *class = data[0];
+   *lu = data[1];
+   return fd;
+}
+
+/*-------------------------------------------------------------------*/
+/* Procedure to serve the shared TN3270 port and the route sockets.  */
+/*-------------------------------------------------------------------*/
+void proc_shared () {
+   int  fd;
+   BYTE class, stan, lu;
+   int  k;
+
+   for (int n = 0; n < MAXLU; n++) {            // Bounded, keep the SDLC line going
+      if ((fd = accept(tn_fd, NULL, 0)) < 0)
+         break;
+      if ((tls_ctx != NULL) && (tls_accept(fd) != 0))
+         continue;                              // Socket already closed
+      if (negotiate_client(fd, &class, &stan, &lu) != 0)
+         continue;                              // Socket already closed
+      if (stan == 0xFF) {                       // Any station: first one we own
+         for (k = 0; (k < MAXSNAPU) && (rt_fd[k] < 0); k++) ;
+         if (k == MAXSNAPU) k = -1;
+      } else {
+         k = addr2station(stan);
+      }
+      if ((k >= 0) && (rt_fd[k] >= 0))
+         lu_attach(k, fd, class, lu);
+      else if (stan != 0xFF)
+         route_client(stan, fd, class, lu);
+      else
+         close(fd);
+   }  // End for n
+   for (BYTE k = 0; k < MAXSNAPU; k++) {
+      if (rt_fd[k] < 0)
+         continue;
+      while ((fd = recv_client(rt_fd[k], &class, &lu)) >= 0)
+         lu_attach(k, fd, class, lu);
+   }  // End for k
+}
+
+/*-------------------------------------------------------------------*/
+/* Attach a negotiated client to the requested or next free LU.      */
+/*-------------------------------------------------------------------*/
+void lu_attach (BYTE k, int fd, BYTE class, BYTE lu) {
+   if (pu2[k]->lunum == 0xFF) {                 /* available LU pool exhausted */
+      printf("\rPU2: No LU port available on 3274-%01X, connection closed\n", k);
+      close(fd);
+      return;
+   }
+   pu2[k]->lu_fd[pu2[k]->lunum] = fd;
+   pu2[k]->lunumr = (lu < MAXLU) ? lu : pu2[k]->lunum;
+   pu2[k]->is_3270[pu2[k]->lunum] = greet_client(fd, class, pu2[k]->punum, pu2[k]->lunumr);
+   lu_connected(k);
+}
+
+/*-------------------------------------------------------------------*/
+/* Set up a just connected LU and find the next available one.       */
+/*-------------------------------------------------------------------*/
+void lu_connected (BYTE k) {
+   if (pu2[k]->lunumr != pu2[k]->lunum) {                                  /* Requested LU number is not the proposed lu number   */
+      if (pu2[k]->lu_fd[pu2[k]->lunumr] < 1) {
+         pu2[k]->lu_fd[pu2[k]->lunumr]  = pu2[k]->lu_fd[pu2[k]->lunum];    /* Copy fd to request lu                               */
+         pu2[k]->is_3270[pu2[k]->lunumr] = pu2[k]->is_3270[pu2[k]->lunum]; /* copy 3270 indicator                                 */
+         pu2[k]->lu_fd[pu2[k]->lunum] = 0;                                 /* clear fd in proposed lu number                      */
+         pu2[k]->is_3270[pu2[k]->lunum] = 0;                               /* clear 3270 indicator for proposed lu number         */
+         pu2[k]->lunum = pu2[k]->lunumr;                                   /* replace proposed lu number with requested lu number */
+      } else {
+         printf("\rPU2: requested lu port %02X is not available, request denied\n", pu2[k]->lunumr);
+      }  // End  if (pu2[k]->lu_fd[pu2[k]->lunumr]
+   }  // End if pu[k]->lunumr
+   ioblk[k][pu2[k]->lunum] =  malloc(sizeof(struct IO3270));
+   ioblk[k][pu2[k]->lunum]->inpbufl = 0;                   /* make sure the initial length is 0  */
+   pu2[k]->daf_addr1[pu2[k]->lunum] = 0;                   /* make sure the initial value is 0   */
+   pu2[k]->bindflag[pu2[k]->lunum] = 0;                    /* make sure the initial value is 0   */
+   pu2[k]->reqcont[pu2[k]->lunum] = 0;                     /* make sure the initial value is 0   */
+   pu2[k]->initselfflag[pu2[k]->lunum] = 0;                /* make sure the initial value is 0   */
+   pu2[k]->dri[pu2[k]->lunum] = OFF;                       /* make sure the initial value is OFF */
+   pu2[k]->chaining[pu2[k]->lunum] = OFF;                  /* make sure the initial value is OFF */
+   pu2[k]->pac_win[pu2[k]->lunum] = 0;                     /* no pacing until BIND               */
+   pu2[k]->pac_ipr[pu2[k]->lunum] = OFF;                   /* make sure the initial value is OFF */
+   if (pu2[k]->actlu[pu2[k]->lunum] == 1)                  /* Is actlu already done?             */
+      pu2[k]->readylu[pu2[k]->lunum] = 2;                  /* Indicate LU is in power off state  */
+   else
+      pu2[k]->readylu[pu2[k]->lunum] = 1;                  /* Indicate LU is ready to go         */
+   if (Tdbg_flag == ON)    // Trace Terminal Controller ?
+      fprintf(T_trace, "3274: LU %02X connected, readylu=%d \n", pu2[k]->lunum, pu2[k]->readylu[pu2[k]->lunum]);
+   printf("\rPU2: LU %02X connected to 3274-%01X\n", pu2[k]->lunum, k);
+   //  Find first available LU
+   pu2[k]->lunum = 0xFF;                                   /* preset to no LU's availble         */
+   for (BYTE j = 0; j < MAXLU; j++) {
+      if (pu2[k]->lu_fd[j] < 1) pu2[k]->lunum = j;
+   }  // end for BYTE j
+   if (pu2[k]->lunum == 0xFF) printf("\rPU2: No more LU ports available. New connections rejected until a LU port is released;\n");
+}
 /********************************************************************/
 /* Procedure to handle 3270 connections and data requests           */
 /********************************************************************/
 int proc_3270 () {
 
    int    rc;
+   if (tn_fd >= 0)
+      proc_shared();
    //
    // Poll briefly for connect requests. If a connect request is received,
    // proceed with connect/accept the request.
@@ -1027,52 +1512,26 @@ int proc_3270 () {
                pu2[k]->lu_fd[pu2[k]->lunum]=accept(pu2[k]->pu_fd, NULL, 0);  /* accept connection request               */
                if (pu2[k]->lu_fd[pu2[k]->lunum] < 1) {
                   printf("\rPU2: accept failed for 3174-%01X %s\n", k, strerror(errno));
+               } else if ((tls_ctx != NULL) && (tls_accept(pu2[k]->lu_fd[pu2[k]->lunum]) != 0)) {
+                  pu2[k]->lu_fd[pu2[k]->lunum] = 0;                             /* socket closed, LU stays available       */
                } else {
                   if (connect_client(&pu2[k]->lu_fd[pu2[k]->lunum], pu2[k]->punum, &pu2[k]->lunum, &pu2[k]->lunumr))  {
                      pu2[k]->is_3270[pu2[k]->lunum] = 1;
                   } else {
                      pu2[k]->is_3270[pu2[k]->lunum] = 0;
                   }  // End if connect_client
-
-                  if (pu2[k]->lunumr != pu2[k]->lunum) {                                  /* Requested LU number is not the proposed lu number   */
-                     if (pu2[k]->lu_fd[pu2[k]->lunumr] < 1) {
-                        pu2[k]->lu_fd[pu2[k]->lunumr]  = pu2[k]->lu_fd[pu2[k]->lunum];    /* Copy fd to request lu                               */
-                        pu2[k]->is_3270[pu2[k]->lunumr] = pu2[k]->is_3270[pu2[k]->lunum]; /* copy 3270 indicator                                 */
-                        pu2[k]->lu_fd[pu2[k]->lunum] = 0;                                 /* clear fd in proposed lu number                      */
-                        pu2[k]->is_3270[pu2[k]->lunum] = 0;                               /* clear 3270 indicator for proposed lu number         */
-                        pu2[k]->lunum = pu2[k]->lunumr;                                   /* replace proposed lu number with requested lu number */
-                     } else {
-                        printf("\rPU2: requested lu port %02X is not available, request denied\n", pu2[k]->lunumr);
-                     }  // End  if (pu2[k]->lu_fd[pu2[k]->lunumr]
-                  }  // End if pu[k]->lunumr
-                  ioblk[k][pu2[k]->lunum] =  malloc(sizeof(struct IO3270));
-                  ioblk[k][pu2[k]->lunum]->inpbufl = 0;                   /* make sure the initial length is 0  */
-                  pu2[k]->daf_addr1[pu2[k]->lunum] = 0;                   /* make sure the initial value is 0   */
-                  pu2[k]->bindflag[pu2[k]->lunum] = 0;                    /* make sure the initial value is 0   */
-                  pu2[k]->reqcont[pu2[k]->lunum] = 0;                     /* make sure the initial value is 0   */
-                  pu2[k]->initselfflag[pu2[k]->lunum] = 0;                /* make sure the initial value is 0   */
-                  pu2[k]->dri[pu2[k]->lunum] = OFF;                       /* make sure the initial value is OFF */
-                  pu2[k]->chaining[pu2[k]->lunum] = OFF;                  /* make sure the initial value is OFF */
-                  if (pu2[k]->actlu[pu2[k]->lunum] == 1)                  /* Is actlu already done?             */
-                     pu2[k]->readylu[pu2[k]->lunum] = 2;                  /* Indicate LU is in power off state  */
-                  else
-                     pu2[k]->readylu[pu2[k]->lunum] = 1;                  /* Indicate LU is ready to go         */
-                  if (Tdbg_flag == ON)    // Trace Terminal Controller ?
-                     fprintf(T_trace, "3274: LU %02X connected, readylu=%d \n", pu2[k]->lunum, pu2[k]->readylu[pu2[k]->lunum]);
-                  printf("\rPU2: LU %02X connected to 3274-%01X\n", pu2[k]->lunum, k);
-                  //  Find first available LU
-                  pu2[k]->lunum = 0xFF;                                   /* preset to no LU's availble         */
-                  for (BYTE j = 0; j < MAXLU; j++) {
-                     if (pu2[k]->lu_fd[j] < 1) pu2[k]->lunum = j;
-                  }  // end for BYTE j
-                  if (pu2[k]->lunum == 0xFF) printf("\rPU2: No more LU ports available. New connections rejected until a LU port is released;\n");
+                  lu_connected(k);
                }  // End if pu2[j]->lu_fd
             }  // End if (pu2[k] != 0xFF)
          }  // End for int i
          for (BYTE j = 0; j < MAXLU; j++) {
             if (pu2[k]->lu_fd[j] > 0) {
-               rc = ioctl(pu2[k]->lu_fd[j], FIONREAD, &pendingrcv);
-               if ((pendingrcv < 1) && (SocketReadAct(pu2[k]->lu_fd[j]))) rc = -1;
+               if (tls_ctx != NULL) {
+                  rc = tls_pending(pu2[k]->lu_fd[j], &pendingrcv);
+               } else {
+                  rc = ioctl(pu2[k]->lu_fd[j], FIONREAD, &pendingrcv);
+                  if ((pendingrcv < 1) && (SocketReadAct(pu2[k]->lu_fd[j]))) rc = -1;
+               }
                if (rc < 0) {
                   if (pu2[k]->actlu[j] == 1)  {                           /* Is actlu already done?                                 */
                       if (pu2[k]->bindflag[j] == 0)                       /* LU has no active BIND                                  */
@@ -1094,7 +1553,10 @@ int proc_3270 () {
                   if ((pu2[k]->lunum > j) || (pu2[k]->lunum == 0xFF))     /* If next available lu greater or no LU's availble...    */
                      pu2[k]->lunum = j;                                   /* ...replace with the just released LU number            */
                } else {
-                  if (pendingrcv > 0) {
+                  // While a record is queued and the pacing window is closed, leave
+                  // further terminal input in the socket instead of overwriting it.
+                  if ((pendingrcv > 0) &&
+                      ((ioblk[k][j]->inpbufl == 0) || pacing_open(pu2[k], j))) {
                      rc = read(pu2[k]->lu_fd[j], bfr, 256-BUFPD);
                      //******
                      if (Tdbg_flag == ON) {              // Trace
@@ -1126,6 +1588,8 @@ void main(int argc, char *argv[]) {
    int Fptr,FptrL, frame_len;       /* SDLC frame pointers and lenght */
    int i, rc;
    int Fptr2[16] = {0};
+   char *tlscert = NULL;            /* TN3270 TLS certificate         */
+   char *tlskey = NULL;             /* TN3270 TLS private key         */
    char ipv4addr[sizeof(struct in_addr)];
    uint8_t signal;                  /* RS232 signal                   */
 
@@ -1137,6 +1601,11 @@ void main(int argc, char *argv[]) {
       printf("\r  -cchn {hostname}    : hostname of host running the 3705\n");
       printf("\r  -ccip {ipaddress}   : ipaddress of host running the 3705 \n");
       printf("\r  -line {line number} : SDLC line number to connect to\n");
+      printf("\r  -addr {xx[,xx]}     : station address(es) of the PU(s), for multipoint lines\n");
+      printf("\r  -port {port}        : shared TN3270 port, routes IBM-xxxx@SSLL to station SS\n");
+      printf("\r  -budget {bytes}     : inbound bytes per poll response (default 4096)\n");
+      printf("\r  -tlscert {file}     : PEM certificate, TN3270 clients must use TLS\n");
+      printf("\r  -tlskey {file}      : PEM private key (default: the -tlscert file)\n");
       printf("\r  -d : switch debug on  \n");
    return;
    }
@@ -1170,12 +1639,48 @@ void main(int argc, char *argv[]) {
          printf("\rPU2: Connection to be established with SDLC line %d\n", linenum);
          i = i + 2;
          continue;
+      } else if (strcmp(argv[i], "-addr") == 0) {
+         char *ap = argv[i+1];
+         unsigned int a;
+         while ((nstaddr < MAXSNAPU) && (sscanf(ap, "%2x", &a) == 1)) {
+            staddr[nstaddr++] = a;
+            printf("\rPU2: 3274-%01X has station address %02X\n", nstaddr - 1, a);
+            if ((ap = strchr(ap, ',')) == NULL) break;
+            ap++;
+         }  // End while
+         i = i + 2;
+         continue;
+      } else if (strcmp(argv[i], "-port") == 0) {
+         sscanf(argv[i+1], "%d", &tnport);
+         printf("\rPU2: TN3270 clients may also connect to shared port %d\n", tnport);
+         i = i + 2;
+         continue;
+      } else if (strcmp(argv[i], "-budget") == 0) {
+         sscanf(argv[i+1], "%d", &pollbudget);
+         if ((pollbudget < 256) || (pollbudget > BUFLEN_3274 / 2))
+            pollbudget = (pollbudget < 256) ? 256 : BUFLEN_3274 / 2;
+         printf("\rPU2: Inbound poll response budget is %d bytes\n", pollbudget);
+         i = i + 2;
+         continue;
+      } else if (strcmp(argv[i], "-tlscert") == 0) {
+         tlscert = argv[i+1];
+         i = i + 2;
+         continue;
+      } else if (strcmp(argv[i], "-tlskey") == 0) {
+         tlskey = argv[i+1];
+         i = i + 2;
+         continue;
       } else {
          printf("\rPU2: invalid argument %s\n",argv[i]);
          printf("\r   Valid arguments are:\n");
          printf("\r    -cchn {hostname}    : hostname of host running the 3705\n");
          printf("\r    -ccip {ipaddress}   : ipaddress of host running the 3705 \n");
          printf("\r    -line {line number} : SDLC line number to connect to\n");
+         printf("\r    -addr {xx[,xx]}     : station address(es) of the PU(s), for multipoint lines\n");
+         printf("\r    -port {port}        : shared TN3270 port, routes IBM-xxxx@SSLL to station SS\n");
+         printf("\r    -budget {bytes}     : inbound bytes per poll response (default 4096)\n");
+         printf("\r    -tlscert {file}     : PEM certificate, TN3270 clients must use TLS\n");
+         printf("\r    -tlskey {file}      : PEM private key (default: the -tlscert file)\n");
          printf("\r    -d : switch debug on  \n");
          return;
       }  // End else
@@ -1190,6 +1695,11 @@ void main(int argc, char *argv[]) {
                        "     i327x_3274 -d : trace all 3274 activities\n"
                        );
    }
+   if (tlscert != NULL) {
+      if (tls_init(tlscert, (tlskey != NULL) ? tlskey : tlscert) != 0)
+         return;
+      printf("\rPU2: TN3270 clients must connect with TLS\n");
+   }
    // SDLC line socket creation
    pusdlc_fd = socket(AF_INET, SOCK_STREAM, 0);
    if (pusdlc_fd <= 0) {
@@ -1215,6 +1725,7 @@ void main(int argc, char *argv[]) {
    while (connect(rs232_fd, (struct sockaddr*)&servaddr, sizeof(servaddr)) != 0) {
       sleep(1);
    }
+   SendLeadID(pusdlc_fd, rs232_fd);
    printf("\rPU2: SDLC line %d connection has been established\n",linenum);
    // Now 'IML' the 3274
    rc = proc_PU2iml();
@@ -1248,6 +1759,7 @@ void main(int argc, char *argv[]) {
          while (connect(rs232_fd, (struct sockaddr*)&servaddr, sizeof(servaddr)) != 0) {
             sleep(1);
          }  // End while
+         SendLeadID(pusdlc_fd, rs232_fd);
          printf("\rPU2: SDLC line connection has been re-established\n");
       } else {
          if (pendingrcv > 0) {
@@ -1292,18 +1804,34 @@ void main(int argc, char *argv[]) {
          //****************************************************************************************************************************
          // Process SDLC frame
          //****************************************************************************************************************************
-                  if ((SDLCreqb[Fptr+FCntl] & 0x01) == IFRAME) {
-                     pu2[station]->seq_Nr++;             // Update receive sequence number
-                     if (pu2[station]->seq_Nr == 8) pu2[station]->seq_Nr = 0;
+                  station = addr2station(SDLCreqb[Fptr+FAddr]);
+                  if (station < 0) {                     // Another station on a multipoint line ?
                      if (Tdbg_flag == ON)
-                        fprintf(T_trace, "\r3274 LH receive sequence count=%d, Fcntl=%02X\n", pu2[station]->seq_Nr, SDLCreqb[FCntl]);
-                  } //End if SDLCreqb[FCntl]
-                  SDLCrspl = proc_PIU(&SDLCreqb[Fptr], frame_len, &SDLCrspb[SDLCrsptl]);
+                        fprintf(T_trace, "\r3274 Frame for station %02X ignored\n", SDLCreqb[Fptr+FAddr]);
+                     SDLCrspl = 0;
+                  } else {
+                     if ((SDLCreqb[Fptr+FCntl] & 0x01) == IFRAME) {
+                        pu2[station]->seq_Nr++;             // Update receive sequence number
+                        if (pu2[station]->seq_Nr == 8) pu2[station]->seq_Nr = 0;
+                        if (Tdbg_flag == ON)
+                           fprintf(T_trace, "\r3274 LH receive sequence count=%d, Fcntl=%02X\n", pu2[station]->seq_Nr, SDLCreqb[FCntl]);
+                     } //End if SDLCreqb[FCntl]
+                     BLU_rsp_nfrm = 0;
+                     BLU_rsp_room = (FptrI < MAXOUT) ? MAXOUT - FptrI : 1;
+                     BLU_rsp_budget = pollbudget - SDLCrsptl;
+                     SDLCrspl = proc_PIU(&SDLCreqb[Fptr], frame_len, &SDLCrspb[SDLCrsptl]);
+                  }  // End if (station < 0)
                   if (SDLCrspl > 0) {
-                     Fptr2[FptrI] = SDLCrsptl;
-                     if (Tdbg_flag == ON)
-                        fprintf(T_trace, "\r3274 Frame pointer index %d contains %d", FptrI, Fptr2[FptrI]);
-                     FptrI++;
+                     if (BLU_rsp_nfrm == 0) {            // Single frame response ?
+                        BLU_rsp_frm[0] = 0;
+                        BLU_rsp_nfrm = 1;
+                     }
+                     for (i = 0; (i < BLU_rsp_nfrm) && (FptrI < 15); i++) {
+                        Fptr2[FptrI] = SDLCrsptl + BLU_rsp_frm[i];
+                        if (Tdbg_flag == ON)
+                           fprintf(T_trace, "\r3274 Frame pointer index %d contains %d", FptrI, Fptr2[FptrI]);
+                        FptrI++;
+                     }
                      Fptr2[FptrI] = 0;
                   } // End if SDLCrspl
                   SDLCrsptl = SDLCrsptl + SDLCrspl;
@@ -1320,13 +1848,15 @@ void main(int argc, char *argv[]) {
          //****************************************************************************************************************************
                if (Tdbg_flag == ON)
                   fprintf(T_trace, "\r3274 Total response length: %d\n", SDLCrsptl);
-               if (SDLCreqb[FptrL+FCntl] & CPoll) {            // Poll command ?
+               if ((SDLCreqb[FptrL+FCntl] & CPoll) &&          // Poll command...
+                   (addr2station(SDLCreqb[FptrL+FAddr]) >= 0)) {  // ...for one of our stations ?
                   // Make sure the receive count is up-to-date before sending the repsonse.
                   // First get the station address and replace the receive count in the Link Header
                   FptrI = 0;
                   Fptr = Fptr2[FptrI];                             //  First frame located at offset 0.
                   do {
-                     station = (SDLCrspb[Fptr+FAddr] & 0x0F) - 1;
+                     station = addr2station(SDLCrspb[Fptr+FAddr]);
+                     SDLCrspb[Fptr+FCntl] &= ~CFinal;    // Only the last frame carries the final bit
                      if ((SDLCrspb[Fptr+FCntl] & 0x03) == SUPRV) {   // Supervisory format ?
                         SDLCrspb[Fptr+FCntl] = (SDLCrspb[Fptr+FCntl] & 0x1F) | (pu2[station]->seq_Nr << 5); // Insert receive sequence
                      }
@@ -1370,6 +1900,24 @@ void main(int argc, char *argv[]) {
 }
 
 
+//*******************************************************************************************
+// Identify the two leads to the 3705 line: the data lead starts with LEAD_DATA, the RS232  *
+// signal lead with LEAD_SIG and the local port of the data lead, so the LIB can pair them. *
+//*******************************************************************************************
+void SendLeadID(int data_fd, int rs232_fd) {
+   struct sockaddr_in addr;
+   socklen_t addrlen = sizeof(addr);
+   uint8_t lead[3];
+
+   lead[0] = LEAD_DATA;
+   send(data_fd, lead, 1, 0);
+   getsockname(data_fd, (struct sockaddr *)&addr, &addrlen);
+   lead[0] = LEAD_SIG;
+   memcpy(&lead[1], &addr.sin_port, 2);                  // Port in network byte order
+   send(rs232_fd, lead, 3, 0);
+   return;
+}
+
 //*******************************************************************************************
 // Check if there is a signal update from the RS232 connection                              *
 // If so, receive signal data from the RS232 connection and respond if needed               *
@@ -86,6 +86,10 @@ struct CB327x {
    uint8_t  not_ready[MAXLU];          /* Not Ready flag                        */
    uint8_t  dri[MAXLU];                /* Definitive Response Indicator         */
    uint8_t  chaining[MAXLU];           /* Chaining Indicator                    */
+   uint8_t  pac_win[MAXLU];            /* Inbound pacing window (BIND byte 8)   */
+   uint8_t  pac_cnt[MAXLU];            /* Requests left in current window       */
+   uint8_t  pac_nxt[MAXLU];            /* Pacing rsp received, next window open */
+   uint8_t  pac_ipr[MAXLU];            /* Isolated pacing response owed to host */
    uint8_t  seq_Nr;                    /* Sequence Number Received              */
    uint8_t  seq_Ns;                    /* Sequence Number Send                  */
    uint8_t  sscp_addr0;
@@ -30,6 +30,8 @@
 #define MAXLU          4         /* Maximum nr of LU's per PU or cluster */
 #define SDLCLBASE    37500       /* Base port number of SDLC line base       */
 #define BSCLBASE     37500       /* Base Port number of BSC line base        */
+#define LEAD_DATA     0x44       /* First byte on the data lead ('D')        */
+#define LEAD_SIG      0x53       /* First byte on the signal lead ('S')      */
 
 #define BUFLEN_3270  65536       /* 3270 Send/Receive buffer  */
 #define BUFLEN_1052    150       /* 1052 Send/Receive buffer  */
@@ -86,6 +88,10 @@ struct CB327x {
    uint8_t  not_ready[MAXLU];          /* Not Ready flag                        */
    uint8_t  dri[MAXLU];                /* Definitive Response Indicator         */
    uint8_t  chaining[MAXLU];           /* Chaining Indicator                    */
+   uint8_t  pac_win[MAXLU];            /* Inbound pacing window (BIND byte 8)   */
+   uint8_t  pac_cnt[MAXLU];            /* Requests left in current window       */
+   uint8_t  pac_nxt[MAXLU];            /* Pacing rsp received, next window open */
+   uint8_t  pac_ipr[MAXLU];            /* Isolated pacing response owed to host */
    uint8_t  seq_Nr;                    /* Sequence Number Received              */
    uint8_t  seq_Ns;                    /* Sequence Number Send                  */
    uint8_t  sscp_addr0;
@@ -65,6 +65,12 @@
 // Sense return codes
 #define SENSE_CR 0x80        // Command Reject
 
+// Channel program: a whole command chain in one bus message (see exec_cpgm)
+#define CCW_CPGM 0xF0        // Pseudo command code of the message header
+#define CCW_CC   0x40        // CCW flag: command chaining
+#define CPGM_MAX 65536       // Max size of CCW's + write data in one message
+#define CPGM_RSP 65535       // Max Read/Sense data in one reply (16 bit length)
+
 #define checkrc(expr) if(!(expr)) { perror(#expr); return -1; }
 
 typedef enum { false, true } bool;
@@ -75,6 +81,9 @@ extern int32 Eregs_Out[];
 extern uint8 M[];
 extern int8  CA1_DS_req_L3;  // Chan Adap Data/Status request flag
 extern int8  CA1_IS_req_L3;  // Chan Adap Initial/Sel request flag
+extern int8  coop_mode;      // Cooperative run mode: CA runs in the CCU thread
+int coop_start(const char *name, void *(*rtn)(void *));
+int coop_yield(void);
 
 // Trace variables
 uint16_t Adbg_reg = 0x00;    // Bit flags for debug/trace
@@ -101,8 +110,10 @@ extern pthread_mutex_t r77_lock;
 void exec_attn();
 void exec_pci();
 void exec_ccw(struct IO3705 *iob);
+void exec_cpgm(struct IO3705 *iob, int rc);
 int reg_bit(int reg, int bit_mask);
 int Ireg_bit(int reg, int bit_mask);
+int ca_addr_chk(struct IO3705 *iob, uint32_t addr, uint16_t count, char dir);
 void wait();
 
 struct CCW {    /* Channel Command Word */
@@ -123,6 +134,17 @@ struct CSW {    /* Channel Status Word */
 
 struct IO3705*  iobs[MAXCHAN];  /* IBM 3705 I/O Block pointer array */
 
+// Channel program being executed. exec_ccw then takes its CCW's and write
+// data from cpgm_buf, and Read/Sense data and status go to cpgm_rsp.
+// Only the CAx thread runs channel programs, so one set will do.
+int      cpgm_active = FALSE;
+uint8_t  cpgm_buf[CPGM_MAX];
+uint32_t cpgm_len, cpgm_ptr;
+uint8_t  cpgm_rsp[8 + CPGM_RSP];
+uint32_t cpgm_rspl;
+uint8_t  cpgm_stat;          // Status of the last CCW executed...
+int      cpgm_stat_set;      // ...if it presented one
+
 struct pth_args {
    void* arg1;
    void* arg2;
@@ -253,6 +275,8 @@ int host_connect(struct IO3705 *iob, int abport) {
             printf("\nCA%c: Host accept failed with errno %d for tag connection...\n\r", iob->CA_id, errno);
             return -1;
          }
+         if (coop_mode == ON)                            // Do not block the CCU
+            coop_yield();
       }
    }
    return 0;
@@ -280,7 +304,11 @@ void send_carnstat(int sockptr, char *carnstat, uint8_t *ackbuf, char CA_id) {
 
    if ((Adbg_flag == ON) && (Adbg_reg & 0x01))    // Trace channel adapter activities ?
       fprintf(A_trace, "CA%c: CARNSTAT %02X via socket %d\n\r", CA_id, *carnstat, sockptr);
-   if (sockptr != -1) {
+   if (cpgm_active) {              // Channel program: status goes back with the reply
+      cpgm_stat = *carnstat;
+      cpgm_stat_set = TRUE;
+      rc = 1;
+   } else if (sockptr != -1) {
       rc = send(sockptr, carnstat, 1, 0);
    if ((Adbg_flag == ON) && (Adbg_reg & 0x01))    // Trace channel adapter activities ?
          fprintf(A_trace, "CA%c: Send %d bytes on socket %d\n\r", CA_id, rc, sockptr);
@@ -331,6 +359,24 @@ int read_socket(int sockptr, char *buffptr, int buffsize) {
    return reclen;
 }
 
+// ************************************************************
+// Function to send Read/Sense data to the host, or add it to
+// the reply of the channel program being executed.
+// ************************************************************
+int send_data(int sockptr, uint8_t *datap, int datasize) {
+   if (cpgm_active) {
+      if (cpgm_rspl + datasize > sizeof(cpgm_rsp)) {
+         printf("\nCA: Channel program reply full, %d bytes of Read/Sense data dropped \n\r",
+                (int) (cpgm_rspl + datasize - sizeof(cpgm_rsp)));
+         datasize = sizeof(cpgm_rsp) - cpgm_rspl;
+      }
+      memcpy(cpgm_rsp + cpgm_rspl, datap, datasize);
+      cpgm_rspl = cpgm_rspl + datasize;
+      return datasize;
+   }
+   return send(sockptr, datap, datasize, 0);
+}
+
 // ************************************************************
 // Function to close TCP socket
 // ************************************************************
@@ -547,7 +593,10 @@ void *CA_T2_thread(void *arg) {
       return 0;
    }
 
-   rc = pthread_create(&id1, NULL, CAx_thread, NULL);
+   if (coop_mode == ON)
+      rc = coop_start("CAX", CAx_thread);
+   else
+      rc = pthread_create(&id1, NULL, CAx_thread, NULL);
    if (rc  != 0) {
       printf("\nCA_T2: Adapter thread creation failed with rc = %d \n\r", rc);
       return 0;
@@ -581,7 +630,11 @@ void *CA_T2_thread(void *arg) {
       /* If a request is received, it is passed to the connection handler funtion    */
       /*    followed by the creation of a thread that emulates the CA hardware,       */
       /*******************************************************************************/
-      event_count = epoll_wait(epoll_fd, events, MAXCHAN*2, 5000);
+      if (coop_mode == ON) {                                    // Do not block the CCU
+         coop_yield();
+         event_count = epoll_wait(epoll_fd, events, MAXCHAN*2, 0);
+      } else
+         event_count = epoll_wait(epoll_fd, events, MAXCHAN*2, 5000);
 
       for (int i = 0; i < event_count; i++) {
          for (int j = 0; j < MAXCHAN; j++) {                    // For evey possibe connected Channel
@@ -667,6 +720,7 @@ void *CAx_thread(void *arg) {
             }  // End if pendingrcv
          }  // End if iobs[j]
       }  // End for int j
+      coop_yield();                                      // COOP mode: let the CCU run
    }  // End of while(1)... */
 }
 
@@ -697,7 +751,12 @@ void exec_ccw(struct IO3705 *iob) {
       return;
    }
 
-   rc = read_socket( iob->bus_socket[iob->abswitch], iob->buffer, sizeof(iob->buffer));
+   if (cpgm_active) {                                    // Next CCW of a channel program ?
+      memcpy(iob->buffer, cpgm_buf + cpgm_ptr, 8);
+      cpgm_ptr = cpgm_ptr + 8;
+      rc = 8;
+   } else
+      rc = read_socket( iob->bus_socket[iob->abswitch], iob->buffer, sizeof(iob->buffer));
 
    if (rc == 0) {
       // Host disconnected, get details and print it
@@ -719,6 +778,10 @@ void exec_ccw(struct IO3705 *iob) {
       ccw.chain =  iob->buffer[5];
       ccw.count = (iob->buffer[6] << 8) | iob->buffer[7];
 
+      if ((ccw.code == CCW_CPGM) && !cpgm_active) {      // A whole command chain ?
+         exec_cpgm(iob, rc);
+         return;
+      }
       Eregs_Inp[0x5A] = ccw.code << 8;                   // Set Chan command in CA Data Buffer
       Eregs_Inp[0x5C] &= ~0xFFFF;                        // Clear command flags CA Command Register
       Eregs_Inp[0x55] &= ~0x0800;                        // Program Requested L3 interrupt flag should be off
@@ -772,6 +835,8 @@ void exec_ccw(struct IO3705 *iob) {
                   fprintf(A_trace, "Fetch starts at %06X, count = %04X\n\r", cacw2, wdcnt);
                }
                wdcnttmp = wdcnt;                         // Bytes to be transferred for this CW
+               if (ca_addr_chk(iob, cacw2, wdcnttmp, 'O') == FALSE)
+                  wdcnttmp = 0;                          // Nothing is fetched from a bad address
                wdcnttot = wdcnttot + wdcnt;              // Total byte count
                for (i = 0; i < wdcnttmp; i++) {
                   iob->buffer[bufbase + i] = M[cacw2 + i];   // Load data directly into memory
@@ -821,7 +886,7 @@ void exec_ccw(struct IO3705 *iob) {
                   wait();                                // Wait for initial selection reset
             }
 
-            rc = send(iob->bus_socket[iob->abswitch], (void*)&iob->buffer, wdcnttot, 0);
+            rc = send_data(iob->bus_socket[iob->abswitch], iob->buffer, wdcnttot);
 
             // Send CA return status to host
             if (condition != 3) {
@@ -868,7 +933,7 @@ void exec_ccw(struct IO3705 *iob) {
             if ((Adbg_flag == ON) && (Adbg_reg & 0x01))  // Trace channel adapter activities ?
                fprintf(A_trace, "CA%c: Sending sense Byte 0 %02X \n\r", iob->CA_id, iob->buffer[0]);
 
-            rc = send_socket(iob->bus_socket[iob->abswitch], (void*)&iob->buffer, 1);
+            rc = send_data(iob->bus_socket[iob->abswitch], iob->buffer, 1);
 
             // Send CA return status to host
             send_carnstat(iob->bus_socket[iob->abswitch], &carnstat, &ackbuf, iob->CA_id);
@@ -906,11 +971,23 @@ void exec_ccw(struct IO3705 *iob) {
                 wait();                                  // Wait for CA1 L3 Request reset
             print_regs(iob, "CCW 05, 09, 01 Pre");
 
+            if (cpgm_active) {                           // Data follows the CCW in the channel program
+               rc = ccw.count;
+               if (rc > sizeof(iob->chainbuf) - iob->chainbl)
+                  rc = sizeof(iob->chainbuf) - iob->chainbl;
+               if (rc > cpgm_len - cpgm_ptr)
+                  rc = cpgm_len - cpgm_ptr;
+               memcpy(iob->chainbuf + iob->chainbl, cpgm_buf + cpgm_ptr, rc);
+               cpgm_ptr = cpgm_ptr + ccw.count;
+            } else {
             // Read data from host, but first make sure host has finished writing all data to the TCP buffer
             pendingrcv = 0;
-            while (pendingrcv != ccw.count)
+            while (pendingrcv != ccw.count) {
                ioctl(iob->bus_socket[iob->abswitch], FIONREAD, &pendingrcv);
+               coop_yield();
+            }
             rc = recv( iob->bus_socket[iob->abswitch], iob->chainbuf + iob->chainbl, sizeof(iob->chainbuf)-iob->chainbl, 0);
+            }
             if ((Adbg_flag == ON) && (Adbg_reg & 0x01))  // Trace channel adapter activities ?
                fprintf(A_trace, "CA%c: received: %d bytes from host\n\r", iob->CA_id, rc);
             iob->bufferl = rc;
@@ -975,6 +1052,8 @@ void exec_ccw(struct IO3705 *iob) {
                   wdcnttmp = wdcnt < iob->bufferl?wdcnt:iob->bufferl;
                   if ((Adbg_flag == ON) && (Adbg_reg & 0x01))   // Trace channel adapter activities ?
                      fprintf(A_trace, "(1) wdcnttmp=%d, wdcnt=%d, iob->bufferl=%d\n\r", wdcnttmp, wdcnt, iob->bufferl);
+                  if (ca_addr_chk(iob, cacw2, wdcnttmp, 'I') == FALSE)
+                     iob->bufferl = wdcnttmp = 0;        // Drop the data rather than wrap it into low storage
 
                   for (i = 0; i < wdcnttmp; i++) {
                      M[cacw2 + i] = iob->chainbuf[bufbase + i];  // Load data directly into memory
@@ -1101,6 +1180,106 @@ void exec_ccw(struct IO3705 *iob) {
 }
 
 
+// ************************************************************
+// Function to execute a channel program sent in one message.
+//
+// A single CCW costs a round trip: command, data, status. For
+// small PIU's those round trips, not the bandwidth, limit the
+// channel. A host may therefore send a whole command chain
+// (e.g. Write + Read) as one message on the bus socket:
+//
+//   F0 00 00 00 00 00 len(2)    header, len = length of what follows
+//   CCW (8 bytes) [data]        write type CCW's followed by their data
+//   CCW (8 bytes) [data] ...    as long as the command chain flag is on
+//
+// The CCW's are executed in order as if they came one by one. The
+// chain ends with the first CCW without command chaining or one
+// that presents a status other than CE+DE (CE+DE+SM skips the next
+// CCW). The host gets one reply:
+//
+//   F0 stat n 00 00 00 len(2)   stat of the last CCW, n CCW's executed
+//   Read/Sense data             all data read by the chain, max 64K-1
+//
+// A message that arrives with more bytes than its len is rejected
+// with Unit Check and no CCW's executed.
+//
+// ATTN and PCI raised by the NCP meanwhile still go out on the tag
+// socket as they occur.
+// ************************************************************
+void exec_cpgm(struct IO3705 *iob, int rc) {
+   uint32_t len;
+   int nccw = 0;
+   uint8_t code, flags;
+   uint16_t count;
+
+   len = (iob->buffer[6] << 8) | iob->buffer[7];
+   if (len == 0)
+      len = CPGM_MAX;                            // len 0 means 64K
+   cpgm_len = rc - 8;                            // Part already read with the header
+   cpgm_ptr = 0;
+   cpgm_rspl = 8;                                // Room for the reply header
+   cpgm_stat = 0x00;
+   if (cpgm_len > len) {                         // Not one channel program: reject it
+      printf("\nCA%c: Channel program of %d bytes received with %d more, rejected \n\r",
+             iob->CA_id, len, cpgm_len - len);
+      cpgm_stat = CSW_CEND | CSW_DEND | CSW_UCHK;
+      cpgm_len = len = 0;                        // Execute nothing
+   }
+   memcpy(cpgm_buf, iob->buffer + 8, cpgm_len);
+   while (cpgm_len < len) {
+      rc = recv(iob->bus_socket[iob->abswitch], cpgm_buf + cpgm_len, len - cpgm_len, MSG_WAITALL);
+      if (rc < 1) {
+         printf("\nCA%c: Channel program incomplete, %d of %d bytes \n\r", iob->CA_id, cpgm_len, len);
+         return;
+      }
+      cpgm_len = cpgm_len + rc;
+   }
+   if ((Adbg_flag == ON) && (Adbg_reg & 0x01))   // Trace channel adapter activities ?
+      fprintf(A_trace, "\nCA%c: Channel program of %d bytes \n\r", iob->CA_id, cpgm_len);
+
+   while (cpgm_ptr + 8 <= cpgm_len) {
+      code  = cpgm_buf[cpgm_ptr];
+      flags = cpgm_buf[cpgm_ptr + 4];
+      cpgm_stat_set = FALSE;
+      cpgm_active = TRUE;
+      exec_ccw(iob);
+      cpgm_active = FALSE;
+      nccw++;
+      if (Eregs_Out[0x55] & 0x0200)              // ATTN request ?
+         exec_attn();
+      if (Eregs_Out[0x57] & 0x0080)              // PCI request ?
+         exec_pci();
+      if (!cpgm_stat_set)                        // No status presented: chain ends
+         break;
+      if (!(flags & CCW_CC))                     // Last CCW of the chain ?
+         break;
+      if ((cpgm_stat & ~CSW_SMOD) != (CSW_CEND | CSW_DEND))
+         break;
+      if ((cpgm_stat & CSW_SMOD) && (cpgm_ptr + 8 <= cpgm_len)) {  // Status modifier: skip a CCW
+         code  = cpgm_buf[cpgm_ptr];
+         count = (cpgm_buf[cpgm_ptr + 6] << 8) | cpgm_buf[cpgm_ptr + 7];
+         cpgm_ptr = cpgm_ptr + 8;
+         if ((code == 0x01) || (code == 0x05) || (code == 0x09))
+            cpgm_ptr = cpgm_ptr + count;
+      }
+   }
+
+   // Reply header, then all Read/Sense data
+   cpgm_rsp[0] = CCW_CPGM;
+   cpgm_rsp[1] = cpgm_stat;
+   cpgm_rsp[2] = nccw;
+   cpgm_rsp[3] = cpgm_rsp[4] = cpgm_rsp[5] = 0x00;
+   cpgm_rsp[6] = ((cpgm_rspl - 8) >> 8) & 0xFF;
+   cpgm_rsp[7] =  (cpgm_rspl - 8) & 0xFF;
+   if ((Adbg_flag == ON) && (Adbg_reg & 0x01))   // Trace channel adapter activities ?
+      fprintf(A_trace, "CA%c: Channel program ended after %d CCW's, status %02X, %d data bytes \n\r",
+              iob->CA_id, nccw, cpgm_stat, cpgm_rspl - 8);
+   if (send(iob->bus_socket[iob->abswitch], cpgm_rsp, cpgm_rspl, 0) < 0)
+      printf("\nCA%c: Channel program reply to host failed...\n\r", iob->CA_id);
+   return;
+}
+
+
 // ************************************************************
 // This subroutine test for 1 bit in a External Output reg.
 // If '0' OFF is returned, if 1 'ON' returned.
@@ -1125,11 +1304,30 @@ int Ireg_bit(int reg, int bit_mask) {
 }
 
 
+// ************************************************************
+// This subroutine checks a CA control word data area.
+// Control words carry an 18 bit address, so with storage above
+// 256K the CA can not reach a buffer that ends above 256K.
+// Such a transfer is refused and logged instead of being
+// wrapped into low storage. FALSE is returned in that case.
+// ************************************************************
+int ca_addr_chk(struct IO3705 *iob, uint32_t addr, uint16_t count, char dir) {
+   if (addr + count <= MAXMEM18)
+      return(TRUE);
+   printf("\nCA%c: Transfer refused, %s control word data area %06X-%06X crosses 256K\n\r",
+          iob->CA_id, (dir == 'I') ? "IN" : "OUT", addr, addr + count - 1);
+   if ((Adbg_flag == ON) && (Adbg_reg & 0x01))  // Trace channel adapter activities ?
+      fprintf(A_trace, "Transfer refused: %c CW data area %06X, count %04X crosses 256K\n\r", dir, addr, count);
+   return(FALSE);
+}
+
+
 // ************************************************************
 // This subroutine waits 1 usec
 // ************************************************************
 void wait() {
-   usleep(1);
+   if (coop_yield() == 0)        // COOP mode: the CCU runs while we wait
+      usleep(1);
    return;
 }
 
@@ -156,6 +156,10 @@
 #include "i3705_Eregs.h"                                /* Exernal regs defs */
 #include <pthread.h>
 #include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <ucontext.h>
 
 #define UNIT_V_MSIZE (UNIT_V_UF+3)                      /* dummy mask */
 #define UNIT_MSIZE   (1 << UNIT_V_MSIZE)
@@ -180,16 +184,80 @@ extern pthread_mutex_t icw_lock;                        /* CS2: ICW update lock
 pthread_mutex_t r77_lock;                               /* CA2/CS2: Reg77 update lock */
 pthread_mutex_t r7f_lock;                               /* CCU: Reg7F update lock */
 
-uint8 M[MAXMEMSIZE] = { 0 };                            /* Memory 3705 */
+/* The C & Z latches are set lazily: most instructions only record what */
+/* the latches depend on. CL_eval() sets CL_C/CL_Z when they are needed. */
+#define CL_NONE         0                               /* CL_C & CL_Z are up to date */
+#define CL_LOG          1                               /* Z = (a == 0), C = (a != 0) */
+#define CL_CMP          2                               /* C = (a < b),  Z = (a == b) */
+#define CL_RES          3                               /* Z = (a == 0), C = b        */
+#define CL_LAZY(g, op, x, y)  do { CL_op[g] = op; CL_a[g] = x; CL_b[g] = y; } while (0)
+
+uint8 M[MAXMEMSIZE] __attribute__((aligned(4096))) = { 0 };  /* Memory 3705 (page aligned for MAPIMAGE) */
+char  M_image[256] = "";                                /* Storage image file mapped over M */
+char  M_shmname[256] = "";                              /* Shared memory segment backing M */
+struct shm3705 *M_shmhdr = NULL;                        /* Header page of that segment */
+static int8 M_shmmask = 0;                              /* Areas mapped over that segment */
 int32 msize;                                            /* specifed memory size */
 
-int32 GR[8][4] = { 0x00 };                              /* General Registers Group 0-3 */
+int32 GR[SHM_PAGE / 16][4] __attribute__((aligned(SHM_PAGE))) = { 0x00 };  /* General Registers Group 0-3 (rows 8.. pad the page) */
 int32 opcode;                                           /* Operation Code 16 bits */
 int32 opcode0, opcode1;                                 /* OpCode byte0(H) & Byte1(L) */
 int8  CL_C[4] = { OFF };                                /* Condition Latches 'C' */
 int8  CL_Z[4] = { OFF };                                /* Condition Latches 'Z' */
-int32 Eregs_Inp[128] = { 0xEFEF };                      /* External regs X'00 -> X'7F' inp */
-int32 Eregs_Out[128] = { 0x0000 };                      /* External regs X'00 -> X'7F' out */
+int8  CL_op[4] = { CL_NONE };                           /* Pending C&Z latch evaluation */
+int32 CL_a[4], CL_b[4];                                 /* Operands of pending evaluation */
+uint8 OP_sw[65536];                                     /* Decode switches having a case per opcode */
+#define OP_SKIP         -1                              /* Switch value that matches no case */
+#ifdef OPSW_CHECK                                       /* Cross-check OP_sw[] against the switches */
+#define OP_SW_MISS(sw)  default: opsw_hit &= ~(sw); break;
+#else
+#define OP_SW_MISS(sw)
+#endif
+int8  OP_sw_built = OFF;                                /* OP_sw[] filled in ? */
+int32 Eregs_Inp[SHM_PAGE / 4] __attribute__((aligned(SHM_PAGE))) = { 0xEFEF };  /* External regs X'00 -> X'7F' inp */
+int32 Eregs_Out[SHM_PAGE / 4] __attribute__((aligned(SHM_PAGE))) = { 0x0000 };  /* External regs X'00 -> X'7F' out */
+int32 GR_mask = 0x3FFFF;                                /* Register width: 18 bits, 19 above 256K */
+int32 XB_mask = 0x30000;                                /* X-byte bits: 6-7, 5-7 above 256K */
+
+#define HLE_NRTN        2                               /* Nr of natively run NCP loops */
+#define HLE_MAXSITE     16                              /* Sites listed per routine */
+#define HLE_CHUNK       256                             /* Max loop iterations per step */
+struct hle_rtn {
+   const char *name;                                    /* SET/SHOW CPU HLE name */
+   int32  len;                                          /* Length of the loop code */
+   int32  (*match)(int32 addr);                         /* Is the loop at addr ? */
+   int32  (*exec)(int32 addr);                          /* Run it, returns nr of instr */
+   int8   enabled;
+   int32  nsite;                                        /* Nr of sites found */
+   int32  site[HLE_MAXSITE];
+   uint32 calls;
+   t_uint64 insts;                                      /* CCU instr not interpreted */
+};
+uint8 HLE_map[MAXMEMSIZE];                              /* Routine nr+1 at its first instr */
+int8  hle_on = ON;                                      /* Scan storage for the loops */
+
+#define COOP_NTASK      4                               /* CA, CA adapter, scanner, LIB */
+#define COOP_STACK      (1024 * 1024)                   /* Stack per coroutine */
+#define COOP_TIME       500                             /* Instr between two services */
+#define COOP_IDLE       250                             /* usec rest in wait state */
+struct coop_task {
+   const char *name;                                    /* SHOW CPU COOP name */
+   void   *(*rtn)(void *);                              /* The former thread routine */
+   ucontext_t ctx;                                      /* Coroutine context */
+   ucontext_t ret;                                      /* Context that resumed it */
+   int8   done;                                         /* Routine has returned */
+   uint32 runs;                                         /* Nr of times resumed */
+};
+struct coop_task coop_tab[COOP_NTASK];
+int32 coop_ntask = 0;
+int8  coop_mode = OFF;                                  /* Cooperative run mode (-c) */
+static __thread struct coop_task *coop_cur = NULL;      /* Coroutine running in this thread */
+
+#define IO_NTHREAD      3                               /* CA adapter, scanner, LIB threads */
+static pthread_mutex_t io_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  io_cond = PTHREAD_COND_INITIALIZER;
+static volatile int8 io_hold = OFF;                     /* I/O threads must park in coop_yield */
+static int32 io_held = 0;                               /* Nr of I/O threads parked */
 
 int8  int_lvl_req[1+5]  = {0, OFF, OFF, OFF, OFF, OFF}; /* Requested Program Levels */
 int8  int_lvl_ent[1+5]  = {0, OFF, OFF, OFF, OFF, OFF}; /* Entered Program Levels */
@@ -239,9 +307,32 @@ t_stat cpu_ex (t_value *vptr, t_addr addr, UNIT *uptr, int32 sw);
 t_stat cpu_dep (t_value val, t_addr addr, UNIT *uptr, int32 sw);
 t_stat cpu_reset (DEVICE *dptr);
 t_stat cpu_set_size (UNIT *uptr, int32 val, char *cptr, void *desc);
+t_stat cpu_set_image (UNIT *uptr, int32 val, char *cptr, void *desc);
+t_stat cpu_save_image (UNIT *uptr, int32 val, char *cptr, void *desc);
+t_stat cpu_show_image (FILE *st, UNIT *uptr, int32 val, void *desc);
+t_stat cpu_set_shm (UNIT *uptr, int32 val, char *cptr, void *desc);
+t_stat cpu_clr_shm (UNIT *uptr, int32 val, char *cptr, void *desc);
+t_stat cpu_show_shm (FILE *st, UNIT *uptr, int32 val, void *desc);
+t_stat cpu_set_hle (UNIT *uptr, int32 val, char *cptr, void *desc);
+t_stat cpu_clr_hle (UNIT *uptr, int32 val, char *cptr, void *desc);
+t_stat cpu_show_hle (FILE *st, UNIT *uptr, int32 val, void *desc);
+t_stat cpu_show_coop (FILE *st, UNIT *uptr, int32 val, void *desc);
+t_stat coop_svc (UNIT *uptr);
+t_stat lib_set_speed (UNIT *uptr, int32 val, char *cptr, void *desc);
+t_stat lib_show_speed (FILE *st, UNIT *uptr, int32 val, void *desc);
+t_stat lib_set_duplex (UNIT *uptr, int32 val, char *cptr, void *desc);
+t_stat lib_show_duplex (FILE *st, UNIT *uptr, int32 val, void *desc);
 t_stat cpu_boot (int32 unitno, DEVICE *dptr);
 
 int32 RegGrp(int32 level);
+void  CL_eval(int32 grp);
+void  OP_sw_init(void);
+int32 hle_step(int32 addr);
+void  hle_scan(void);
+void  coop_sched(void);
+void  coop_idle(void);
+static int  io_quiesce(void);
+static void io_resume(void);
 int32 GetMem(int32 addr);
 int32 PutMem(int32 addr, int32 data);
 
@@ -256,7 +347,7 @@ int16 reason;
 
 unsigned short old_crc;
 unsigned char crc_data;
-UNIT cpu_unit = { UDATA (NULL, UNIT_FIX + UNIT_BINK, MAXMEMSIZE) };
+UNIT cpu_unit = { UDATA (NULL, UNIT_FIX + UNIT_BINK, MAXMEM18) };
 
 REG cpu_reg[] = {
     { HRDATA (IAR, PC, 20), REG_RO },
@@ -272,50 +363,50 @@ REG cpu_reg[] = {
     { FLDATA (IREQ5, int_lvl_req[4], 8) },
 
     /* Group 0 registers */
-    { HRDATA (GR0G0, GR[0][0], 18) },
-    { HRDATA (GR1G0, GR[1][0], 18) },
-    { HRDATA (GR2G0, GR[2][0], 18) },
-    { HRDATA (GR3G0, GR[3][0], 18) },
-    { HRDATA (GR4G0, GR[4][0], 18) },
-    { HRDATA (GR5G0, GR[5][0], 18) },
-    { HRDATA (GR6G0, GR[6][0], 18) },
-    { HRDATA (GR7G0, GR[7][0], 18) },
+    { HRDATA (GR0G0, GR[0][0], 19) },
+    { HRDATA (GR1G0, GR[1][0], 19) },
+    { HRDATA (GR2G0, GR[2][0], 19) },
+    { HRDATA (GR3G0, GR[3][0], 19) },
+    { HRDATA (GR4G0, GR[4][0], 19) },
+    { HRDATA (GR5G0, GR[5][0], 19) },
+    { HRDATA (GR6G0, GR[6][0], 19) },
+    { HRDATA (GR7G0, GR[7][0], 19) },
     { FLDATA (CLCG0, CL_C[0],   8) },
     { FLDATA (CLZG0, CL_Z[0],   8) },
 
     /* Group 1 registers */
-    { HRDATA (GR0G1, GR[0][1], 18) },
-    { HRDATA (GR1G1, GR[1][1], 18) },
-    { HRDATA (GR2G1, GR[2][1], 18) },
-    { HRDATA (GR3G1, GR[3][1], 18) },
-    { HRDATA (GR4G1, GR[4][1], 18) },
-    { HRDATA (GR5G1, GR[5][1], 18) },
-    { HRDATA (GR6G1, GR[6][1], 18) },
-    { HRDATA (GR7G1, GR[7][1], 18) },
+    { HRDATA (GR0G1, GR[0][1], 19) },
+    { HRDATA (GR1G1, GR[1][1], 19) },
+    { HRDATA (GR2G1, GR[2][1], 19) },
+    { HRDATA (GR3G1, GR[3][1], 19) },
+    { HRDATA (GR4G1, GR[4][1], 19) },
+    { HRDATA (GR5G1, GR[5][1], 19) },
+    { HRDATA (GR6G1, GR[6][1], 19) },
+    { HRDATA (GR7G1, GR[7][1], 19) },
     { FLDATA (CLCG1, CL_C[1],   8) },
     { FLDATA (CLZG1, CL_Z[1],   8) },
 
     /* Group 2 registers */
-    { HRDATA (GR0G2, GR[0][2], 18) },
-    { HRDATA (GR1G2, GR[1][2], 18) },
-    { HRDATA (GR2G2, GR[2][2], 18) },
-    { HRDATA (GR3G2, GR[3][2], 18) },
-    { HRDATA (GR4G2, GR[4][2], 18) },
-    { HRDATA (GR5G2, GR[5][2], 18) },
-    { HRDATA (GR6G2, GR[6][2], 18) },
-    { HRDATA (GR7G2, GR[7][2], 18) },
+    { HRDATA (GR0G2, GR[0][2], 19) },
+    { HRDATA (GR1G2, GR[1][2], 19) },
+    { HRDATA (GR2G2, GR[2][2], 19) },
+    { HRDATA (GR3G2, GR[3][2], 19) },
+    { HRDATA (GR4G2, GR[4][2], 19) },
+    { HRDATA (GR5G2, GR[5][2], 19) },
+    { HRDATA (GR6G2, GR[6][2], 19) },
+    { HRDATA (GR7G2, GR[7][2], 19) },
     { FLDATA (CLCG2, CL_C[2],   8) },
     { FLDATA (CLZG2, CL_Z[2],   8) },
 
     /* Group 3 registers */
-    { HRDATA (GR0G3, GR[0][3], 18) },
-    { HRDATA (GR1G3, GR[1][3], 18) },
-    { HRDATA (GR2G3, GR[2][3], 18) },
-    { HRDATA (GR3G3, GR[3][3], 18) },
-    { HRDATA (GR4G3, GR[4][3], 18) },
-    { HRDATA (GR5G3, GR[5][3], 18) },
-    { HRDATA (GR6G3, GR[6][3], 18) },
-    { HRDATA (GR7G3, GR[7][3], 18) },
+    { HRDATA (GR0G3, GR[0][3], 19) },
+    { HRDATA (GR1G3, GR[1][3], 19) },
+    { HRDATA (GR2G3, GR[2][3], 19) },
+    { HRDATA (GR3G3, GR[3][3], 19) },
+    { HRDATA (GR4G3, GR[4][3], 19) },
+    { HRDATA (GR5G3, GR[5][3], 19) },
+    { HRDATA (GR6G3, GR[6][3], 19) },
+    { HRDATA (GR7G3, GR[7][3], 19) },
     { FLDATA (CLCG3, CL_C[3],   8) },
     { FLDATA (CLZG3, CL_Z[3],   8) },
 
@@ -421,12 +512,21 @@ MTAB cpu_mod[] = {    // <=== for future 3705 model selection
     { UNIT_MSIZE, 393216, NULL, "384K", &cpu_set_size },
     { UNIT_MSIZE, 458752, NULL, "448K", &cpu_set_size },
     { UNIT_MSIZE, 524288, NULL, "512K", &cpu_set_size },
+    { MTAB_XTD|MTAB_VDV, 0, "LINESPEED", "LINESPEED", &lib_set_speed, &lib_show_speed },
+    { MTAB_XTD|MTAB_VDV, 0, "DUPLEX", "DUPLEX", &lib_set_duplex, &lib_show_duplex },
+    { MTAB_XTD|MTAB_VDV|MTAB_NC, 0, "MAPIMAGE", "MAPIMAGE", &cpu_set_image, &cpu_show_image },
+    { MTAB_XTD|MTAB_VDV|MTAB_NC, 0, NULL, "SAVEIMAGE", &cpu_save_image, NULL },
+    { MTAB_XTD|MTAB_VDV|MTAB_NC, 0, "SHMEM", "SHMEM", &cpu_set_shm, &cpu_show_shm },
+    { MTAB_XTD|MTAB_VDV, 0, NULL, "NOSHMEM", &cpu_clr_shm, NULL },
+    { MTAB_XTD|MTAB_VDV, 0, "HLE", "HLE", &cpu_set_hle, &cpu_show_hle },
+    { MTAB_XTD|MTAB_VDV, 0, NULL, "NOHLE", &cpu_clr_hle, NULL },
+    { MTAB_XTD|MTAB_VDV, 0, "COOP", NULL, NULL, &cpu_show_coop },
     { 0 }
 };
 
 DEVICE cpu_dev = {
     "CPU", &cpu_unit, cpu_reg, cpu_mod,
-    1, 16, 18, 1, 16, 8,
+    1, 16, 19, 1, 16, 8,
     &cpu_ex, &cpu_dep, &cpu_reset, &cpu_boot,
     NULL, NULL
 };
@@ -472,11 +572,24 @@ int32 i, j, w_byte, addr;
 int32 R1fld, R2fld, Rfld;
 int32 N1fld, N2fld, Nfld;
 int32 Afld, Bfld, Dfld, Efld, Ifld, Mfld, Tfld;
+int32 opsw;                                     /* Decode switches for this opcode */
+#ifdef OPSW_CHECK
+int32 opsw_hit;                                 /* Switches that did have a case for it */
+#endif
 
 Grp = RegGrp(lvl);
 saved_PC = PC;
 PC = GR[0][Grp];
 reason = 0;
+if (MEMSIZE > MAXMEM18) {                      /* Extended addressing: X-bit 5 in use */
+   GR_mask = 0x7FFFF;
+   XB_mask = 0x70000;
+} else {
+   GR_mask = 0x3FFFF;
+   XB_mask = 0x30000;
+}
+if (coop_mode == ON)                           /* CA, scanner and LIB on the event queue */
+   coop_sched();
 
 //********************************************************
 // Main instruction fetch/decode loop                    *
@@ -535,6 +648,7 @@ while (reason == 0) {                          /* Loop until halted */
 //********************************************************
    if (wait_state != ON) {
       if (debug_reg & 0x01) {  /* Trace instruction + mnem. */
+         CL_eval(Grp);         /* fprint_sym shows the latches */
          fprintf(trace, "\n[%06d] exec IAR=%05X - %04X        ", cc++,
             saved_PC, opcode );
          fprint_sym(trace, PC, (uint32 *) val, &cpu_unit, SWMASK('M') );
@@ -688,7 +802,10 @@ while (reason == 0) {                          /* Loop until halted */
    }
 
    if (wait_state == ON) {
-      usleep(1000);                            // Get some rest...
+      if (coop_mode == ON)
+         coop_idle();                          // Let CA, scanner and LIB run
+      else
+         usleep(1000);                         // Get some rest...
       continue;
    }
 
@@ -700,11 +817,19 @@ while (reason == 0) {                          /* Loop until halted */
    PC = GR[0][Grp];
    saved_PC = PC;
 
+   if (HLE_map[PC] && hle_step(PC))            /* Hot NCP loop run natively ? */
+      continue;
+
    val[0] = opcode0 = GetMem(PC);              /* Instruction byte 0(H) */
-   PC = (PC + 1) & AMASK;
+   PC = (PC + 1) & GR_mask;
    val[1] = opcode1 = GetMem(PC);              /* Instruction byte 1(L) */
-   PC = (PC + 1) & AMASK;
+   PC = (PC + 1) & GR_mask;
    opcode = (opcode0 << 8) | (opcode1);        /* Instr to be executed. */
+#ifdef OPSW_CHECK
+   opsw = opsw_hit = 0xFF;                     /* Full decode, compared with OP_sw[] below */
+#else
+   opsw = OP_sw[opcode];                       /* Switches below that decode it */
+#endif
    val[2] = GetMem(PC);                        /* Needed for possible LA */
    val[3] = GetMem(PC + 1);                    /* and BAL instructions. */
 
@@ -732,7 +857,7 @@ while (reason == 0) {                          /* Loop until halted */
          Eregs_Inp[0x7A]++;                    /* ...Increment Cycle Utilization Register */
    } // End if cycle_eight
 
-   switch (opcode & 0xF800) {
+   switch ((opsw & 0x01) ? (opcode & 0xF800) : OP_SKIP) {
       case (0xA800):
          /* B    T              [RT]  */
          /* 01234567 89012345
@@ -754,6 +879,7 @@ while (reason == 0) {                          /* Loop until halted */
          Grp = RegGrp(lvl);
          Tfld = (opcode & 0x07FE);
 
+         CL_eval(Grp);                         /* Latches needed now */
          if (CL_C[Grp] == ON) {
             if (opcode & 0x0001)
                GR[0][Grp] = GR[0][Grp] - Tfld;
@@ -770,6 +896,7 @@ while (reason == 0) {                          /* Loop until halted */
          Grp = RegGrp(lvl);
          Tfld = (opcode & 0x07FE);
 
+         CL_eval(Grp);                         /* Latches needed now */
          if (CL_Z[Grp] == ON) {
             if (opcode & 0x0001)
                GR[0][Grp] = GR[0][Grp] - Tfld;
@@ -791,10 +918,10 @@ while (reason == 0) {                          /* Loop until halted */
 
             if (Nfld == 0) {                   /* Count is contained in byte 0 only */
                w_byte = (GR[Rfld][Grp] - 0x00100) & 0x0FF00;
-               GR[Rfld][Grp] = (GR[Rfld][Grp] & 0x300FF) | w_byte;
+               GR[Rfld][Grp] = (GR[Rfld][Grp] & (XB_mask | 0xFF)) | w_byte;
             } else {                           /* Count is contained in byte 0 & 1 */
                w_byte = (GR[Rfld][Grp] - 0x00001) & 0x0FFFF;
-               GR[Rfld][Grp] = (GR[Rfld][Grp] & 0x30000) | w_byte;
+               GR[Rfld][Grp] = (GR[Rfld][Grp] & XB_mask) | w_byte;
             }
             if ((w_byte & 0xFFFF) == 0x0000)   /* Next instr if result = 0 */
                break;
@@ -840,21 +967,14 @@ while (reason == 0) {                          /* Loop until halted */
          Grp = RegGrp(lvl);
          Rfld = (opcode0 & 0x06) + 1;          /* Extract odd register nr */
          Nfld = (opcode0 & 0x01);
-         /* Reset C&Z latches */
-         CL_Z[Grp] = OFF;
-         CL_C[Grp] = OFF;
 
          if (Nfld == 0) {                      /* Byte 0(H) */
-            GR[Rfld][Grp] = (GR[Rfld][Grp] & 0x300FF) | (opcode1 << 8);
+            GR[Rfld][Grp] = (GR[Rfld][Grp] & (XB_mask | 0xFF)) | (opcode1 << 8);
          } else {                              /* Byte 1(L) */
-            GR[Rfld][Grp] = (GR[Rfld][Grp] & 0x3FF00) | opcode1;
+            GR[Rfld][Grp] = (GR[Rfld][Grp] & (XB_mask | 0xFF00)) | opcode1;
          }
          /* Test selected byte for zero */
-         if (opcode1 == 0x00) {
-            CL_Z[Grp] = ON;
-         } else {
-            CL_C[Grp] = ON;
-         }
+         CL_LAZY(Grp, CL_LOG, opcode1, 0);
          break;
 
       case (0x9000):
@@ -865,28 +985,19 @@ while (reason == 0) {                          /* Loop until halted */
          Rfld = (opcode0 & 0x06) + 1;          /* Extract odd register nr */
          Nfld = (opcode0 & 0x01);
          Ifld =  opcode1;
-         /* Reset C&Z latches */
-         CL_Z[Grp] = OFF;
-         CL_C[Grp] = OFF;
 
          if (Nfld == 0) {                      /* Byte 0(H) */
             w_byte = GR[Rfld][Grp] + (Ifld << 8);
-            if (((GR[Rfld][Grp] & 0xFFFF) +    /* Overflow from byte 0(H) ? */
-                 (Ifld << 8)) > 0xFFFF)
-               CL_C[Grp] = ON;
-            if ((w_byte & 0xFF00) == 0x0000)   /* Result zero ? */
-               CL_Z[Grp] = ON;
-            w_byte &= 0x3FFFF;                 /* Remove possible overflow bit */
+            CL_LAZY(Grp, CL_RES, w_byte & 0xFF00,  /* Result zero ? */
+                    ((GR[Rfld][Grp] & 0xFFFF) + (Ifld << 8)) > 0xFFFF);  /* Overflow from byte 0(H) ? */
+            w_byte &= GR_mask;                 /* Remove possible overflow bit */
             /* Store result back in register */
             GR[Rfld][Grp] = w_byte;
          } else {                              /* Byte X, 0(H) & 1(L) */
             w_byte = GR[Rfld][Grp] + Ifld;
-            if (((GR[Rfld][Grp] & 0x0FFFF) +   /* Overflow from byte 1(L) ? */
-                 (Ifld)) > 0xFFFF)
-               CL_C[Grp] = ON;
-            if ((w_byte & 0xFFFF) == 0x0000)   /* Result zero ? (X-byte not include) */
-               CL_Z[Grp] = ON;
-            w_byte &= 0x3FFFF;                 /* Remove possible overflow bit */
+            CL_LAZY(Grp, CL_RES, w_byte & 0xFFFF,  /* Result zero ? (X-byte not include) */
+                    ((GR[Rfld][Grp] & 0x0FFFF) + Ifld) > 0xFFFF);  /* Overflow from byte 1(L) ? */
+            w_byte &= GR_mask;                 /* Remove possible overflow bit */
             /* Store result back in register */
             GR[Rfld][Grp] = w_byte;
          }
@@ -900,29 +1011,22 @@ while (reason == 0) {                          /* Loop until halted */
          Rfld = (opcode0 & 0x06) + 1;          /* Extract odd register nr */
          Nfld = (opcode0 & 0x01);
          Ifld =  opcode1;
-         /* Reset C&Z latches */
-         CL_Z[Grp] = OFF;
-         CL_C[Grp] = OFF;
 
          w_byte = Ifld;                        /* Get second operand */
 
          /* Perform SUB with operand 1 */
          if (Nfld == 0) {                      /* Byte 0(H) result */
             w_byte = GR[Rfld][Grp] + (~(w_byte << 8)) + 1;
-            if (((GR[Rfld][Grp] & 0x0FF00) +   /* Overflow from byte 0(H) ? */
-                 (~(Ifld << 8) & 0x3FF00) + 0x0100) & 0x10000)
-               CL_C[Grp] = ON;
-            if ((w_byte & 0x0FF00) == 0x0000)  /* Result zero ? (X-byte not include) */
-               CL_Z[Grp] = ON;
-            w_byte &= 0x3FFFF;                 /* Remove possible overflow bit */
+            CL_LAZY(Grp, CL_RES, w_byte & 0x0FF00,  /* Result zero ? (X-byte not include) */
+                    ((GR[Rfld][Grp] & 0x0FF00) +   /* Overflow from byte 0(H) ? */
+                     (~(Ifld << 8) & 0x3FF00) + 0x0100) & 0x10000);
+            w_byte &= GR_mask;                 /* Remove possible overflow bit */
          } else {                              /* Byte 0 & 1 result */
             w_byte = (GR[Rfld][Grp] + (~w_byte) + 1);
-            if (((GR[Rfld][Grp] & 0x0FFFF) +   /* Overflow from byte 0 & 1 ? */
-                 (~Ifld) + 1) & 0x10000)
-               CL_C[Grp] = ON;
-            if ((w_byte & 0xFFFF) == 0x0000)   /* Result zero ? (X-byte not include) */
-               CL_Z[Grp] = ON;
-            w_byte &= 0x3FFFF;                 /* Remove possible overflow bit */
+            CL_LAZY(Grp, CL_RES, w_byte & 0xFFFF,  /* Result zero ? (X-byte not include) */
+                    ((GR[Rfld][Grp] & 0x0FFFF) +   /* Overflow from byte 0 & 1 ? */
+                     (~Ifld) + 1) & 0x10000);
+            w_byte &= GR_mask;                 /* Remove possible overflow bit */
          }
          /* Store result back in register */
          GR[Rfld][Grp] = w_byte;
@@ -936,19 +1040,13 @@ while (reason == 0) {                          /* Loop until halted */
          Rfld = (opcode0 & 0x06) + 1;          /* Extract odd register nr */
          Nfld = (opcode0 & 0x01);
          Ifld = opcode1;
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
 
          if (Nfld == 0)                        /* Byte 0(H) */
             w_byte = (GR[Rfld][Grp] >> 8) & 0x000FF;
          else                                  /* Byte 1(L) */
             w_byte = GR[Rfld][Grp] & 0x000FF;
-         /* Update C&Z latches */
-         if (w_byte < Ifld)                    /* R < Ifld ? */
-            CL_C[Grp] = ON;
-         if (w_byte == Ifld)                   /* Equal ? */
-            CL_Z[Grp] = ON;
+         /* Update C&Z latches: C if R < Ifld, Z if equal */
+         CL_LAZY(Grp, CL_CMP, w_byte, Ifld);
          break;
 
       case (0xC000):
@@ -959,24 +1057,15 @@ while (reason == 0) {                          /* Loop until halted */
          Rfld = (opcode0 & 0x06) + 1;          /* Extract odd register nr */
          Nfld = (opcode0 & 0x01);
          Ifld =  opcode1;
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
 
          if (Nfld == 0) {                      /* Byte 0(H) */
             GR[Rfld][Grp] = GR[Rfld][Grp] ^ (Ifld << 8);  /* XR */
             /* Update C&Z latches */
-            if ((GR[Rfld][Grp] & 0x0FF00) == 0x00000)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            CL_LAZY(Grp, CL_LOG, GR[Rfld][Grp] & 0x0FF00, 0);
          } else {                              /* Byte 1(L) */
             GR[Rfld][Grp] = GR[Rfld][Grp] ^ (Ifld);   /* XR */
             /* Update C&Z latches */
-            if ((GR[Rfld][Grp] & 0x000FF) == 0x00000)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            CL_LAZY(Grp, CL_LOG, GR[Rfld][Grp] & 0x000FF, 0);
          }
          break;
 
@@ -988,24 +1077,15 @@ while (reason == 0) {                          /* Loop until halted */
          Rfld = (opcode0 & 0x06) + 1;          /* Extract odd register nr */
          Nfld = (opcode0 & 0x01);
          Ifld =  opcode1;
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
 
          if (Nfld == 0) {                      /* Byte 0(H) */
             GR[Rfld][Grp] = GR[Rfld][Grp] | (Ifld << 8);  /* OR */
             /* Update C&Z latches */
-            if ((GR[Rfld][Grp] & 0x0FF00) == 0x00000)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            CL_LAZY(Grp, CL_LOG, GR[Rfld][Grp] & 0x0FF00, 0);
          } else {                              /* Byte 1(L) */
             GR[Rfld][Grp] = GR[Rfld][Grp] | (Ifld);   /* OR */
             /* Update C&Z latches */
-            if ((GR[Rfld][Grp] & 0x000FF) == 0x00000)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            CL_LAZY(Grp, CL_LOG, GR[Rfld][Grp] & 0x000FF, 0);
          }
          break;
 
@@ -1017,26 +1097,17 @@ while (reason == 0) {                          /* Loop until halted */
          Rfld = (opcode0 & 0x06) + 1;          /* Extract odd register nr */
          Nfld = (opcode0 & 0x01);
          Ifld =  opcode1;
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
 
          if (Nfld == 0) {                      /* Byte 0(H) */
-            Ifld = (Ifld << 8) | 0x300FF;
+            Ifld = (Ifld << 8) | (XB_mask | 0xFF);
             GR[Rfld][Grp] = GR[Rfld][Grp] & Ifld;     /* AND */
             /* Update C&Z latches */
-            if ((GR[Rfld][Grp] & 0x0FF00) == 0x00000)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            CL_LAZY(Grp, CL_LOG, GR[Rfld][Grp] & 0x0FF00, 0);
          } else {                              /* Byte 1(L) */
-            Ifld = Ifld | 0x3FF00;
+            Ifld = Ifld | (XB_mask | 0xFF00);
             GR[Rfld][Grp] = GR[Rfld][Grp] & Ifld;    /* AND */
             /* Update C&Z latches */
-            if ((GR[Rfld][Grp] & 0x000FF) == 0x00000)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            CL_LAZY(Grp, CL_LOG, GR[Rfld][Grp] & 0x000FF, 0);
          }
          break;
 
@@ -1048,23 +1119,18 @@ while (reason == 0) {                          /* Loop until halted */
          Rfld = (opcode0 & 0x06) + 1;          /* Extract odd register nr */
          Nfld = (opcode0 & 0x01);
          Ifld =  opcode1;
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
 
          if (Nfld == 0)                        /* Byte 0(H) */
             w_byte = (GR[Rfld][Grp] >> 8) & 0x000FF;
          else                                  /* Byte 1(L) */
             w_byte = GR[Rfld][Grp] & 0x000FF;
          /* Update C&Z latches */
-         if ((w_byte & Ifld) == 0x00)
-            CL_Z[Grp] = ON;
-         else
-            CL_C[Grp] = ON;
+         CL_LAZY(Grp, CL_LOG, w_byte & Ifld, 0);
          break;
+      OP_SW_MISS(0x01)
    }
 
-   switch (opcode & 0x88FF) {
+   switch ((opsw & 0x02) ? (opcode & 0x88FF) : OP_SKIP) {
       case (0x0008):
          /* LCR  R1(N1),R2(N2)  [RR]  */
          /* 01234567 89012345
@@ -1077,6 +1143,7 @@ while (reason == 0) {                          /* Loop until halted */
          /* Reset Z&C latches */
          CL_C[Grp] = OFF;
          CL_Z[Grp] = OFF;
+         CL_op[Grp] = CL_NONE;                 /* Latches set directly */
 
          /* Fetch the selected byte from R2 */
          if (N2fld == 0)                       /* Byte 0(H) */
@@ -1113,9 +1180,6 @@ while (reason == 0) {                          /* Loop until halted */
          R2fld = ((opcode0 & 0x60) >> 4) + 1;  /* Extract reg 2 nr */
          N1fld = ( opcode0 & 0x01);
          N2fld = ((opcode0 & 0x10) >> 4);
-         /* Reset Z&C latches */
-         CL_Z[Grp] = OFF;
-         CL_C[Grp] = OFF;
 
          /* Fetch the selected byte from R2 */
          if (N2fld == 0)                       /* Byte 0(H) */
@@ -1126,18 +1190,16 @@ while (reason == 0) {                          /* Loop until halted */
          /* Perform ADD with the selected byte from R1 */
          if (N1fld == 0) {                     /* Byte 0(H) result */
             w_byte = GR[R1fld][Grp] + (w_byte << 8);
-            if ((w_byte & 0x0FF00) == 0x00)    /* Zero ? */
-               CL_Z[Grp] = ON;
+            CL_a[Grp] = w_byte & 0x0FF00;      /* Zero ? */
          } else {                              /* Byte 0 & 1 result */
             w_byte = GR[R1fld][Grp] + w_byte;
-            if ((w_byte & 0x0FFFF) == 0x00000) /* Zero ? */
-               CL_Z[Grp] = ON;
+            CL_a[Grp] = w_byte & 0x0FFFF;      /* Zero ? */
          }
          /* Byte 0 overflow ? */
-         if ((w_byte & 0x7F0000) > (GR[R1fld][Grp] & 0x7F0000))
-            CL_C[Grp] = ON;
+         CL_b[Grp] = (w_byte & 0x7F0000) > (GR[R1fld][Grp] & 0x7F0000);
+         CL_op[Grp] = CL_RES;
          /* Remove possible X byte overflow bit and save the result */
-         GR[R1fld][Grp] = w_byte & 0x3FFFF;
+         GR[R1fld][Grp] = w_byte & GR_mask;
          break;
 
       case (0x0028):
@@ -1152,6 +1214,7 @@ while (reason == 0) {                          /* Loop until halted */
          /* Reset Z&C latches */
          CL_Z[Grp] = OFF;
          CL_C[Grp] = OFF;
+         CL_op[Grp] = CL_NONE;                 /* Latches set directly */
 
          int32 R2H, R2L;
 
@@ -1166,8 +1229,8 @@ while (reason == 0) {                          /* Loop until halted */
             if (w_byte > (GR[R1fld][Grp] & 0x0FF00))  /* Result < 0 ? */
                CL_C[Grp] = ON;
             R2H = ~(w_byte);
-            R2H = (R2H + 0x00100) & 0x3FF00;   /* 2-complement */
-            GR[R1fld][Grp] = (GR[R1fld][Grp] + R2H) & 0x3FFFF;
+            R2H = (R2H + 0x00100) & (XB_mask | 0xFF00);  /* 2-complement */
+            GR[R1fld][Grp] = (GR[R1fld][Grp] + R2H) & GR_mask;
             if ((GR[R1fld][Grp] & 0x0FF00) == 0x00)   /* Result zero ?*/
                CL_Z[Grp] = ON;
 
@@ -1183,8 +1246,8 @@ while (reason == 0) {                          /* Loop until halted */
             if (w_byte > (GR[R1fld][Grp] & 0x0FFFF))  /* Result < 0 ? */
                CL_C[Grp] = ON;
             R2L = ~(w_byte);
-            R2L = (R2L + 1) & 0x3FFFF;         /* 2-complement */
-            GR[R1fld][Grp] = (GR[R1fld][Grp] + R2L) & 0x3FFFF;
+            R2L = (R2L + 1) & GR_mask;         /* 2-complement */
+            GR[R1fld][Grp] = (GR[R1fld][Grp] + R2L) & GR_mask;
             if ((GR[R1fld][Grp] & 0x0FFFF) == 0x0000) /* Result zero ?*/
                CL_Z[Grp] = ON;
          }
@@ -1199,9 +1262,6 @@ while (reason == 0) {                          /* Loop until halted */
          R2fld = ((opcode0 & 0x60) >> 4) + 1;  /* Extract reg 2 nr */
          N1fld = ( opcode0 & 0x01);
          N2fld = ((opcode0 & 0x10) >> 4);
-         /* Reset Z&C latches */
-         CL_Z[Grp] = OFF;
-         CL_C[Grp] = OFF;
 
          /* Fetch the required byte from R2 */
          if (N2fld == 0)
@@ -1211,17 +1271,10 @@ while (reason == 0) {                          /* Loop until halted */
          w_byte = w_byte & 0x000FF;
 
          /* Perform a compare between the selected regs */
-         if (N1fld == 0) {                     /* Byte 0(H) */
-            if ((( GR[R1fld][Grp] >> 8) & 0x000FF) < w_byte)
-               CL_C[Grp] = ON;
-            if ((( GR[R1fld][Grp] >> 8) & 0x000FF) == w_byte)
-               CL_Z[Grp] = ON;
-         } else {                              /* Byte 1(L) */
-            if (( GR[R1fld][Grp] & 0x000FF) < w_byte)
-               CL_C[Grp] = ON;
-            if (( GR[R1fld][Grp] & 0x000FF) == w_byte)
-               CL_Z[Grp] = ON;
-         }
+         if (N1fld == 0)                       /* Byte 0(H) */
+            CL_LAZY(Grp, CL_CMP, (GR[R1fld][Grp] >> 8) & 0x000FF, w_byte);
+         else                                  /* Byte 1(L) */
+            CL_LAZY(Grp, CL_CMP, GR[R1fld][Grp] & 0x000FF, w_byte);
          break;
 
       case (0x0048):
@@ -1233,9 +1286,6 @@ while (reason == 0) {                          /* Loop until halted */
          R2fld = ((opcode0 & 0x60) >> 4) + 1;  /* Extract odd reg 2 nr */
          N1fld = ( opcode0 & 0x01);
          N2fld = ((opcode0 & 0x10) >> 4);
-         /* Reset Z&C latches */
-         CL_Z[Grp] = OFF;
-         CL_C[Grp] = OFF;
 
          /* Fetch the selected byte from R2 */
          if (N2fld == 0)                       /* Byte 0(H) */
@@ -1246,16 +1296,10 @@ while (reason == 0) {                          /* Loop until halted */
          /* Perform XOR with the selected byte from R1 */
          if (N1fld == 0) {                     /* Byte 0(H) */
             GR[R1fld][Grp] ^= (w_byte << 8);
-            if ((GR[R1fld][Grp] & 0xFF00) == 0x00)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            CL_LAZY(Grp, CL_LOG, GR[R1fld][Grp] & 0xFF00, 0);
          } else {                              /* Byte 1(L) */
             GR[R1fld][Grp] ^= w_byte;
-            if ((GR[R1fld][Grp] & 0x00FF) == 0x00)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            CL_LAZY(Grp, CL_LOG, GR[R1fld][Grp] & 0x00FF, 0);
          }
          break;
 
@@ -1268,9 +1312,6 @@ while (reason == 0) {                          /* Loop until halted */
          N1fld = ( opcode0 & 0x01);
          R2fld = ((opcode0 & 0x60) >> 4) + 1;  /* Extract odd reg 2 nr */
          N2fld = ((opcode0 & 0x10) >> 4);
-         /* Reset Z&C latches */
-         CL_Z[Grp] = OFF;
-         CL_C[Grp] = OFF;
 
          /* Fetch the selected byte from R2 */
          if (N2fld == 0)                       /* Byte 0(H) */
@@ -1281,16 +1322,10 @@ while (reason == 0) {                          /* Loop until halted */
          /* Perform OR with the selected byte from R1 */
          if (N1fld == 0) {                     /* Byte 0(H) */
             GR[R1fld][Grp] |= (w_byte << 8);
-            if ((GR[R1fld][Grp] & 0x0FF00) == 0x00)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            CL_LAZY(Grp, CL_LOG, GR[R1fld][Grp] & 0x0FF00, 0);
          } else {                              /* Byte 1(L) */
             GR[R1fld][Grp] |= w_byte;
-            if ((GR[R1fld][Grp] & 0x000FF) == 0x00)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            CL_LAZY(Grp, CL_LOG, GR[R1fld][Grp] & 0x000FF, 0);
          }
          break;
 
@@ -1303,9 +1338,6 @@ while (reason == 0) {                          /* Loop until halted */
          R2fld = ((opcode0 & 0x60) >> 4) + 1;  /* Extract odd reg 2 nr */
          N1fld = ( opcode0 & 0x01);
          N2fld = ((opcode0 & 0x10) >> 4);
-         /* Reset Z&C latches */
-         CL_Z[Grp] = OFF;
-         CL_C[Grp] = OFF;
 
          /* Fetch the selected byte from R2 */
          if (N2fld == 0)                       /* Byte 0(H) */
@@ -1315,17 +1347,11 @@ while (reason == 0) {                          /* Loop until halted */
 
          /* Perform AND with the selected byte from R1 */
          if (N1fld == 0) {
-            GR[R1fld][Grp] &= ((w_byte << 8) | 0x300FF);
-            if ((GR[R1fld][Grp] & 0x0FF00) == 0x00)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            GR[R1fld][Grp] &= ((w_byte << 8) | (XB_mask | 0xFF));
+            CL_LAZY(Grp, CL_LOG, GR[R1fld][Grp] & 0x0FF00, 0);
          } else {
-            GR[R1fld][Grp] &= (w_byte | 0x3FF00);
-            if ((GR[R1fld][Grp] & 0x000FF) == 0x00)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            GR[R1fld][Grp] &= (w_byte | (XB_mask | 0xFF00));
+            CL_LAZY(Grp, CL_LOG, GR[R1fld][Grp] & 0x000FF, 0);
          }
          break;
 
@@ -1341,6 +1367,7 @@ while (reason == 0) {                          /* Loop until halted */
          /* Reset Z&C latches */
          CL_Z[Grp] = OFF;
          CL_C[Grp] = OFF;
+         CL_op[Grp] = CL_NONE;                 /* Latches set directly */
 
          /* Fetch the selected byte from R2 */
          if (N2fld == 0)                       /* Byte 0(H) */
@@ -1376,9 +1403,9 @@ while (reason == 0) {                          /* Loop until halted */
          w_byte = GetMem(addr);
          GR[Bfld][Grp] = GR[Bfld][Grp] + 1;
          if (Nfld == 0) {                      /* Byte 0(H) */
-            GR[Rfld][Grp] = (GR[Rfld][Grp] & 0x300FF) | (w_byte << 8);
+            GR[Rfld][Grp] = (GR[Rfld][Grp] & (XB_mask | 0xFF)) | (w_byte << 8);
          } else {                              /* Byte 1(L) */
-            GR[Rfld][Grp] = (GR[Rfld][Grp] & 0x3FF00) | w_byte;
+            GR[Rfld][Grp] = (GR[Rfld][Grp] & (XB_mask | 0xFF00)) | w_byte;
          }
          break;
 
@@ -1399,9 +1426,10 @@ while (reason == 0) {                          /* Loop until halted */
             w_byte = GR[Rfld][Grp] & 0x000FF;  /* Byte 1(L) */
          PutMem(addr, w_byte);
          break;
+      OP_SW_MISS(0x02)
    }
 
-   switch (opcode & 0x8880) {
+   switch ((opsw & 0x04) ? (opcode & 0x8880) : OP_SKIP) {
       case (0x0800):
          /* IC   R(N),D(B)      [RS]  */
          /* 01234567 89012345
@@ -1419,10 +1447,11 @@ while (reason == 0) {                          /* Loop until halted */
          w_byte = GetMem(addr);
 
          if (Nfld == 0)                        /* Byte 0(H) */
-            GR[Rfld][Grp] = (GR[Rfld][Grp] & 0x300FF) | (w_byte << 8);
+            GR[Rfld][Grp] = (GR[Rfld][Grp] & (XB_mask | 0xFF)) | (w_byte << 8);
          else                                  /* Byte 1(L) */
-            GR[Rfld][Grp] = (GR[Rfld][Grp] & 0x3FF00) | w_byte;
+            GR[Rfld][Grp] = (GR[Rfld][Grp] & (XB_mask | 0xFF00)) | w_byte;
 
+         CL_op[Grp] = CL_NONE;                 /* Latches set directly */
          /* Test the selected byte (w_byte) */
          if (w_byte == 0x00)
             CL_Z[Grp] = ON;
@@ -1461,9 +1490,10 @@ while (reason == 0) {                          /* Loop until halted */
             w_byte = (GR[Rfld][Grp] & 0x000FF);
          PutMem(addr, w_byte);
          break;
+      OP_SW_MISS(0x04)
    }
 
-   switch (opcode & 0x8881) {
+   switch ((opsw & 0x08) ? (opcode & 0x8881) : OP_SKIP) {
       case (0x0001):
          /* LH   R,D(B)         [RS]  */
          /* 01234567 89012345
@@ -1477,7 +1507,7 @@ while (reason == 0) {                          /* Loop until halted */
             addr = 0x00700 + Dfld;             /* See PoO 4-10 */
          else
             addr = (GR[Bfld][Grp] + Dfld);
-         addr &= 0x3FFFE;                      /* Force HW boundary */
+         addr &= GR_mask & ~0x01;               /* Force HW boundary */
 
          w_byte = GetMem(addr) << 8;
          addr++;
@@ -1487,13 +1517,7 @@ while (reason == 0) {                          /* Loop until halted */
          if (Rfld == 0) break;                 /* New IAR ! */
 
          /* Update C&Z latches */
-         if (w_byte == 0x0000) {
-            CL_Z[Grp] = ON;
-            CL_C[Grp] = OFF;
-         } else {
-            CL_Z[Grp] = OFF;
-            CL_C[Grp] = ON;
-         }
+         CL_LAZY(Grp, CL_LOG, w_byte, 0);
          break;
 
       case (0x0081):
@@ -1509,7 +1533,7 @@ while (reason == 0) {                          /* Loop until halted */
             addr = 0x00700 + Dfld;             /* See PoO 4-4 */
          else
             addr = (GR[Bfld][Grp] + Dfld);
-         addr &= 0x3FFFE;                      /* Force HW boundary */
+         addr &= GR_mask & ~0x01;               /* Force HW boundary */
 
          if (Rfld > 0) {
             PutMem(addr, (GR[Rfld][Grp] >> 8) & 0x000FF);
@@ -1520,9 +1544,10 @@ while (reason == 0) {                          /* Loop until halted */
             PutMem(addr+1, 0x00);
          }
          break;
+      OP_SW_MISS(0x08)
    }
 
-   switch (opcode & 0x8883) {
+   switch ((opsw & 0x10) ? (opcode & 0x8883) : OP_SKIP) {
       case (0x0002):
          /* L    R,D(B)         [RS]  */
          /* 01234567 89012345
@@ -1536,22 +1561,16 @@ while (reason == 0) {                          /* Loop until halted */
             addr = 0x00780 + Dfld;             /* See PoO 4-10 */
          else
             addr = (GR[Bfld][Grp] + Dfld);
-         addr &= 0x3FFFE;                      /* Force HW boundary */
+         addr &= GR_mask & ~0x01;               /* Force HW boundary */
 
-         w_byte = (GetMem(addr+1) & 0x03) << 16; /* Load X-byte */
+         w_byte = (GetMem(addr+1) & (XB_mask >> 16)) << 16; /* Load X-byte */
          w_byte |= GetMem(addr+2) << 8;        /* Byte 0(H) */
          w_byte |= GetMem(addr+3);             /* Byte 1(L) */
          GR[Rfld][Grp] = w_byte;
          if (Rfld == 0) break;                 /* New IAR ! */
 
          /* Update C&Z latches */
-         if (w_byte == 0x00000) {              /* Test includes X-byte */
-            CL_Z[Grp] = ON;
-            CL_C[Grp] = OFF;
-         } else {
-            CL_Z[Grp] = OFF;
-            CL_C[Grp] = ON;
-         }
+         CL_LAZY(Grp, CL_LOG, w_byte, 0);   /* Test includes X-byte */
          break;
 
       case (0x0082):
@@ -1567,24 +1586,25 @@ while (reason == 0) {                          /* Loop until halted */
             addr = 0x00780 + Dfld;             /* See PoO 4-12 */
          else
             addr = (GR[Bfld][Grp] + Dfld);
-         addr &= 0x3FFFE;                      /* Force HW boundary */
+         addr &= GR_mask & ~0x01;               /* Force HW boundary */
 
          if (Rfld > 0) {
             PutMem(addr+3,  GR[Rfld][Grp] & 0xFF);
             PutMem(addr+2, (GR[Rfld][Grp] >> 8) & 0xFF);
-            w_byte = GetMem(addr+1) & 0xFC;    /* Keep the high 6 bits */
-            PutMem(addr+1, w_byte | ((GR[Rfld][Grp] >> 16) & 0x03));
+            w_byte = GetMem(addr+1) & ~(XB_mask >> 16);  /* Keep the bits above the X-byte */
+            PutMem(addr+1, w_byte | ((GR[Rfld][Grp] >> 16) & (XB_mask >> 16)));
          } else {
             PutMem(addr+3, 0x00);              /* Clear mem locations */
             PutMem(addr+2, 0x00);
-            w_byte = GetMem(addr+1) & 0xFC;    /* Keep the high 6 bits */
+            w_byte = GetMem(addr+1) & ~(XB_mask >> 16);  /* Keep the bits above the X-byte */
             PutMem(addr+1, w_byte);            /* Clear X-byte bits */
          }
          // NOTE: special condition ST inst at loc 0x0010 to be implemented !!
          break;
+      OP_SW_MISS(0x10)
    }
 
-   switch (opcode & 0x88FF) {
+   switch ((opsw & 0x20) ? (opcode & 0x88FF) : OP_SKIP) {
       case (0x0080):
          /* LHR  R1,R2          [RR]  */
          /* 01234567 89012345
@@ -1599,13 +1619,7 @@ while (reason == 0) {                          /* Loop until halted */
          if (R1fld == 0) break;
 
          /* Update C&Z latches */
-         if (GR[R1fld][Grp] == 0x0000) {
-            CL_Z[Grp] = ON;
-            CL_C[Grp] = OFF;
-         } else {
-            CL_Z[Grp] = OFF;
-            CL_C[Grp] = ON;
-         }
+         CL_LAZY(Grp, CL_LOG, GR[R1fld][Grp], 0);
          break;
 
       case (0x0090):
@@ -1617,18 +1631,12 @@ while (reason == 0) {                          /* Loop until halted */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
 
          w_byte = (GR[R1fld][Grp] & 0xFFFF) + (GR[R2fld][Grp] & 0xFFFF);
-         GR[R1fld][Grp] = (GR[R1fld][Grp] & 0x30000) | (w_byte & 0xFFFF);
+         GR[R1fld][Grp] = (GR[R1fld][Grp] & XB_mask) | (w_byte & 0xFFFF);
          /* If R1 = Register 0, a branch to newly formed address occurs */
          if (R1fld == 0) break;
 
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
-         /* Update C&Z latches */
-         if (w_byte & 0x10000)                 /* Overflow ? */
-            CL_C[Grp] = ON;
-         if ((w_byte & 0xFFFF) == 0x0000)      /* Result 0 ? */
-            CL_Z[Grp] = ON;
+         /* Update C&Z latches: C on overflow, Z if result 0 */
+         CL_LAZY(Grp, CL_RES, w_byte & 0xFFFF, w_byte & 0x10000);
          break;
 
       case (0x00A0):
@@ -1644,14 +1652,8 @@ while (reason == 0) {                          /* Loop until halted */
          /* If R1 = Register 0, a branch to newly formed address occurs */
          if (R1fld == 0) break;
 
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
-         /* Update C&Z latches */
-         if (w_byte & 0x10000)                 /* Result < 0 ? */
-            CL_C[Grp] = ON;
-         if (GR[R1fld][Grp] == 0x0000)         /* Result == 0 ? */
-            CL_Z[Grp] = ON;
+         /* Update C&Z latches: C if result < 0, Z if result == 0 */
+         CL_LAZY(Grp, CL_RES, GR[R1fld][Grp], w_byte & 0x10000);
          break;
 
       case (0x00B0):
@@ -1661,17 +1663,9 @@ while (reason == 0) {                          /* Loop until halted */
          Grp = RegGrp(lvl);
          R2fld = ((opcode0 & 0x70) >> 4);      /* Extract register 2 */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
 
          /* Test if R1 is < R2 */
-         if ((GR[R1fld][Grp] & 0xFFFF) ==      /* Compare for equal */
-             (GR[R2fld][Grp] & 0xFFFF))
-            CL_Z[Grp] = ON;
-         if ((GR[R1fld][Grp] & 0xFFFF) <       /* Compare for less */
-             (GR[R2fld][Grp] & 0xFFFF))
-            CL_C[Grp] = ON;
+         CL_LAZY(Grp, CL_CMP, GR[R1fld][Grp] & 0xFFFF, GR[R2fld][Grp] & 0xFFFF);
          break;
 
       case (0x00C0):
@@ -1688,13 +1682,7 @@ while (reason == 0) {                          /* Loop until halted */
          if (R1fld == 0) break;
 
          /* Update C&Z latches */
-         if (w_byte == 0x0000) {
-            CL_Z[Grp] = ON;
-            CL_C[Grp] = OFF;
-         } else {
-            CL_Z[Grp] = OFF;
-            CL_C[Grp] = ON;
-         }
+         CL_LAZY(Grp, CL_LOG, w_byte, 0);
          break;
 
       case (0x00D0):
@@ -1706,18 +1694,12 @@ while (reason == 0) {                          /* Loop until halted */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
 
          w_byte = (GR[R1fld][Grp] & 0x0FFFF) | (GR[R2fld][Grp] & 0x0FFFF);
-         GR[R1fld][Grp] = (GR[R1fld][Grp] & 0x30000) | w_byte;  /* OHR */
+         GR[R1fld][Grp] = (GR[R1fld][Grp] & XB_mask) | w_byte;  /* OHR */
          /* If R1 = Register 0, a branch to newly formed address occurs */
          if (R1fld == 0) break;
 
          /* Update C&Z latches */
-         if ((GR[R1fld][Grp] & 0xFFFF) == 0x0000) {
-            CL_Z[Grp] = ON;
-            CL_C[Grp] = OFF;
-         } else {
-            CL_Z[Grp] = OFF;
-            CL_C[Grp] = ON;
-         }
+         CL_LAZY(Grp, CL_LOG, GR[R1fld][Grp] & 0xFFFF, 0);
          break;
 
       case (0x00E0):
@@ -1729,18 +1711,12 @@ while (reason == 0) {                          /* Loop until halted */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
 
          w_byte = (GR[R1fld][Grp] & 0x0FFFF) & (GR[R2fld][Grp] & 0x0FFFF);
-         GR[R1fld][Grp] = (GR[R1fld][Grp] & 0x30000) | w_byte;  /* NHR */
+         GR[R1fld][Grp] = (GR[R1fld][Grp] & XB_mask) | w_byte;  /* NHR */
          /* If R1 = Register 0, a branch to newly formed address occurs */
          if (R1fld == 0) break;
 
          /* Update C&Z latches */
-         if (w_byte == 0x0000) {
-            CL_Z[Grp] = ON;
-            CL_C[Grp] = OFF;
-         } else {
-            CL_Z[Grp] = OFF;
-            CL_C[Grp] = ON;
-         }
+         CL_LAZY(Grp, CL_LOG, w_byte, 0);
          break;
 
       case (0x00F0):
@@ -1758,6 +1734,7 @@ while (reason == 0) {                          /* Loop until halted */
          /* Reset C&Z latches */
          CL_C[Grp] = OFF;
          CL_Z[Grp] = OFF;
+         CL_op[Grp] = CL_NONE;                 /* Latches set directly */
          /* Update C&Z latches */
          /* If a 1 bit will be shifted out, set C latch */
          if (w_byte & 0x00001)
@@ -1779,13 +1756,7 @@ while (reason == 0) {                          /* Loop until halted */
          if (R1fld == 0) break;
 
          /* Update C&Z latches */
-         if (GR[R1fld][Grp] == 0x00000) {
-            CL_Z[Grp] = ON;
-            CL_C[Grp] = OFF;
-         } else {
-            CL_Z[Grp] = OFF;
-            CL_C[Grp] = ON;
-         }
+         CL_LAZY(Grp, CL_LOG, GR[R1fld][Grp], 0);
          break;
 
       case (0x0098):
@@ -1797,18 +1768,12 @@ while (reason == 0) {                          /* Loop until halted */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
 
          w_byte = GR[R1fld][Grp] + GR[R2fld][Grp];
-         GR[R1fld][Grp] = w_byte & 0x3FFFF;    /* Remove possible overflow bit */
+         GR[R1fld][Grp] = w_byte & GR_mask;    /* Remove possible overflow bit */
          /* If R1 = Register 0, a branch to newly formed address occurs */
          if (R1fld == 0) break;
 
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
-         /* Update C&Z latches */
-         if (w_byte & 0x40000)                 /* Bit 21 overflow ? */
-            CL_C[Grp] = ON;
-         if (GR[R1fld][Grp] == 0x00000)
-            CL_Z[Grp] = ON;
+         /* Update C&Z latches: C on bit 21 overflow, Z if result 0 */
+         CL_LAZY(Grp, CL_RES, GR[R1fld][Grp], w_byte & (GR_mask + 1));
          break;
 
       case (0x00A8):
@@ -1820,18 +1785,12 @@ while (reason == 0) {                          /* Loop until halted */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
 
          w_byte = GR[R1fld][Grp] + ~(GR[R2fld][Grp]) + 1;   /* SR */
-         GR[R1fld][Grp] = w_byte & 0x3FFFF;    /* Remove possible overflow bit */
+         GR[R1fld][Grp] = w_byte & GR_mask;    /* Remove possible overflow bit */
          /* If R1 = Register 0, a branch to newly formed address occurs */
          if (R1fld == 0) break;
 
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
-         /* Update C&Z latches */
-         if (w_byte & 0x40000)                 /* X-byte included */
-            CL_C[Grp] = ON;
-         if (GR[R1fld][Grp] == 0x00000)
-            CL_Z[Grp] = ON;
+         /* Update C&Z latches (X-byte included) */
+         CL_LAZY(Grp, CL_RES, GR[R1fld][Grp], w_byte & (GR_mask + 1));
          break;
 
       case (0x00B8):
@@ -1841,19 +1800,9 @@ while (reason == 0) {                          /* Loop until halted */
          Grp = RegGrp(lvl);
          R2fld = ((opcode0 & 0x70) >> 4);      /* Extract register 2 */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
 
          /* Test if R1 is < R2 */                           /* CR */
-         if (GR[R1fld][Grp] == GR[R2fld][Grp]) /* Compare for equal */
-            CL_Z[Grp] = ON;
-         if (GR[R1fld][Grp] < GR[R2fld][Grp])  /* Compare for less */
-            CL_C[Grp] = ON;
-         break;
-
-         if (GR[R1fld][Grp] < GR[R2fld][Grp])  /* Compare for less */
-            CL_C[Grp] = ON;
+         CL_LAZY(Grp, CL_CMP, GR[R1fld][Grp], GR[R2fld][Grp]);
          break;
 
       case (0x00C8):
@@ -1869,13 +1818,7 @@ while (reason == 0) {                          /* Loop until halted */
          if (R1fld == 0) break;
 
          /* Update C&Z latches */
-         if (GR[R1fld][Grp] == 0x00000) {      /* Result zero ? */
-            CL_Z[Grp] = ON;
-            CL_C[Grp] = OFF;
-         } else {
-            CL_Z[Grp] = OFF;
-            CL_C[Grp] = ON;
-         }
+         CL_LAZY(Grp, CL_LOG, GR[R1fld][Grp], 0);   /* Result zero ? */
          break;
 
       case (0x00D8):
@@ -1891,13 +1834,7 @@ while (reason == 0) {                          /* Loop until halted */
          if (R1fld == 0) break;
 
          /* Update C&Z latches */
-         if (GR[R1fld][Grp] == 0x00000) {      /* Result zero ? */
-            CL_Z[Grp] = ON;
-            CL_C[Grp] = OFF;
-         } else {
-            CL_Z[Grp] = OFF;
-            CL_C[Grp] = ON;
-         }
+         CL_LAZY(Grp, CL_LOG, GR[R1fld][Grp], 0);   /* Result zero ? */
          break;
 
       case (0x00E8):
@@ -1913,13 +1850,7 @@ while (reason == 0) {                          /* Loop until halted */
          if (R1fld == 0) break;
 
          /* Update C&Z latches */
-         if (GR[R1fld][Grp] == 0x00000) {      /* Result zero ? */
-            CL_Z[Grp] = ON;
-            CL_C[Grp] = OFF;
-         } else {
-            CL_Z[Grp] = OFF;
-            CL_C[Grp] = ON;
-         }
+         CL_LAZY(Grp, CL_LOG, GR[R1fld][Grp], 0);   /* Result zero ? */
          break;
 
       case (0x00F8):
@@ -1938,6 +1869,7 @@ while (reason == 0) {                          /* Loop until halted */
          /* Reset C&Z latches */
          CL_C[Grp] = OFF;
          CL_Z[Grp] = OFF;
+         CL_op[Grp] = CL_NONE;                 /* Latches set directly */
          /* Update C&Z latches */
          /* If a 1 bit will be shifted out, set C latch */
          if (w_byte & 0x00001)
@@ -1960,9 +1892,10 @@ while (reason == 0) {                          /* Loop until halted */
          if (R2fld > 0)
             GR[0][Grp] = w_byte;               /* New IAR */
          break;
+      OP_SW_MISS(0x20)
    }
 
-   switch (opcode & 0x880F) {
+   switch ((opsw & 0x40) ? (opcode & 0x880F) : OP_SKIP) {
       case (0x000C):
          /* IN   R,E            [RE]  */
          /* 01234567 89012345
@@ -2029,6 +1962,7 @@ while (reason == 0) {                          /* Loop until halted */
             Eregs_Inp[0x79]  = 0x0000;              // Reset all bits in reg 0x79
             Eregs_Inp[0x79] |= 0x0008;              // Fet storage installed
             Eregs_Inp[0x79] |= 0x0001;              // CE IPL escape jumper NOT installed
+            CL_eval(3);                             // L5 latches needed now
             if (CL_C[3] == ON) Eregs_Inp[0x79] |= 0x0200;  // L5 C & Z flags
             if (CL_Z[3] == ON) Eregs_Inp[0x79] |= 0x0100;
 
@@ -2248,6 +2182,8 @@ while (reason == 0) {                          /* Loop until halted */
                if (w_byte & 0x8000)  {         // Reset IPL L1 ?
                   Eregs_Inp[0x53] &= ~0x0200;  // Reset not-initialized flag
                   ipl_req_L1 = OFF;
+                  if (hle_on == ON)            // NCP is in storage now
+                     hle_scan();
                }
                if (w_byte & 0x0004)            // Reset all L1 prgm checks
                   IO_L5_chk = OP_reg_chk = adr_ex_chk = OFF;
@@ -2277,6 +2213,7 @@ while (reason == 0) {                          /* Loop until halted */
             }
             if (Efld == 0x79) {                // Utility Control
                if (!(Eregs_Out[Efld] & 0x0400)) { // Inhibit bit PL5 C&Z flag off ?
+                  CL_op[3] = CL_NONE;             // Latches set directly, drop pending evaluation
                   if (Eregs_Out[Efld] & 0x0200)   // Prog L5 C flag
                      CL_C[3] = ON;
                   else
@@ -2339,9 +2276,10 @@ while (reason == 0) {                          /* Loop until halted */
             }
          }
          break;
+      OP_SW_MISS(0x40)
    }
 
-   switch (opcode & 0xF8F0) {
+   switch ((opsw & 0x80) ? (opcode & 0xF8F0) : OP_SKIP) {
       case (0xB800):
          /* BAL  R,A            [RA]  */
          /* 01234567 89012345 ... 901
@@ -2351,9 +2289,9 @@ while (reason == 0) {                          /* Loop until halted */
                                                /* Get branch addr from memory */
          Afld = (opcode1 & 0x03) << 16;        /* Xbyte EA18 */
          Afld = Afld | (GetMem(PC) << 8);      /* Read 3rd & 4th byte */
-         PC = (PC + 1) & AMASK;
+         PC = (PC + 1) & GR_mask;
          Afld = Afld |  GetMem(PC);
-         PC = (PC + 1) & AMASK;
+         PC = (PC + 1) & GR_mask;
 
          if (Rfld > 0)                         /* No link addr if R=0 */
             GR[Rfld][Grp] = PC;                /* Store link address */
@@ -2369,13 +2307,22 @@ while (reason == 0) {                          /* Loop until halted */
                                                /* Get load address from memory */
          Afld = (opcode1 & 0x03) << 16;        /* Xbyte EA18 */
          Afld = Afld | (GetMem(PC) << 8);      /* Read 3rd & 4th byte */
-         PC = (PC + 1) & AMASK;
+         PC = (PC + 1) & GR_mask;
          Afld = Afld |  GetMem(PC);
-         PC = (PC + 1) & AMASK;
+         PC = (PC + 1) & GR_mask;
          GR[0][Grp] = PC;                      /* Update IAR */
          GR[Rfld][Grp] = Afld;                 /* Load R with 16 bit address */
          break;
+      OP_SW_MISS(0x80)
+   }
+
+#ifdef OPSW_CHECK
+   if (opsw_hit != OP_sw[opcode]) {            /* A case missing from sw_case[] or vice versa */
+      printf("CPU: Opcode %04X has a case in switches %02X, OP_sw[] says %02X \n\r",
+             opcode, opsw_hit, OP_sw[opcode]);
+      reason = STOP_OPSW;
    }
+#endif
 
    if (opcode == 0xB840) {
       /* EXIT                EXIT  */
@@ -2394,6 +2341,8 @@ while (reason == 0) {                          /* Loop until halted */
 //###################### END OF SIMULATOR WHILE LOOP ######################
 
 PC = saved_PC;
+for (i = 0; i < 4; i++)                        /* Latches visible to SCP */
+   CL_eval(i);
 /* Simulation halted */
 return (reason);
 }
@@ -2412,6 +2361,64 @@ int32 RegGrp(int32 level)
       return(level - 2);     // Lvl 5 => Reg Grp 3
 }
 
+/*** Set the C & Z latches of a register group from the pending evaluation ***/
+
+void CL_eval(int32 grp)
+{
+   switch (CL_op[grp]) {
+      case CL_LOG:
+         CL_Z[grp] = (CL_a[grp] == 0) ? ON : OFF;
+         CL_C[grp] = (CL_a[grp] == 0) ? OFF : ON;
+         break;
+      case CL_CMP:
+         CL_C[grp] = (CL_a[grp] <  CL_b[grp]) ? ON : OFF;
+         CL_Z[grp] = (CL_a[grp] == CL_b[grp]) ? ON : OFF;
+         break;
+      case CL_RES:
+         CL_Z[grp] = (CL_a[grp] == 0) ? ON : OFF;
+         CL_C[grp] = (CL_b[grp] != 0) ? ON : OFF;
+         break;
+   }
+   CL_op[grp] = CL_NONE;
+}
+
+/*** Fill the decode table: which switches in sim_instr have a case for an opcode ***/
+/*** The rows below must follow the case labels of those switches.             ***/
+/*** A build with -DOPSW_CHECK (make DEBUG=1) decodes every opcode in all      ***/
+/*** switches and stops with STOP_OPSW where they disagree with this table.    ***/
+
+void OP_sw_init(void)
+{
+   static const struct {
+      uint8  sw;                               /* Switch bit in OP_sw[] */
+      uint16 mask;                             /* Opcode mask of that switch */
+      uint16 val[8];                           /* Its case values (0 = unused) */
+   } sw_case[] = {
+      { 0x01, 0xF800, { 0xA800, 0x9800, 0x8800, 0xB800, 0xC800, 0xD800, 0xE800, 0xF800 } },
+      { 0x01, 0xF800, { 0x8000, 0x9000, 0xA000, 0xB000, 0xC000, 0xD000, 0xE000, 0xF000 } },
+      { 0x02, 0x88FF, { 0x0008, 0x0018, 0x0028, 0x0038, 0x0048, 0x0058, 0x0068, 0x0078 } },
+      { 0x02, 0x88FF, { 0x0010, 0x0030 } },
+      { 0x04, 0x8880, { 0x0800, 0x0880 } },
+      { 0x08, 0x8881, { 0x0001, 0x0081 } },
+      { 0x10, 0x8883, { 0x0002, 0x0082 } },
+      { 0x20, 0x88FF, { 0x0080, 0x0090, 0x00A0, 0x00B0, 0x00C0, 0x00D0, 0x00E0, 0x00F0 } },
+      { 0x20, 0x88FF, { 0x0088, 0x0098, 0x00A8, 0x00B8, 0x00C8, 0x00D8, 0x00E8, 0x00F8 } },
+      { 0x20, 0x88FF, { 0x0040 } },
+      { 0x40, 0x880F, { 0x000C, 0x0004 } },
+      { 0x80, 0xF8F0, { 0xB800, 0xB820 } },
+   };
+   int32 op, n, v;
+
+   for (op = 0; op < 65536; op++) {
+      OP_sw[op] = 0;
+      for (n = 0; n < sizeof(sw_case) / sizeof(sw_case[0]); n++)
+         for (v = 0; v < 8; v++)
+            if ((sw_case[n].val[v] != 0) && ((op & sw_case[n].mask) == sw_case[n].val[v]))
+               OP_sw[op] |= sw_case[n].sw;
+   }
+   OP_sw_built = ON;
+}
+
 /*** Fetch a byte from memory ***/
 
 int32 GetMem(int32 addr)
@@ -2464,6 +2471,603 @@ t_stat cpu_set_size (UNIT *uptr, int32 val, char *cptr, void *desc) {
       return SCPE_OK;
    MEMSIZE = val;
    for (int i = MEMSIZE; i < MAXMEMSIZE; i++) M[i] = 0x00;
+   if (M_shmhdr != NULL)
+      M_shmhdr->memsize = MEMSIZE;
+   if (MEMSIZE > MAXMEM18)                   /* CA control words hold 18 bit addresses */
+      printf("CPU: Channel adapter buffers must reside below 256K \n\r");
+   return SCPE_OK;
+}
+
+/*** Storage image ***/
+// SET CPU SAVEIMAGE=file writes storage 0...MEMSIZE-1 as a raw image.
+// SET CPU MAPIMAGE=file maps such an image over M with MAP_PRIVATE, so
+// several 3705's started from the same image share the pages NCP only
+// reads. A page gets its own private copy the first time it is written.
+
+t_stat cpu_save_image (UNIT *uptr, int32 val, char *cptr, void *desc) {
+   FILE *fp;
+
+   if ((cptr == NULL) || (*cptr == 0))
+      return SCPE_ARG;
+   if ((fp = fopen(cptr, "wb")) == NULL) {
+      printf("CPU: Cannot create storage image %s \n\r", cptr);
+      return SCPE_OPENERR;
+   }
+   if (fwrite(M, 1, MEMSIZE, fp) != MEMSIZE) {
+      printf("CPU: Write error on storage image %s \n\r", cptr);
+      fclose(fp);
+      return SCPE_IOERR;
+   }
+   fclose(fp);
+   printf("CPU: %dK storage saved to %s \n\r", MEMSIZE / 1024, cptr);
+   return SCPE_OK;
+}
+
+t_stat cpu_set_image (UNIT *uptr, int32 val, char *cptr, void *desc) {
+   struct stat sb;
+   MTAB *mptr;
+   int fd;
+
+   if ((cptr == NULL) || (*cptr == 0))
+      return SCPE_ARG;
+   if (M_shmname[0] != 0) {
+      printf("CPU: Storage is in shared segment %s, SET CPU NOSHMEM first \n\r", M_shmname);
+      return SCPE_ARG;
+   }
+   if ((fd = open(cptr, O_RDONLY)) < 0) {
+      printf("CPU: Cannot open storage image %s \n\r", cptr);
+      return SCPE_OPENERR;
+   }
+   if (fstat(fd, &sb) < 0) {
+      printf("CPU: Cannot get size of storage image %s: %s \n\r", cptr, strerror(errno));
+      close(fd);
+      return SCPE_IOERR;
+   }
+   for (mptr = cpu_mod; mptr->mask != 0; mptr++)  // Only the storage sizes SET CPU offers
+      if ((mptr->mask == UNIT_MSIZE) && (mptr->match == sb.st_size))
+         break;
+   if (mptr->mask == 0) {
+      printf("CPU: Storage image %s has invalid size %ld \n\r", cptr, (long) sb.st_size);
+      close(fd);
+      return SCPE_ARG;
+   }
+   if (io_quiesce() < 0) {                     // CA, scanner and LIB must not write meanwhile
+      printf("CPU: I/O threads busy, storage image %s not mapped \n\r", cptr);
+      close(fd);
+      return SCPE_IOERR;
+   }
+   // Replace the pages of M in place: every pointer to M stays valid.
+   if (mmap(M, sb.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+      printf("CPU: Cannot map storage image %s \n\r", cptr);
+      io_resume();
+      close(fd);
+      return SCPE_IOERR;
+   }
+   io_resume();
+   close(fd);                                  // Mapping keeps the file referenced
+   for (int i = sb.st_size; i < MAXMEMSIZE; i++) M[i] = 0x00;
+   cpu_set_size(&cpu_unit, sb.st_size, NULL, NULL);
+   strncpy(M_image, cptr, sizeof(M_image) - 1);
+   printf("CPU: %dK storage mapped from %s \n\r", MEMSIZE / 1024, cptr);
+   return SCPE_OK;
+}
+
+t_stat cpu_show_image (FILE *st, UNIT *uptr, int32 val, void *desc) {
+   if (M_image[0] == 0)
+      fprintf(st, "no storage image");
+   else
+      fprintf(st, "storage image=%s", M_image);
+   return SCPE_OK;
+}
+
+/*** Live view of storage and registers ***/
+// SET CPU SHMEM=name creates POSIX shared memory segment /name laid out
+// as described in i3705_defs.h and maps its pages over GR, Eregs_Inp,
+// Eregs_Out and M with MAP_SHARED. The current contents are copied in
+// first. A dump formatter or monitor can then map the segment read-only
+// and follow the NCP while it runs. SET CPU NOSHMEM moves the areas
+// back to private memory and removes the segment.
+
+// Map area bit over the segment at off (fd >= 0) or back over private memory (fd < 0).
+// The CA, scanner and LIB threads must be held (io_quiesce) while this runs.
+static int shm_swap (int fd, off_t off, void *addr, size_t len, int8 bit) {
+   static uint8 save[MAXMEMSIZE];
+
+   memcpy(save, addr, len);                    // MAP_FIXED discards the old contents
+   if (fd >= 0)
+      addr = mmap(addr, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, off);
+   else
+      addr = mmap(addr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+   if (addr == MAP_FAILED)
+      return -1;
+   memcpy(addr, save, len);
+   if (fd >= 0)
+      M_shmmask |= bit;
+   else
+      M_shmmask &= ~bit;
+   return 0;
+}
+
+// Move the shared areas back to private memory. Returns -1 if any of them stays shared.
+static int shm_back (void) {
+   if (M_shmmask & 0x01) shm_swap(-1, 0, GR, SHM_PAGE, 0x01);
+   if (M_shmmask & 0x02) shm_swap(-1, 0, Eregs_Inp, SHM_PAGE, 0x02);
+   if (M_shmmask & 0x04) shm_swap(-1, 0, Eregs_Out, SHM_PAGE, 0x04);
+   if (M_shmmask & 0x08) shm_swap(-1, 0, M, MAXMEMSIZE, 0x08);
+   return (M_shmmask == 0) ? 0 : -1;
+}
+
+t_stat cpu_set_shm (UNIT *uptr, int32 val, char *cptr, void *desc) {
+   char name[258];
+   int fd;
+
+   if ((cptr == NULL) || (*cptr == 0))
+      return SCPE_ARG;
+   if (M_shmname[0] != 0) {
+      printf("CPU: Already in shared segment %s \n\r", M_shmname);
+      return SCPE_ARG;
+   }
+   snprintf(name, sizeof(name), "%s%s", (*cptr == '/') ? "" : "/", cptr);
+   if ((fd = shm_open(name, O_RDWR | O_CREAT, 0644)) < 0) {
+      printf("CPU: Cannot create shared segment %s: %s \n\r", name, strerror(errno));
+      return SCPE_OPENERR;
+   }
+   if (ftruncate(fd, SHM_SIZE) < 0) {
+      printf("CPU: Cannot size shared segment %s: %s \n\r", name, strerror(errno));
+      close(fd);
+      shm_unlink(name);
+      return SCPE_IOERR;
+   }
+   M_shmhdr = mmap(NULL, SHM_PAGE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if (M_shmhdr == MAP_FAILED) {
+      printf("CPU: Cannot map shared segment %s: %s \n\r", name, strerror(errno));
+      M_shmhdr = NULL;
+      close(fd);
+      shm_unlink(name);
+      return SCPE_IOERR;
+   }
+   if (io_quiesce() < 0) {                     // CA, scanner and LIB must not write meanwhile
+      printf("CPU: I/O threads busy, storage and registers not shared \n\r");
+      munmap(M_shmhdr, SHM_PAGE);
+      M_shmhdr = NULL;
+      close(fd);
+      shm_unlink(name);
+      return SCPE_IOERR;
+   }
+   if ((shm_swap(fd, SHM_GR, GR, SHM_PAGE, 0x01) < 0) ||
+       (shm_swap(fd, SHM_EREGS_INP, Eregs_Inp, SHM_PAGE, 0x02) < 0) ||
+       (shm_swap(fd, SHM_EREGS_OUT, Eregs_Out, SHM_PAGE, 0x04) < 0) ||
+       (shm_swap(fd, SHM_STORAGE, M, MAXMEMSIZE, 0x08) < 0)) {
+      printf("CPU: Cannot map shared segment %s: %s \n\r", name, strerror(errno));
+      shm_back();                              // Whatever was swapped goes back to private memory
+      io_resume();
+      munmap(M_shmhdr, SHM_PAGE);
+      M_shmhdr = NULL;
+      close(fd);
+      shm_unlink(name);
+      return SCPE_IOERR;
+   }
+   io_resume();
+   close(fd);                                  // Mappings keep the segment referenced
+   M_shmhdr->version = SHM_VERSION;
+   M_shmhdr->memsize = MEMSIZE;
+   M_shmhdr->maxmemsize = MAXMEMSIZE;
+   memcpy(M_shmhdr->magic, SHM_MAGIC, sizeof(M_shmhdr->magic));
+   M_image[0] = 0;                             // A mapped image is now a copy
+   strncpy(M_shmname, name, sizeof(M_shmname) - 1);
+   printf("CPU: Storage and registers shared in %s \n\r", M_shmname);
+   return SCPE_OK;
+}
+
+t_stat cpu_clr_shm (UNIT *uptr, int32 val, char *cptr, void *desc) {
+   if (M_shmname[0] == 0)
+      return SCPE_OK;
+   if (io_quiesce() < 0) {
+      printf("CPU: I/O threads busy, %s stays shared \n\r", M_shmname);
+      return SCPE_IOERR;
+   }
+   if (shm_back() < 0) {
+      printf("CPU: Cannot unmap shared segment %s: %s \n\r", M_shmname, strerror(errno));
+      io_resume();
+      return SCPE_IOERR;                       // Areas not moved back keep using the segment
+   }
+   io_resume();
+   memset(M_shmhdr->magic, 0, sizeof(M_shmhdr->magic));  // Tell readers the view is gone
+   munmap(M_shmhdr, SHM_PAGE);
+   M_shmhdr = NULL;
+   shm_unlink(M_shmname);
+   M_shmname[0] = 0;
+   return SCPE_OK;
+}
+
+t_stat cpu_show_shm (FILE *st, UNIT *uptr, int32 val, void *desc) {
+   if (M_shmname[0] == 0)
+      fprintf(st, "no shared segment");
+   else
+      fprintf(st, "shared segment=%s", M_shmname);
+   return SCPE_OK;
+}
+
+/*** High-level emulation of hot NCP loops ***/
+// A few NCP inner loops execute most CCU instructions under load. Each
+// routine below recognizes one such loop by its instruction pattern and
+// runs whole iterations of it natively, leaving M, GR and the latches as
+// the interpreter would after the same number of iterations. At most
+// HLE_CHUNK iterations run per step: the loop is then re-entered at its
+// first instruction, so interrupts are still taken between iterations.
+// Sites are found by a storage scan at sim_load and when NCP resets its
+// IPL L1 request, or given from the load map with SET CPU HLE=name@addr.
+// Each call checks the code again, so overwritten storage is interpreted.
+// HLE steps aside while instructions are traced or breakpoints are set.
+
+#define HW(a)          ((M[a] << 8) | M[(a) + 1])       /* Halfword at a */
+
+/* Buffer move:  ICT  Ra(N),Bs / STCT Ra(N),Bd / BCT Rc(Nc),*-4 */
+int32 hle_mv_match (int32 addr) {
+   int32 i1 = HW(addr), i2 = HW(addr + 2), i3 = HW(addr + 4);
+   int32 Bs, Bd, Ra, Rc;
+
+   if (((i1 & 0x88FF) != 0x0010) || ((i2 & 0x88FF) != 0x0030) || ((i3 & 0xF8FF) != 0xB887))
+      return 0;
+   if (((i1 >> 8) & 0x07) != ((i2 >> 8) & 0x07))        /* Same register byte */
+      return 0;
+   Bs = (i1 >> 12) & 0x07;
+   Bd = (i2 >> 12) & 0x07;
+   Ra = ((i1 >> 8) & 0x06) + 1;
+   Rc = ((i3 >> 8) & 0x06) + 1;
+   return (Bs != 0) && (Bd != 0) && (Bs != Bd) && (Ra != Bs) && (Ra != Bd) &&
+          (Rc != Bs) && (Rc != Bd) && (Rc != Ra);
+}
+
+int32 hle_mv_exec (int32 addr) {
+   int32 i1 = HW(addr), i3 = HW(addr + 4);
+   int32 Bs = (i1 >> 12) & 0x07, Bd = (HW(addr + 2) >> 12) & 0x07;
+   int32 Ra = ((i1 >> 8) & 0x06) + 1, Na = (i1 >> 8) & 0x01;
+   int32 Rc = ((i3 >> 8) & 0x06) + 1, Nc = (i3 >> 8) & 0x01;
+   int32 src = GR[Bs][Grp], dst = GR[Bd][Grp];
+   int32 n, k, c = 0;
+
+   n = Nc ? (GR[Rc][Grp] & 0xFFFF) : ((GR[Rc][Grp] >> 8) & 0xFF);
+   if (n == 0) n = Nc ? 0x10000 : 0x100;        /* BCT wraps the count */
+   k = (n > HLE_CHUNK) ? HLE_CHUNK : n;
+   if ((src + k > MEMSIZE) || (dst + k > MEMSIZE))
+      return 0;                                 /* Let the interpreter raise it */
+   for (int i = 0; i < k; i++) {                /* Byte by byte: overlap as on the CCU */
+      c = M[src + i];
+      M[dst + i] = c;
+   }
+   GR[Bs][Grp] += k;
+   GR[Bd][Grp] += k;
+   if (Na == 0)
+      GR[Ra][Grp] = (GR[Ra][Grp] & (XB_mask | 0xFF)) | (c << 8);
+   else
+      GR[Ra][Grp] = (GR[Ra][Grp] & (XB_mask | 0xFF00)) | c;
+   if (Nc == 0)
+      GR[Rc][Grp] = (GR[Rc][Grp] & (XB_mask | 0xFF)) | ((GR[Rc][Grp] - (k << 8)) & 0x0FF00);
+   else
+      GR[Rc][Grp] = (GR[Rc][Grp] & XB_mask) | ((GR[Rc][Grp] - k) & 0x0FFFF);
+   GR[0][Grp] = (k == n) ? addr + 6 : addr;
+   return 3 * k;
+}
+
+/* Translate:  ICT Rt(1),Bs / IC Rc(N),0(Rt) / STCT Rc(N),Bd / BCT Rn(Nn),*-6 */
+/* Byte 0 and X of Rt hold the 256 byte aligned translate table address.     */
+int32 hle_tr_match (int32 addr) {
+   int32 i1 = HW(addr), i2 = HW(addr + 2), i3 = HW(addr + 4), i4 = HW(addr + 6);
+   int32 Bs, Bd, Rt, Rc, Rn;
+
+   if (((i1 & 0x89FF) != 0x0110) || ((i2 & 0x88FF) != 0x0800) ||
+       ((i3 & 0x88FF) != 0x0030) || ((i4 & 0xF8FF) != 0xB889))
+      return 0;
+   Bs = (i1 >> 12) & 0x07;
+   Rt = ((i1 >> 8) & 0x06) + 1;
+   Rc = ((i2 >> 8) & 0x06) + 1;
+   Bd = (i3 >> 12) & 0x07;
+   Rn = ((i4 >> 8) & 0x06) + 1;
+   if ((((i2 >> 12) & 0x07) != Rt) || (((i2 >> 8) & 0x07) != ((i3 >> 8) & 0x07)))
+      return 0;                                 /* IC via Rt, STCT of the same byte */
+   return (Bs != 0) && (Bd != 0) && (Bs != Bd) &&
+          (Rt != Bs) && (Rt != Bd) && (Rc != Bs) && (Rc != Bd) && (Rc != Rt) &&
+          (Rn != Bs) && (Rn != Bd) && (Rn != Rt) && (Rn != Rc);
+}
+
+int32 hle_tr_exec (int32 addr) {
+   int32 i1 = HW(addr), i2 = HW(addr + 2), i4 = HW(addr + 6);
+   int32 Bs = (i1 >> 12) & 0x07, Bd = (HW(addr + 4) >> 12) & 0x07;
+   int32 Rt = ((i1 >> 8) & 0x06) + 1;
+   int32 Rc = ((i2 >> 8) & 0x06) + 1, Nc = (i2 >> 8) & 0x01;
+   int32 Rn = ((i4 >> 8) & 0x06) + 1, Nn = (i4 >> 8) & 0x01;
+   int32 src = GR[Bs][Grp], dst = GR[Bd][Grp], tab = GR[Rt][Grp] & (XB_mask | 0xFF00);
+   int32 n, k, c = 0, t = 0, j;
+
+   n = Nn ? (GR[Rn][Grp] & 0xFFFF) : ((GR[Rn][Grp] >> 8) & 0xFF);
+   if (n == 0) n = Nn ? 0x10000 : 0x100;
+   k = (n > HLE_CHUNK) ? HLE_CHUNK : n;
+   if ((src + k > MEMSIZE) || (dst + k > MEMSIZE) || (tab + 0x100 > MEMSIZE))
+      return 0;
+   for (int i = 0; i < k; i++) {
+      c = M[src + i];
+      t = M[tab + c];
+      M[dst + i] = t;
+   }
+   GR[Bs][Grp] += k;
+   GR[Bd][Grp] += k;
+   GR[Rt][Grp] = tab | c;
+   if (Nc == 0)
+      GR[Rc][Grp] = (GR[Rc][Grp] & (XB_mask | 0xFF)) | (t << 8);
+   else
+      GR[Rc][Grp] = (GR[Rc][Grp] & (XB_mask | 0xFF00)) | t;
+   CL_op[Grp] = CL_NONE;                        /* Latches of the last IC */
+   CL_Z[Grp] = (t == 0) ? ON : OFF;
+   for (j = 0; t != 0; t >>= 1)
+      j += t & 0x01;
+   CL_C[Grp] = (j & 0x01) ? OFF : ON;           /* Even number of one bits */
+   if (Nn == 0)
+      GR[Rn][Grp] = (GR[Rn][Grp] & (XB_mask | 0xFF)) | ((GR[Rn][Grp] - (k << 8)) & 0x0FF00);
+   else
+      GR[Rn][Grp] = (GR[Rn][Grp] & XB_mask) | ((GR[Rn][Grp] - k) & 0x0FFFF);
+   GR[0][Grp] = (k == n) ? addr + 8 : addr;
+   return 4 * k;
+}
+
+struct hle_rtn hle_tab[HLE_NRTN] = {
+//    Name      Len  Match          Exec
+    { "MOVE",   6,   &hle_mv_match, &hle_mv_exec, ON },
+    { "TRANSL", 8,   &hle_tr_match, &hle_tr_exec, ON },
+};
+
+/* Run the routine at addr. Returns the nr of CCU instructions it stands for, 0 = interpret */
+int32 hle_step (int32 addr) {
+   struct hle_rtn *r = &hle_tab[HLE_map[addr] - 1];
+   int32 n, tick;
+
+   if ((r->enabled == OFF) || (debug_reg & 0x01) || sim_brk_summ)
+      return 0;
+   if (!r->match(addr)) {                       /* Code has been overwritten */
+      HLE_map[addr] = 0;
+      return 0;
+   }
+   if ((n = r->exec(addr)) == 0)
+      return 0;
+   r->calls++;
+   r->insts += n;
+   saved_PC = addr + r->len - 2;                /* Last instr executed was the BCT */
+   sim_interval = sim_interval - (n - 1);       /* One tick already taken */
+   tick = cycle_eight + n - 1;                  /* Keep the Cycle Utilization count */
+   cycle_eight = tick % 8;
+   for (tick = tick / 8; tick > 0; tick--) {
+      if (Eregs_Inp[0x7A] == 0xFFFF)
+         Eregs_Inp[0x7A] = 0x8000;
+      else
+         Eregs_Inp[0x7A]++;
+   }
+   return n;
+}
+
+/* Find the sites of all enabled routines in storage */
+void hle_scan (void) {
+   memset(HLE_map, 0, sizeof(HLE_map));
+   for (int r = 0; r < HLE_NRTN; r++) {
+      hle_tab[r].nsite = 0;
+      if (hle_tab[r].enabled == OFF)
+         continue;
+      for (int32 addr = 0; addr + hle_tab[r].len <= MEMSIZE; addr += 2) {
+         if ((HLE_map[addr] == 0) && hle_tab[r].match(addr)) {
+            HLE_map[addr] = r + 1;
+            if (hle_tab[r].nsite < HLE_MAXSITE)
+               hle_tab[r].site[hle_tab[r].nsite] = addr;
+            hle_tab[r].nsite++;
+         }
+      }
+   }
+}
+
+// SET CPU HLE              enable all routines and scan storage
+// SET CPU HLE=name         enable one routine and scan storage
+// SET CPU HLE=name@addr    enable one routine at a load map address
+t_stat cpu_set_hle (UNIT *uptr, int32 val, char *cptr, void *desc) {
+   char *ap = NULL;
+   int32 addr, r;
+
+   hle_on = ON;
+   if ((cptr == NULL) || (*cptr == 0)) {
+      for (r = 0; r < HLE_NRTN; r++)
+         hle_tab[r].enabled = ON;
+      hle_scan();
+      return SCPE_OK;
+   }
+   if ((ap = strchr(cptr, '@')) != NULL)
+      *ap++ = '\0';
+   for (r = 0; (r < HLE_NRTN) && (strcmp(cptr, hle_tab[r].name) != 0); r++) ;
+   if (r == HLE_NRTN)
+      return SCPE_ARG;
+   hle_tab[r].enabled = ON;
+   if (ap == NULL) {
+      hle_scan();
+      return SCPE_OK;
+   }
+   addr = strtol(ap, &ap, 16);
+   if ((*ap != '\0') || (addr & 0x01) || (addr + hle_tab[r].len > MEMSIZE))
+      return SCPE_ARG;
+   if (!hle_tab[r].match(addr)) {
+      printf("CPU: No %s loop at %05X \n\r", hle_tab[r].name, addr);
+      return SCPE_ARG;
+   }
+   if (HLE_map[addr] != r + 1) {
+      HLE_map[addr] = r + 1;
+      if (hle_tab[r].nsite < HLE_MAXSITE)
+         hle_tab[r].site[hle_tab[r].nsite] = addr;
+      hle_tab[r].nsite++;
+   }
+   return SCPE_OK;
+}
+
+// SET CPU NOHLE            interpret everything
+// SET CPU NOHLE=name       interpret one routine, e.g. to validate it
+t_stat cpu_clr_hle (UNIT *uptr, int32 val, char *cptr, void *desc) {
+   int32 r;
+
+   if ((cptr == NULL) || (*cptr == 0)) {
+      hle_on = OFF;
+      memset(HLE_map, 0, sizeof(HLE_map));
+      for (r = 0; r < HLE_NRTN; r++)
+         hle_tab[r].nsite = 0;
+      return SCPE_OK;
+   }
+   for (r = 0; (r < HLE_NRTN) && (strcmp(cptr, hle_tab[r].name) != 0); r++) ;
+   if (r == HLE_NRTN)
+      return SCPE_ARG;
+   hle_tab[r].enabled = OFF;
+   return SCPE_OK;
+}
+
+t_stat cpu_show_hle (FILE *st, UNIT *uptr, int32 val, void *desc) {
+   fprintf(st, "HLE %s", (hle_on == ON) ? "on" : "off");
+   for (int r = 0; r < HLE_NRTN; r++) {
+      fprintf(st, "\n  %-7s %-3s %d site(s)", hle_tab[r].name,
+              (hle_tab[r].enabled == ON) ? "on" : "off", hle_tab[r].nsite);
+      for (int s = 0; (s < hle_tab[r].nsite) && (s < HLE_MAXSITE); s++)
+         fprintf(st, " %05X", hle_tab[r].site[s]);
+      fprintf(st, ", %u calls, %llu instructions", hle_tab[r].calls,
+              (unsigned long long) hle_tab[r].insts);
+   }
+   return SCPE_OK;
+}
+
+/* Cooperative run mode (i3705 -c): the CA, scanner and LIB thread routines run as
+   coroutines in the CCU thread. Each has a unit on the SIMH event queue that resumes
+   it every COOP_TIME instructions; the routine returns control at the points where
+   its thread would sleep or wait for the CCU (coop_yield).                        */
+UNIT coop_unit[COOP_NTASK] = {
+   { UDATA (&coop_svc, 0, 0) }, { UDATA (&coop_svc, 0, 0) },
+   { UDATA (&coop_svc, 0, 0) }, { UDATA (&coop_svc, 0, 0) }
+};
+
+static void coop_resume (struct coop_task *t) {
+   struct coop_task *prev = coop_cur;           /* A coroutine may start another one */
+
+   coop_cur = t;
+   t->runs++;
+   swapcontext(&t->ret, &t->ctx);
+   coop_cur = prev;
+}
+
+/* Give control back to whoever resumed the running coroutine. Returns 0 if not in one.
+   A CA, scanner or LIB thread parks here while io_quiesce holds them.                 */
+int coop_yield (void) {
+   struct coop_task *t = coop_cur;
+
+   if (t == NULL) {
+      if (io_hold == ON) {
+         pthread_mutex_lock(&io_lock);
+         io_held++;
+         pthread_cond_broadcast(&io_cond);
+         while (io_hold == ON)
+            pthread_cond_wait(&io_cond, &io_lock);
+         io_held--;
+         pthread_mutex_unlock(&io_lock);
+      }
+      return 0;
+   }
+   swapcontext(&t->ctx, &t->ret);
+   return 1;
+}
+
+/* Hold the CA, scanner and LIB threads at their next wait point, so SCP can change
+   the storage and register mappings under them. In COOP mode they only run from
+   the event queue, which is stopped while SCP executes a command. Returns -1 if
+   the threads do not all come to a hold within 5 seconds.                         */
+static int io_quiesce (void) {
+   struct timespec tmo;
+   int rc = 0;
+
+   if (coop_mode == ON)
+      return 0;
+   clock_gettime(CLOCK_REALTIME, &tmo);
+   tmo.tv_sec += 5;
+   pthread_mutex_lock(&io_lock);
+   io_hold = ON;
+   while ((io_held < IO_NTHREAD) && (rc == 0))
+      rc = pthread_cond_timedwait(&io_cond, &io_lock, &tmo);
+   if (io_held < IO_NTHREAD) {
+      io_hold = OFF;
+      pthread_cond_broadcast(&io_cond);
+      pthread_mutex_unlock(&io_lock);
+      return -1;
+   }
+   pthread_mutex_unlock(&io_lock);
+   return 0;
+}
+
+static void io_resume (void) {
+   if (coop_mode == ON)
+      return;
+   pthread_mutex_lock(&io_lock);
+   io_hold = OFF;
+   pthread_cond_broadcast(&io_cond);
+   pthread_mutex_unlock(&io_lock);
+}
+
+static void coop_entry (void) {
+   struct coop_task *t = coop_cur;
+
+   t->rtn(NULL);
+   t->done = ON;
+   coop_yield();                                /* Never resumed again */
+}
+
+/* Start rtn as a coroutine instead of a thread and run it up to its first wait */
+int coop_start (const char *name, void *(*rtn)(void *)) {
+   struct coop_task *t;
+
+   if (coop_ntask == COOP_NTASK)
+      return -1;
+   t = &coop_tab[coop_ntask];
+   t->name = name;
+   t->rtn = rtn;
+   t->done = OFF;
+   t->runs = 0;
+   getcontext(&t->ctx);
+   if ((t->ctx.uc_stack.ss_sp = malloc(COOP_STACK)) == NULL)
+      return -1;
+   t->ctx.uc_stack.ss_size = COOP_STACK;
+   t->ctx.uc_link = NULL;
+   makecontext(&t->ctx, coop_entry, 0);
+   coop_ntask++;
+   coop_resume(t);
+   return 0;
+}
+
+t_stat coop_svc (UNIT *uptr) {
+   struct coop_task *t = &coop_tab[uptr - coop_unit];
+
+   if (t->done == OFF) {
+      coop_resume(t);
+      sim_activate(uptr, COOP_TIME);
+   }
+   return SCPE_OK;
+}
+
+/* Put the services on the event queue; called each time the CCU starts running */
+void coop_sched (void) {
+   for (int i = 0; i < coop_ntask; i++)
+      if ((coop_tab[i].done == OFF) && !sim_is_active(&coop_unit[i]))
+         sim_activate(&coop_unit[i], COOP_TIME);
+}
+
+/* Wait state: no instructions are counted, so service everything directly */
+void coop_idle (void) {
+   for (int i = 0; i < coop_ntask; i++)
+      if (coop_tab[i].done == OFF)
+         coop_resume(&coop_tab[i]);
+   usleep(COOP_IDLE);
+}
+
+t_stat cpu_show_coop (FILE *st, UNIT *uptr, int32 val, void *desc) {
+   fprintf(st, "COOP %s", (coop_mode == ON) ? "on" : "off");
+   for (int i = 0; i < coop_ntask; i++)
+      fprintf(st, "\n  %-4s %u runs%s", coop_tab[i].name, coop_tab[i].runs,
+              (coop_tab[i].done == ON) ? ", ended" : "");
    return SCPE_OK;
 }
 
@@ -2607,6 +3211,8 @@ t_stat cpu_reset (DEVICE *dptr) {              /* RESET pressed */
       int_lvl_mask[i] = ON;                    /* Set all Pgm Level masks */
    }
    lvl = 5;
+   if (OP_sw_built == OFF)                     /* Decode table not yet built ? */
+      OP_sw_init();
    /* Set cycle count register */
    Eregs_Inp[0x7A] = 0x8000;                    /* CUCR RPQ install        */
    cycle_eight = 0;                             /* 8 cycle counter to zero */
@@ -48,15 +48,38 @@
 #define STOP_INVADDR    6                               /* Prog check - invalid addr */
 #define STOP_INVDEV     7                               /* Prog check - invalid dev cmd */
 #define STOP_NOCD       8                               /* ATTN card reader */
+#define STOP_OPSW       9                               /* Decode table mismatch */
 #define RESET_INTERRUPT 77                              /* special return from SIO */
 
 /* Memory */
 
-#define MAXMEMSIZE      262144                          /* max memory size */
+#define MAXMEMSIZE      524288                          /* max memory size */
+#define MAXMEM18        262144                          /* max storage for 18 bit registers */
 #define AMASK           (MAXMEMSIZE - 1)                /* logical addr mask */
 #define PAMASK          (MAXMEMSIZE - 1)                /* physical addr mask */
 #define MEMSIZE         (cpu_unit.capac)                /* actual memory size */
 
+/* Live view (SET CPU SHMEM=name): a POSIX shared memory segment holding
+   a header page, one page each for GR, Eregs_Inp and Eregs_Out, then M.
+   The simulator runs on these pages directly, so a reader sees the
+   registers and storage as they are, without stopping the CCU. */
+
+#define SHM_PAGE        4096                            /* segment page size */
+#define SHM_GR          (1 * SHM_PAGE)                  /* int32 GR[8][4] */
+#define SHM_EREGS_INP   (2 * SHM_PAGE)                  /* int32 Eregs_Inp[128] */
+#define SHM_EREGS_OUT   (3 * SHM_PAGE)                  /* int32 Eregs_Out[128] */
+#define SHM_STORAGE     (4 * SHM_PAGE)                  /* uint8 M[MAXMEMSIZE] */
+#define SHM_SIZE        (SHM_STORAGE + MAXMEMSIZE)      /* total segment size */
+#define SHM_MAGIC       "I3705SHM"
+#define SHM_VERSION     1
+
+struct shm3705 {                                        /* header page */
+    char    magic[8];                                   /* SHM_MAGIC */
+    uint32  version;                                    /* SHM_VERSION */
+    uint32  memsize;                                    /* actual memory size */
+    uint32  maxmemsize;                                 /* size of storage area */
+};
+
 /* I/O structure
 
    The I/O structure is tied together by dev_table, indexed by
@@ -127,3 +150,7 @@ struct IO3705 {
 #define DCD 0x10   /* Data Carrier Detect           */
 #define RTS 0x08   /* Request To Send               */
 #define DTR 0x04   /* Data Terminal Ready           */
+
+/* Line speed model direction. A half duplex line has one for both, a full duplex line one each */
+#define LIB_TX 0
+#define LIB_RX 1
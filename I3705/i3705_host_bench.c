@@ -0,0 +1,877 @@
+/* Copyright (c) 2026, Edwin Freekenhorst and Henk Stegeman
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   i3705_host_bench.c: Host/SSCP stand-in traffic generator.
+
+   This driver takes the place of Hercules and VTAM on a 3705 channel
+   adapter.  It connects the bus and tag sockets of a CA port (CAPORTS in
+   i3705_chan_T2.c), sends the device number and then runs a script of
+   channel programs and SNA requests against the NCP:
+
+        Host stand-in              Channel adapter            NCP
+        CCW (8 bytes) ---- bus ---> exec_ccw --------------> L3 int
+        write data    ---- bus --->  chainbuf -> M[]
+                      <--- bus ---- CA return status
+                      <--- tag ---- ATTN <------------------ NCP has data
+        CCW 02 (Read) ---- bus --->  M[] -> buffer
+                      <--- bus ---- data + CA return status
+
+   Script statements (one per line, '*' starts a comment):
+     ipl file             Load the NCP: file holds the loader records, each
+                          a 2 byte length followed by the record.  The
+                          first record goes with an IPL CCW, the others
+                          with Write CCW's.
+     ccw xx [hex data]    Issue one CCW, with write data if given.
+     chain xx[:hex] ...   Issue a command chain as one channel program,
+                          e.g. "chain 01:4C00...  02" for a Write + Read.
+     write hex data       Write one or more PIU's as given.
+     sa host ncp          Host and NCP subarea addresses (FID4 OSAF/DSAF).
+     sscp elem            SSCP element address (default 1).
+     appl elem            First application element address (default 2).
+     lu elem[,elem...]    LU element addresses used by the sessions.
+     actpu elem           ACTPU to the PU at element elem.
+     actlu                ACTLU to all LU's.
+     bind                 BIND and SDT from an application element per LU.
+     pause ms             Wait.
+     mix sessions=n inq=n resp=n think=ms count=n
+                          Run count transactions on each of n sessions:
+                          send an inq byte request (definite response,
+                          change direction) and wait for the +RSP.  With
+                          resp > 0 also wait for the reply from the
+                          terminal (e.g. the TN3270 client) and answer it.
+
+   Reported: transactions per second, bytes per second and the
+   transaction latency (min/avg/max and 95th percentile).
+
+   With -chain every CCW goes out as a one CCW channel program (see
+   exec_cpgm in i3705_chan_T2.c): write data travels with the CCW and
+   the reply is framed, so no -gap delay or idle wait is needed.
+
+   Usage: i3705_host [-host addr] [-ca n] [-port a|b] [-devnum xxxx] [-gap usec] [-wait sec] [-chain] [-d] script
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define CAPORT          37051          // CA1 port A (CAPORTS in i3705_chan_T2.c)
+#define BUFLEN_CA       4096           // CA data chaining buffer (chainbuf)
+#define MAXSESS         64             // Sessions
+#define MAXLAT          100000         // Latency samples kept for the percentile
+#define TH4_LEN         26             // FID4 TH length
+#define RH_LEN          3              // RH length
+#define CCW_CPGM        0xF0           // Channel program header (CCW_CPGM in i3705_chan_T2.c)
+#define CCW_CC          0x40           // CCW flag: command chaining
+#define MAXCHAIN        16             // Max CCW's in a chain statement
+
+// CSW Unit Status conditions (as in i3705_chan_T2.c)
+#define CSW_ATTN 0x80                  // Attention
+#define CSW_SMOD 0x40                  // Status Modifier
+#define CSW_CEND 0x08                  // Channel End (CE)
+#define CSW_DEND 0x04                  // Device End (DE)
+#define CSW_UCHK 0x02                  // Unit check
+#define CSW_UEXC 0x01                  // Unit Exception
+
+// Session phases
+#define SS_IDLE    0                   // Not in use
+#define SS_THINK   1                   // Waiting for think time to expire
+#define SS_RSP     2                   // Waiting for the +RSP
+#define SS_REPLY   3                   // Waiting for the terminal's reply
+#define SS_DONE    4                   // All transactions done
+
+struct Session {
+   int      phase;
+   uint16_t lu;                        // LU element address
+   uint16_t appl;                      // Application element address
+   uint16_t snf;                       // Last sequence number sent
+   long     trans;                     // Transactions completed
+   long     timeouts;                  // Transactions timed out
+   double   lattot, latmin, latmax;    // Latency total, min and max (usec)
+   struct timespec start;              // Start of current transaction
+   struct timespec due;                // End of think time
+} sess[MAXSESS];
+
+int bus_fd = -1, tag_fd = -1;          // Channel connection
+char *hostaddr = "127.0.0.1";          // 3705 address
+int caport = CAPORT;                   // CA port
+uint16_t devnum = 0x0660;              // Device number sent at connect
+int gap = 2000;                        // usec between a CCW and its write data
+int maxwait = 10;                      // Response time limit (sec)
+int debug = 0;                         // Trace channel I/O
+int cpgm = 0;                          // Send CCW's as channel programs (-chain)
+
+uint32_t host_sa = 1, ncp_sa = 3;      // Subarea addresses
+uint16_t sscp_elem = 1;                // SSCP element
+uint16_t appl_elem = 2;                // First application element
+uint16_t lus[MAXSESS];                 // LU element addresses
+int nlus = 0;
+uint16_t sscp_snf = 0;                 // SSCP session sequence number
+
+double lat[MAXLAT];                    // Latency samples
+long nlat = 0;
+long bytes_out = 0, bytes_in = 0;      // RU bytes sent and received in the mix
+
+uint8_t rbuf[BUFLEN_CA];               // Read CCW data
+
+// LU type 2 BIND image
+static uint8_t bind_ru[] = {
+   0x31, 0x01, 0x03, 0x03, 0xB1, 0x90, 0x30, 0x80,
+   0x00, 0x01, 0x85, 0x85, 0x0A, 0x00, 0x02, 0x80,
+   0x00, 0x00, 0x00, 0x00, 0x18, 0x50, 0x00, 0x7E,
+   0x00 };
+
+// ***************************************************************
+// Function to return elapsed time in usec.
+// ***************************************************************
+static double usec(struct timespec *from, struct timespec *to) {
+   return ((to->tv_sec - from->tv_sec) * 1000000.0) + ((to->tv_nsec - from->tv_nsec) / 1000.0);
+}
+
+// ***************************************************************
+// Function to dump a buffer when tracing.
+// ***************************************************************
+static void dump(char *text, uint8_t *buf, int len) {
+   if (debug == 0)
+      return;
+   printf("HOST: %s %d bytes:", text, len);
+   for (int i = 0; i < len; i++) {
+      if ((i % 16) == 0)
+         printf("\n      ");
+      printf("%02X ", buf[i]);
+   }
+   printf("\n");
+}
+
+// ***************************************************************
+// Connect the bus and the tag socket and send the device number.
+// The channel adapter accepts the bus connection first.
+// ***************************************************************
+static int ca_connect(void) {
+   struct sockaddr_in servaddr;
+   uint8_t dev[2];
+   int flag = 1;
+
+   servaddr.sin_family = AF_INET;
+   servaddr.sin_addr.s_addr = inet_addr(hostaddr);
+   servaddr.sin_port = htons(caport);
+   bus_fd = socket(AF_INET, SOCK_STREAM, 0);
+   tag_fd = socket(AF_INET, SOCK_STREAM, 0);
+   for (int i = 0; connect(bus_fd, (struct sockaddr*)&servaddr, sizeof(servaddr)) != 0; i++) {
+      if (i == 100) {
+         printf("HOST: Cannot connect to %s port %d: %s\n", hostaddr, caport, strerror(errno));
+         return -1;
+      }
+      usleep(100000);
+   }
+   if (connect(tag_fd, (struct sockaddr*)&servaddr, sizeof(servaddr)) != 0) {
+      printf("HOST: Tag connection to %s port %d failed: %s\n", hostaddr, caport, strerror(errno));
+      return -1;
+   }
+   setsockopt(bus_fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+   usleep(100000);                               // Let the CA accept both
+   dev[0] = devnum >> 8;
+   dev[1] = devnum & 0xFF;
+   send(bus_fd, dev, 2, 0);
+   printf("HOST: Connected to %s port %d as device %04X\n", hostaddr, caport, devnum);
+   usleep(100000);                               // CA reads the device number
+   return 0;
+}
+
+// ***************************************************************
+// Read from a socket with a time limit (msec).
+// Returns the number of bytes read, 0 on timeout, -1 on error.
+// ***************************************************************
+static int read_wait(int fd, uint8_t *buf, int len, int msec) {
+   struct pollfd pfd;
+   int rc;
+
+   pfd.fd = fd;
+   pfd.events = POLLIN;
+   rc = poll(&pfd, 1, msec);
+   if (rc < 1)
+      return rc;
+   rc = read(fd, buf, len);
+   if (rc < 1) {
+      printf("HOST: Channel connection lost\n");
+      return -1;
+   }
+   return rc;
+}
+
+// ***************************************************************
+// Length of the complete FID4 PIU's at the start of buf, or -1 if
+// the data is not a sequence of FID4 PIU's.
+// ***************************************************************
+static int piu_len(uint8_t *buf, int len) {
+   int ptr = 0, dcf;
+
+   while (len - ptr >= TH4_LEN) {
+      if ((buf[ptr] & 0xF0) != 0x40)
+         return -1;
+      dcf = (buf[ptr + 24] << 8) | buf[ptr + 25];
+      if (ptr + TH4_LEN + dcf > len)
+         break;
+      ptr = ptr + TH4_LEN + dcf;
+   }
+   return ptr;
+}
+
+// ***************************************************************
+// Execute n command chained CCW's as one channel program.  Write
+// type commands carry count[i] bytes from data[i].  The data of
+// all Read and Sense CCW's is returned in rbuf (*rlen).
+// Returns the status of the last CCW executed, or -1.
+// ***************************************************************
+static int exec_chain(int n, uint8_t *code, uint8_t **data, int *count, int *rlen) {
+   static uint8_t pgm[8 + MAXCHAIN * (8 + BUFLEN_CA)];
+   uint8_t hdr[8];
+   int ptr = 8, len, rc;
+
+   for (int i = 0; i < n; i++) {
+      pgm[ptr] = code[i];
+      pgm[ptr + 1] = pgm[ptr + 2] = pgm[ptr + 3] = 0x00;
+      pgm[ptr + 4] = (i < n - 1) ? CCW_CC : 0x00;
+      pgm[ptr + 5] = 0x00;
+      pgm[ptr + 6] = (count[i] >> 8) & 0xFF;
+      pgm[ptr + 7] = count[i] & 0xFF;
+      ptr = ptr + 8;
+      if ((code[i] == 0x01) || (code[i] == 0x05) || (code[i] == 0x09)) {
+         memcpy(pgm + ptr, data[i], count[i]);
+         dump("Write", data[i], count[i]);
+         ptr = ptr + count[i];
+      }
+      if (debug)
+         printf("HOST: CCW %02X count %d%s\n", code[i], count[i], (i < n - 1) ? " chained" : "");
+   }
+   memset(pgm, 0x00, 8);
+   pgm[0] = CCW_CPGM;
+   pgm[6] = ((ptr - 8) >> 8) & 0xFF;
+   pgm[7] = (ptr - 8) & 0xFF;
+   send(bus_fd, pgm, ptr, 0);
+
+   // Reply: 8 byte header (status, CCW's executed, data length), then the data
+   for (len = 0; len < 8; len = len + rc)
+      if ((rc = read_wait(bus_fd, hdr + len, 8 - len, maxwait * 1000)) < 1) {
+         if (rc == 0)
+            printf("HOST: No reply to channel program\n");
+         return -1;
+      }
+   ptr = (hdr[6] << 8) | hdr[7];
+   if ((hdr[0] != CCW_CPGM) || (ptr > sizeof(rbuf))) {
+      printf("HOST: Invalid channel program reply %02X\n", hdr[0]);
+      return -1;
+   }
+   for (len = 0; len < ptr; len = len + rc)
+      if ((rc = read_wait(bus_fd, rbuf + len, ptr - len, maxwait * 1000)) < 1)
+         return -1;
+   if (rlen != NULL)
+      *rlen = len;
+   if (hdr[2] < n)
+      printf("HOST: Chain ended after %d of %d CCW's\n", hdr[2], n);
+   dump("Status", &hdr[1], 1);
+   dump("Read", rbuf, len);
+   return hdr[1];
+}
+
+// ***************************************************************
+// Execute one CCW.  Write type commands send count bytes from
+// data, a Read or Sense returns its data in rbuf (*rlen).
+// Returns the CA return status, or -1 if the channel is lost.
+// ***************************************************************
+static int exec_ccw(uint8_t code, uint8_t *data, int count, int *rlen) {
+   uint8_t ccw[8];
+   int rc, len = 0, plen;
+
+   if (cpgm)
+      return exec_chain(1, &code, &data, &count, rlen);
+   ccw[0] = code;
+   ccw[1] = ccw[2] = ccw[3] = 0x00;
+   ccw[4] = 0x00;                                // No chaining
+   ccw[5] = 0x00;
+   ccw[6] = (count >> 8) & 0xFF;
+   ccw[7] = count & 0xFF;
+   if (debug)
+      printf("HOST: CCW %02X count %d\n", code, count);
+   send(bus_fd, ccw, 8, 0);
+
+   if ((code == 0x01) || (code == 0x05) || (code == 0x09)) {
+      // The CA reads the CCW first and then waits for exactly count bytes.
+      usleep(gap);
+      dump("Write", data, count);
+      send(bus_fd, data, count, 0);
+   }
+
+   // Collect the data (Read/Sense) and the status byte that ends it.
+   // A Sense returns one byte and a Read returns FID4 PIU's, so the
+   // status is the first byte after them.  Otherwise wait until the CA
+   // has nothing more to send.
+   do {
+      rc = read_wait(bus_fd, rbuf + len, sizeof(rbuf) - len, maxwait * 1000);
+      if (rc < 1) {
+         if (rc == 0)
+            printf("HOST: No status for CCW %02X\n", code);
+         return -1;
+      }
+      len = len + rc;
+      if ((code == 0x04) && (len < 2))
+         continue;
+      if ((code == 0x02) && ((plen = piu_len(rbuf, len)) > 0) && (len > plen))
+         break;
+      rc = read_wait(bus_fd, rbuf + len, sizeof(rbuf) - len, gap / 1000 + 1);
+      if (rc < 0)
+         return -1;
+      len = len + rc;
+   } while ((rc > 0) && (len < sizeof(rbuf)));
+
+   if (rlen != NULL)
+      *rlen = len - 1;
+   dump("Status", &rbuf[len - 1], 1);
+   if ((code == 0x02) || (code == 0x04))
+      dump("Read", rbuf, len - 1);
+   return rbuf[len - 1];
+}
+
+// ***************************************************************
+// Build a FID4 PIU: TH, RH and RU.  Returns its length.
+// ***************************************************************
+static int build_piu(uint8_t *buf, uint16_t def, uint16_t oef, uint16_t snf,
+                     uint8_t rh0, uint8_t rh1, uint8_t rh2, uint8_t *ru, int rulen) {
+   memset(buf, 0x00, TH4_LEN);
+   buf[0]  = 0x4C;                               // FID4, whole BIU
+   buf[8]  = (ncp_sa >> 24) & 0xFF;              // DSAF
+   buf[9]  = (ncp_sa >> 16) & 0xFF;
+   buf[10] = (ncp_sa >> 8) & 0xFF;
+   buf[11] = ncp_sa & 0xFF;
+   buf[12] = (host_sa >> 24) & 0xFF;             // OSAF
+   buf[13] = (host_sa >> 16) & 0xFF;
+   buf[14] = (host_sa >> 8) & 0xFF;
+   buf[15] = host_sa & 0xFF;
+   buf[17] = 0x0C;                               // MPF whole BIU, normal flow
+   buf[18] = def >> 8;                           // DEF
+   buf[19] = def & 0xFF;
+   buf[20] = oef >> 8;                           // OEF
+   buf[21] = oef & 0xFF;
+   buf[22] = snf >> 8;                           // SNF
+   buf[23] = snf & 0xFF;
+   buf[24] = (RH_LEN + rulen) >> 8;              // DCF
+   buf[25] = (RH_LEN + rulen) & 0xFF;
+   buf[TH4_LEN]     = rh0;
+   buf[TH4_LEN + 1] = rh1;
+   buf[TH4_LEN + 2] = rh2;
+   memcpy(&buf[TH4_LEN + RH_LEN], ru, rulen);
+   return TH4_LEN + RH_LEN + rulen;
+}
+
+// ***************************************************************
+// Write PIU's to the NCP.  Returns 0 if the CA ended the write
+// with channel end and device end.
+// ***************************************************************
+static int write_piu(uint8_t *buf, int len) {
+   int rc;
+
+   rc = exec_ccw(0x01, buf, len, NULL);
+   if (rc < 0)
+      return -1;
+   if (rc & (CSW_UCHK | CSW_UEXC)) {
+      printf("HOST: Write ended with status %02X\n", rc);
+      exec_ccw(0x04, NULL, 1, NULL);             // Sense clears the condition
+      return -1;
+   }
+   return 0;
+}
+
+// ***************************************************************
+// Wait for an attention and read the NCP data.
+// Returns the data length in rbuf, 0 on timeout, -1 on error.
+// ***************************************************************
+static int read_piu(int msec) {
+   uint8_t attn;
+   int rc, len;
+
+   rc = read_wait(tag_fd, &attn, 1, msec);
+   if (rc < 1)
+      return rc;
+   if (debug)
+      printf("HOST: Tag status %02X\n", attn);
+   rc = exec_ccw(0x02, NULL, BUFLEN_CA, &len);
+   if (rc < 0)
+      return -1;
+   return len;
+}
+
+// ***************************************************************
+// Send an SSCP request and wait for its positive response.
+// ***************************************************************
+static int sscp_req(char *name, uint16_t def, uint8_t *ru, int rulen) {
+   uint8_t buf[BUFLEN_CA];
+   int len, ptr, plen, rh;
+   struct timespec start, now;
+
+   sscp_snf++;
+   len = build_piu(buf, def, sscp_elem, sscp_snf, 0x6B, 0x80, 0x00, ru, rulen);
+   if (write_piu(buf, len) != 0)
+      return -1;
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   do {
+      if ((len = read_piu(1000)) < 0)
+         return -1;
+      for (ptr = 0; ptr + TH4_LEN + RH_LEN <= len; ptr = ptr + plen) {
+         plen = TH4_LEN + ((rbuf[ptr + 24] << 8) | rbuf[ptr + 25]);
+         rh = ptr + TH4_LEN;
+         if ((rbuf[rh] & 0x80) && (((rbuf[ptr + 20] << 8) | rbuf[ptr + 21]) == def)) {
+            if (rbuf[rh + 1] & 0x10) {
+               printf("HOST: %s to element %d rejected, sense %02X%02X%02X%02X\n", name, def,
+                      rbuf[rh + 3], rbuf[rh + 4], rbuf[rh + 5], rbuf[rh + 6]);
+               return -1;
+            }
+            printf("HOST: %s to element %d accepted\n", name, def);
+            return 0;
+         }
+      }
+      clock_gettime(CLOCK_MONOTONIC, &now);
+   } while (usec(&start, &now) < maxwait * 1000000.0);
+   printf("HOST: No response to %s for element %d\n", name, def);
+   return -1;
+}
+
+// ***************************************************************
+// IPL: send the loader records in file to the CA.
+// ***************************************************************
+static int ipl(char *file) {
+   FILE *fp;
+   uint8_t rec[BUFLEN_CA], hdr[2];
+   int len, rc, nrec = 0;
+
+   if ((fp = fopen(file, "rb")) == NULL) {
+      printf("HOST: Cannot open IPL file %s\n", file);
+      return -1;
+   }
+   while (fread(hdr, 1, 2, fp) == 2) {
+      len = (hdr[0] << 8) | hdr[1];
+      if ((len < 1) || (len > sizeof(rec)) || (fread(rec, 1, len, fp) != len)) {
+         printf("HOST: Invalid record %d in IPL file %s\n", nrec + 1, file);
+         fclose(fp);
+         return -1;
+      }
+      rc = exec_ccw((nrec == 0) ? 0x05 : 0x01, rec, len, NULL);
+      if ((rc < 0) || (rc & CSW_UCHK)) {
+         printf("HOST: IPL record %d ended with status %02X\n", nrec + 1, rc & 0xFF);
+         fclose(fp);
+         return -1;
+      }
+      nrec++;
+   }
+   fclose(fp);
+   printf("HOST: IPL complete, %d records loaded\n", nrec);
+   return 0;
+}
+
+// ***************************************************************
+// Convert a string of hex digits (blanks allowed) into buf.
+// ***************************************************************
+static int hex2bin(char *s, uint8_t *buf, int max) {
+   int len = 0, hi = -1, d;
+
+   for (; *s != '\0'; s++) {
+      if (isspace(*s))
+         continue;
+      if (!isxdigit(*s))
+         return -1;
+      d = isdigit(*s) ? *s - '0' : toupper(*s) - 'A' + 10;
+      if (hi < 0) {
+         hi = d;
+      } else {
+         if (len == max)
+            return -1;
+         buf[len++] = (hi << 4) | d;
+         hi = -1;
+      }
+   }
+   return (hi < 0) ? len : -1;
+}
+
+// ***************************************************************
+// Start the next transaction of a session.
+// ***************************************************************
+static int send_inq(struct Session *s, int inq) {
+   uint8_t buf[BUFLEN_CA], ru[BUFLEN_CA];
+   int len;
+
+   memset(ru, 0x40, inq);
+   ru[0] = 0xF5;                                 // Erase/Write
+   ru[1] = 0xC3;                                 // WCC
+   s->snf++;
+   len = build_piu(buf, s->lu, s->appl, s->snf, 0x03, 0x80, 0x20, ru, inq);
+   if (write_piu(buf, len) != 0)
+      return -1;
+   bytes_out = bytes_out + inq;
+   clock_gettime(CLOCK_MONOTONIC, &s->start);
+   s->phase = SS_RSP;
+   return 0;
+}
+
+// ***************************************************************
+// End a transaction: record its latency and start the think time.
+// ***************************************************************
+static void end_trans(struct Session *s, int think, long count) {
+   struct timespec now;
+   double t;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   t = usec(&s->start, &now);
+   s->lattot += t;
+   if ((s->trans == 0) || (t < s->latmin)) s->latmin = t;
+   if (t > s->latmax) s->latmax = t;
+   if (nlat < MAXLAT)
+      lat[nlat++] = t;
+   s->trans++;
+   if (s->trans + s->timeouts >= count) {
+      s->phase = SS_DONE;
+      return;
+   }
+   s->due = now;
+   s->due.tv_sec += think / 1000;
+   s->due.tv_nsec += (think % 1000) * 1000000L;
+   if (s->due.tv_nsec >= 1000000000L) {
+      s->due.tv_sec++;
+      s->due.tv_nsec -= 1000000000L;
+   }
+   s->phase = SS_THINK;
+}
+
+static int cmp_lat(const void *a, const void *b) {
+   double x = *(const double *)a, y = *(const double *)b;
+   return (x < y) ? -1 : (x > y);
+}
+
+// ***************************************************************
+// Run the transaction mix.
+// ***************************************************************
+static int mix(int nsess, int inq, int resp, int think, long count) {
+   struct timespec start, now;
+   struct Session *s;
+   uint8_t rsp[BUFLEN_CA];
+   double elapsed, t;
+   int len, ptr, plen, rh, rulen, done, i;
+   uint16_t oef;
+   long trans = 0, timeouts = 0;
+
+   if ((nsess < 1) || (nsess > nlus) || (inq < 2) || (inq > BUFLEN_CA - TH4_LEN - RH_LEN) || (count < 1)) {
+      printf("HOST: Invalid mix: sessions 1..%d (lu statement), inq 2..%d, count > 0\n",
+             nlus, BUFLEN_CA - TH4_LEN - RH_LEN);
+      return -1;
+   }
+   printf("HOST: Mix of %d session(s), %d byte inquiries, %d byte replies, think %d msec, %ld transactions per session\n",
+          nsess, inq, resp, think, count);
+   nlat = 0;
+   bytes_out = bytes_in = 0;
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   for (i = 0; i < nsess; i++) {
+      sess[i].trans = sess[i].timeouts = 0;
+      sess[i].lattot = sess[i].latmax = 0;
+      sess[i].due = start;
+      sess[i].phase = SS_THINK;
+   }
+
+   do {
+      // Start the sessions whose think time is over.
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      for (i = 0; i < nsess; i++) {
+         s = &sess[i];
+         if ((s->phase == SS_THINK) && (usec(&s->due, &now) >= 0))
+            if (send_inq(s, inq) != 0)
+               return -1;
+         if (((s->phase == SS_RSP) || (s->phase == SS_REPLY)) && (usec(&s->start, &now) > maxwait * 1000000.0)) {
+            s->timeouts++;
+            printf("HOST: Session with LU element %d timed out\n", s->lu);
+            s->phase = (s->trans + s->timeouts >= count) ? SS_DONE : SS_THINK;
+            s->due = now;
+         }
+      }
+
+      // Collect the NCP data and match it to the sessions.
+      if ((len = read_piu(1)) < 0)
+         return -1;
+      for (ptr = 0; ptr + TH4_LEN + RH_LEN <= len; ptr = ptr + plen) {
+         plen = TH4_LEN + ((rbuf[ptr + 24] << 8) | rbuf[ptr + 25]);
+         rulen = plen - TH4_LEN - RH_LEN;
+         rh = ptr + TH4_LEN;
+         oef = (rbuf[ptr + 20] << 8) | rbuf[ptr + 21];
+         for (i = 0; (i < nsess) && (sess[i].lu != oef); i++) ;
+         if (i == nsess)
+            continue;
+         s = &sess[i];
+         if (rbuf[rh] & 0x80) {                  // Response
+            if ((s->phase == SS_RSP) && (((rbuf[ptr + 22] << 8) | rbuf[ptr + 23]) == s->snf)) {
+               if (rbuf[rh + 1] & 0x10)
+                  printf("HOST: Negative response from LU element %d\n", s->lu);
+               if (resp > 0)
+                  s->phase = SS_REPLY;
+               else
+                  end_trans(s, think, count);
+            }
+         } else {                                // Request from the terminal
+            bytes_in = bytes_in + rulen;
+            if (rbuf[rh + 1] & 0x80) {           // Definite response requested ?
+               build_piu(rsp, s->lu, s->appl, (rbuf[ptr + 22] << 8) | rbuf[ptr + 23],
+                         0x83, 0x80, 0x00, NULL, 0);
+               if (write_piu(rsp, TH4_LEN + RH_LEN) != 0)
+                  return -1;
+            }
+            if (s->phase == SS_REPLY)
+               end_trans(s, think, count);
+         }
+      }
+
+      done = 1;
+      for (i = 0; i < nsess; i++)
+         if (sess[i].phase != SS_DONE) done = 0;
+   } while (done == 0);
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   elapsed = usec(&start, &now) / 1000000.0;
+
+   printf("\n  Session  LU elem  Transactions  Timeouts  Lat min(us)  Lat avg(us)  Lat max(us)\n");
+   for (i = 0; i < nsess; i++) {
+      s = &sess[i];
+      printf("  %7d  %7d  %12ld  %8ld  %11.0f  %11.0f  %11.0f\n", i, s->lu, s->trans, s->timeouts,
+             s->latmin, (s->trans > 0) ? s->lattot / s->trans : 0.0, s->latmax);
+      trans = trans + s->trans;
+      timeouts = timeouts + s->timeouts;
+   }
+   qsort(lat, nlat, sizeof(double), cmp_lat);
+   t = (nlat > 0) ? lat[(nlat * 95) / 100] : 0.0;
+   printf("\n  Elapsed: %.2f sec, %ld transactions, %ld timeouts\n", elapsed, trans, timeouts);
+   printf("  Throughput: %.1f transactions/sec, %.0f bytes/sec out, %.0f bytes/sec in\n",
+          trans / elapsed, bytes_out / elapsed, bytes_in / elapsed);
+   printf("  Latency: 95%% below %.0f usec\n\n", t);
+   return 0;
+}
+
+// ***************************************************************
+// Fetch the value of keyword=value from a mix statement.
+// ***************************************************************
+static long keyval(char *stmt, char *key, long dflt) {
+   char *p = strstr(stmt, key);
+   int n = strlen(key);
+
+   if ((p == NULL) || (p[n] != '='))
+      return dflt;
+   return atol(p + n + 1);
+}
+
+// ***************************************************************
+// Execute one script statement.
+// ***************************************************************
+static int statement(char *line, int lineno) {
+   uint8_t buf[BUFLEN_CA];
+   char verb[16], arg[256];
+   int len, rc, n;
+   uint8_t ccode[MAXCHAIN], *cdata[MAXCHAIN];
+   int ccount[MAXCHAIN];
+   unsigned int a, b;
+   uint8_t actpu_ru[] = { 0x11, 0x01, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01 };
+   uint8_t actlu_ru[] = { 0x0D, 0x01, 0x01 };
+   uint8_t sdt_ru[]   = { 0xA0 };
+   char *p;
+
+   verb[0] = arg[0] = '\0';
+   n = sscanf(line, "%15s %255[^\n]", verb, arg);
+   if ((n < 1) || (verb[0] == '*'))
+      return 0;
+   for (p = verb; *p != '\0'; p++)
+      *p = tolower(*p);
+
+   if (strcmp(verb, "ipl") == 0) {
+      return ipl(arg);
+   } else if (strcmp(verb, "ccw") == 0) {
+      if (sscanf(arg, "%x", &a) != 1)
+         goto bad;
+      p = strchr(arg, ' ');
+      len = (p != NULL) ? hex2bin(p, buf, sizeof(buf)) : 0;
+      if (len < 0)
+         goto bad;
+      rc = exec_ccw(a, buf, (len > 0) ? len : 1, NULL);
+      printf("HOST: CCW %02X ended with status %02X\n", a, rc & 0xFF);
+      return (rc < 0) ? -1 : 0;
+   } else if (strcmp(verb, "chain") == 0) {
+      len = 0;                                   // Write data is kept in buf
+      n = 0;
+      for (p = strtok(arg, " "); p != NULL; p = strtok(NULL, " ")) {
+         if ((n == MAXCHAIN) || (sscanf(p, "%x", &a) != 1))
+            goto bad;
+         ccode[n] = a;
+         cdata[n] = buf + len;
+         ccount[n] = 1;
+         if ((p = strchr(p, ':')) != NULL) {
+            if ((rc = hex2bin(p + 1, buf + len, sizeof(buf) - len)) < 1)
+               goto bad;
+            ccount[n] = rc;
+            len = len + rc;
+         } else if (a == 0x02) {
+            ccount[n] = BUFLEN_CA;
+         }
+         n++;
+      }
+      if (n == 0)
+         goto bad;
+      rc = exec_chain(n, ccode, cdata, ccount, &len);
+      printf("HOST: Chain of %d CCW's ended with status %02X, %d bytes read\n", n, rc & 0xFF, len);
+      return (rc < 0) ? -1 : 0;
+   } else if (strcmp(verb, "write") == 0) {
+      if ((len = hex2bin(arg, buf, sizeof(buf))) < 1)
+         goto bad;
+      return write_piu(buf, len);
+   } else if (strcmp(verb, "sa") == 0) {
+      if (sscanf(arg, "%u %u", &a, &b) != 2)
+         goto bad;
+      host_sa = a;
+      ncp_sa = b;
+   } else if (strcmp(verb, "sscp") == 0) {
+      sscp_elem = atoi(arg);
+   } else if (strcmp(verb, "appl") == 0) {
+      appl_elem = atoi(arg);
+   } else if (strcmp(verb, "lu") == 0) {
+      for (p = strtok(arg, ", "); (p != NULL) && (nlus < MAXSESS); p = strtok(NULL, ", ")) {
+         sess[nlus].lu = lus[nlus] = atoi(p);
+         sess[nlus].appl = appl_elem + nlus;
+         sess[nlus].snf = 0;
+         nlus++;
+      }
+   } else if (strcmp(verb, "actpu") == 0) {
+      return sscp_req("ACTPU", atoi(arg), actpu_ru, sizeof(actpu_ru));
+   } else if (strcmp(verb, "actlu") == 0) {
+      for (n = 0; n < nlus; n++)
+         if (sscp_req("ACTLU", lus[n], actlu_ru, sizeof(actlu_ru)) != 0)
+            return -1;
+   } else if (strcmp(verb, "bind") == 0) {
+      for (n = 0; n < nlus; n++) {
+         len = build_piu(buf, lus[n], sess[n].appl, 0, 0x6B, 0x80, 0x00, bind_ru, sizeof(bind_ru));
+         if (write_piu(buf, len) != 0)
+            return -1;
+         usleep(100000);
+         len = build_piu(buf, lus[n], sess[n].appl, 0, 0x6B, 0x80, 0x00, sdt_ru, sizeof(sdt_ru));
+         if (write_piu(buf, len) != 0)
+            return -1;
+         while (read_piu(500) > 0) ;             // Drain the BIND and SDT responses
+         printf("HOST: Session %d bound, application element %d, LU element %d\n", n, sess[n].appl, lus[n]);
+      }
+   } else if (strcmp(verb, "pause") == 0) {
+      usleep(atoi(arg) * 1000);
+   } else if (strcmp(verb, "mix") == 0) {
+      return mix(keyval(arg, "sessions", 1), keyval(arg, "inq", 64), keyval(arg, "resp", 0),
+                 keyval(arg, "think", 0), keyval(arg, "count", 100));
+   } else {
+      goto bad;
+   }
+   return 0;
+
+bad:
+   printf("HOST: Invalid statement in line %d: %s\n", lineno, line);
+   return -1;
+}
+
+int main(int argc, char *argv[]) {
+   FILE *fp;
+   char line[4096], *script = NULL;
+   int i, lineno = 0, ca = 1, port = 0;
+   unsigned int dev;
+
+   i = 1;
+   while (i < argc) {
+      if ((strcmp(argv[i], "-host") == 0) && (i + 1 < argc)) {
+         hostaddr = argv[i+1];
+         i = i + 2;
+      } else if ((strcmp(argv[i], "-ca") == 0) && (i + 1 < argc)) {
+         ca = atoi(argv[i+1]);
+         i = i + 2;
+      } else if ((strcmp(argv[i], "-port") == 0) && (i + 1 < argc)) {
+         port = (tolower(argv[i+1][0]) == 'b') ? 1 : 0;
+         i = i + 2;
+      } else if ((strcmp(argv[i], "-devnum") == 0) && (i + 1 < argc)) {
+         sscanf(argv[i+1], "%x", &dev);
+         devnum = dev;
+         i = i + 2;
+      } else if ((strcmp(argv[i], "-gap") == 0) && (i + 1 < argc)) {
+         gap = atoi(argv[i+1]);
+         i = i + 2;
+      } else if ((strcmp(argv[i], "-wait") == 0) && (i + 1 < argc)) {
+         maxwait = atoi(argv[i+1]);
+         i = i + 2;
+      } else if (strcmp(argv[i], "-chain") == 0) {
+         cpgm = 1;
+         i++;
+      } else if (strcmp(argv[i], "-d") == 0) {
+         debug = 1;
+         i++;
+      } else if ((argv[i][0] != '-') && (script == NULL)) {
+         script = argv[i];
+         i++;
+      } else {
+         script = NULL;
+         break;
+      }
+   }
+   if ((script == NULL) || (ca < 1) || (ca > 2) || (gap < 0) || (maxwait < 1)) {
+      printf("HOST: Usage: i3705_host [options] script\n");
+      printf("   Valid options are:\n");
+      printf("    -host {addr}   : address of the 3705 (default 127.0.0.1)\n");
+      printf("    -ca {1|2}      : channel adapter (default 1)\n");
+      printf("    -port {a|b}    : channel adapter port (default a)\n");
+      printf("    -devnum {xxxx} : device number (default 0660)\n");
+      printf("    -gap {usec}    : delay between a CCW and its write data (default 2000)\n");
+      printf("    -wait {sec}    : response time limit (default 10)\n");
+      printf("    -chain         : send CCW's as channel programs\n");
+      printf("    -d             : trace channel I/O\n");
+      return 1;
+   }
+   caport = CAPORT + ((ca - 1) * 2) + port;
+   if ((fp = fopen(script, "r")) == NULL) {
+      printf("HOST: Cannot open script %s\n", script);
+      return 1;
+   }
+   if (ca_connect() != 0)
+      return 1;
+
+   while (fgets(line, sizeof(line), fp) != NULL) {
+      lineno++;
+      line[strcspn(line, "\r\n")] = '\0';
+      if (statement(line, lineno) != 0) {
+         printf("HOST: Script stopped at line %d\n", lineno);
+         fclose(fp);
+         return 1;
+      }
+   }
+   fclose(fp);
+   close(bus_fd);
+   close(tag_fd);
+   return 0;
+}
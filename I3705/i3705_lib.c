@@ -99,9 +99,11 @@
 #include <sys/ioctl.h>
 #include <sys/syscall.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <pthread.h>
 #include <ncurses.h>
+#include <time.h>
 
 #define RED_BLACK    1
 #define GREEN_BLACK  2
@@ -118,20 +120,56 @@
 #define LIBLBASE        20             // LIB line ports start at 20
 
 #define SYN 0x32
+#define PAD 0xFF                       // Ends each BSC transmission block
+#define TADDR_NEW  -2                  // LIBtaddr: no part of the frame sent yet
+
+#define T1_SPEED        1544000        // T1 line speed (bps)
+#define TXQLEN          (4 * BUFLEN_327x)   // Transmit queue size per line
+#define TXQ_HIWAT       (2 * BUFLEN_327x)   // Above this CTS is held low for the line
+#define MAXSTAT         8              // Secondary stations (327x connections) per multipoint line
+#define MAXLEAD         (2 * MAXSTAT)  // Accepted connections waiting to be identified per line
+#define LEADTMO         5              // Seconds a lead may wait to be identified or paired
+#define LEAD_DATA       0x44           // First byte on a data lead ('D')
+#define LEAD_SIG        0x53           // First byte on a signal lead ('S'), then the port of its data lead
+
+struct LIBStat {                       // One secondary station (327x) on a line
+   int      d327x_fd;                  // Data lead connection
+   int      s327x_fd;                  // RS232 signal lead connection
+   uint8_t  LIB_txq[TXQLEN];           // Transmit queue (frames waiting to go to this 327x)
+   uint32_t txqhead;                   // First byte in transmit queue
+   uint32_t txqlen;                    // Bytes in transmit queue
+   struct sockaddr_in dpeer;           // Remote end of the data lead (the signal lead names it)
+   time_t   tconn;                     // When the data lead was identified
+};
 
 struct LIBLine {
    int      line_fd;
    int      linenum;
-   int      d327x_fd;                  // Data lead connection
-   int      s327x_fd;                  // RS232 signal lead connection
+   struct LIBStat *stat[MAXSTAT];      // Stations on this line (NULL = free slot)
+   int      nstat;                     // Stations with both leads connected
+   int      nhalf;                     // Stations still waiting for their signal lead
+   int      lead_fd[MAXLEAD];          // Accepted connections not identified yet (0 = free)
+   time_t   lead_t[MAXLEAD];           // ...and when they were accepted
+   int      nlead;                     // Connections not identified yet
+   int8_t   addrmap[256];              // SDLC station address -> station (-1 = not yet seen)
+   int      rstat;                     // Station that filled the receive buffer last
    int      epoll_fd;                  // Event polling file desciptor
    uint8_t  LIB_rbuf[BUFLEN_327x];     // Received data buffer
    uint8_t  LIB_tbuf[BUFLEN_327x];     // Transmit data buffer
    uint16_t LIBrlen;                   // Size of received data in buffer
+   uint16_t LIBrptr;                   // Next received character in buffer
    uint16_t LIBtlen;                   // Size of transmit data in buffer
+   int      LIBtaddr;                  // Station address of a frame sent in parts (TADDR_NEW)
+   int8     LIBtsdlc;                  // Transmission is SDLC (1), BSC (0) or not known yet (-1)
    int8     LIBsync;                   // Track receive progress
+   uint32_t txqlen;                    // Bytes in the transmit queues of all stations
+   double   tokens[2];                 // Speed model: characters that may pass now (LIB_TX, LIB_RX)
+   struct timespec tb_last[2];         // Speed model: time of last token refill
 } *LIBline[MAX_LINES];
 
+uint32_t LIBspeed[MAX_LINES];          // Line speed in bps (0 = unlimited). SET CPU LINESPEED=
+uint8_t  LIBduplex[MAX_LINES];         // Line is full duplex (ON/OFF). SET CPU DUPLEX=
+
 struct epoll_event event, events[MAX_LINES];
 
 pthread_mutex_t line_lock;             // Line lock
@@ -147,6 +185,8 @@ extern uint16_t Sdbg_flag;             // 1 when S_trace.log open
 extern FILE *S_trace;                  // Scanner trace file fd
 
 extern int32 Eregs_Inp[];              // Input registers (only needed for the cycle counter)
+extern int8 coop_mode;                 // Cooperative run mode: LIB runs in the CCU thread
+int coop_yield(void);
 int8 station;                          // Station #
 uint8_t prev_state;
 
@@ -208,24 +248,13 @@ void proc_LIBdisbuf(int k)  {
    if ( LIBline[k]->LIBrlen != 0) {
       pthread_mutex_lock(&line_lock);
       LIBline[k]->LIBrlen = 0;                              // set to no data in buffer.
+      LIBline[k]->LIBrptr = 0;
       pthread_mutex_unlock(&line_lock);
       if ((Sdbg_flag == ON) && (Sdbg_reg & 0x04))           // Trace line activities ?
          fprintf(S_trace, "\r#04L%1d< buffer content discarded\n", k);
    }
 }
 
-//*********************************************************************
-//  Function Shift all chacters in an array to the left.              *
-//*********************************************************************
-static int ShiftLeft(char *buffer, int len)  {
-   int i;
-   for (i = 1; i < len; i++) {
-      buffer[i - 1] = buffer[i];
-   }
-   len--;
-   return len;
-}
-
 //*********************************************************************
 // Function to check if socket is (still) connected                   *
 //*********************************************************************
@@ -243,15 +272,178 @@ static bool IsSocketConnected(int sockfd) {
    return true;
 }
 
+//*********************************************************************
+// Station address of the SDLC frame(s) in a buffer.                  *
+// Returns -1 if the buffer does not start with a flag (BSC data).    *
+//*********************************************************************
+static int LIBaddr(uint8_t *buf, int len) {
+   int i = 0;
+   if ((i < len) && ((buf[i] == 0x00) || (buf[i] == 0xAA))) i++;    // Skip modem clocking
+   if ((i >= len) || (buf[i] != 0x7E))                              // No SDLC flag ?
+      return -1;
+   while ((i < len) && (buf[i] == 0x7E)) i++;                       // Skip (consecutive) flags
+   if (i >= len)
+      return -1;
+   return buf[i];
+}
+
+//*********************************************************************
+// Remove a station from a line and close its connections.            *
+// When the last station has gone, DCD, DSR and RI are dropped.       *
+// Must not be called with rs232_lock held (lock order is line_lock,  *
+// then rs232_lock).                                                  *
+//*********************************************************************
+static void LIBstat_close(int k, int s) {
+   struct LIBStat *st;
+   int left;
+
+   pthread_mutex_lock(&line_lock);
+   st = LIBline[k]->stat[s];
+   LIBline[k]->stat[s] = NULL;
+   LIBline[k]->txqlen -= st->txqlen;                                // Discard its queued frames
+   for (int a = 0; a < 256; a++)
+      if (LIBline[k]->addrmap[a] == s)
+         LIBline[k]->addrmap[a] = -1;                               // Forget its station address(es)
+   if (st->s327x_fd > 0)
+      LIBline[k]->nstat--;
+   else
+      LIBline[k]->nhalf--;
+   left = LIBline[k]->nstat;
+   pthread_mutex_unlock(&line_lock);
+
+   close (st->d327x_fd);                                            // Close the data socket of this station
+   if (st->s327x_fd > 0)
+      close (st->s327x_fd);                                         // Close its RS232 signal socket
+   free(st);
+   if (left == 0) {
+      pthread_mutex_lock(&rs232_lock);
+      RS232[k] &= ~(DCD | DSR | RI);                                // Set DCD, DSR and RI off;
+      pthread_mutex_unlock(&rs232_lock);
+   }
+   printf("\rLIB: 327x disconnected from line-%d (station %d)\n", k+LIBLBASE, s);
+   // Re-enable event polling for this line (i.e. poll for a new connection request).
+   event.events = EPOLLIN;
+   event.data.fd = LIBline[k]->line_fd;
+   if (epoll_ctl(LIBline[k]->epoll_fd, EPOLL_CTL_MOD, LIBline[k]->line_fd, &event)) {
+      printf("\rLIB: Modifying polling event error %d for line-%d\n", errno, k+LIBLBASE);
+      close(LIBline[k]->epoll_fd);
+   }  // End  if (epoll_ctl(LIBline[k]->epoll_fd
+   return;
+}
+
+//*********************************************************************
+// Identify the connections accepted on a line and pair them into     *
+// stations. A 327x starts its data lead with LEAD_DATA and its       *
+// signal lead with LEAD_SIG and the port of its data lead, so leads  *
+// of stations connecting at the same time are not mixed up, whatever *
+// order they arrive in. A connection that is not identified, or a    *
+// station that gets no signal lead, within LEADTMO seconds is closed.*
+//*********************************************************************
+static void LIBlead_check(int k) {
+   struct LIBStat *st;
+   struct sockaddr_in peer;
+   socklen_t peerlen;
+   uint8_t hello[3];
+   time_t now = time(NULL);
+   int fd, s, rc, done;
+
+   for (int l = 0; l < MAXLEAD; l++) {
+      fd = LIBline[k]->lead_fd[l];
+      if (fd < 1)
+         continue;
+      done = 1;
+      rc = recv(fd, hello, sizeof(hello), MSG_PEEK | MSG_DONTWAIT);
+      peerlen = sizeof(peer);
+      getpeername(fd, (struct sockaddr *)&peer, &peerlen);
+      if ((rc >= 1) && (hello[0] == LEAD_DATA)) {                   // Data lead of a new station ?
+         for (s = 0; s < MAXSTAT; s++)
+            if (LIBline[k]->stat[s] == NULL) break;
+         if (s == MAXSTAT) {
+            printf("\rLIB: Line-%d has %d stations already, connection refused\n", k+LIBLBASE, MAXSTAT);
+            close(fd);
+         } else {
+            recv(fd, hello, 1, 0);                                  // Take the identification off
+            st = malloc(sizeof(struct LIBStat));
+            st->d327x_fd = fd;
+            st->s327x_fd = 0;
+            st->txqhead = 0;
+            st->txqlen = 0;
+            st->dpeer = peer;
+            st->tconn = now;
+            pthread_mutex_lock(&line_lock);
+            LIBline[k]->stat[s] = st;
+            LIBline[k]->nhalf++;
+            pthread_mutex_unlock(&line_lock);
+         }
+      } else if ((rc == sizeof(hello)) && (hello[0] == LEAD_SIG)) { // ...or a signal lead ?
+         for (s = 0; s < MAXSTAT; s++) {                            // Find the station of its data lead
+            st = LIBline[k]->stat[s];
+            if ((st != NULL) && (st->s327x_fd < 1) &&
+                (st->dpeer.sin_addr.s_addr == peer.sin_addr.s_addr) &&
+                (memcmp(&st->dpeer.sin_port, &hello[1], 2) == 0))
+               break;
+         }
+         if (s < MAXSTAT) {
+            recv(fd, hello, sizeof(hello), 0);                      // Take the identification off
+            pthread_mutex_lock(&line_lock);
+            st->s327x_fd = fd;
+            LIBline[k]->nstat++;
+            LIBline[k]->nhalf--;
+            pthread_mutex_unlock(&line_lock);
+            if (LIBline[k]->nstat == 1) {
+               pthread_mutex_lock(&rs232_lock);
+               RS232[k] = DCD | RI;                                 // DCD and RI on
+               pthread_mutex_unlock(&rs232_lock);
+            }
+            printf("\rLIB: 327x connected to line-%d (station %d)\n", k+LIBLBASE, s);
+         } else if (now - LIBline[k]->lead_t[l] >= LEADTMO) {
+            printf("\rLIB: Signal lead on line-%d without a data lead, connection closed\n", k+LIBLBASE);
+            close(fd);
+         } else {
+            done = 0;                                               // Its data lead may still come
+         }
+      } else if ((rc == 0) || ((rc < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK))) {
+         close(fd);                                                 // Gone before it said what it is
+      } else if ((rc > 0) && (hello[0] != LEAD_SIG)) {
+         printf("\rLIB: Unidentified connection on line-%d closed\n", k+LIBLBASE);
+         close(fd);
+      } else if (now - LIBline[k]->lead_t[l] >= LEADTMO) {
+         printf("\rLIB: No lead identification on line-%d, connection closed\n", k+LIBLBASE);
+         close(fd);
+      } else {
+         done = 0;                                                  // Wait for (the rest of) the identification
+      }
+      if (done == 1) {
+         LIBline[k]->lead_fd[l] = 0;
+         LIBline[k]->nlead--;
+      }
+   }  // End for l
+   for (s = 0; s < MAXSTAT; s++) {                                  // Free half-open stations
+      st = LIBline[k]->stat[s];
+      if ((st != NULL) && (st->s327x_fd < 1) && (now - st->tconn >= LEADTMO)) {
+         printf("\rLIB: No signal lead for station %d on line-%d\n", s, k+LIBLBASE);
+         LIBstat_close(k, s);
+      }
+   }  // End for s
+   return;
+}
+
 //*******************************************************************************************
-// Check if there is a signal update from the RS232 connection                              *
+// Check if there is a signal update from the RS232 connections of the stations on the line *
 // If so, receive signal data from the RS232 connection and assert related local DCE signal *
-// If an error occurs, both the line and the RS232 connection will be closed                *
+// The local DCE signals are sent to all stations (multipoint: they all share the line).    *
+// If an error occurs, the connections of that station will be closed                       *
 //*******************************************************************************************
 static void ReadSig(int k) {
    int rc, pendingrcv;
    uint8_t sig;
+   int gone[MAXSTAT];
+   int backed;
+   struct LIBStat *st;
    RS232x[k] = 0;                                        // Flag transmit off
+   pthread_mutex_lock(&line_lock);
+   backed = (LIBline[k]->txqlen >= TXQ_HIWAT);           // Transmit queues backed up ?
+   pthread_mutex_unlock(&line_lock);
    pthread_mutex_lock(&rs232_lock);
    if ((RS232[k] & DTR) && (!(RS232[k] & DSR))) {
       RS232[k] |= DSR;                                   // ...set DSR high (scanner may receive/transmit)
@@ -266,27 +458,41 @@ static void ReadSig(int k) {
    if ((!(RS232[k] & DTR)) && (RS232[k] & RTS)) {
       RS232[k] &= ~RTS;                                  // ...set RTS low for local (remote scanner should not transmit)
       RS232r[k] &= ~CTS;                                 // ...set CTS low for remote (remote scanner should not transmit)
+      if (LIBduplex[k] == ON)
+         RS232[k] &= ~CTS;                               // ...a full duplex line is not turned around, drop CTS here
+      RS232x[k] = 1;                                     // Flag transmit on
+   }
+   // A full duplex line has a carrier both ways: RTS and CTS stay on as long as DTR is on,
+   // so there is no RTS/CTS exchange with the remote for each transmission.
+   if ((LIBduplex[k] == ON) && (RS232[k] & DTR) && (!(RS232[k] & CTS)) &&
+       (backed == 0)) {                                  // ...unless the transmit queues are backed up
+      RS232[k] |= RTS | CTS;
+      RS232r[k] |= RTS | CTS;
       RS232x[k] = 1;                                     // Flag transmit on
    }
-   if (LIBline[k]->s327x_fd > 0) {                                  // If there is a connection...
-      if (IsSocketConnected(LIBline[k]->s327x_fd)) {                // ...and if it is still alive...
+   for (int s = 0; s < MAXSTAT; s++) {
+      gone[s] = 0;
+      st = LIBline[k]->stat[s];
+      if ((st == NULL) || (st->s327x_fd < 1))                       // No station, or no signal lead yet
+         continue;
+      if (IsSocketConnected(st->s327x_fd)) {                        // If the connection is still alive...
          pendingrcv = 0;
-         rc = ioctl(LIBline[k]->s327x_fd, FIONREAD, &pendingrcv);   // ...check for (signal) data in the TCP buffer
+         rc = ioctl(st->s327x_fd, FIONREAD, &pendingrcv);           // ...check for (signal) data in the TCP buffer
          if (pendingrcv > 0) {                                      // If there is data...
-            if (pendingrcv > 1)
             //******************************************************
             for (int i = 0; i < pendingrcv; i++) {
-               rc = read(LIBline[k]->s327x_fd, &sig, 1);            // ...read it
+               rc = read(st->s327x_fd, &sig, 1);                    // ...read it
             }
             //******************************************************
             if ((Sdbg_flag == ON) && (Sdbg_reg & 0x04))             // Trace line activities ?
-               fprintf(S_trace, "\r#04L%1d< received RS232 = %02X\n", k, sig);
+               fprintf(S_trace, "\r#04L%1d< received RS232 = %02X from station %d\n", k, sig, s);
             if (rc == 1) {                                          // If signal data weas received (must be 1 byte only) ....
                if ((sig & RTS) && (RS232[k] & DTR) && (LIBline[k]->LIBrlen == 0)) {   // If remote DCE has set RTS and CTS was not yet high....
                    RS232r[k] |= CTS;
                    RS232x[k] = 1;                                   // Flag transmit on
                }
-               if ((sig & CTS) && (RS232[k] & DTR) && (!(RS232[k] & CTS))) {    // If remote DCE has set RTS and CTS was not yet high....
+               if ((sig & CTS) && (RS232[k] & DTR) && (!(RS232[k] & CTS)) &&  // If remote DCE has set RTS and CTS was not yet high....
+                   (backed == 0)) {                                            // ...and the transmit queues are not backed up
                    RS232[k] |= CTS;
                } // End if (sig & RTS)
             }  // End if (rc == 1)
@@ -294,105 +500,205 @@ static void ReadSig(int k) {
          // Send the current RS232 signal back. NB: THis might include updates made by the scanner,
          //******************************************************
          if (RS232x[k] == 1) {
-            rc = send(LIBline[k]->s327x_fd, &RS232r[k], 1, 0);          // send current RS232 signal.
+            rc = send(st->s327x_fd, &RS232r[k], 1, 0);              // send current RS232 signal.
             if (rc != 1)
-               printf("\rLIB: RS232 signal exchange  failure on line-%d\n",k+LIBLBASE);
+               printf("\rLIB: RS232 signal exchange  failure on line-%d station %d\n", k+LIBLBASE, s);
          }
          //******************************************************
       } else {
-         // Close the connection and add a new polling event, to allow for a re-connect.
-         close (LIBline[k]->d327x_fd);                              // Close the data socket for this line
-         LIBline[k]->d327x_fd = 0;                                  // Reset file descriptor
-         close (LIBline[k]->s327x_fd);                              // Close RS232 signal socket
-         LIBline[k]->s327x_fd = 0;                                  // Reset file descriptor
-         RS232[k] &= ~(DCD | DSR | RI);                             // Set DCD, DSR and RI off;
-         printf("\rLIB: 327x disconnected from line-%d\n", k+LIBLBASE);
-         // Re-enable event polling for this line (i.e. poll for a new connection request).
-         event.events = EPOLLIN;
-         event.data.fd = LIBline[k]->line_fd;
-         if (epoll_ctl(LIBline[k]->epoll_fd, EPOLL_CTL_MOD, LIBline[k]->line_fd, &event)) {
-            printf("\rLIB: Modifying polling event error %d for line-%d\n", errno, k+LIBLBASE);
-            close(LIBline[k]->epoll_fd);
-         }  // End  if (epoll_ctl(LIBline[k]->epoll_fd
+         gone[s] = 1;                                               // Close it once rs232_lock is released
       }  // End if IsSocketConnected
-   }  // End  if (LIBline[k]->s327x_fd > 0)
+   }  // End for s
    pthread_mutex_unlock(&rs232_lock);
+   for (int s = 0; s < MAXSTAT; s++)
+      if (gone[s] == 1)
+         LIBstat_close(k, s);
    return;
 }
 //*********************************************************************
 // Receive data from the line (SDLC or BSC frame)                     *
-// If an error occurs, the connection will be closed                  *
+// On a multipoint line only the polled station answers. The stations *
+// are checked round robin, and the address of an SDLC response tells *
+// which station has it, so later frames for it go there only.        *
+// Lost connections are closed by ReadSig (LIB thread).               *
 //*********************************************************************
 int ReadLIB(int k) {
-   int rc, j, pendingrcv;
+   int rc, s, addr, pendingrcv;
+   struct LIBStat *st;
    LIBline[k]->LIBrlen = 0;                                         // Preset to no data received.
+   LIBline[k]->LIBrptr = 0;
    rc = -1;                                                         // Preset return coe
-   if (LIBline[k]->d327x_fd > 0) {                                  // If there is a connection...
-      if (IsSocketConnected(LIBline[k]->d327x_fd)) {                // ...and if it is still alive...
-         pendingrcv = 0;
-         rc = ioctl(LIBline[k]->d327x_fd, FIONREAD, &pendingrcv);   // ...check for any data in the TCP buffer
-         if (pendingrcv > 0) {
-            pthread_mutex_lock(&line_lock);
-            LIBline[k]->LIBrlen = read(LIBline[k]->d327x_fd, LIBline[k]->LIB_rbuf, BUFLEN_327x); // If data available, read it
-            pthread_mutex_unlock(&line_lock);
-         }  // End if (pendingrcv > 0)
-         return 0;                                                  // return
-      } else {
-         // Close the connection and add a new polling event, to allow for a re-connect.
-         close (LIBline[k]->d327x_fd);
-         LIBline[k]->d327x_fd = 0;
-         RS232[k] &= ~(DCD | DSR | RI);                             // Set DCD, DSR and RI off;
-         printf("\rLIB: 327x disconnected from line-%d\n", k+LIBLBASE);
-         // Re-enable event polling for this line (i.e. poll for a new connection request).
-         event.events = EPOLLIN;
-         event.data.fd = LIBline[k]->line_fd;
-         if (epoll_ctl(LIBline[k]->epoll_fd, EPOLL_CTL_MOD, LIBline[k]->line_fd, &event)) {
-            printf("\rLIB: Modifying polling event error %d for line-%d\n", errno, k+LIBLBASE);
-            close(LIBline[k]->epoll_fd);
-            return -1;
+   pthread_mutex_lock(&line_lock);
+   for (int n = 1; n <= MAXSTAT; n++) {
+      s = (LIBline[k]->rstat + n) % MAXSTAT;                        // Start after the last sender
+      st = LIBline[k]->stat[s];
+      if ((st == NULL) || (st->s327x_fd < 1))                       // No (complete) station
+         continue;
+      if (!IsSocketConnected(st->d327x_fd))                         // Connection lost ?
+         continue;
+      rc = 0;
+      pendingrcv = 0;
+      ioctl(st->d327x_fd, FIONREAD, &pendingrcv);                   // ...check for any data in the TCP buffer
+      if (pendingrcv > 0) {
+         LIBline[k]->LIBrlen = read(st->d327x_fd, LIBline[k]->LIB_rbuf, BUFLEN_327x); // If data available, read it
+         LIBline[k]->rstat = s;
+         addr = LIBaddr(LIBline[k]->LIB_rbuf, LIBline[k]->LIBrlen);
+         if ((addr >= 0) && (addr != 0xFF) && (LIBline[k]->addrmap[addr] != s)) {
+            LIBline[k]->addrmap[addr] = s;                          // This station answers to addr
+            if ((Sdbg_flag == ON) && (Sdbg_reg & 0x04))             // Trace line activities ?
+               fprintf(S_trace, "\r#04L%1d< station address %02X is station %d\n", k, addr, s);
          }
-      }  // End if IsSocketConnected
-      return -1;
-   }  // End  if (LIBline[k]->d327x_fd > 0)
+         break;
+      }  // End if (pendingrcv > 0)
+   }  // End for n
+   pthread_mutex_unlock(&line_lock);
    return rc;
 }
 
+//*********************************************************************
+//   Transmit queue. Frames are queued per station and sent without   *
+//   blocking, so a slow 327x only holds up its own line. If the      *
+//   queues back up beyond TXQ_HIWAT, CTS is dropped and held low     *
+//   until they have drained, which makes NCP wait in PCF 8.          *
+//   DSR stays up: the scanner reports a DSR drop to NCP as a data    *
+//   set failure (PCF 2), which ends the transmission, not delays it. *
+//   An SDLC frame goes to the station that answers to its address.   *
+//   Frames for an address not seen yet, broadcasts (FF) and BSC      *
+//   data go to all stations on the line.                             *
+//*********************************************************************
+static void LIBtxq_put(int line, int addr, uint8_t *buf, int len) {
+   struct LIBStat *st;
+   uint32_t tail;
+   int dest;
+
+   pthread_mutex_lock(&line_lock);
+   dest = ((addr >= 0) && (addr != 0xFF)) ? LIBline[line]->addrmap[addr] : -1;
+   for (int s = 0; s < MAXSTAT; s++) {
+      st = LIBline[line]->stat[s];
+      if ((st == NULL) || (st->s327x_fd < 1) || ((dest >= 0) && (dest != s)))
+         continue;
+      if (st->txqlen + len > TXQLEN) {                               // No room ?
+         printf("\rLIB: Transmit queue overflow on line-%d station %d, frame of %d bytes dropped\n", line+LIBLBASE, s, len);
+         continue;
+      }
+      for (int i = 0; i < len; i++) {
+         tail = (st->txqhead + st->txqlen) % TXQLEN;
+         st->LIB_txq[tail] = buf[i];
+         st->txqlen++;
+      }
+      LIBline[line]->txqlen += len;
+   }  // End for s
+   if (LIBline[line]->txqlen > TXQ_HIWAT) {                          // Backed up ?
+      pthread_mutex_lock(&rs232_lock);
+      RS232[line] &= ~CTS;                                           // Hold off the next transmission
+      pthread_mutex_unlock(&rs232_lock);
+      if ((Sdbg_flag == ON) && (Sdbg_reg & 0x04))                    // Trace line activities ?
+         fprintf(S_trace, "\r#04L%1d> transmit queues at %d bytes, CTS dropped\n", line, LIBline[line]->txqlen);
+   }
+   pthread_mutex_unlock(&line_lock);
+   return;
+}
+
+static void LIBtxq_send(int line) {
+   struct LIBStat *st;
+   uint32_t len;
+   ssize_t rc;
+
+   pthread_mutex_lock(&line_lock);
+   for (int s = 0; s < MAXSTAT; s++) {
+      st = LIBline[line]->stat[s];
+      if (st == NULL)
+         continue;
+      while (st->txqlen > 0) {
+         len = TXQLEN - st->txqhead;                                 // Contiguous part of the queue
+         if (len > st->txqlen)
+            len = st->txqlen;
+         rc = send(st->d327x_fd, &st->LIB_txq[st->txqhead], len, MSG_DONTWAIT | MSG_NOSIGNAL);
+         if (rc <= 0)                                                // Socket full or gone (a lost connection is handled by ReadSig)
+            break;
+         st->txqhead = (st->txqhead + rc) % TXQLEN;
+         st->txqlen -= rc;
+         LIBline[line]->txqlen -= rc;
+      }  // End while
+   }  // End for s
+   pthread_mutex_unlock(&line_lock);
+   return;
+}
+
+//*********************************************************************
+//   Send the (part of a) frame in LIB_tbuf to the station(s).        *
+//   The parts of a frame longer than LIB_tbuf all go where its       *
+//   first part went. last = 1 when the frame is complete.            *
+//*********************************************************************
+static void LIBtframe(int line, int last) {
+   struct LIBLine *ln = LIBline[line];
+   int addr;
+
+   if ((Sdbg_flag == ON) && (Sdbg_reg & 0x04)) {                     // Trace line activities ?
+      fprintf(S_trace, "\n#04L%1d> Transmit Buffer (%d bytes): ", line, ln->LIBtlen);
+      for (int i = 0; i < ln->LIBtlen; i ++) {
+          fprintf(S_trace, "%02X ", ln->LIB_tbuf[i]);
+      }  // End for
+      fprintf(S_trace, "\n\r");
+   }  // End if Sdbg_reg
+   addr = (ln->LIBtaddr != TADDR_NEW) ? ln->LIBtaddr : LIBaddr(ln->LIB_tbuf, ln->LIBtlen);
+   //**************************************************************
+   LIBtxq_put(line, addr, ln->LIB_tbuf, ln->LIBtlen);               // Queue frame for its station(s)
+   LIBtxq_send(line);                                                // ...and send what the socket takes now
+   //**************************************************************
+   ln->LIBtaddr = (last == 1) ? TADDR_NEW : addr;
+   ln->LIBtlen = 0;
+}
 
 //*********************************************************************
 //   Get transmitted Character from scanner                           *
+//   Each frame goes to the station as soon as it is complete (SDLC   *
+//   closing flag after the FCS, BSC PAD), so the frames of one       *
+//   transmission do not wait for the turnaround and LIB_tbuf holds   *
+//   one frame at most.                                               *
 //*********************************************************************
 void proc_LIBtdata (unsigned char LIBtchar, uint8_t state, int line) {
-uint8 rc;
-
-   // Scanner state C or D  means end of transmission, send buffer to controller.
-   if ((LIBline[line]->LIBsync == 1) && ((state == 0xC) || (state == 0xD))) {
-      if ((Sdbg_flag == ON) && (Sdbg_reg & 0x04)) {                  // Trace line activities ?
-         fprintf(S_trace, "\n#04L%1d> Transmit Buffer (%d bytes): ", line, LIBline[line]->LIBtlen);
-         for (int i = 0; i < LIBline[line]->LIBtlen; i ++) {
-             fprintf(S_trace, "%02X ", LIBline[line]->LIB_tbuf[i]);
-         }  // End for
-         fprintf(S_trace, "\n\r");
-      }  // End if Sdbg_reg
+   struct LIBLine *ln = LIBline[line];
+   int i;
 
-      LIBline[line]->LIBsync = 0;                                    // Reset SYNC.
-      //**************************************************************
-      rc = send(LIBline[line]->d327x_fd, LIBline[line]->LIB_tbuf, LIBline[line]->LIBtlen, 0); // Send frame
-      //**************************************************************
-      LIBline[line]->LIBtlen = 0;                                    // Reset transmitted data length.
+   // Scanner state C or D  means end of transmission, send what is left to controller.
+   if ((ln->LIBsync == 1) && ((state == 0xC) || (state == 0xD))) {
+      ln->LIBsync = 0;                                               // Reset SYNC.
+      for (i = 0; (i < ln->LIBtlen) && (ln->LIBtsdlc == 1) &&       // Only flags (or modem clocking)
+                  ((ln->LIB_tbuf[i] == 0x7E) || (ln->LIB_tbuf[i] == 0x00) || (ln->LIB_tbuf[i] == 0xAA)); i++) ;
+      if (i < ln->LIBtlen)                                           // ...need not be sent.
+         LIBtframe(line, 1);
+      ln->LIBtlen = 0;                                               // Reset transmitted data length.
+      ln->LIBtaddr = TADDR_NEW;
    }  // End if state
 
    // If we are in receive mode, append the character to the buffer.
-   if ((LIBline[line]->LIBsync == 1) && (state != 0x8)) {
-      LIBline[line]->LIB_tbuf[LIBline[line]->LIBtlen] = LIBtchar;    // Add character to buffer
-      LIBline[line]->LIBtlen++;                                      // Increment length
+   if ((ln->LIBsync == 1) && (state != 0x8)) {
+      if (ln->LIBtlen == BUFLEN_327x)                                // Frame does not fit...
+         LIBtframe(line, 0);                                         // ...send the first part now
+      if ((ln->LIBtsdlc == -1) && (LIBtchar != 0x00) && (LIBtchar != 0xAA))
+         ln->LIBtsdlc = (LIBtchar == 0x7E);                          // SDLC starts with a flag, BSC with SYN
+      ln->LIB_tbuf[ln->LIBtlen] = LIBtchar;                          // Add character to buffer
+      ln->LIBtlen++;                                                 // Increment length
+      if (LIBspeed[line] != 0)
+         ln->tokens[LIB_TX] -= 1.0;                                  // Character has passed the line
+      if ((ln->LIBtsdlc == 1) && (LIBtchar == 0x7E) && (ln->LIBtlen >= 3) &&
+          (ln->LIB_tbuf[ln->LIBtlen-3] == 0x47) && (ln->LIB_tbuf[ln->LIBtlen-2] == 0x0F)) {
+         LIBtframe(line, 1);                                         // End of SDLC frame
+         ln->LIB_tbuf[0] = 0x7E;                                     // The closing flag may also open the next
+         ln->LIBtlen = 1;
+      } else if ((ln->LIBtsdlc == 0) && (LIBtchar == PAD)) {
+         LIBtframe(line, 1);                                         // End of BSC block
+      }
    }  // End if LIBline[line]->LIBsync
 
    // Check if we are in pcf state 8. This indicates the start of a transmission.
    // However, if we are still in receiving mode, there is no reset of the buffer length and
    // we continue appending to the current buffer.
-   if ((state == 0x8) && (LIBline[line]->LIBsync != 1)) {
-      LIBline[line]->LIBsync = 1;                                    // Indicate we are in receive mode
-      LIBline[line]->LIBtlen = 0;                                    // Ensure length is set to zero
+   if ((state == 0x8) && (ln->LIBsync != 1)) {
+      ln->LIBsync = 1;                                               // Indicate we are in receive mode
+      ln->LIBtlen = 0;                                               // Ensure length is set to zero
+      ln->LIBtsdlc = -1;
    }  // End if state == 0x8
 
    // Check if we received two consecutive SYN characters in the text...
@@ -426,9 +732,13 @@ uint8 rc;
    }
    rc = 0;                                                           // preset to no characters to transmit
    if (LIBline[line]->LIBrlen > 0) {                                 // If there is data in the buffer....
-      *LIBrchar = LIBline[line]->LIB_rbuf[0];                        // ...point to first character
-      if (!((state == 0x4) || (state == 0x5)))                       // If we are not in PCF 4 or 5...
-         LIBline[line]->LIBrlen = ShiftLeft(LIBline[line]->LIB_rbuf, LIBline[line]->LIBrlen); // shift whole buffer to left.
+      *LIBrchar = LIBline[line]->LIB_rbuf[LIBline[line]->LIBrptr];   // ...point to first character
+      if (!((state == 0x4) || (state == 0x5))) {                     // If we are not in PCF 4 or 5...
+         LIBline[line]->LIBrptr++;                                   // ...it has been taken.
+         LIBline[line]->LIBrlen--;
+         if (LIBspeed[line] != 0)
+            LIBline[line]->tokens[(LIBduplex[line] == ON) ? LIB_RX : LIB_TX] -= 1.0;  // Character has passed the line
+      }
       if (LIBline[line]->LIBrlen == 0)                               // If buffer fully processed...
          rc = 2;                                                     // ...indicate last character, which also means end of frame
       else                                                           // Otherwise...
@@ -437,6 +747,157 @@ uint8 rc;
    return rc;                                                        // Back to scanner
 }
 
+//*********************************************************************
+//   Hunt for a flag (SDLC) or SYN (BSC) in PCF 4/5.                  *
+//   All idle fill in front of it is dropped in one scan pass, rather *
+//   than one character per pass. Returns 1 with c as the next        *
+//   character, 0 if nothing was received, or -1 if the buffer held   *
+//   fill only (it is then empty).                                    *
+//*********************************************************************
+int  proc_LIBhunt (unsigned char c, uint8_t state, int line) {
+   unsigned char receivedChar, *p;
+   int skip;
+
+   if (proc_LIBrdata(&receivedChar, state, line) == 0)               // Nothing received
+      return 0;
+   if (receivedChar == c)
+      return 1;
+   p = memchr(&LIBline[line]->LIB_rbuf[LIBline[line]->LIBrptr], c, LIBline[line]->LIBrlen);
+   if (p == NULL) {                                                  // Only fill...
+      proc_LIBdisbuf(line);                                          // ...drop it all
+      return -1;
+   }
+   skip = p - &LIBline[line]->LIB_rbuf[LIBline[line]->LIBrptr];
+   LIBline[line]->LIBrptr += skip;
+   LIBline[line]->LIBrlen -= skip;
+   if ((Sdbg_flag == ON) && (Sdbg_reg & 0x04))                       // Trace line activities ?
+      fprintf(S_trace, "\r#04L%1d< %d fill characters skipped\n", line, skip);
+   return 1;
+}
+
+//*********************************************************************
+//   Received characters still waiting in the line buffer.            *
+//*********************************************************************
+int  proc_LIBrpend (int line) {
+   return LIBline[line]->LIBrlen;
+}
+
+//*********************************************************************
+//   Line speed model (token bucket).                                 *
+//   Returns 1 if the line may pass a character to or from the        *
+//   scanner now, 0 if the scanner has to wait.                       *
+//   Tokens are refilled at speed/8 characters per second. At most    *
+//   20 msec worth of characters (minimal 2) can be saved up.         *
+//   A half duplex line shares one bucket for both directions, a full *
+//   duplex line has the full line speed in each direction (dir).     *
+//*********************************************************************
+int proc_LIBpace(int line, int dir) {
+   struct timespec now;
+   double cps, burst;
+
+   if (LIBspeed[line] == 0)                                          // Unlimited ?
+      return 1;
+   if (LIBduplex[line] == OFF)                                       // Half duplex ?
+      dir = LIB_TX;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   cps = LIBspeed[line] / 8.0;                                       // Characters per second
+   burst = (cps / 50.0 < 2.0) ? 2.0 : cps / 50.0;
+   LIBline[line]->tokens[dir] += ((now.tv_sec - LIBline[line]->tb_last[dir].tv_sec) +
+                                  (now.tv_nsec - LIBline[line]->tb_last[dir].tv_nsec) / 1e9) * cps;
+   if (LIBline[line]->tokens[dir] > burst)
+      LIBline[line]->tokens[dir] = burst;
+   LIBline[line]->tb_last[dir] = now;
+   return (LIBline[line]->tokens[dir] >= 1.0);
+}
+
+//*********************************************************************
+//   SET CPU LINESPEED={line|ALL}:{speed}                             *
+//   speed = bps (9600, 56K, ...), T1 or UNLIMITED                    *
+//*********************************************************************
+t_stat lib_set_speed (UNIT *uptr, int32 val, char *cptr, void *desc) {
+   char *sp;
+   unsigned long speed;
+   int line, first, last;
+
+   if ((cptr == NULL) || ((sp = strchr(cptr, ':')) == NULL))
+      return SCPE_ARG;
+   *sp++ = '\0';
+   if (strcmp(cptr, "ALL") == 0) {
+      first = 0;
+      last = MAX_LINES - 1;
+   } else {
+      line = strtol(cptr, &cptr, 10) - LIBLBASE;
+      if ((*cptr != '\0') || (line < 0) || (line >= MAX_LINES))
+         return SCPE_ARG;
+      first = last = line;
+   }
+   if (strcmp(sp, "UNLIMITED") == 0) {
+      speed = 0;
+   } else if (strcmp(sp, "T1") == 0) {
+      speed = T1_SPEED;
+   } else {
+      speed = strtoul(sp, &sp, 10);
+      if ((*sp == 'K') && (*(sp+1) == '\0'))
+         speed = speed * 1000;
+      else if (*sp != '\0')
+         return SCPE_ARG;
+      if (speed < 50)
+         return SCPE_ARG;
+   }
+   for (line = first; line <= last; line++)
+      LIBspeed[line] = speed;
+   return SCPE_OK;
+}
+
+t_stat lib_show_speed (FILE *st, UNIT *uptr, int32 val, void *desc) {
+   for (int line = 0; line < MAX_LINES; line++) {
+      if (LIBspeed[line] == 0)
+         fprintf(st, "%sline-%d=UNLIMITED", (line == 0) ? "" : ", ", line + LIBLBASE);
+      else
+         fprintf(st, "%sline-%d=%u", (line == 0) ? "" : ", ", line + LIBLBASE, LIBspeed[line]);
+   }
+   return SCPE_OK;
+}
+
+//*********************************************************************
+//   SET CPU DUPLEX={line|ALL}:{FULL|HALF}                            *
+//   Set this for lines the NCP generates with DUPLEX=FULL.           *
+//*********************************************************************
+t_stat lib_set_duplex (UNIT *uptr, int32 val, char *cptr, void *desc) {
+   char *sp;
+   uint8_t duplex;
+   int line, first, last;
+
+   if ((cptr == NULL) || ((sp = strchr(cptr, ':')) == NULL))
+      return SCPE_ARG;
+   *sp++ = '\0';
+   if (strcmp(cptr, "ALL") == 0) {
+      first = 0;
+      last = MAX_LINES - 1;
+   } else {
+      line = strtol(cptr, &cptr, 10) - LIBLBASE;
+      if ((*cptr != '\0') || (line < 0) || (line >= MAX_LINES))
+         return SCPE_ARG;
+      first = last = line;
+   }
+   if (strcmp(sp, "FULL") == 0)
+      duplex = ON;
+   else if (strcmp(sp, "HALF") == 0)
+      duplex = OFF;
+   else
+      return SCPE_ARG;
+   for (line = first; line <= last; line++)
+      LIBduplex[line] = duplex;
+   return SCPE_OK;
+}
+
+t_stat lib_show_duplex (FILE *st, UNIT *uptr, int32 val, void *desc) {
+   for (int line = 0; line < MAX_LINES; line++)
+      fprintf(st, "%sline-%d=%s", (line == 0) ? "" : ", ", line + LIBLBASE,
+              (LIBduplex[line] == ON) ? "FULL" : "HALF");
+   return SCPE_OK;
+}
+
 //*********************************************************************
 //   Thread to handle connections from the 327x cluster emulator      *
 //*********************************************************************
@@ -447,11 +908,13 @@ void *LIB_thread(void *arg)
    int    pendingrcv;              /* pending data on the socket     */
    int    event_count;             /* # events received              */
    int    rc, rc1;                 /* return code from various rtns  */
+   int    fd, s, l;                /* accepted connection, station   */
    int    alive = 1;               /* Enable KEEP_ALIVE              */
    int    idle = 5;                /* First  probe after 5 seconds   */
    int    intvl = 3;               /* Subsequent probes after 3 sec  */
    int    cntpkt = 3;              /* Timeout after 3 failed probes  */
    int    timeout = 1000;
+   int    tmo;                     /* epoll timeout (ms)             */
    struct sockaddr_in sin, *sin2;  /* bind socket address structure  */
    struct ifaddrs *nwaddr, *ifa;   /* interface address structure    */
    char   *ipaddr;
@@ -462,8 +925,24 @@ void *LIB_thread(void *arg)
       LIBline[j] =  malloc(sizeof(struct LIBLine));
       LIBline[j]->linenum = j;
       LIBline[j]->LIBrlen = 0;
+      LIBline[j]->LIBrptr = 0;
       LIBline[j]->LIBtlen = 0;
+      LIBline[j]->LIBtaddr = TADDR_NEW;
       LIBline[j]->LIBsync = 0;
+      for (s = 0; s < MAXSTAT; s++)
+         LIBline[j]->stat[s] = NULL;
+      LIBline[j]->nstat = 0;
+      LIBline[j]->nhalf = 0;
+      for (int l = 0; l < MAXLEAD; l++)
+         LIBline[j]->lead_fd[l] = 0;
+      LIBline[j]->nlead = 0;
+      LIBline[j]->rstat = 0;
+      memset(LIBline[j]->addrmap, -1, sizeof(LIBline[j]->addrmap));
+      LIBline[j]->txqlen = 0;
+      for (int d = LIB_TX; d <= LIB_RX; d++) {
+         LIBline[j]->tokens[d] = 0.0;
+         clock_gettime(CLOCK_MONOTONIC, &LIBline[j]->tb_last[d]);
+      }
    }  // End for j = 0
 
    getifaddrs(&nwaddr);      /* Get TCP network address */
@@ -521,69 +1000,65 @@ void *LIB_thread(void *arg)
    }
    //
    // Poll briefly for connect requests. If a connect request is received, proceed with connect/accept the request.
+   // Each station (327x) makes two connections, a data lead and an RS232 signal lead. They are
+   // identified by their first bytes and paired into a station by LIBlead_check.
+   // Up to MAXSTAT stations can connect to one (multipoint) line.
    // Next, check all active connection for input data.
    //
    while (1) {
+      // A station waiting for CTS holds up its frame and with that the scanner
+      // hunting for it, so only idle lines may wait the full 50 msec per line.
+      tmo = 50;
+      for (int k = 0; k < MAX_LINES; k++)
+         if ((LIBline[k]->nstat > 0) || (LIBline[k]->nlead > 0) || (LIBline[k]->nhalf > 0)) tmo = 1;
+      if (coop_mode == ON) tmo = 0;                         // COOP mode: never block the CCU
       for (int k = 0; k < MAX_LINES; k++) {
-         event_count = epoll_wait(LIBline[k]->epoll_fd, events, 1, 50);
-         for (int i = 0; i < event_count; i++) {
-            LIBline[k]->d327x_fd = accept(LIBline[k]->line_fd, NULL, 0);
-            if (LIBline[k]->d327x_fd < 1) {
-               printf("\rLIB: accept failed for data connection on line-%d %s\n", k+LIBLBASE, strerror(errno));
-            } else {
-               if (setsockopt(LIBline[k]->d327x_fd, SOL_SOCKET, SO_KEEPALIVE, (void *)&alive, sizeof(alive))) {
-                  perror("ERROR: setsockopt(), SO_KEEPALIVE");
-                  return NULL;
-               }
-               if (setsockopt(LIBline[k]->d327x_fd, IPPROTO_TCP, TCP_KEEPIDLE, (void *)&idle, sizeof(idle))) {
-                  perror("ERROR: setsockopt(), SO_KEEPIDLE");
-                  return NULL;
-               }
-               if (setsockopt(LIBline[k]->d327x_fd, IPPROTO_TCP, TCP_KEEPINTVL, (void *)&intvl, sizeof(intvl))) {
-                  perror("ERROR: setsockopt(), SO_KEEPINTVL");
-                  return NULL;
-               }
-               if (setsockopt(LIBline[k]->d327x_fd, IPPROTO_TCP, TCP_KEEPCNT, (void *)&cntpkt, sizeof(cntpkt))) {
-                  perror("ERROR: setsockopt(), SO_KEEPCNT");
-                  return NULL;
-               }
-            }  // End if LIBline[k]->d327x_fd
-         }  // End for int i
-
-         // After the data link is established, the signal connection needs to be established.
-         if ((LIBline[k]->d327x_fd > 0) && (LIBline[k]->s327x_fd < 1))  {
-            event_count = epoll_wait(LIBline[k]->epoll_fd, events, 1, 50);
-            for (int i = 0; i < event_count; i++) {
-               LIBline[k]->s327x_fd = accept(LIBline[k]->line_fd, NULL, 0);
-               if (LIBline[k]->s327x_fd < 1) {
-                  printf("\rLIB: Accept failed for signal connection on line-%d %s\n", k+LIBLBASE, strerror(errno));
-               } else {
-                  if (setsockopt(LIBline[k]->s327x_fd, SOL_SOCKET, SO_KEEPALIVE, (void *)&alive, sizeof(alive))) {
-                     perror("ERROR: setsockopt(), SO_KEEPALIVE");
-                     return NULL;
-                  }
-                  if (setsockopt(LIBline[k]->s327x_fd, IPPROTO_TCP, TCP_KEEPIDLE, (void *)&idle, sizeof(idle))) {
-                     perror("ERROR: setsockopt(), SO_KEEPIDLE");
-                     return NULL;
-                  }
-                  if (setsockopt(LIBline[k]->s327x_fd, IPPROTO_TCP, TCP_KEEPINTVL, (void *)&intvl, sizeof(intvl))) {
-                     perror("ERROR: setsockopt(), SO_KEEPINTVL");
-                     return NULL;
-                  }
-                  if (setsockopt(LIBline[k]->s327x_fd, IPPROTO_TCP, TCP_KEEPCNT, (void *)&cntpkt, sizeof(cntpkt))) {
-                     perror("ERROR: setsockopt(), SO_KEEPCNT");
-                     return NULL;
-                  }
-                  RS232[k] = DCD | RI;   // DCD and RI on
-                  printf("\rLIB: 327x connected to line-%d\n", k+LIBLBASE);
-               } // End if (LIBline[k]->s327x_fd < 1)
-            }  // End for (int i
-         }  // End  if (LIBline[k]->d327x_fd > 0)
-         if (LIBline[k]->s327x_fd > 0)
+         event_count = epoll_wait(LIBline[k]->epoll_fd, events, 1, tmo);
+         while (event_count > 0) {
+            fd = accept(LIBline[k]->line_fd, NULL, 0);
+            if (fd < 1) {
+               printf("\rLIB: accept failed for connection on line-%d %s\n", k+LIBLBASE, strerror(errno));
+               break;
+            }
+            if (setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, (void *)&alive, sizeof(alive))) {
+               perror("ERROR: setsockopt(), SO_KEEPALIVE");
+               return NULL;
+            }
+            if (setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, (void *)&idle, sizeof(idle))) {
+               perror("ERROR: setsockopt(), SO_KEEPIDLE");
+               return NULL;
+            }
+            if (setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, (void *)&intvl, sizeof(intvl))) {
+               perror("ERROR: setsockopt(), SO_KEEPINTVL");
+               return NULL;
+            }
+            if (setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, (void *)&cntpkt, sizeof(cntpkt))) {
+               perror("ERROR: setsockopt(), SO_KEEPCNT");
+               return NULL;
+            }
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (void *)&alive, sizeof(alive));  // Frames go out one by one
+            for (l = 0; l < MAXLEAD; l++)
+               if (LIBline[k]->lead_fd[l] < 1) break;
+            if (l == MAXLEAD) {
+               printf("\rLIB: Line-%d has %d connections waiting already, connection refused\n", k+LIBLBASE, MAXLEAD);
+               close(fd);
+               break;
+            }
+            LIBline[k]->lead_fd[l] = fd;                    // Identified (and paired) by LIBlead_check
+            LIBline[k]->lead_t[l] = time(NULL);
+            LIBline[k]->nlead++;
+            event_count = epoll_wait(LIBline[k]->epoll_fd, events, 1, 0);
+         }  // End while (event_count > 0)
+         if ((LIBline[k]->nlead > 0) || (LIBline[k]->nhalf > 0))
+            LIBlead_check(k);                               // Pair new leads into stations
+         if (LIBline[k]->txqlen > 0)
+            LIBtxq_send(k);                                 // Drain the transmit queue
+         if (LIBline[k]->nstat > 0)
             ReadSig(k);
       }  // End for int k
      if (shwlib == 1) LIBpanel_Init();
      if (shwlib == 2) LIBpanel_Updt();
+     coop_yield();                                          // COOP mode: back to the CCU
    }  // End while(1)
 
    return NULL;
@@ -597,7 +1072,8 @@ void LIBpanel_Init() {
    uint32_t old_cucr;                         // To save cycle counter.
    old_cucr = Eregs_Inp[0x7A];                // save current cycle counter
    while (Eregs_Inp[0x7A] == old_cucr)        // wait until cycle counter changes (= processing continues)
-      sleep(1);
+      if (coop_yield() == 0)
+         sleep(1);
    // *********************************************************************************
    // Build the lib panel.
    // If the panel is ready, set the shwlib value to 2, which enables the update cycle.
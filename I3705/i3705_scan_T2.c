@@ -127,6 +127,7 @@ extern int32 cc;
 
 extern int Ireg_bit(int reg, int bit_mask);
 extern void wait();
+int coop_yield(void);
 
 int8 Eflg_rcvd[MAX_LINES];              /* Eflag received                            */
 int8 FCS_rcvd[MAX_LINES][2];            /* Frame Check Sequence bytes Received       */
@@ -151,6 +152,8 @@ uint8_t icw_pdf_reg[MAX_LINES];        /* Status ICW PDF reg: FILLED or EMPTY
 extern uint8_t RS232[MAX_LINES];       /* RS232 signals                             */
 
 int8 CS2_req_L2_int = OFF;
+#define RXRUN 64                      // Max characters served back to back on one line
+#define RXWAIT 200                     // Max 50 usec waits for NCP to leave L2 in a run
 pthread_mutex_t icw_lock;              // ICW lock (0 - 45)
 extern pthread_mutex_t rs232_lock;            // RS232 signal lock
 
@@ -170,14 +173,400 @@ void Init_ICW(int max);
 void proc_LIBdisbuf(int line);
 void proc_LIBtdata(unsigned char transmitChar, uint8_t state, int line);
 int  proc_LIBrdata(unsigned char *receivedChar, uint8_t state, int line);
+int  proc_LIBhunt(unsigned char c, uint8_t state, int line);
+int  proc_LIBrpend(int line);
+int  proc_LIBpace(int line, int dir);
+extern uint32_t LIBspeed[];            /* Line speed in bps (0 = unlimited)         */
+extern uint8_t  LIBduplex[];           /* Line is full duplex (DUPLEX=FULL)         */
 
 
+// *******************************************************************
+// Line protocol handlers.
+// The line control PCF states (0-3, F) and the DSR, L2 and CTS checks
+// are common to all lines and done in CS2_thread. The protocol
+// dependent part of each PCF state is done by the handler selected
+// from the line_proto table by the ICW LCD of the line.
+// Handlers are called with icw_lock held.
+// *******************************************************************
+struct line_proto {
+   char *name;                         // Line protocol name (trace)
+   void (*pcf_proc[16])(int line);     // PCF state handlers, NULL = no protocol action
+};
+
+// ===================================================================
+//  SDLC line handlers (LCD = 8 or 9)
+// ===================================================================
+
+// PCF 4/5: Monitor flag
+void SDLC_mon_flag(int line) {
+   int ret;
+
+   Eflg_rcvd[line] = OFF;                     // Reset Eflag
+   //*******************************************************
+   ret = proc_LIBhunt(0x7E, icw_pcf[line], line);  // Skip fill up to the flag
+   //*******************************************************
+   if (ret == 0) return;                      // Return if nothing received.
+   if (ret == 1) {
+      //icw_sdf[line] &= 0x00;                // Clear SDF
+      icw_scf[line] |= 0x04;                  // Set 7E detected flag
+      icw_lcd[line]  = 0x9;                   // LCD = 9 (SDLC 8-bit)
+      icw_pcf_nxt[line] = 0x6;                // Goto PCF = 6...
+      CS2_req_L2_int = ON;                    // ...and issue a L2 int
+   } else {                                   // Fill only, already discarded
+      icw_pcf_nxt[line] = 0x5;                // Stay in PCF = 5...
+   } // End  if (ret == 1)
+   return;
+}
+
+// PCF 6: Receive info - block data interrupts
+void SDLC_rx_inhibit(int line) {
+   unsigned char receivedChar;
+   int ret;
+
+   //*******************************************************
+   ret = proc_LIBrdata(&receivedChar, icw_pcf[line], line);
+   //*******************************************************
+   // Idle flags need no service request, so a run of them is taken
+   // in one pass. The first other character is handled below.
+   while ((ret == 1) && (receivedChar == 0x7E) && proc_LIBpace(line, LIB_RX))
+      ret = proc_LIBrdata(&receivedChar, icw_pcf[line], line);
+   if (ret == 0) return;                      // Return if nothing received.
+   if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02)) {     // Trace scanner activities ?
+      fprintf(S_trace, "\n#02L%1d< CS2[%1X]: proc_LBrdata rc=%d ",
+                        line, icw_pcf[line],ret);
+      fprintf(S_trace, "\n#02L%1d< CS2[%1X]: PCF = 6 (re-)entered ",
+                        line, icw_pcf[line]);
+      fprintf(S_trace, "\n#02L%1d< CS2[%1X]: Received byte = *** %02X ***, Eflag=%d",
+                        line, icw_pcf[line], receivedChar, Eflg_rcvd[line]);
+   }
+
+   if (receivedChar == 0x7E) {                //  flag?
+      icw_pcf_nxt[line] = 0x6;                // Stay in PCF = 6...
+      icw_scf[line] |= 0x04;                  // Set flag det bit
+   } else {
+      icw_scf[line] &= ~0x04;                 // Reset flag det bit
+      icw_pdf[line] = receivedChar;
+      icw_pdf_reg[line] = FILLED;             // Signal NCP to read pdf.
+      icw_scf[line] |= 0x40;                  // Set norm char serv flag
+      icw_pcf_nxt[line] = 0x7;                // Stay in PCF = 7...
+      CS2_req_L2_int = ON;                    // Issue a L2 interrupt
+   }
+   return;
+}
+
+// PCF 7: Receive info - allow data interrupts
+void SDLC_rx(int line) {
+   unsigned char receivedChar;
+   int ret;
+
+   //*******************************************************
+   ret = proc_LIBrdata(&receivedChar, icw_pcf[line], line);
+   //*******************************************************
+   if (ret == 0)                              // No characters received?
+      return;
+   // Check end of frame when a flag byte is detected. If the FCS matches, this is really the end of the frame.,
+   // else we bumped into a regular x7E character,
+   if ((receivedChar == 0x7E) && (FCS_rcvd[line][0] == 0x47) && (FCS_rcvd[line][1] == 0x0F)) {
+      Eflg_rcvd[line] = ON;
+   } else {
+      FCS_rcvd[line][0] = FCS_rcvd[line][1];
+      FCS_rcvd[line][1] = receivedChar;
+      Eflg_rcvd[line] = OFF;                  // No Eflag
+   }
+
+   if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02)) {     // Trace scanner activities ?
+      fprintf(S_trace, "\n#02L%1d< CS2[%1X]: PCF = 7 (re-)entered ",
+                        line, icw_pcf[line]);
+      fprintf(S_trace, "\n#02L%1d< CS2[%1X]: Received byte = *** %02X ***, Eflag=%d",
+                        line, icw_pcf[line], receivedChar, Eflg_rcvd[line]);
+   } // End if ((Sdbg_flag == ON)
+   if (Eflg_rcvd[line] == ON) {
+      if (LIBduplex[line] == OFF)             // A full duplex line keeps receiving...
+         icw_lne_stat[line] = TX;             // ...else line turnaround to transmitting...
+      icw_scf[line] |= 0x44;                  // Set 7E detected flag
+      icw_lcd[line]  = 0x9;                   // LCD = 9 (SDLC 8-bit)
+      icw_pcf_nxt[line] = 0x6;                // Goto PCF = 6...
+      CS2_req_L2_int = ON;                    // ...and issue a L2 int
+      Eflg_rcvd[line] = OFF;                  // Reset Eflag
+      FCS_rcvd[line][0] = 0x00;               // Clear FCS buffer
+      FCS_rcvd[line][1] = 0x00;               // Clear FCS buffer
+   } else {
+      icw_pdf[line] = receivedChar;
+      icw_pdf_reg[line] = FILLED;             // Signal NCP to read pdf.
+      icw_scf[line] |= 0x40;                  // Set norm char serv flag
+      icw_pcf_nxt[line] = 0x7;                // Stay in PCF = 7...
+      CS2_req_L2_int = ON;                    // Issue a L2 interrupt
+   } // End if (Eflg_rcvd[line] == ON)
+   return;
+}
+
+// PCF 8: Transmit initial (CTS is on)
+void SDLC_tx_init(int line) {
+   // Call LIBtdata to indicate start of a new frame. transmitChar is ignored.
+   //*******************************************************
+   proc_LIBtdata(icw_pdf[line], icw_pcf[line], line);
+   //*******************************************************
+   icw_scf[line] &= 0xFB;                     // Reset flag detected flag
+   // CTS is now on.
+   icw_pcf_nxt[line] = 0x9;                   // Goto PCF = 9
+   // NO CS2_req_L2_int !
+   return;
+}
+
+// PCF 9: Transmit normal
+void SDLC_tx(int line) {
+   unsigned char transmitChar;
+
+   if (icw_pdf_reg[line] == FILLED) {         // New char avail to xmit ?
+      transmitChar = icw_pdf[line];
+      if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02)) {  // Trace scanner activities ?
+         fprintf(S_trace, "\n#02L%1d> CS2[%1X]: PCF = 9 (re-)entered ",
+                           line, icw_pcf[line]);
+         fprintf(S_trace, "\n#02L%1d> CS2[%1X]: Transmitting PDF = *** %02X ***",
+                           line, icw_pcf[line], icw_pdf[line]);
+      }
+      //*******************************************************
+      proc_LIBtdata(transmitChar, icw_pcf[line], line);
+      //*******************************************************
+
+      // Next char please...
+      icw_pdf_reg[line] = EMPTY;              // Ask NCP for next byte
+      icw_scf[line] |= 0x40;                  // Set norm char serv flag
+      icw_pcf_nxt[line] = 0x9;                // Stay in PCF = 9...
+      CS2_req_L2_int = ON;                    // Issue a L2 interrupt
+   }
+   return;
+}
+
+// PCF C: Transmit turnaround - RTS off
+void SDLC_turn_off(int line) {
+   if (icw_pcf_prev[line] != icw_pcf[line]) { // First entry ?
+      if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))  // Trace scanner activities ?
+         fprintf(S_trace, "\n#02L%1d> CS2[%1X]: PCF = C entered, next PCF will be set by NCP ",
+                           line, icw_pcf[line]);
+
+      // ******************************************************************
+      // Signal SDLC that final character has been received.
+      proc_LIBtdata(icw_pdf[line], icw_pcf[line], line);
+      // ******************************************************************
+      icw_lne_stat[line] = RX;                // Line turnaround to receiving...
+      icw_scf[line] |= 0x40;                  // Set norm char serv flag
+      icw_pcf_nxt[line] = 0x5;                // Goto PCF = 5...
+      CS2_req_L2_int = ON;                    // ...and issue a L2 int
+   }
+   return;
+}
+
+// PCF D: Transmit turnaround - keep RTS on
+void SDLC_turn_on(int line) {
+   if (icw_pcf_prev[line] != icw_pcf[line]) { // First entry ?
+      if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))  // Trace scanner activities ?
+         fprintf(S_trace, "\n#02L%1d> CS2[%1X]: PCF = D entered, next PCF will be set by NCP ",
+                           line, icw_pcf[line]);
+   }
+   // NO CS2_req_L2_int !
+   return;
+}
+
+// ===================================================================
+//  BSC line handlers (LCD = C)
+// ===================================================================
+
+// PCF 4/5: Monitor for SYN
+void BSC_mon_syn(int line) {
+   unsigned char receivedChar = 0x32;
+   int ret;
+
+   //*******************************************************
+   ret = proc_LIBhunt(receivedChar, icw_pcf[line], line);  // Skip fill up to the SYN
+   //*******************************************************
+   if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))
+      fprintf (trace, "\n#02L%1d> CS2[%1X]: Hunt ret=%d", line, icw_pcf[line], ret);
+   if (ret == 1) {                            // Found a SYN flag
+      if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))
+         fprintf(S_trace, "\n#02L%1d> CS2[%1X]: Received SYN! - goto state 7", line, icw_pcf[line]);
+      icw_pdf[line] = receivedChar;
+      icw_pcf_nxt[line]  = 0x7;               // Goto PCF = 7
+      icw_sdf[line] |= 0x04;                  // Set SYNC flag
+   }  // End if receivedChar
+   return;
+}
+
+// PCF 6: Receive info - block data interrupts
+// Served as for SDLC, without the flag run: the first character that
+// is not X'7E' goes to NCP and the line goes to PCF 7.
+void BSC_rx_inhibit(int line) {
+   unsigned char receivedChar;
+   int ret;
+
+   //*******************************************************
+   ret = proc_LIBrdata(&receivedChar, icw_pcf[line], line);
+   //*******************************************************
+   if (ret == 0) return;                      // Return if nothing received.
+   if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02)) {     // Trace scanner activities ?
+      fprintf(S_trace, "\n#02L%1d< CS2[%1X]: PCF = 6 (re-)entered, received byte = *** %02X ***",
+                        line, icw_pcf[line], receivedChar);
+   }
+
+   if (receivedChar == 0x7E) {                //  flag?
+      icw_pcf_nxt[line] = 0x6;                // Stay in PCF = 6...
+      icw_scf[line] |= 0x04;                  // Set flag det bit
+   } else {
+      icw_scf[line] &= ~0x04;                 // Reset flag det bit
+      icw_pdf[line] = receivedChar;
+      icw_pdf_reg[line] = FILLED;             // Signal NCP to read pdf.
+      icw_scf[line] |= 0x40;                  // Set norm char serv flag
+      icw_pcf_nxt[line] = 0x7;                // Stay in PCF = 7...
+      CS2_req_L2_int = ON;                    // Issue a L2 interrupt
+   }
+   return;
+}
+
+// PCF 7: Receive info - allow data interrupts
+void BSC_rx(int line) {
+   unsigned char receivedChar;
+   int ret;
+
+   if ((icw_scf[line] & 0x40) == 0) {         // NCP has read pdf ?
+      //*******************************************************
+      ret = proc_LIBrdata(&receivedChar, icw_pcf[line], line);
+      //*******************************************************
+      if (ret != 1) receivedChar = 0xFF;
+      icw_pdf[line] = receivedChar;
+      if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02)) {  // Trace scanner activities ?
+         fprintf(S_trace, "\n#02L%1d< CS2[%1X]: State 7 ch = %02X\n", line, icw_pdf[line], receivedChar);
+      }
+      //icw_pdf_reg[line] = FILLED;            // Signal NCP to read pdf.
+      icw_scf[line] |= 0x40;                  // Set norm char serv flag
+      icw_pcf_nxt[line] = 0x7;                // Stay in PCF = 7...
+      CS2_req_L2_int = ON;                    // Issue a L2 interrupt
+   }  // End if icw_scf[line]
+   return;
+}
+
+// PCF 8: Transmit initial (CTS is on)
+void BSC_tx_init(int line) {
+   unsigned char transmitChar = 0x00;
+
+   if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02)) {
+      fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: icw_pdf=%02X icw_scf=%02X icw_scf&0x40=%02X\n",
+                        line, icw_pcf[line], 0xff & icw_pdf[line], 0xff & icw_scf[line], icw_scf[line] & 0x40);
+      fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: 1. condition=%01X icw_pdf=%02X icw_scf=%02X\n",
+                        line, icw_pcf[line], (icw_scf[line] & 0x40) == 0, 0xff & icw_pdf[line], 0xff & icw_scf[line]);
+   }
+   if ((icw_scf[line] & 0x40) == 0) {         // New char avail to xmit ?
+      transmitChar = icw_pdf[line];
+      if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02)) {
+         fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: 2. condition=%01X icw_pdf=%02X icw_scf=%02X\n",
+                           line, icw_pcf[line], (icw_scf[line] & 0x40) == 0, 0xff & icw_pdf[line], 0xff & icw_scf[line]);
+         fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: State 8 ch=%02X \n",line, icw_pcf[line], transmitChar);
+      }
+   }
+   //*******************************************************
+   proc_LIBtdata(transmitChar,icw_pcf[line], line);
+   //*******************************************************
+   // Next byte please...
+   icw_pdf_reg[line] = EMPTY;                 // Ask NCP for next byte
+   icw_scf[line] |= 0x40;                     // Set norm char serv flag
+   icw_pcf_nxt[line] = 0x9;                   // Go to PCF = 9...
+   CS2_req_L2_int = ON;                       // Issue a L2 interrupt
+   return;
+}
+
+// PCF 9: Transmit normal, PCF A: Transmit normal with new sync
+void BSC_tx(int line) {
+   unsigned char transmitChar;
+
+   if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))
+      fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: icw_pdf=%02X icw_scf=%02X lvl=%d\n",
+                        line, icw_pcf[line], 0xff & icw_pdf[line], 0xff & icw_scf[line], lvl);
+   if ((icw_scf[line] & 0x40) == 0) {         // New char avail to xmit ?
+      transmitChar = icw_pdf[line];
+      if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02)) {   // Trace scanner activities ?
+         fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: State %1X ch=%02X \n", line, icw_pcf[line], icw_pcf[line], transmitChar);
+      }
+      //*******************************************************
+      proc_LIBtdata(transmitChar,icw_pcf[line], line);
+      //*******************************************************
+
+      // Next byte please...
+      icw_pdf_reg[line] = EMPTY;              // Ask NCP for next byte
+      icw_scf[line] |= 0x40;                  // Set norm char serv flag
+      icw_pcf_nxt[line] = icw_pcf[line];      // Stay in PCF = 9 or A...
+      CS2_req_L2_int = ON;                    // Issue a L2 interrupt
+   }
+   return;
+}
+
+// PCF C: Transmit turnaround - RTS off
+void BSC_turn_off(int line) {
+   if (icw_pcf_prev[line] != icw_pcf[line]) { // First entry ?
+      if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))
+         fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: Now into state C.\n", line, icw_pcf[line]);
+      //*******************************************************
+      proc_LIBtdata(icw_pdf[line], icw_pcf[line], line);  //Signal line we are done
+      //*******************************************************
+
+      icw_lne_stat[line] = RX;                // Line turnaround to receiving...
+      icw_scf[line] |= 0x40;                  // Set norm char serv flag
+      icw_pcf_nxt[line] = 0x5;                // Goto PCF = 5...
+      CS2_req_L2_int = ON;                    // ...and issue a L2 int
+   }
+   return;
+}
+
+// PCF D: Transmit turnaround - keep RTS on
+void BSC_turn_on(int line) {
+   if (icw_pcf_prev[line] != icw_pcf[line]) { // First entry ?
+      if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))    // Trace scanner activities ?
+         fprintf(S_trace, "\n#02L%1d> CS2[%1X]: PCF = D entered, next PCF will be set by NCP \n\r", line, icw_pcf[line]);
+   }
+   icw_pcf_nxt[line] = 0x5;                   // Goto PCF = 5...
+   CS2_req_L2_int = ON;                       // ...and issue a L2 int
+   return;
+}
+
+// ===================================================================
+//  Line protocol table, indexed by ICW LCD.
+//  LCD 8 is SDLC until the first flag is received; the receive
+//  handlers then set the LCD to 9. Transmit requires LCD 9.
+//  Start/stop (LCD 0-7) is not implemented: these lines, like all
+//  unassigned LCDs, only run the common line control states.
+// ===================================================================
+struct line_proto SDLC8_proto = { "SDLC", {
+   [0x4] = SDLC_mon_flag,   [0x5] = SDLC_mon_flag,
+   [0x6] = SDLC_rx_inhibit, [0x7] = SDLC_rx } };
+
+struct line_proto SDLC_proto = { "SDLC", {
+   [0x4] = SDLC_mon_flag,   [0x5] = SDLC_mon_flag,
+   [0x6] = SDLC_rx_inhibit, [0x7] = SDLC_rx,
+   [0x8] = SDLC_tx_init,    [0x9] = SDLC_tx,
+   [0xC] = SDLC_turn_off,   [0xD] = SDLC_turn_on } };
+
+struct line_proto BSC_proto = { "BSC", {
+   [0x4] = BSC_mon_syn,     [0x5] = BSC_mon_syn,
+   [0x6] = BSC_rx_inhibit,  [0x7] = BSC_rx,
+   [0x8] = BSC_tx_init,     [0x9] = BSC_tx,       [0xA] = BSC_tx,
+   [0xC] = BSC_turn_off,    [0xD] = BSC_turn_on } };
+
+struct line_proto *line_proto[16] = {
+   [0x8] = &SDLC8_proto,
+   [0x9] = &SDLC_proto,
+   [0xC] = &BSC_proto };
+
+// Call the protocol handler of the current PCF state of a line (if any).
+#define LINE_PROTO(line)                                                       \
+   if ((line_proto[icw_lcd[line]] != NULL) &&                                  \
+       (line_proto[icw_lcd[line]]->pcf_proc[icw_pcf[line]] != NULL))           \
+      (*line_proto[icw_lcd[line]]->pcf_proc[icw_pcf[line]])(line)
+
 void *CS2_thread(void *arg) {
    int Bptr = 0;                       // Tx/Rx buffer index pointer
    int i, c;
+   int busy;                           // An unpaced line was serviced this scan cycle
+   int raised;                         // This line raised a L2 interrupt this pass
+   int rxrun;                          // Characters served back to back on this line
    register char *s;
-   unsigned char receivedChar[MAX_LINES], transmitChar;
-   int ret;
 
    fprintf (stderr, "\rCS-T2: Thread %ld started succesfully...\n", syscall(SYS_gettid));
    // core_id = 1 (CPU), 2 (SCAN), 3 (SDLC)
@@ -223,7 +612,9 @@ void *CS2_thread(void *arg) {
    // Scanner loop starts here...
    // ********************************************************************
    while(1) {
+      busy = OFF;
       for (line = 0; line < MAX_LINES; line++) {     // Scan all lines
+         raised = OFF;
 
          pthread_mutex_lock(&icw_lock);
          if (icw_pcf[line] != icw_pcf_nxt[line]) {   // pcf changed by NCP ?
@@ -316,141 +707,25 @@ void *CS2_thread(void *arg) {
 
                //if (icw_lne_stat[line] == RESET)      // Line is silent. Wait for NCP time out.
                //   break;
-               if (icw_lne_stat[line] == TX)         // Line is silent. Wait for NCP action.
+               if ((icw_lne_stat[line] == TX) &&     // Line is silent. Wait for NCP action.
+                   (LIBduplex[line] == OFF))         // (A full duplex line is never silent.)
                   break;
-
-               if (icw_lcd[line] == 0xC) {           // BSC EBCDIC ?
-                  //*******************************************************
-                  ret = proc_LIBrdata(&receivedChar[line], icw_pcf[line], line);
-                  //*******************************************************
-                  if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))
-                     fprintf (trace, "\n#02L%1d> CS2[%1X]: Read ret=%d, ch=%02X", line, icw_pcf[line], ret, receivedChar[line]);
-                  if (ret != 1) break;
-                  if (receivedChar[line] == 0x32)  {       // Found a SYN flag
-                     if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))
-                        fprintf(S_trace, "\n#02L%1d> CS2[%1X]: Received SYN! - goto state 7", line, icw_pcf[line]);
-                     icw_pdf[line] = receivedChar[line];
-                     icw_pcf_nxt[line]  = 0x7;       // Goto PCF = 7
-                     icw_sdf[line] |= 0x04;          // Set SYNC flag
-                  }  // End if receivedChar[line]
-               }  // end BSC
-
-               if ((icw_lcd[line] == 0x8) || (icw_lcd[line] == 0x9)) {  // SDLC ?
-                  Eflg_rcvd[line] = OFF;                      // Reset Eflag
-                  //*******************************************************
-                  ret = proc_LIBrdata(&receivedChar[line], icw_pcf[line], line);
-                  //*******************************************************
-                  if (ret == 0) break;                    // Break if nothing received.
-                  if (receivedChar[line] == 0x7E) {
-                     //icw_sdf[line] &= 0x00;             // Clear SDF
-                     icw_scf[line] |= 0x04;             // Set 7E detected flag
-                     icw_lcd[line]  = 0x9;              // LCD = 9 (SDLC 8-bit)
-                     icw_pcf_nxt[line] = 0x6;           // Goto PCF = 6...
-                     CS2_req_L2_int = ON;               // ...and issue a L2 int
-                 } else {
-                     proc_LIBdisbuf(line);              // Discard line buffer content
-                     icw_pcf_nxt[line] = 0x5;           // Stay in PCF = 5...
-                 } // End  if (receivedChar[line] == 0x7E)
-               }  // End if (icw_lcd[line] == 0x8...
-               break;
-
-            case 0x6:                                // Receive info-inhibit data interrupt
-               if ((svc_req_L2 == ON) || (lvl == 2)) {  // Is L2 interrupt active ?
+               if ((svc_req_L2 == ON) || (lvl == 2)) // If L2 interrupt active ?
                   break;                             // Loop till inactive...
-               }
-                     //*******************************************************
-                     ret = proc_LIBrdata(&receivedChar[line], icw_pcf[line], line);
-                     //*******************************************************
-                  if (ret == 0) break;                    // Break if nothing received.
-                     if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02)) {     // Trace scanner activities ?
-                        fprintf(S_trace, "\n#02L%1d< CS2[%1X]: proc_LBrdata rc=%d ",
-                                          line, icw_pcf[line],ret);
-                     }
-                  if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02)) {  // Trace scanner activities ?
-                     fprintf(S_trace, "\n#02L%1d< CS2[%1X]: PCF = 6 (re-)entered ",
-                                       line, icw_pcf[line]);
-                     fprintf(S_trace, "\n#02L%1d< CS2[%1X]: Received byte = *** %02X ***, Eflag=%d",
-                                       line, icw_pcf[line], receivedChar[line], Eflg_rcvd[line]);
-                  }
 
-                  if (receivedChar[line] == 0x7E) {        //  flag?
-                     icw_pcf_nxt[line] = 0x6;        // Stay in PCF = 6...
-                     icw_scf[line] |= 0x04;          // Set flag det bit
-                  } else {
-                     icw_scf[line] &= ~0x04;         // Reset flag det bit
-                     icw_pdf[line] = receivedChar[line];
-                     icw_pdf_reg[line] = FILLED;     // Signal NCP to read pdf.
-                     icw_scf[line] |= 0x40;          // Set norm char serv flag
-                     icw_pcf_nxt[line] = 0x7;        // Stay in PCF = 7...
-                     CS2_req_L2_int = ON;            // Issue a L2 interrupt
-                  }
+               LINE_PROTO(line);                     // Monitor flag (SDLC) or SYN (BSC)
                break;
 
+            case 0x6:                                // Receive info-inhibit data interrupt
             case 0x7:                                // Receive info-allow data interrupt
+            case 0x9:                                // Transmit normal
+            case 0xA:                                // Transmit normal with new sync
                if ((svc_req_L2 == ON) || (lvl == 2)) // If L2 interrupt active ?
                   break;                             // Loop till inactive...
+               if (!proc_LIBpace(line, (icw_pcf[line] >= 0x9) ? LIB_TX : LIB_RX))  // Line speed reached ?
+                  break;                             // Loop till next character time...
 
-               if (icw_lcd[line] == 0xC) {           // BSC ?
-                  if ((icw_scf[line] & 0x40) == 0) { // NCP has read pdf ?
-                     //*******************************************************
-                     ret = proc_LIBrdata(&receivedChar[line], icw_pcf[line], line);
-                     //*******************************************************
-                     if (ret != 1) receivedChar[line] = 0xFF;
-                     icw_pdf[line] = receivedChar[line];
-                     if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02)) {  // Trace scanner activities ?
-                        fprintf(S_trace, "\n#02L%1d< CS2[%1X]: State 7 ch = %02X\n", line, icw_pdf[line], receivedChar[line]);
-                     }
-                     //icw_pdf_reg[line] = FILLED;   // Signal NCP to read pdf.
-                     icw_scf[line] |= 0x40;          // Set norm char serv flag
-                     icw_pcf_nxt[line] = 0x7;        // Stay in PCF = 7...
-                     CS2_req_L2_int = ON;            // Issue a L2 interrupt
-                  }  // End if icw_scf[line]
-               }  // End BSC
-
-               if ((icw_lcd[line] == 0x8) || (icw_lcd[line] == 0x9)) {  // SDLC ?
-                  //pthread_mutex_lock(&icw_lock);
-                  //*******************************************************
-                  ret = proc_LIBrdata(&receivedChar[line], icw_pcf[line], line);
-                  //*******************************************************
-                  if (ret == 0) {                       // No characters received?
-                     //pthread_mutex_unlock(&icw_lock);
-                     break;
-                  }
-                  // Check end of frame when a flag byte is detected. If the FCS matches, this is really the end of the frame.,
-                  // else we bumped into a regular x7E character,
-                  if ((receivedChar[line] == 0x7E) && (FCS_rcvd[line][0] == 0x47) && (FCS_rcvd[line][1] == 0x0F)) {
-                     Eflg_rcvd[line] = ON;
-                  } else {
-                     FCS_rcvd[line][0] = FCS_rcvd[line][1];
-                     FCS_rcvd[line][1] = receivedChar[line];
-                     Eflg_rcvd[line] = OFF;                 // No Eflag
-                  }
-
-                  if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02)) {     // Trace scanner activities ?
-                     fprintf(S_trace, "\n#02L%1d< CS2[%1X]: PCF = 7 (re-)entered ",
-                                       line, icw_pcf[line]);
-                     fprintf(S_trace, "\n#02L%1d< CS2[%1X]: Received byte = *** %02X ***, Eflag=%d",
-                                       line, icw_pcf[line], receivedChar[line], Eflg_rcvd[line]);
-                  } // End if ((receivedChar[line] == 0x7E)
-                  if (Eflg_rcvd[line] == ON) {
-                     icw_lne_stat[line] = TX;           // Line turnaround to transmitting...
-                     icw_scf[line] |= 0x44;             // Set 7E detected flag
-                     icw_lcd[line]  = 0x9;              // LCD = 9 (SDLC 8-bit)
-                     icw_pcf_nxt[line] = 0x6;           // Goto PCF = 6...
-                     CS2_req_L2_int = ON;               // ...and issue a L2 int
-                     Eflg_rcvd[line] = OFF;             // Reset Eflag
-                     FCS_rcvd[line][0] = 0x00;          // Clear FCS buffer
-                     FCS_rcvd[line][1] = 0x00;          // Clear FCS buffer
-                  } else {
-                     icw_pdf[line] = receivedChar[line];
-                     icw_pdf_reg[line] = FILLED;        // Signal NCP to read pdf.
-                     icw_scf[line] |= 0x40;             // Set norm char serv flag
-                     icw_pcf_nxt[line] = 0x7;           // Stay in PCF = 7...
-                     CS2_req_L2_int = ON;               // Issue a L2 interrupt
-                  } // End if (Eflg_rcvd[line] == ON)
-                  //pthread_mutex_unlock(&icw_lock);
-               }  // End if (icw_lcd[line] == 0x8...
-
+               LINE_PROTO(line);
                break;
 
             case 0x8:                                // Transmit initial-turn RTS on
@@ -461,183 +736,29 @@ void *CS2_thread(void *arg) {
                   RS232[line] |= RTS;                // Raise Request To Send
                   break;
                }
+               if (!proc_LIBpace(line, LIB_TX))      // Line speed reached ?
+                  break;
 
                if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))   // Trace scanner activities ?
                   fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: PCF = 8 entered, next PCF will be 9 ",
                                     line, icw_pcf[line]);
 
-               if (icw_lcd[line] == 0xC) {           // BSC EBCDIC ?
-                  if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02)) {
-                     fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: icw_pdf=%02X icw_scf=%02X icw_scf&0x40=%02X\n",
-                                       line, icw_pcf[line], 0xff & icw_pdf[line], 0xff & icw_scf[line], icw_scf[line] & 0x40);
-                     fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: 1. condition=%01X icw_pdf=%02X icw_scf=%02X\n",
-                                       line, icw_pcf[line], (icw_scf[line] & 0x40) == 0, 0xff & icw_pdf[line], 0xff & icw_scf[line]);
-                  }
-                  if ((icw_scf[line] & 0x40) == 0) { // New char avail to xmit ?
-                     transmitChar = icw_pdf[line];
-                     if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02)) {
-                        fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: 2. condition=%01X icw_pdf=%02X icw_scf=%02X\n",
-                                          line, icw_pcf[line], (icw_scf[line] & 0x40) == 0, 0xff & icw_pdf[line], 0xff & icw_scf[line]);
-                        fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: State 8 ch=%02X \n",line, icw_pcf[line], transmitChar);
-                     }
-                  }
-                  //*******************************************************
-                  proc_LIBtdata(transmitChar,icw_pcf[line], line);
-                  //*******************************************************
-                  // Next byte please...
-                  icw_pdf_reg[line] = EMPTY;         // Ask NCP for next byte
-                  icw_scf[line] |= 0x40;             // Set norm char serv flag
-                  icw_pcf_nxt[line] = 0x9;           // Go to PCF = 9...
-                  CS2_req_L2_int = ON;               // Issue a L2 interrupt
-               }  // End BSC
-
-               if (icw_lcd[line] == 0x9) {           // SDLC ?
-                  // Call LIBtdata to indicate start of a new frame. transmitChar is ignored.
-                  //*******************************************************
-                  proc_LIBtdata(transmitChar, icw_pcf[line], line);
-                  //*******************************************************
-                  icw_scf[line] &= 0xFB;             // Reset flag detected flag
-                  // CTS is now on.
-                  icw_pcf_nxt[line] = 0x9;           // Goto PCF = 9
-                  // NO CS2_req_L2_int !
-               }  // End SDLC
-               break;
-
-            case 0x9:                                // Transmit normal
-               if ((svc_req_L2 == ON) || (lvl == 2)) // If L2 interrupt active ?
-                  break;
-
-               if (icw_lcd[line] == 0xC) {           // BSC EBCDIC ?
-                  if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))
-                     fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: icw_pdf=%02X icw_scf=%02X lvl=%d\n",
-                                       line, icw_pcf[line], 0xff & icw_pdf[line], 0xff & icw_scf[line]);
-                  if ((icw_scf[line] & 0x40) == 0) { // New char avail to xmit ?
-                     transmitChar = icw_pdf[line];
-                     if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02)) {   // Trace scanner activities ?
-                        fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: State 9 ch=%02X \n", line, icw_pcf[line], transmitChar);
-                     }
-                     //*******************************************************
-                     proc_LIBtdata(transmitChar,icw_pcf[line], line);
-                     //*******************************************************
-
-                     // Next byte please...
-                     icw_pdf_reg[line] = EMPTY;      // Ask NCP for next byte
-                     icw_scf[line] |= 0x40;          // Set norm char serv flag
-                     icw_pcf_nxt[line] = 0x9;        // Stay in PCF = 9...
-                     CS2_req_L2_int = ON;            // Issue a L2 interrupt
-                  }
-               }
-
-               if (icw_lcd[line] == 0x9) {           // SDLC ?
-                  if (icw_pdf_reg[line] == FILLED) { // New char avail to xmit ?
-                     transmitChar = icw_pdf[line];
-                     if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02)) {  // Trace scanner activities ?
-                        fprintf(S_trace, "\n#02L%1d> CS2[%1X]: PCF = 9 (re-)entered ",
-                                          line, icw_pcf[line]);
-                        fprintf(S_trace, "\n#02L%1d> CS2[%1X]: Transmitting PDF = *** %02X ***",
-                                          line, icw_pcf[line], icw_pdf[line]);
-                     }
-                     //*******************************************************
-                     proc_LIBtdata(transmitChar, icw_pcf[line], line);
-                     //*******************************************************
-
-                     // Next char please...
-                     icw_pdf_reg[line] = EMPTY;      // Ask NCP for next byte
-                     icw_scf[line] |= 0x40;          // Set norm char serv flag
-                     icw_pcf_nxt[line] = 0x9;        // Stay in PCF = 9...
-                     CS2_req_L2_int = ON;            // Issue a L2 interrupt
-                  }
-               }  // End SDLC
-               break;
-
-            case 0xA:                                // Transmit normal with new sync
-               if ((svc_req_L2 == ON) || (lvl == 2)) // If L2 interrupt active ?
-                  break;
-
-               if (icw_lcd[line] == 0xC) {           // BSC EBCDIC
-                  if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))
-                     fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: icw_pdf=%02X icw_scf=%02X lvl=%d\n",
-                                       line, icw_pcf[line], 0xff & icw_pdf[line], 0xff & icw_scf[line]);
-                  if ((icw_scf[line] & 0x40) == 0) { // New char avail to xmit ?
-                     transmitChar = icw_pdf[line];
-                     if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02)) {   // Trace scanner activities ?
-                        fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: State 9 ch=%02X \n",
-                                          line, icw_pcf[line], transmitChar);
-                     }
-                     //*******************************************************
-                     proc_LIBtdata(transmitChar,icw_pcf[line], line);
-                     //*******************************************************
-
-                     // Next byte please...
-                     icw_pdf_reg[line] = EMPTY;      // Ask NCP for next byte
-                     icw_scf[line] |= 0x40;          // Set norm char serv flag
-                     icw_pcf_nxt[line] = 0xA;        // Stay in PCF = A...
-                     CS2_req_L2_int = ON;            // Issue a L2 interrupt
-                  }
-               }  // End BSC
+               LINE_PROTO(line);
                break;
 
             case 0xB:                                // Not used
                break;
 
             case 0xC:                                // Transmit turnaround-turn RTS off
-               if (icw_lcd[line] == 0xC) {           // BSC EBCDIC
-                  if (icw_pcf_prev[line] != icw_pcf[line]) {  // First entry ?
-                     if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))
-                        fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: Now into state C.\n", line, icw_pcf[line]);
-                     transmitChar = icw_pdf[line];   // Will not be used.
-                     //*******************************************************
-                     proc_LIBtdata(transmitChar, icw_pcf[line], line);  //Signal line we are done
-                     //*******************************************************
-
-                     icw_lne_stat[line] = RX;        // Line turnaround to receiving...
-                     icw_scf[line] |= 0x40;          // Set norm char serv flag
-                     icw_pcf_nxt[line] = 0x5;        // Goto PCF = 5...
-                     CS2_req_L2_int = ON;            // ...and issue a L2 int
-                  }
-               }  //end BSC
-
-               if (icw_lcd[line] == 0x9) {           // SDLC ?
-                  if (icw_pcf_prev[line] != icw_pcf[line]) {  // First entry ?
-
-                     if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))  // Trace scanner activities ?
-                        fprintf(S_trace, "\n#02L%1d> CS2[%1X]: PCF = C entered, next PCF will be set by NCP ",
-                                          line, icw_pcf[line]);
-
-                     // ******************************************************************
-                     // Signal SDLC that final character has been received.
-                     proc_LIBtdata(transmitChar, icw_pcf[line], line);
-                     // ******************************************************************
-                     icw_lne_stat[line] = RX;        // Line turnaround to receiving...
-                     icw_scf[line] |= 0x40;          // Set norm char serv flag
-                     icw_pcf_nxt[line] = 0x5;        // Goto PCF = 5...
-                     CS2_req_L2_int = ON;            // ...and issue a L2 int
-                  }
-               }  // End SDLC
-               RS232[line] &= ~RTS;                 // Drop Request To Send and
-               RS232[line] &= ~CTS;                 // ...drop Clear To Send and
+               LINE_PROTO(line);
+               if (LIBduplex[line] == OFF) {         // A full duplex line keeps RTS and CTS on
+                  RS232[line] &= ~RTS;              // Drop Request To Send and
+                  RS232[line] &= ~CTS;              // ...drop Clear To Send and
+               }
                break;
 
             case 0xD:                                // Transmit turnaround-keep RTS on
-               if (icw_lcd[line] == 0xC) {           // BSC EBCDIC ?
-                  if (icw_pcf_prev[line] != icw_pcf[line]) {  // First entry ?
-                     if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))    // Trace scanner activities ?
-                        fprintf(S_trace, "\n#02L%1d> CS2[%1X]: PCF = D entered, next PCF will be set by NCP \n\r", line, icw_pcf[line]);
-                  }
-                     icw_pcf_nxt[line] = 0x5;        // Goto PCF = 5...
-                     CS2_req_L2_int = ON;            // ...and issue a L2 int
-                                                     // ==> ??? NO CS2_req_L2_int !
-               }  // End BSC
-
-               if (icw_lcd[line] == 0x9) {           // SDLC ?
-                  if (icw_pcf_prev[line] != icw_pcf[line]) {  // First entry ?
-                     if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))  // Trace scanner activities ?
-                        fprintf(S_trace, "\n#02L%1d> CS2[%1X]: PCF = D entered, next PCF will be set by NCP ",
-                                          line, icw_pcf[line]);
-                  }
-                  // NO CS2_req_L2_int !
-               }  // End SDLC
-
+               LINE_PROTO(line);
                break;
 
             case 0xE:                                // Not used
@@ -667,8 +788,11 @@ void *CS2_thread(void *arg) {
                fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: SVCL2 interrupt issued for PCF = %1X ",
                                  line, icw_pcf[line], icw_pcf[line]);
 
+            if (LIBspeed[line] == 0)                 // Unpaced line: do not wait for the scan cycle
+               busy = ON;
             while (svc_req_L2 == ON) {               // Wait till CCU has finished L2 processing
-               usleep(1000);                         // some time to finish L2.
+               if (coop_yield() == 0)                // COOP mode: let the CCU run, else give it
+                  usleep((busy == ON) ? 50 : 1000);  // some time to finish L2.
             }
 
             abar_int = line + 0x020;                 // Set ABAR with line # that caused the L2 int.
@@ -679,6 +803,7 @@ void *CS2_thread(void *arg) {
 
             svc_req_L2 = ON;                         // Issue a level 2 interrrupt
             CS2_req_L2_int = OFF;                    // Reset int req flag
+            raised = ON;
          }
 
 
@@ -694,8 +819,45 @@ void *CS2_thread(void *arg) {
                fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: Next PCF = %1X ",
                                  line, icw_pcf_prev[line], icw_pcf[line] );
          }
+
+         // Batched character service: while a receiving line has buffered
+         // data, serve its next character as soon as NCP has left the L2
+         // handler for this one, instead of after a full scan cycle (and its
+         // sleep). The run and each wait are bounded, so a NCP that stays in
+         // L2 does not hold up the other lines.
+         for (rxrun = 0; (raised == ON) && (rxrun < RXRUN); rxrun++) {
+            if (((icw_pcf[line] != 0x6) && (icw_pcf[line] != 0x7)) || (proc_LIBrpend(line) == 0))
+               break;
+            for (i = 0; (i < RXWAIT) && ((svc_req_L2 == ON) || (lvl == 2)); i++)
+               if (coop_yield() == 0)                // Wait till NCP has the character
+                  usleep(50);
+            if ((svc_req_L2 == ON) || (lvl == 2))    // Still in L2: on to the other lines
+               break;
+            raised = OFF;
+
+            pthread_mutex_lock(&icw_lock);
+            if (icw_pcf[line] != icw_pcf_nxt[line]) {   // pcf changed by NCP ?
+               icw_pcf_prev[line] = icw_pcf[line];
+               icw_pcf[line] = icw_pcf_nxt[line];
+            }
+            if (((icw_pcf[line] == 0x6) || (icw_pcf[line] == 0x7)) && proc_LIBpace(line, LIB_RX))
+               LINE_PROTO(line);
+            pthread_mutex_unlock(&icw_lock);
+
+            if (CS2_req_L2_int) {                    // Next character for NCP ?
+               abar_int = line + 0x020;              // Set ABAR with line # that caused the L2 int.
+               svc_req_L2 = ON;                      // Issue a level 2 interrrupt
+               CS2_req_L2_int = OFF;                 // Reset int req flag
+               raised = ON;
+            }
+            pthread_mutex_lock(&icw_lock);
+            icw_pcf_prev[line] = icw_pcf[line];      // Save current pcf
+            icw_pcf[line] = icw_pcf_nxt[line];       // Set new current pcf
+            pthread_mutex_unlock(&icw_lock);
+         }
       }  // End for line = 0 ---> MAX_LINES           // End of scanning one line, next please...
-      usleep(500);
+      if ((coop_yield() == 0) && (busy == OFF))      // COOP mode: back to the CCU each cycle
+         usleep(500);                                // Idle or paced lines only ?
 
    }  // End of while(1)...
    return (0);
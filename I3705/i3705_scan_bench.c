@@ -0,0 +1,530 @@
+/* Copyright (c) 2026, Edwin Freekenhorst and Henk Stegeman
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   i3705_scan_bench.c: Scanner and LIB benchmark driver.
+
+   This driver links the Communication Scanner (i3705_scan_T2.c) and the Line
+   Interface Base (i3705_lib.c) without the CCU.  A small NCP stub takes the
+   place of the NCP level 2 line service routines: it sets the PCF states,
+   services the L2 interrupts and feeds or consumes the PDF, exactly as the
+   CCU would do through the ICW external registers x'44' and x'45'.
+
+   For every line a remote station stand-in connects to the LIB line ports
+   (data and RS232 signal connection, like the i3274 does) and answers each
+   poll frame with a response frame of a configurable size.
+   With -stations n the line is multipoint: n stand-ins with station
+   addresses C1, C2, ... connect to it, each answering only polls for its
+   own address, and the NCP stub polls the addresses round robin.
+
+   One poll cycle per line:
+
+        NCP stub                 Scanner / LIB              Station
+        PCF 8 (RTS) ------------> RTS ----------------------->
+                    <------------ CTS <-----------------------
+        PCF 9 (char/L2) ... ----> LIB_tbuf
+        PCF C ------------------> send frame --------------->
+                                  LIB_rbuf <----------------- response frame
+        PCF 5/6/7 (char/L2) <---- ...
+
+   Reported per line:
+     - Characters per second (transmitted + received by the NCP stub).
+     - L2 latency: time from the stub completing a service request
+       until the scanner raises the next L2 interrupt for that line.
+     - Poll cycle time: PCF 8 set until the end flag of the response.
+
+   With -duplex the lines are full duplex (SET CPU DUPLEX=ALL:FULL): RTS and
+   CTS stay on, so PCF 8 does not wait for the station, and at a limited
+   speed each direction has the full line speed.
+
+   With -frames n each poll transmission is n frames: n-1 RR frames without
+   the poll bit, then the poll. The stations count the frames they get and
+   only answer the poll.
+
+   Usage: i3705_bench [-lines n] [-stations n] [-polls n] [-size n] [-frames n] [-speed bps] [-duplex] [-time sec] [-d]
+*/
+
+#include "sim_defs.h"
+#include "i3705_defs.h"
+#include "i3705_scanner.h"
+#include <ctype.h>
+#include <time.h>
+#include <poll.h>
+#include <ifaddrs.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define LIBLBASE        20             // LIB line ports start at 20 (as in i3705_lib.c)
+#define LEAD_DATA       0x44           // Lead identification (as in i3705_lib.c)
+#define LEAD_SIG        0x53
+#define BUFLEN_STN      16384          // Station stand-in buffer
+#define MAXSTN          8              // Stations per line (MAXSTAT in i3705_lib.c)
+
+// Stub NCP line phases
+#define PH_DOWN    0                   // Waiting for station connection
+#define PH_SETUP   1                   // Set mode / monitor DSR
+#define PH_TX      2                   // Transmitting poll frame
+#define PH_RX      3                   // Receiving response frame
+#define PH_DONE    4                   // All polls completed
+
+// Globals normally provided by the CCU (i3705_cpu.c)
+int32 Eregs_Inp[128] = { 0x0000 };     /* External regs X'00 -> X'7F' inp */
+int32 Eregs_Out[128] = { 0x0000 };     /* External regs X'00 -> X'7F' out */
+int8  svc_req_L2 = OFF;                /* SVC L2 request flag */
+int32 lvl = 5;                         /* Active Program Level (1...5) */
+int32 debug_reg = 0x00;                /* Bit flags for debug/trace */
+int32 cc = 1;
+FILE  *trace;
+int8  coop_mode = OFF;                 /* Scanner and LIB run as threads here */
+int   coop_yield(void) { return 0; }
+
+extern uint8_t icw_scf[];
+extern uint8_t icw_pdf[];
+extern uint8_t icw_lcd[];
+extern uint8_t icw_pcf[];
+extern uint8_t icw_pcf_nxt[];
+extern uint8_t icw_pdf_reg[];
+extern uint8_t RS232[];
+extern int abar_int;
+extern pthread_mutex_t icw_lock;
+extern uint16_t Sdbg_reg;
+
+void *CS2_thread(void *arg);
+void *LIB_thread(void *arg);
+t_stat lib_set_speed (UNIT *uptr, int32 val, char *cptr, void *desc);
+t_stat lib_set_duplex (UNIT *uptr, int32 val, char *cptr, void *desc);
+
+// Poll frame as the NCP sends it: Bflag, address, RR + poll, FCS, Eflag
+static uint8_t poll_frame[] = { 0x7E, 0xC1, 0x11, 0x47, 0x0F, 0x7E };
+
+struct BenchLine {
+   int      phase;                     // Stub NCP phase
+   int      txptr;                     // Next poll frame character
+   int      rxcnt;                     // Characters received in current frame
+   uint8_t  addr;                      // Station address polled in current cycle
+   long     polls;                     // Completed poll cycles
+   long     txchars;                   // Characters transmitted
+   long     rxchars;                   // Characters received
+   long     l2cnt;                     // L2 interrupts serviced
+   double   l2tot, l2max;              // L2 latency total and max (usec)
+   double   polltot, pollmax;          // Poll cycle time total and max (usec)
+   struct timespec svc_done;           // Last service completion
+   struct timespec poll_start;         // Start of current poll cycle
+} bline[MAX_LINES];
+
+struct BenchStn {
+   int      line;                      // Line the station is on
+   uint8_t  addr;                      // Its station address
+   long     answered;                  // Polls answered
+   long     frames;                    // Frames received for its address
+   volatile int up;                    // Both leads accepted by the LIB
+} bstn[MAX_LINES][MAXSTN];
+
+int nlines = 1;                        // Number of lines driven
+int nstations = 1;                     // Stations per line
+long npolls = 1000;                    // Poll cycles per line
+int rsize = 256;                       // Response frame size
+int nframes = 1;                       // Frames per poll transmission
+int maxtime = 60;                      // Benchmark time limit (sec)
+char *speed = "UNLIMITED";             // Line speed (SET CPU LINESPEED=ALL:speed)
+char *duplex = "HALF";                 // Line duplex (SET CPU DUPLEX=ALL:duplex)
+char *ipaddr;                          // LIB address
+
+// ***************************************************************
+// Stubs for the panel functions used by the LIB panel.
+// ***************************************************************
+void stringAtXY(int x, int y, char *buf, int colour) {
+   return;
+}
+
+void integerAtXY(int x, int y, int value, int colour) {
+   return;
+}
+
+// ***************************************************************
+// Channel adapter helpers used by the scanner (i3705_chan_T2.c).
+// ***************************************************************
+int Ireg_bit(int reg, int bit_mask) {
+   if ((Eregs_Inp[reg] & bit_mask) == 0x00)
+      return(OFF);
+   else
+      return(ON);
+}
+
+void wait() {
+   usleep(1);
+   return;
+}
+
+// ***************************************************************
+// Function to return elapsed time in usec.
+// ***************************************************************
+static double usec(struct timespec *from, struct timespec *to) {
+   return ((to->tv_sec - from->tv_sec) * 1000000.0) + ((to->tv_nsec - from->tv_nsec) / 1000.0);
+}
+
+// ***************************************************************
+// Station stand-in: nstations per line.
+// Connects the data and RS232 signal leads, returns CTS on RTS and
+// answers each poll frame for its address with a response frame
+// of rsize bytes.
+// ***************************************************************
+void *STN_thread(void *arg) {
+   struct BenchStn *stn = (struct BenchStn *)arg;
+   int line = stn->line;
+   int data_fd, sig_fd, rc, a, f, n, rlen = 0;
+   uint8_t sig, cts = CTS;
+   uint8_t rbuf[BUFLEN_STN], tbuf[BUFLEN_STN];
+   struct sockaddr_in servaddr, dataaddr;
+   socklen_t addrlen = sizeof(dataaddr);
+   uint8_t lead[3];
+   struct pollfd pfd[2];
+
+   // Build the response frame: Bflag, address, I-frame, data, FCS, Eflag
+   tbuf[0] = 0x7E;
+   tbuf[1] = stn->addr;
+   tbuf[2] = 0x10;
+   for (int i = 3; i < rsize - 3; i++)
+      tbuf[i] = 0x40;
+   tbuf[rsize - 3] = 0x47;
+   tbuf[rsize - 2] = 0x0F;
+   tbuf[rsize - 1] = 0x7E;
+
+   servaddr.sin_family = AF_INET;
+   servaddr.sin_addr.s_addr = inet_addr(ipaddr);
+   servaddr.sin_port = htons(37500 + LIBLBASE + line);
+   data_fd = socket(AF_INET, SOCK_STREAM, 0);
+   sig_fd = socket(AF_INET, SOCK_STREAM, 0);
+   while (connect(data_fd, (struct sockaddr*)&servaddr, sizeof(servaddr)) != 0)
+      usleep(10000);
+   while (connect(sig_fd, (struct sockaddr*)&servaddr, sizeof(servaddr)) != 0)
+      usleep(10000);
+   lead[0] = LEAD_DATA;                          // Identify the leads, so the LIB can pair them
+   send(data_fd, lead, 1, 0);
+   getsockname(data_fd, (struct sockaddr *)&dataaddr, &addrlen);
+   lead[0] = LEAD_SIG;
+   memcpy(&lead[1], &dataaddr.sin_port, 2);
+   send(sig_fd, lead, 3, 0);
+   usleep(200000);                               // Let the LIB pair both
+   stn->up = 1;
+
+   pfd[0].fd = data_fd;
+   pfd[0].events = POLLIN;
+   pfd[1].fd = sig_fd;
+   pfd[1].events = POLLIN;
+   while (1) {
+      if (poll(pfd, 2, 100) < 1)
+         continue;
+      if (pfd[1].revents & POLLIN) {
+         rc = read(sig_fd, &sig, 1);
+         if (rc < 1) break;
+         if (sig & RTS)
+            send(sig_fd, &cts, 1, 0);            // Ready to receive
+      }
+      if (pfd[0].revents & POLLIN) {
+         rc = read(data_fd, rbuf + rlen, sizeof(rbuf) - rlen);
+         if (rc < 1) break;
+         rlen = rlen + rc;
+         // Handle each complete frame (FCS and Eflag) in the buffer
+         for (n = 0, f = 0; n + 2 < rlen; n++) {
+            if ((rbuf[n] == 0x47) && (rbuf[n+1] == 0x0F) && (rbuf[n+2] == 0x7E)) {
+               for (a = f; (a < n) && (rbuf[a] == 0x7E); a++) ;
+               if ((a + 1 < n) && (rbuf[a] == stn->addr)) {   // For us ?
+                  stn->frames++;
+                  if (rbuf[a+1] & 0x10) {        // Polled ?
+                     send(data_fd, tbuf, rsize, 0);    // Send response frame
+                     stn->answered++;
+                  }
+               }
+               n = n + 2;
+               f = n + 1;
+            }
+         }
+         memmove(rbuf, rbuf + f, rlen - f);
+         rlen = rlen - f;
+         if (rlen == sizeof(rbuf))               // Garbage, discard
+            rlen = 0;
+      }
+   }
+   close(data_fd);
+   close(sig_fd);
+   return NULL;
+}
+
+// ***************************************************************
+// Start a poll cycle: fill PDF with the first character and
+// set PCF 8 (transmit initial - raise RTS).
+// Must be called with the icw_lock held.
+// ***************************************************************
+static void start_poll(int line) {
+   bline[line].phase = PH_TX;
+   bline[line].txptr = 1;
+   bline[line].rxcnt = 0;
+   bline[line].addr = 0xC1 + (bline[line].polls % nstations);   // Next station in the poll list
+   icw_lcd[line] = 0x9;                          // SDLC 8-bit
+   icw_pdf[line] = poll_frame[0];
+   icw_pdf_reg[line] = FILLED;
+   icw_pcf_nxt[line] = 0x8;
+   clock_gettime(CLOCK_MONOTONIC, &bline[line].poll_start);
+}
+
+// ***************************************************************
+// NCP stub L2 service routine for one line.
+// Must be called with the icw_lock held.
+// ***************************************************************
+static void service_L2(int line) {
+   struct BenchLine *bl = &bline[line];
+   struct timespec now;
+   double t;
+   int n;
+
+   switch (icw_pcf_nxt[line]) {
+      case 0x0:                                  // Set mode completed
+         if (bl->phase == PH_SETUP)
+            icw_pcf_nxt[line] = 0x2;             // Monitor DSR
+         break;
+
+      case 0x4:                                  // DSR on, line ready
+         if (bl->phase == PH_SETUP)
+            start_poll(line);
+         break;
+
+      case 0x9:                                  // Character transmitted
+         bl->txchars++;
+         if (bl->txptr < nframes * sizeof(poll_frame)) {
+            n = bl->txptr % sizeof(poll_frame);  // Character in the frame
+            if (n == 1)
+               icw_pdf[line] = bl->addr;
+            else if ((n == 2) && (bl->txptr < (nframes - 1) * sizeof(poll_frame)))
+               icw_pdf[line] = 0x01;             // RR without the poll bit
+            else
+               icw_pdf[line] = poll_frame[n];
+            bl->txptr++;
+            icw_pdf_reg[line] = FILLED;
+         } else {
+            icw_pcf_nxt[line] = 0xC;             // Turnaround, RTS off
+         }
+         break;
+
+      case 0x5:                                  // Turnaround completed
+         bl->phase = PH_RX;
+         break;
+
+      case 0x7:                                  // Character received
+         bl->rxchars++;
+         bl->rxcnt++;
+         icw_pdf_reg[line] = EMPTY;              // NCP has read pdf
+         break;
+
+      case 0x6:                                  // Flag detected
+         if ((bl->phase == PH_RX) && (bl->rxcnt > 0)) {   // End of frame ?
+            bl->rxchars++;                       // Count the Eflag
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            t = usec(&bl->poll_start, &now);
+            bl->polltot += t;
+            if (t > bl->pollmax) bl->pollmax = t;
+            bl->polls++;
+            if (bl->polls < npolls)
+               start_poll(line);
+            else {
+               bl->phase = PH_DONE;
+               icw_pcf_nxt[line] = 0x0;
+            }
+         }
+         break;
+   }
+   icw_scf[line] &= 0xBF;                        // Service Interlock RESET
+}
+
+int main(int argc, char *argv[]) {
+   pthread_t id1, id2, stn_id[MAX_LINES][MAXSTN];
+   int line, done, i;
+   struct ifaddrs *nwaddr, *ifa;
+   struct timespec start, now;
+   double elapsed, t;
+   long txtot = 0, rxtot = 0;
+   char sbuf[32];
+   int trace_on = 0;
+
+   i = 1;
+   while (i < argc) {
+      if ((strcmp(argv[i], "-lines") == 0) && (i + 1 < argc)) {
+         nlines = atoi(argv[i+1]);
+         i = i + 2;
+      } else if ((strcmp(argv[i], "-stations") == 0) && (i + 1 < argc)) {
+         nstations = atoi(argv[i+1]);
+         i = i + 2;
+      } else if ((strcmp(argv[i], "-polls") == 0) && (i + 1 < argc)) {
+         npolls = atol(argv[i+1]);
+         i = i + 2;
+      } else if ((strcmp(argv[i], "-size") == 0) && (i + 1 < argc)) {
+         rsize = atoi(argv[i+1]);
+         i = i + 2;
+      } else if ((strcmp(argv[i], "-frames") == 0) && (i + 1 < argc)) {
+         nframes = atoi(argv[i+1]);
+         i = i + 2;
+      } else if ((strcmp(argv[i], "-speed") == 0) && (i + 1 < argc)) {
+         speed = argv[i+1];
+         i = i + 2;
+      } else if (strcmp(argv[i], "-duplex") == 0) {
+         duplex = "FULL";
+         i++;
+      } else if ((strcmp(argv[i], "-time") == 0) && (i + 1 < argc)) {
+         maxtime = atoi(argv[i+1]);
+         i = i + 2;
+      } else if (strcmp(argv[i], "-d") == 0) {
+         trace_on = 1;
+         i++;
+      } else {
+         printf("BENCH: invalid argument %s\n", argv[i]);
+         printf("   Valid arguments are:\n");
+         printf("    -lines {n}   : number of lines to drive (1..%d)\n", MAX_LINES);
+         printf("    -stations {n}: stations per (multipoint) line (1..%d)\n", MAXSTN);
+         printf("    -polls {n}   : poll cycles per line\n");
+         printf("    -size {n}    : response frame size in bytes\n");
+         printf("    -frames {n}  : frames per poll transmission\n");
+         printf("    -speed {bps} : line speed (9600, 56K, T1 or UNLIMITED)\n");
+         printf("    -duplex      : full duplex lines\n");
+         printf("    -time {sec}  : benchmark time limit\n");
+         printf("    -d           : trace scanner and line I/O to trace_S.log\n");
+         return 1;
+      }
+   }
+   if ((nlines < 1) || (nlines > MAX_LINES) || (nstations < 1) || (nstations > MAXSTN) ||
+       (rsize < 8) || (rsize > BUFLEN_STN) || (npolls < 1) || (nframes < 1)) {
+      printf("BENCH: Invalid lines, stations, polls, size or frames argument\n");
+      return 1;
+   }
+   snprintf(sbuf, sizeof(sbuf), "ALL:%s", speed);
+   for (i = 0; sbuf[i] != '\0'; i++)
+      sbuf[i] = toupper(sbuf[i]);
+   if (lib_set_speed(NULL, 0, sbuf, NULL) != SCPE_OK) {
+      printf("BENCH: Invalid speed argument %s\n", speed);
+      return 1;
+   }
+   snprintf(sbuf, sizeof(sbuf), "ALL:%s", duplex);
+   lib_set_duplex(NULL, 0, sbuf, NULL);
+
+   // Use the same network address as the LIB does.
+   getifaddrs(&nwaddr);
+   for (ifa = nwaddr; ifa != NULL; ifa = ifa->ifa_next) {
+      if (ifa->ifa_addr != NULL && ifa->ifa_addr->sa_family == AF_INET && strcmp(ifa->ifa_name, "lo")) {
+         ipaddr = strdup(inet_ntoa(((struct sockaddr_in *)ifa->ifa_addr)->sin_addr));
+         break;
+      }
+   }
+   freeifaddrs(nwaddr);
+   if (ipaddr == NULL) {
+      printf("BENCH: No network interface available for the LIB\n");
+      return 1;
+   }
+
+   pthread_mutex_init(&icw_lock, NULL);
+   pthread_create(&id1, NULL, LIB_thread, NULL);
+   pthread_create(&id2, NULL, CS2_thread, NULL);
+   sleep(1);                                     // Let the LIB listeners come up
+   if (trace_on)
+      Sdbg_reg = 0x06;                           // Trace scanner and line I/O (CS2_thread clears it at start)
+
+   for (line = 0; line < nlines; line++) {
+      bline[line].phase = PH_DOWN;
+      for (i = 0; i < nstations; i++) {
+         bstn[line][i].line = line;
+         bstn[line][i].addr = 0xC1 + i;
+         pthread_create(&stn_id[line][i], NULL, STN_thread, &bstn[line][i]);
+      }
+   }
+   printf("BENCH: %d line(s), %d station(s) per line, %ld polls per line, %d byte response frames, speed %s, %s duplex\n",
+          nlines, nstations, npolls, rsize, speed, duplex);
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   for (line = 0; line < nlines; line++)
+      clock_gettime(CLOCK_MONOTONIC, &bline[line].svc_done);
+
+   // ********************************************************************
+   // NCP stub loop: bring up the lines and service the L2 interrupts.
+   // ********************************************************************
+   do {
+      for (line = 0; line < nlines; line++) {
+         for (i = 0; (i < nstations) && bstn[line][i].up; i++) ;
+         if ((bline[line].phase == PH_DOWN) && (RS232[line] & DCD) &&
+             (i == nstations)) {                 // A lost poll is never retried: wait for all stations
+            pthread_mutex_lock(&icw_lock);
+            bline[line].phase = PH_SETUP;
+            icw_lcd[line] = 0x8;                 // SDLC
+            icw_pcf_nxt[line] = 0x1;             // Set mode - DTR on
+            pthread_mutex_unlock(&icw_lock);
+         }
+      }
+
+      if (svc_req_L2 == ON) {
+         lvl = 2;                                // Enter level 2
+         line = abar_int - 0x020;
+         svc_req_L2 = OFF;                       // Input x'40' resets the L2 request
+         clock_gettime(CLOCK_MONOTONIC, &now);
+         if ((line >= 0) && (line < nlines)) {
+            t = usec(&bline[line].svc_done, &now);
+            bline[line].l2tot += t;
+            if (t > bline[line].l2max) bline[line].l2max = t;
+            bline[line].l2cnt++;
+            pthread_mutex_lock(&icw_lock);
+            service_L2(line);
+            pthread_mutex_unlock(&icw_lock);
+            clock_gettime(CLOCK_MONOTONIC, &bline[line].svc_done);
+         }
+         lvl = 5;                                // Exit level 2
+      } else {
+         usleep(1);
+      }
+
+      done = 1;
+      for (line = 0; line < nlines; line++)
+         if (bline[line].phase != PH_DONE) done = 0;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      elapsed = usec(&start, &now) / 1000000.0;
+   } while ((done == 0) && (elapsed < maxtime));
+
+   if (done == 0)
+      printf("BENCH: Time limit of %d seconds reached, results are partial\n", maxtime);
+
+   printf("\nLine   Polls   Tx chars   Rx chars    Chars/s   L2 avg(us)  L2 max(us)  Poll avg(us)  Poll max(us)\n");
+   for (line = 0; line < nlines; line++) {
+      struct BenchLine *bl = &bline[line];
+      printf("%4d %7ld %10ld %10ld %10.0f %12.1f %11.1f %13.1f %13.1f\n",
+             line + LIBLBASE, bl->polls, bl->txchars, bl->rxchars,
+             (bl->txchars + bl->rxchars) / elapsed,
+             bl->l2cnt ? bl->l2tot / bl->l2cnt : 0.0, bl->l2max,
+             bl->polls ? bl->polltot / bl->polls : 0.0, bl->pollmax);
+      txtot += bl->txchars;
+      rxtot += bl->rxchars;
+   }
+   if ((nstations > 1) || (nframes > 1)) {
+      printf("\nLine  Station  Polls answered  Frames received\n");
+      for (line = 0; line < nlines; line++)
+         for (i = 0; i < nstations; i++)
+            printf("%4d       %02X %15ld %16ld\n", line + LIBLBASE, bstn[line][i].addr,
+                   bstn[line][i].answered, bstn[line][i].frames);
+   }
+   printf("Total: %ld chars in %.2f seconds, %.0f chars/s\n", txtot + rxtot, elapsed, (txtot + rxtot) / elapsed);
+   return 0;
+}
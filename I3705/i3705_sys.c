@@ -32,13 +32,15 @@ extern FILE *trace;        // DEBUG HJS
 
 extern int32 lvl;
 extern int32 Grp;
-extern int32 GR[8][4];
+extern int32 GR[][4];
 extern int8  CL_C[4], CL_Z[4];
 extern int8  test_mode;
-extern int32 Eregs_Inp[128];
-extern int32 Eregs_Out[128];
+extern int32 Eregs_Inp[];
+extern int32 Eregs_Out[];
 extern unsigned char M[];
 extern int32 saved_PC;
+extern int8  hle_on;
+void hle_scan(void);
 char *parse_addr(char *cptr,  char *gbuf, t_addr *addr, int32 *addrtype);
 
 int32 printf_sym (FILE *of, char *strg, t_addr addr, uint32 *val,
@@ -75,7 +77,8 @@ const char *sim_stop_messages[] = {
     "Invalid Qbyte",
     "Invalid Address",
     "Invalid Device Command",
-    "ATTN Card Reader"
+    "ATTN Card Reader",
+    "Decode table mismatch"
 };
 
 /* This is the opcode master defintion table.  Each possible instr mnemonic
@@ -181,6 +184,8 @@ t_stat sim_load (FILE *fileref, char *cptr, char *fnam, int flag) {
    }
    printf("\n\r");
    printf ("%d Bytes loaded. Last byte stored at loc %05X.\n", i, addr-1);
+   if (hle_on == ON)                                  /* Find hot NCP loops */
+      hle_scan();
    return (SCPE_OK);
 }
 
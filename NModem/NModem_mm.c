@@ -52,6 +52,8 @@
 #define OFF 0
 
 #define LINEBASE   37500
+#define LEAD_DATA  0x44    /* First byte on the data lead ('D')    */
+#define LEAD_SIG   0x53    /* First byte on the signal lead ('S')  */
 
 uint16_t Tdbg_flag = OFF;          /* 1 when Ttrace.log open */
 FILE *T_trace;
@@ -64,6 +66,7 @@ uint8_t        LINE_rbuf[65536];    /* Line Read Buffer                      */
 uint16_t       LINErlen;            /* Buffer size of received data          */
 
 int SocketReadAct (int fd);
+void SendLeadID (int data_fd, int rs232_fd);
 
 
 //*********************************************************************
@@ -282,6 +285,7 @@ void main(int argc, char *argv[]) {
             rc2 = connect(rs232f_fd, line1host->ai_addr,line1host->ai_addrlen);
          }  // End if ((rc1 = 0) && (!(IsSocketConnected(rs232f_fd))))
          if ((rc1 == 0) && (rc2 == 0)) {
+            SendLeadID(line1_fd, rs232f_fd);
             printf("\rNModem: Line 1 connection has been established\n");
             line1state = RDY;    // Line is now ready
          }  // End if ((rc1 == 0) && (rc2 == 0))
@@ -295,6 +299,7 @@ void main(int argc, char *argv[]) {
             rc2 = connect(rs232s_fd, line2host->ai_addr,line2host->ai_addrlen);
          }  // End if ((rc1 = 0) && (!(IsSocketConnected(rs232s_fd))))
          if ((rc1 == 0) && (rc2 == 0)) {
+            SendLeadID(line2_fd, rs232s_fd);
             printf("\rNModem: Line 2 connection has been established\n");
             line2state = RDY; // Line is now ready
          }  // End if ((rc1 == 0) && (rc2 == 0))
@@ -416,6 +421,24 @@ void main(int argc, char *argv[]) {
    return;
 }
 
+//*******************************************************************************************
+// Identify the two leads to a 3705 line: the data lead starts with LEAD_DATA, the RS232    *
+// signal lead with LEAD_SIG and the local port of the data lead, so the LIB can pair them. *
+//*******************************************************************************************
+void SendLeadID(int data_fd, int rs232_fd) {
+   struct sockaddr_in addr;
+   socklen_t addrlen = sizeof(addr);
+   uint8_t lead[3];
+
+   lead[0] = LEAD_DATA;
+   send(data_fd, lead, 1, 0);
+   getsockname(data_fd, (struct sockaddr *)&addr, &addrlen);
+   lead[0] = LEAD_SIG;
+   memcpy(&lead[1], &addr.sin_port, 2);                  // Port in network byte order
+   send(rs232_fd, lead, 3, 0);
+   return;
+}
+
 /*-------------------------------------------------------------------*/
 /* Check if there is read activiy on the socket                      */
 /* This is used by the caller to detect a connection break           */
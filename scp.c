@@ -385,6 +385,8 @@ void *CA_T2_thread(void *arg);                      /* HJS for i3705 sim */
 void *CS2_thread(void *arg);
 void *PNL_thread(void *arg);
 void *LIB_thread(void *arg);
+extern int8 coop_mode;                              /* i3705 -c: run them in the CCU thread */
+int coop_start(const char *name, void *(*rtn)(void *));
 
 
 /* Global data */
@@ -705,6 +707,20 @@ argc = ccommand (&argv);
 
 pthread_t thread;
 
+for (i = 1; i < argc; i++)                              /* Cooperative run mode requested ? */
+    if ((argv[i] != NULL) && (*argv[i] == '-') &&
+        ((sw = get_switches (argv[i])) > 0) && (sw & SWMASK ('C')))
+        coop_mode = 1;
+
+if (coop_mode) {                                        /* CA, scanner and LIB as coroutines */
+   if ((coop_start("CA", CA_T2_thread) != 0) ||         /* ...serviced from the event queue */
+       (coop_start("CS2", CS2_thread) != 0) ||
+       (coop_start("LIB", LIB_thread) != 0)) {
+      fprintf (stderr, "\r\nCan't create cooperative task\n");
+      exit(1);
+   }
+}
+else {
                                                         /* Start the type 2 channel adaptor execution thread */
 rc = pthread_create(&thread, NULL, CA_T2_thread, NULL);
 if (rc != 0) {                                          /* Any problems ? */
@@ -721,6 +737,7 @@ if (rc != 0) {                                          /* Any problems ? */
            strerror(errno));
    exit(1);
 }
+}
 
 rc = pthread_create(&thread, NULL, PNL_thread, NULL);
 if (rc != 0) {                                          /* Any problems ? */
@@ -730,6 +747,7 @@ if (rc != 0) {                                          /* Any problems ? */
    exit(1);
 }
 
+if (!coop_mode) {
 rc = pthread_create(&thread, NULL, LIB_thread, NULL);
 if (rc != 0) {                                          /* Any problems ? */
    fprintf (stderr,
@@ -737,6 +755,7 @@ if (rc != 0) {                                          /* Any problems ? */
            strerror(errno));
    exit(1);
 }
+}
 
 //*** Multi thread support coding ends here  HJS
 